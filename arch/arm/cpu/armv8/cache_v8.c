@@ -335,6 +335,41 @@ static int count_required_pts(u64 addr, int level, u64 maxaddr)
 	return r;
 }
 
+/* Whether mem_map is the one that the tables built at compile time are for */
+static bool use_static_pgtables(void)
+{
+	const struct mm_region *map = mm_static_pgtables.map;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_ARMV8_STATIC_PGTABLES))
+		return false;
+
+	for (i = 0; map[i].size || map[i].attrs; i++) {
+		if (mem_map[i].virt != map[i].virt ||
+		    mem_map[i].phys != map[i].phys ||
+		    mem_map[i].size != map[i].size ||
+		    mem_map[i].attrs != map[i].attrs)
+			return false;
+	}
+
+	return !mem_map[i].size && !mem_map[i].attrs;
+}
+
+/* Returns the number of page tables that setup_static_pgtables() creates */
+static int count_static_pts(void)
+{
+	int count = 1;
+	int slot;
+
+	for (slot = 0; slot < MM_STATIC_SLOTS; slot++) {
+		if ((mm_static_pgtables.l1[slot] & PTE_TYPE_MASK) ==
+		    PTE_TYPE_TABLE)
+			count++;
+	}
+
+	return count;
+}
+
 /* Returns the estimated required size of all page tables */
 __weak u64 get_page_table_size(void)
 {
@@ -348,7 +383,11 @@ __weak u64 get_page_table_size(void)
 		start_level = 1;
 
 	/* Account for all page tables we would need to cover our memory map */
-	size = one_pt * count_required_pts(0, start_level - 1, 1ULL << va_bits);
+	if (use_static_pgtables())
+		size = one_pt * count_static_pts();
+	else
+		size = one_pt * count_required_pts(0, start_level - 1,
+						   1ULL << va_bits);
 
 	/*
 	 * We need to duplicate our page table once to have an emergency pt to
@@ -365,6 +404,76 @@ __weak u64 get_page_table_size(void)
 	return size;
 }
 
+/* Returns the end of the highest DRAM bank, or 0 if they are not known yet */
+static u64 get_dram_end(void)
+{
+	u64 end = 0;
+	int i;
+
+	if (!gd->bd)
+		return 0;
+	for (i = 0; i < CONFIG_NR_DRAM_BANKS; i++) {
+		if (gd->bd->bi_dram[i].size)
+			end = max(end, (u64)gd->bd->bi_dram[i].start +
+				       gd->bd->bi_dram[i].size);
+	}
+
+	return end;
+}
+
+__weak int mmu_dram_is_shared(u64 start, u64 size)
+{
+	return 0;
+}
+
+/*
+ * Unmap a normal-memory block which lies entirely above the end of the
+ * highest DRAM bank, unless the board shares it with others
+ */
+static void trim_static_pte(u64 *pte, u64 va, u64 size, u64 dram_end)
+{
+	if (!dram_end || va < dram_end || pte_type(pte) != PTE_TYPE_BLOCK)
+		return;
+	if (mmu_dram_is_shared(va, size))
+		return;
+	if ((*pte & PMD_ATTRINDX_MASK) == PMD_ATTRINDX(MT_NORMAL))
+		*pte = PTE_TYPE_FAULT;
+}
+
+/*
+ * Copy the page tables built at compile time. The only thing left to do at
+ * run time is to drop the blocks of the DRAM window which have no DRAM behind
+ * them, once the DRAM banks are known.
+ */
+static void setup_static_pgtables(void)
+{
+	const struct mm_static_pgtables *spt = &mm_static_pgtables;
+	u64 l1size = 1ULL << level2shift(1);
+	u64 l2size = 1ULL << level2shift(2);
+	u64 dram_end = get_dram_end();
+	u64 *l1, *l2;
+	u64 va;
+	int slot, i;
+
+	l1 = create_table();
+	for (slot = 0; slot < MM_STATIC_SLOTS; slot++) {
+		va = slot * l1size;
+		if ((spt->l1[slot] & PTE_TYPE_MASK) != PTE_TYPE_TABLE) {
+			l1[slot] = spt->l1[slot];
+			trim_static_pte(&l1[slot], va, l1size, dram_end);
+			continue;
+		}
+
+		l2 = create_table();
+		memcpy(l2, spt->l2[spt->l1[slot] >> PAGE_SHIFT],
+		       MAX_PTE_ENTRIES * sizeof(u64));
+		for (i = 0; dram_end && i < MAX_PTE_ENTRIES; i++)
+			trim_static_pte(&l2[i], va + i * l2size, l2size,
+					dram_end);
+		set_pte_table(&l1[slot], l2);
+	}
+}
+
 void setup_pgtables(void)
 {
 	int i;
@@ -372,6 +481,11 @@ void setup_pgtables(void)
 	if (!gd->arch.tlb_fillptr || !gd->arch.tlb_addr)
 		panic("Page table pointer not setup.");
 
+	if (use_static_pgtables()) {
+		setup_static_pgtables();
+		return;
+	}
+
 	/*
 	 * Allocate the first level we're on with invalidate entries.
 	 * If the starting level is 0 (va_bits >= 39), then this is our
@@ -449,11 +563,158 @@ inline void flush_dcache_all(void)
 }
 
 #ifndef CONFIG_SYS_DISABLE_DCACHE_OPS
+#ifdef CONFIG_ARMV8_DCACHE_RANGES
+/* Number of ranges held by a batch and by the dirty set */
+#define DCACHE_RANGES	16
+
+/**
+ * struct dcache_ranges - list of address ranges aligned to cache lines
+ *
+ * Ranges which overlap or touch are merged as they are added, so each line
+ * is only operated on once.
+ *
+ * @start: Start address of each range
+ * @end: End address of each range (exclusive)
+ * @count: Number of ranges in use
+ * @overflow: true if a range did not fit, so that the list is incomplete
+ */
+struct dcache_ranges {
+	ulong start[DCACHE_RANGES];
+	ulong end[DCACHE_RANGES];
+	int count;
+	bool overflow;
+};
+
+/* These are used before relocation, when BSS is not available */
+static struct dcache_ranges dcache_batch __section(".data");
+static int dcache_batch_depth __section(".data");
+static struct dcache_ranges dcache_dirty __section(".data");
+
+static ulong dcache_line_size(void)
+{
+	ulong ctr;
+
+	asm volatile("mrs %0, ctr_el0" : "=r" (ctr));
+
+	return 4UL << ((ctr >> 16) & 0xf);
+}
+
+/* Returns false if @list is full and the range does not touch any in it */
+static bool dcache_ranges_add(struct dcache_ranges *list, ulong start,
+			      ulong stop)
+{
+	ulong line = dcache_line_size();
+	int i;
+
+	start = ALIGN_DOWN(start, line);
+	stop = ALIGN(stop, line);
+	if (start >= stop)
+		return true;
+
+	for (i = 0; i < list->count; i++) {
+		if (start > list->end[i] || stop < list->start[i])
+			continue;
+		/* Take the range out and look again, as it may now touch others */
+		start = min(start, list->start[i]);
+		stop = max(stop, list->end[i]);
+		list->count--;
+		list->start[i] = list->start[list->count];
+		list->end[i] = list->end[list->count];
+		i = -1;
+	}
+	if (list->count == DCACHE_RANGES)
+		return false;
+	list->start[list->count] = start;
+	list->end[list->count] = stop;
+	list->count++;
+
+	return true;
+}
+
+static void dcache_batch_flush(void)
+{
+	int i;
+
+	for (i = 0; i < dcache_batch.count; i++)
+		__asm_flush_dcache_range(dcache_batch.start[i],
+					 dcache_batch.end[i]);
+	dcache_batch.count = 0;
+}
+
+/*
+ * Starts a batch of I/O set-up, during which flush_dcache_range() only queues
+ * its range. The queued ranges are flushed together by dcache_batch_end(), so
+ * the device must not look at the memory until then. Batches may be nested.
+ */
+void dcache_batch_start(void)
+{
+	dcache_batch_depth++;
+}
+
+void dcache_batch_end(void)
+{
+	if (!dcache_batch_depth)
+		return;
+	dcache_batch_depth--;
+	if (!dcache_batch_depth)
+		dcache_batch_flush();
+}
+
+void dcache_mark_dirty(ulong start, ulong size)
+{
+	if (!dcache_ranges_add(&dcache_dirty, start, start + size))
+		dcache_dirty.overflow = true;
+}
+
+/*
+ * Cleans the dirty ranges and the stack, then turns off the data cache and
+ * the MMU. Nothing else written since the cache was enabled reaches memory,
+ * so the caller must have marked everything which the next stage reads.
+ * Falls back to dcache_disable() when the set is incomplete or too large for
+ * cleaning by address to be quicker than cleaning by set/way.
+ */
+void dcache_disable_dirty(ulong stack_top)
+{
+	ulong sctlr = get_sctlr();
+	ulong total = 0;
+	ulong sp;
+	int i;
+
+	if (!(sctlr & CR_C))
+		return;
+
+	for (i = 0; i < dcache_dirty.count; i++)
+		total += dcache_dirty.end[i] - dcache_dirty.start[i];
+	if (dcache_dirty.overflow || total > CONFIG_ARMV8_DCACHE_DIRTY_LIMIT) {
+		dcache_disable();
+		invalidate_dcache_all();
+		return;
+	}
+
+	for (i = 0; i < dcache_dirty.count; i++)
+		__asm_flush_dcache_range(dcache_dirty.start[i],
+					 dcache_dirty.end[i]);
+	dcache_dirty.count = 0;
+
+	/* The callers' frames are read back after the cache is off */
+	asm volatile("mov %0, sp" : "=r" (sp));
+	__asm_flush_dcache_range(sp, stack_top);
+	set_sctlr(sctlr & ~(CR_C | CR_M));
+
+	__asm_invalidate_tlb_all();
+	invalidate_dcache_all();
+}
+#endif /* CONFIG_ARMV8_DCACHE_RANGES */
+
 /*
  * Invalidates range in all levels of D-cache/unified cache
  */
 void invalidate_dcache_range(unsigned long start, unsigned long stop)
 {
+#ifdef CONFIG_ARMV8_DCACHE_RANGES
+	/* Keep the order of operations, as an invalidate may drop writes */
+	dcache_batch_flush();
+#endif
 	__asm_invalidate_dcache_range(start, stop);
 }
 
@@ -462,6 +723,15 @@ void invalidate_dcache_range(unsigned long start, unsigned long stop)
  */
 void flush_dcache_range(unsigned long start, unsigned long stop)
 {
+#ifdef CONFIG_ARMV8_DCACHE_RANGES
+	if (dcache_batch_depth) {
+		if (!dcache_ranges_add(&dcache_batch, start, stop)) {
+			dcache_batch_flush();
+			dcache_ranges_add(&dcache_batch, start, stop);
+		}
+		return;
+	}
+#endif
 	__asm_flush_dcache_range(start, stop);
 }
 #else
@@ -513,9 +783,14 @@ u64 *__weak arch_get_page_table(void) {
 	return NULL;
 }
 
-static bool is_aligned(u64 addr, u64 size, u64 align)
+/*
+ * Whether the whole block at @addr is inside the range. The rest of the range
+ * is handled by the next blocks, so a range which is not a multiple of the
+ * block size only splits the blocks at its ends.
+ */
+static bool covers_block(u64 addr, u64 size, u64 blocksize)
 {
-	return !(addr & (align - 1)) && !(size & (align - 1));
+	return !(addr & (blocksize - 1)) && size >= blocksize;
 }
 
 /* Use flag to indicate if attrs has more than d-cache attributes */
@@ -524,9 +799,10 @@ static u64 set_one_region(u64 start, u64 size, u64 attrs, bool flag, int level)
 	int levelshift = level2shift(level);
 	u64 levelsize = 1ULL << levelshift;
 	u64 *pte = find_pte(start, level);
+	bool table = level < 3 && pte_type(pte) == PTE_TYPE_TABLE;
 
 	/* Can we can just modify the current level block PTE? */
-	if (is_aligned(start, size, levelsize)) {
+	if (!table && covers_block(start, size, levelsize)) {
 		if (flag) {
 			*pte &= ~PMD_ATTRMASK;
 			*pte |= attrs & PMD_ATTRMASK;
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Generate the page tables for a fixed memory map at build time
+ *
+ * The memory map header of the board (CONFIG_ARMV8_STATIC_PGTABLES_MAP) is
+ * built into this tool, which writes out a C file defining mm_static_pgtables.
+ * setup_pgtables() then copies those tables into place instead of building
+ * them from mem_map one block at a time.
+ *
+ * The map must lie within the first 4GB and each region must be aligned to
+ * 2MB, so that every 1GB slot is either a block, a fault or a table of 2MB
+ * blocks.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef unsigned long long u64;
+
+/* As in U-Boot's linux/const.h, which the host's one may be found instead of */
+#define UL(x)		(_UL(x))
+
+#include MEM_MAP_HEADER
+
+#define L1_SHIFT	30
+#define L2_SHIFT	21
+#define L2_ENTRIES	512
+
+static const struct mm_region *map = board_mem_map;
+
+static int map_count(void)
+{
+	int i;
+
+	for (i = 0; map[i].size || map[i].attrs; i++)
+		;
+
+	return i;
+}
+
+static void check_map(void)
+{
+	u64 align = (1ULL << L2_SHIFT) - 1;
+	u64 limit = (u64)MM_STATIC_SLOTS << L1_SHIFT;
+	int i;
+
+	for (i = 0; i < map_count(); i++) {
+		if ((map[i].virt | map[i].phys | map[i].size) & align ||
+		    map[i].virt + map[i].size > limit) {
+			fprintf(stderr, "mkpgtables: region %#llx+%#llx ",
+				map[i].virt, map[i].size);
+			fprintf(stderr, "is not 2MB-aligned within 4GB\n");
+			exit(1);
+		}
+	}
+}
+
+/* Returns the descriptor for the block of 1 << @shift bytes at @va */
+static u64 block_desc(u64 va, int shift)
+{
+	u64 end = va + (1ULL << shift);
+	int i;
+
+	for (i = 0; i < map_count(); i++) {
+		if (va >= map[i].virt && end <= map[i].virt + map[i].size)
+			return (va - map[i].virt + map[i].phys) | map[i].attrs |
+				PTE_TYPE_BLOCK | PTE_BLOCK_AF;
+	}
+
+	return PTE_TYPE_FAULT;
+}
+
+/* Whether a region covers part of the slot at @va, but not all of it */
+static int slot_is_split(u64 va)
+{
+	u64 end = va + (1ULL << L1_SHIFT);
+	u64 start, stop;
+	int i;
+
+	for (i = 0; i < map_count(); i++) {
+		start = map[i].virt;
+		stop = start + map[i].size;
+		if (start < end && stop > va && (start > va || stop < end))
+			return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	u64 l1[MM_STATIC_SLOTS];
+	int tables = 0;
+	int slot, i;
+
+	check_map();
+
+	printf("/* Generated by mkpgtables from %s, do not edit */\n\n",
+	       MEM_MAP_HEADER);
+	printf("#include <common.h>\n#include <asm/armv8/mmu.h>\n\n");
+
+	printf("static const struct mm_region map[] = {\n");
+	for (i = 0; i < map_count(); i++)
+		printf("\t{ %#llxULL, %#llxULL, %#llxULL, %#llxULL },\n",
+		       map[i].virt, map[i].phys, map[i].size, map[i].attrs);
+	printf("\t{ 0, }\n};\n\n");
+
+	for (slot = 0; slot < MM_STATIC_SLOTS; slot++) {
+		u64 va = (u64)slot << L1_SHIFT;
+
+		if (!slot_is_split(va)) {
+			l1[slot] = block_desc(va, L1_SHIFT);
+			continue;
+		}
+
+		if (!tables)
+			printf("static const u64 l2[][%d] = {\n", L2_ENTRIES);
+		printf("\t{\t/* 0x%08llx */\n", va);
+		for (i = 0; i < L2_ENTRIES; i++)
+			printf("%s%#llxULL,%s", i % 4 ? " " : "\t\t",
+			       block_desc(va + ((u64)i << L2_SHIFT), L2_SHIFT),
+			       i % 4 == 3 ? "\n" : "");
+		printf("\t},\n");
+		l1[slot] = PTE_TYPE_TABLE | (u64)tables++ << PAGE_SHIFT;
+	}
+	if (tables)
+		printf("};\n\n");
+
+	printf("const struct mm_static_pgtables mm_static_pgtables = {\n");
+	printf("\t.map = map,\n\t.l1 = {\n");
+	for (slot = 0; slot < MM_STATIC_SLOTS; slot++)
+		printf("\t\t%#llxULL,\n", l1[slot]);
+	printf("\t},\n\t.l2 = %s,\n};\n", tables ? "l2" : "NULL");
+
+	return 0;
+}
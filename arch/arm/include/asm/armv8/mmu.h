@@ -135,6 +135,43 @@ struct mm_region {
 extern struct mm_region *mem_map;
 void setup_pgtables(void);
 u64 get_tcr(int el, u64 *pips, u64 *pva_bits);
+
+/* Number of 1GB level-1 slots covered by struct mm_static_pgtables */
+#define MM_STATIC_SLOTS		4
+
+/**
+ * struct mm_static_pgtables - page tables built at compile time
+ *
+ * With CONFIG_ARMV8_STATIC_PGTABLES, mkpgtables generates these from the
+ * memory map of the board, which must lie within the first 4GB and be aligned
+ * to 2MB. setup_pgtables() then only copies them into place.
+ *
+ * @map: Memory map the tables were built from, ending with an empty region
+ * @l1: Level-1 descriptor of each slot. Table descriptors hold the index of
+ *	the level-2 table in @l2 instead of its address.
+ * @l2: Level-2 tables, made of 2MB blocks
+ */
+struct mm_static_pgtables {
+	const struct mm_region *map;
+	u64 l1[MM_STATIC_SLOTS];
+	const u64 (*l2)[512];
+};
+
+extern const struct mm_static_pgtables mm_static_pgtables;
+
+/**
+ * mmu_dram_is_shared() - check whether DRAM above the banks stays mapped
+ *
+ * With CONFIG_ARMV8_STATIC_PGTABLES, the normal-memory blocks above the end of
+ * the highest DRAM bank are unmapped. A board whose DRAM window also holds
+ * memory that it shares with other clusters, or loads images into for them,
+ * returns non-zero for those blocks to keep them mapped.
+ *
+ * @start: Start of the block
+ * @size: Size of the block
+ * @return non-zero to keep the block mapped, 0 to unmap it
+ */
+int mmu_dram_is_shared(u64 start, u64 size);
 #endif
 
 #endif /* _ASM_ARMV8_MMU_H_ */
@@ -27,6 +27,8 @@
 #include <asm/byteorder.h>
 #include <linux/libfdt.h>
 #include <mapmem.h>
+#include <sample_prof.h>
+#include <serial.h>
 #include <fdt_support.h>
 #include <asm/bootm.h>
 #include <asm/secure.h>
@@ -113,6 +115,10 @@ static void announce_and_cleanup(int fake)
 
 	board_quiesce_devices();
 
+#ifdef CONFIG_SAMPLE_PROF
+	sample_prof_stop();
+#endif
+
 	printf("\nStarting kernel ...%s\n\n", fake ?
 		"(fake run for tracing)" : "");
 	/*
@@ -125,6 +131,11 @@ static void announce_and_cleanup(int fake)
 	/* Remove all active vital devices next */
 	dm_remove_devices_flags(DM_REMOVE_ACTIVE_ALL);
 
+#if CONFIG_IS_ENABLED(DM_SERIAL)
+	/* Console output may still be queued for the UART interrupt */
+	serial_flush();
+#endif
+
 	cleanup_before_linux();
 }
 
@@ -179,10 +179,10 @@ int cleanup_before_boot_other(void)
 
 	/*
 	 * turn off D-cache
-	 * dcache_disable() in turn flushes the d-cache and disables MMU
+	 * only the images loaded for the next stage and the stack are cleaned
+	 * before the d-cache and MMU are disabled
 	 */
-	dcache_disable();
-	invalidate_dcache_all();
+	dcache_disable_dirty(CONFIG_SYS_INIT_SP_ADDR);
 
 	return 0;
 }
@@ -215,6 +215,7 @@ int spl_part_load(struct mmc *mmc, char *part_name, void *addr, u64 size)
 		pr_err("mmc read %s fail!\n", part_name);
 		return -EINVAL;
 	}
+	dcache_mark_dirty((ulong)addr, cnt * mmc->read_bl_len);
 
 	return 0;
 }
@@ -303,6 +304,7 @@ int spl_load_ap2(struct mmc *mmc)
 
 	addr = (void *)IMG_BACKUP_PRELOADER_OFF;
 	memcpy((void *)AP2_PRELOADER_MEMBASE, addr, IMG_BACKUP_PRELOADER_SZ);
+	dcache_mark_dirty(AP2_PRELOADER_MEMBASE, IMG_BACKUP_PRELOADER_SZ);
 
 	return 0;
 }
@@ -356,9 +358,11 @@ int spl_ap2_run(void)
 
 	addr = (void *)IMG_BACKUP_ATF_OFF;
 	memcpy((void *)AP2_ATF_MEMBASE, addr, IMG_BACKUP_ATF_SZ);
+	dcache_mark_dirty(AP2_ATF_MEMBASE, IMG_BACKUP_ATF_SZ);
 
 	addr = (void *)IMG_BACKUP_BOOTLOADER_OFF;
 	memcpy((void *)AP2_BOOTLOADER_MEMBASE, addr, IMG_BACKUP_BOOTLOADER_SZ);
+	dcache_mark_dirty(AP2_BOOTLOADER_MEMBASE, IMG_BACKUP_BOOTLOADER_SZ);
 
 	fmt = genimg_get_format((void *)IMG_BACKUP_KERNEL_OFF);
 	printf("fmt = %d\n", fmt);
@@ -366,15 +370,19 @@ int spl_ap2_run(void)
 	if (fmt == IMAGE_FORMAT_FIT) {
 		addr = (void *)IMG_BACKUP_KERNEL_OFF;
 		memcpy((void *)AP2_KERNEL_UIMAGE_MEMBASE, addr, IMG_BACKUP_KERNEL_SZ);
+		dcache_mark_dirty(AP2_KERNEL_UIMAGE_MEMBASE, IMG_BACKUP_KERNEL_SZ);
 	} else {
 		addr = (void *)IMG_BACKUP_DTB_OFF;
 		memcpy((void *)AP2_REE_MEMBASE, addr, IMG_BACKUP_DTB_SZ);
+		dcache_mark_dirty(AP2_REE_MEMBASE, IMG_BACKUP_DTB_SZ);
 
 		addr = (void *)IMG_BACKUP_KERNEL_OFF;
 		memcpy((void *)AP2_KERNEL_MEMBASE, addr, IMG_BACKUP_KERNEL_SZ);
+		dcache_mark_dirty(AP2_KERNEL_MEMBASE, IMG_BACKUP_KERNEL_SZ);
 
 		addr = (void *)IMG_BACKUP_RAMDISK_OFF;
 		memcpy((void *)AP2_BOARD_RAMDISK_MEMBASE, addr, IMG_BACKUP_RAMDISK_SZ);
+		dcache_mark_dirty(AP2_BOARD_RAMDISK_MEMBASE, IMG_BACKUP_RAMDISK_SZ);
 	}
 
 	return 0;
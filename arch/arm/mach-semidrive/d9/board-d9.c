@@ -20,43 +20,23 @@
 #include <usb/dwc2_udc.h>
 #include <phy.h>
 #include <clk.h>
-
-#define  MM_RAM_BASE	0x40000000UL
-#define  MM_RAM_SIZE	0xC0000000UL    /* 3GB */
+#include "mem_map.h"
 
 DECLARE_GLOBAL_DATA_PTR;
 
-static struct mm_region d9_ref_mem_map[] = {
-	{
-		/* RAM */
-		.virt = MM_RAM_BASE,
-		.phys = MM_RAM_BASE,
-		.size = MM_RAM_SIZE,
-		.attrs = PTE_BLOCK_MEMTYPE(MT_NORMAL) |
-			 PTE_BLOCK_INNER_SHARE
-	}, {
-		/* IO SPACE(OSPI AHB_MEM) */
-		.virt = 0x4000000UL,
-		.phys = 0x4000000UL,
-		.size = 0x8000000UL,	/* 128MB */
-		.attrs = PTE_BLOCK_MEMTYPE(MT_DEVICE_NGNRNE) |
-			 PTE_BLOCK_NON_SHARE |
-			 PTE_BLOCK_PXN | PTE_BLOCK_UXN
-	}, {
-		/* IO SPACE */
-		.virt = 0x30000000UL,
-		.phys = 0x30000000UL,
-		.size = 0x10000000UL,	/* 256MB */
-		.attrs = PTE_BLOCK_MEMTYPE(MT_DEVICE_NGNRNE) |
-			 PTE_BLOCK_NON_SHARE |
-			 PTE_BLOCK_PXN | PTE_BLOCK_UXN
-	}, {
-		/* List terminator */
-		0,
-	}
-};
+struct mm_region *mem_map = board_mem_map;
 
-struct mm_region *mem_map = d9_ref_mem_map;
+#if defined(CONFIG_TARGET_D9PLUS_AP1_REF) || defined(CONFIG_TARGET_D9PLUS_AP2_REF)
+/*
+ * The two clusters of the d9plus share the DRAM window: each one's banks lie
+ * between those of the other, and the images of the other cluster and of the
+ * DIL are loaded into it. Keep all of it mapped.
+ */
+int mmu_dram_is_shared(u64 start, u64 size)
+{
+	return start < MM_RAM_BASE + MM_RAM_SIZE && start + size > MM_RAM_BASE;
+}
+#endif
 
 ulong board_get_usable_ram_top(ulong total_size)
 {
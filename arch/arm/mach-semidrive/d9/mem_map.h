@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Memory map of the d9 series
+ *
+ * This is also built into mkpgtables, which generates the page tables for it
+ * at compile time, so it must only use constants.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef __D9_MEM_MAP_H
+#define __D9_MEM_MAP_H
+
+#include <asm/armv8/mmu.h>
+
+#define  MM_RAM_BASE	0x40000000UL
+#define  MM_RAM_SIZE	0xC0000000UL    /* 3GB */
+
+static struct mm_region board_mem_map[] = {
+	{
+		/* RAM */
+		.virt = MM_RAM_BASE,
+		.phys = MM_RAM_BASE,
+		.size = MM_RAM_SIZE,
+		.attrs = PTE_BLOCK_MEMTYPE(MT_NORMAL) |
+			 PTE_BLOCK_INNER_SHARE
+	}, {
+		/* IO SPACE(OSPI AHB_MEM) */
+		.virt = 0x4000000UL,
+		.phys = 0x4000000UL,
+		.size = 0x8000000UL,	/* 128MB */
+		.attrs = PTE_BLOCK_MEMTYPE(MT_DEVICE_NGNRNE) |
+			 PTE_BLOCK_NON_SHARE |
+			 PTE_BLOCK_PXN | PTE_BLOCK_UXN
+	}, {
+		/* IO SPACE */
+		.virt = 0x30000000UL,
+		.phys = 0x30000000UL,
+		.size = 0x10000000UL,	/* 256MB */
+		.attrs = PTE_BLOCK_MEMTYPE(MT_DEVICE_NGNRNE) |
+			 PTE_BLOCK_NON_SHARE |
+			 PTE_BLOCK_PXN | PTE_BLOCK_UXN
+	}, {
+		/* List terminator */
+		0,
+	}
+};
+
+#endif /* __D9_MEM_MAP_H */
@@ -49,6 +49,7 @@ ulong board_get_usable_ram_top(ulong total_size)
 	lmb_add(&lmb, gd->ram_base, gd->ram_size);
 	boot_fdt_add_mem_rsv_regions(&lmb, (void *)gd->fdt_blob);
 	reg = lmb_alloc(&lmb, CONFIG_SYS_MALLOC_LEN + total_size, SZ_4K);
+	lmb_uninit(&lmb);
 
 	if (reg)
 		return ALIGN(reg + CONFIG_SYS_MALLOC_LEN + total_size, SZ_4K);
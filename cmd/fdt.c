@@ -15,8 +15,10 @@
 #include <linux/types.h>
 #include <asm/global_data.h>
 #include <linux/libfdt.h>
+#include <fdt_batch.h>
 #include <fdt_support.h>
 #include <mapmem.h>
+#include <time.h>
 #include <asm/io.h>
 
 #define MAX_LEVEL	32		/* how deeply nested we will go */
@@ -31,6 +33,9 @@ static int fdt_valid(struct fdt_header **blobp);
 static int fdt_parse_prop(char *const*newval, int count, char *data, int *len);
 static int fdt_print(const char *pathp, char *prop, int depth);
 static int is_printable_string(const void *data, int len);
+#ifdef CONFIG_OF_LIBFDT_OVERLAY
+static int fdt_apply_list(int argc, char *const argv[]);
+#endif
 
 /*
  * The working_fdt points to our working flattened device tree.
@@ -696,12 +701,16 @@ static int do_fdt(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 		struct fdt_header *blob;
 		int ret;
 
-		if (argc != 3)
+		if (argc < 3)
 			return CMD_RET_USAGE;
 
 		if (!working_fdt)
 			return CMD_RET_FAILURE;
 
+		/* several overlays are applied in one pass */
+		if (argc > 3)
+			return fdt_apply_list(argc - 2, argv + 2);
+
 		addr = simple_strtoul(argv[2], NULL, 16);
 		blob = map_sysmem(addr, 0);
 		if (!fdt_valid(&blob))
@@ -1110,12 +1119,51 @@ static int fdt_print(const char *pathp, char *prop, int depth)
 	return 0;
 }
 
+#ifdef CONFIG_OF_LIBFDT_OVERLAY
+/*
+ * Apply the overlays at the addresses in argv[] to the working fdt, which is
+ * only written once they have all been merged
+ */
+static int fdt_apply_list(int argc, char *const argv[])
+{
+	struct fdt_overlay_batch ob;
+	struct fdt_header *blob;
+	ulong start;
+	int i, ret;
+
+	ret = fdt_overlay_batch_init(&ob, working_fdt);
+	for (i = 0; !ret && i < argc; i++) {
+		blob = map_sysmem(simple_strtoul(argv[i], NULL, 16), 0);
+		if (!fdt_valid(&blob)) {
+			ret = -FDT_ERR_BADMAGIC;
+			break;
+		}
+
+		/* apply method prints messages on error */
+		start = timer_get_us();
+		ret = fdt_overlay_batch_apply_verbose(&ob, blob);
+		if (!ret)
+			printf("%s: applied in %lu us\n", argv[i],
+			       timer_get_us() - start);
+	}
+	if (!ret) {
+		ret = fdt_overlay_batch_commit(&ob, NULL, 0);
+		if (ret)
+			printf("libfdt fdt_overlay_batch_commit(): %s\n",
+			       fdt_strerror(ret));
+	}
+	fdt_overlay_batch_uninit(&ob);
+
+	return ret ? CMD_RET_FAILURE : 0;
+}
+#endif
+
 /********************************************************************/
 #ifdef CONFIG_SYS_LONGHELP
 static char fdt_help_text[] =
 	"addr [-c]  <addr> [<length>]   - Set the [control] fdt location to <addr>\n"
 #ifdef CONFIG_OF_LIBFDT_OVERLAY
-	"fdt apply <addr>                    - Apply overlay to the DT\n"
+	"fdt apply <addr> [<addr>...]        - Apply overlay(s) to the DT\n"
 #endif
 #ifdef CONFIG_OF_BOARD_SETUP
 	"fdt boardsetup                      - Do board-specific set up\n"
@@ -18,6 +18,7 @@
 #include <console.h>
 #include <flash.h>
 #include <hash.h>
+#include <iobuf.h>
 #include <log.h>
 #include <mapmem.h>
 #include <rand.h>
@@ -1385,11 +1386,30 @@ U_BOOT_CMD(
 #endif
 
 #ifdef CONFIG_CMD_MEMINFO
+#ifdef CONFIG_IOBUF
+static void show_iobuf(void)
+{
+	struct iobuf_stats stats;
+
+	iobuf_get_stats(&stats);
+	puts("iobuf: ");
+	print_size(stats.size, ", used ");
+	print_size(stats.used, " (peak ");
+	print_size(stats.peak, "), largest free ");
+	print_size(stats.largest_free, "\n");
+	printf("       %u buffers, %lu allocated, %lu did not fit\n",
+	       stats.count, stats.allocs, stats.fails);
+}
+#endif
+
 static int do_mem_info(struct cmd_tbl *cmdtp, int flag, int argc,
 		       char *const argv[])
 {
 	puts("DRAM:  ");
 	print_size(gd->ram_size, "\n");
+#ifdef CONFIG_IOBUF
+	show_iobuf();
+#endif
 
 	return 0;
 }
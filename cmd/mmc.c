@@ -451,6 +451,7 @@ static int do_mmc_sparse_write(struct cmd_tbl *cmdtp, int flag,
 	sparse.size = dev_desc->lba - blk;
 	sparse.write = mmc_sparse_write;
 	sparse.reserve = mmc_sparse_reserve;
+	sparse.erase = NULL;
 	sparse.mssg = NULL;
 	sprintf(dest, "0x" LBAF, sparse.start * sparse.blksz);
 
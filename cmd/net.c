@@ -15,6 +15,7 @@
 #include <net.h>
 #include <net/udp.h>
 #include <net/sntp.h>
+#include <net/wget.h>
 
 static int netboot_common(enum proto_t, struct cmd_tbl *, int, char * const []);
 
@@ -123,6 +124,32 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(struct cmd_tbl *cmdtp, int flag, int argc,
+		   char *const argv[])
+{
+	int ret;
+
+	wget_range_offset = 0;
+	wget_range_size = 0;
+	if (argc > 3 && strict_strtoul(argv[3], 16, &wget_range_offset) < 0)
+		return CMD_RET_USAGE;
+	if (argc > 4 && strict_strtoul(argv[4], 16, &wget_range_size) < 0)
+		return CMD_RET_USAGE;
+
+	bootstage_mark_name(BOOTSTAGE_KERNELREAD_START, "wget_start");
+	ret = netboot_common(WGET, cmdtp, min(argc, 3), argv);
+	bootstage_mark_name(BOOTSTAGE_KERNELREAD_STOP, "wget_done");
+	return ret;
+}
+
+U_BOOT_CMD(wget, 5, 1, do_wget,
+	   "load a file via network using HTTP",
+	   "[loadAddress] [[hostIPaddr:]path [offset [size]]]\n"
+	   "Load the file, or size bytes of it from offset (in hex), from the\n"
+	   "HTTP server at serverip, or hostIPaddr, on port httpdstp (80).");
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -5,12 +5,14 @@
 
 #include <config.h>
 #include <command.h>
+#include <fdt_support.h>
 #include <fdtdec.h>
 #include <fs.h>
 #include <log.h>
 #include <mapmem.h>
 #include <memalign.h>
 #include <part.h>
+#include <linux/errno.h>
 
 struct persistent_ram_buffer {
 	u32    sig;
@@ -481,6 +483,18 @@ static int do_pstore(struct cmd_tbl *cmdtp, int flag, int argc, char * const arg
 	return c->cmd(cmdtp, flag, argc, argv);
 }
 
+int pstore_get_pmsg_zone(phys_addr_t *addr, phys_size_t *size)
+{
+	if (!pstore_pmsg_size || pstore_ecc_size)
+		return -ENOSPC;
+
+	/* The pmsg zone is the last one, as for 'pstore save' */
+	*addr = pstore_addr + pstore_length - pstore_pmsg_size;
+	*size = pstore_pmsg_size;
+
+	return 0;
+}
+
 void fdt_fixup_pstore(void *blob)
 {
 	char node[32];
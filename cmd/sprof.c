@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Commands for the timer-based sampling profiler
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <env.h>
+#include <mapmem.h>
+#include <sample_prof.h>
+#include <linux/errno.h>
+
+static int get_args(int argc, char *const argv[], char **buff,
+		    size_t *buff_ptr, size_t *buff_size)
+{
+	if (argc < 4) {
+		*buff_size = env_get_ulong("profsize", 16, 0);
+		*buff = map_sysmem(env_get_ulong("profbase", 16, 0),
+				   *buff_size);
+		*buff_ptr = env_get_ulong("profoffset", 16, 0);
+	} else {
+		*buff_size = simple_strtoul(argv[3], NULL, 16);
+		*buff = map_sysmem(simple_strtoul(argv[2], NULL, 16),
+				   *buff_size);
+		*buff_ptr = 0;
+	}
+	if (!*buff_size || *buff_ptr > *buff_size)
+		return -1;
+
+	return 0;
+}
+
+static int do_sprof_start(int argc, char *const argv[])
+{
+	uint hz = 0, flags = 0;
+	int i, ret;
+
+	for (i = 2; i < argc; i++) {
+		if (!strcmp(argv[i], "lr"))
+			flags |= SAMPLE_PROF_LR;
+		else if (!strcmp(argv[i], "fp"))
+			flags |= SAMPLE_PROF_LR | SAMPLE_PROF_FP;
+		else
+			hz = simple_strtoul(argv[i], NULL, 10);
+	}
+
+	ret = sample_prof_start(hz, flags);
+	if (ret) {
+		printf("Cannot start sampling (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	return 0;
+}
+
+static int do_sprof_dump(int argc, char *const argv[])
+{
+	size_t buff_size, avail, buff_ptr, needed;
+	char *buff;
+	int ret;
+
+	if (get_args(argc, argv, &buff, &buff_ptr, &buff_size))
+		return CMD_RET_USAGE;
+
+	avail = buff_size - buff_ptr;
+	ret = sample_prof_list(buff + buff_ptr, avail, &needed);
+	if (ret) {
+		printf("Error: buffer too small (%#zx bytes needed)\n", needed);
+		return CMD_RET_FAILURE;
+	}
+	printf("Samples dumped to %08lx, size %#zx\n",
+	       (ulong)map_to_sysmem(buff + buff_ptr), needed);
+	env_set_hex("profbase", map_to_sysmem(buff));
+	env_set_hex("profsize", buff_size);
+	env_set_hex("profoffset", buff_ptr + needed);
+
+	return 0;
+}
+
+static int do_sprof(struct cmd_tbl *cmdtp, int flag, int argc,
+		    char *const argv[])
+{
+	const char *cmd = argc < 2 ? NULL : argv[1];
+
+	if (!cmd)
+		return CMD_RET_USAGE;
+
+	if (!strcmp(cmd, "start"))
+		return do_sprof_start(argc, argv);
+	else if (!strcmp(cmd, "stop"))
+		sample_prof_stop();
+	else if (!strcmp(cmd, "reset"))
+		sample_prof_reset();
+	else if (!strcmp(cmd, "stats"))
+		sample_prof_print_stats();
+	else if (!strcmp(cmd, "hist"))
+		return sample_prof_print_hist(argc > 2 ?
+			simple_strtoul(argv[2], NULL, 10) : 20) ?
+			CMD_RET_FAILURE : 0;
+	else if (!strcmp(cmd, "dump"))
+		return do_sprof_dump(argc, argv);
+	else
+		return CMD_RET_USAGE;
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	sprof,	4,	0,	do_sprof,
+	"sampling profiler",
+	"start [<hz>] [lr|fp]          - start sampling (fp adds callchain)\n"
+	"sprof stop                         - stop sampling\n"
+	"sprof reset                        - stop and discard all samples\n"
+	"sprof stats                        - display sampling statistics\n"
+	"sprof hist [<n>]                   - show the <n> hottest functions\n"
+	"sprof dump [<addr> <size>]         - dump samples into buffer"
+);
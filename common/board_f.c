@@ -25,10 +25,12 @@
 #include <i2c.h>
 #include <init.h>
 #include <initcall.h>
+#include <iobuf.h>
 #include <lcd.h>
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <of_live.h>
 #include <os.h>
 #include <post.h>
 #include <relocate.h>
@@ -495,6 +497,20 @@ static int reserve_malloc(void)
 	return 0;
 }
 
+#ifdef CONFIG_IOBUF
+/* reserve memory for the I/O buffer pool, see iobuf_init() */
+static int reserve_iobuf(void)
+{
+	gd->start_addr_sp = ALIGN_DOWN(gd->start_addr_sp - CONFIG_IOBUF_SIZE,
+				       IOBUF_PAGE_SIZE);
+	gd->iobuf_base = gd->start_addr_sp;
+	debug("Reserving %dk for I/O buffers at: %08lx\n",
+	      CONFIG_IOBUF_SIZE >> 10, gd->start_addr_sp);
+
+	return 0;
+}
+#endif
+
 /* (permanently) allocate a Board Info struct */
 static int reserve_board(void)
 {
@@ -518,6 +534,18 @@ static int reserve_global_data(void)
 	return 0;
 }
 
+/* Number of bytes to copy when relocating the device tree */
+static ulong fdt_reloc_size(const void *blob)
+{
+	ulong size = fdt_totalsize(blob);
+
+	/* Keep the live tree image together with the tree it describes */
+	if (IS_ENABLED(CONFIG_OF_LIVE_IMAGE))
+		size += of_live_image_size(blob);
+
+	return size;
+}
+
 static int reserve_fdt(void)
 {
 	if (!IS_ENABLED(CONFIG_OF_EMBED)) {
@@ -527,7 +555,7 @@ static int reserve_fdt(void)
 		 * section, then it will be relocated with other data.
 		 */
 		if (gd->fdt_blob) {
-			gd->fdt_size = ALIGN(fdt_totalsize(gd->fdt_blob), 32);
+			gd->fdt_size = ALIGN(fdt_reloc_size(gd->fdt_blob), 32);
 
 			gd->start_addr_sp = reserve_stack_aligned(gd->fdt_size);
 			gd->new_fdt = map_sysmem(gd->start_addr_sp, gd->fdt_size);
@@ -628,7 +656,7 @@ static int reloc_fdt(void)
 			return 0;
 		if (gd->new_fdt) {
 			memcpy(gd->new_fdt, gd->fdt_blob,
-			       fdt_totalsize(gd->fdt_blob));
+			       fdt_reloc_size(gd->fdt_blob));
 			gd->fdt_blob = gd->new_fdt;
 		}
 	}
@@ -920,6 +948,9 @@ static const init_fnc_t init_sequence_f[] = {
 	reserve_trace,
 	reserve_uboot,
 	reserve_malloc,
+#ifdef CONFIG_IOBUF
+	reserve_iobuf,
+#endif
 	reserve_board,
 	reserve_global_data,
 	reserve_fdt,
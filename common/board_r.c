@@ -37,6 +37,7 @@
 #include <ide.h>
 #include <init.h>
 #include <initcall.h>
+#include <iobuf.h>
 #if defined(CONFIG_CMD_KGDB)
 #include <kgdb.h>
 #endif
@@ -630,6 +631,9 @@ static init_fnc_t init_sequence_r[] = {
 #endif
 #ifdef CONFIG_SYS_NONCACHED_MEMORY
 	noncached_init,
+#endif
+#ifdef CONFIG_IOBUF
+	iobuf_init,
 #endif
 	initr_of_live,
 #ifdef CONFIG_DM
@@ -76,6 +76,10 @@ static inline void boot_start_lmb(bootm_headers_t *images) { }
 static int bootm_start(struct cmd_tbl *cmdtp, int flag, int argc,
 		       char *const argv[])
 {
+#ifdef CONFIG_LMB
+	/* Free the regions of any earlier bootm which did not boot */
+	lmb_uninit(&images.lmb);
+#endif
 	memset((void *)&images, 0, sizeof(images));
 	images.verify = env_get_yesno("verify");
 
@@ -7,6 +7,7 @@
 
 #include <common.h>
 #include <cpu_func.h>
+#include <iobuf.h>
 #include <log.h>
 #include <malloc.h>
 #include <errno.h>
@@ -45,8 +46,12 @@ int bounce_buffer_start_extalign(struct bounce_buffer *state, void *data,
 	state->flags = flags;
 
 	if (!addr_is_aligned(state)) {
-		state->bounce_buffer = memalign(alignment,
-						state->len_aligned);
+		/* The I/O buffer pool keeps large bounce buffers off the heap */
+		if (alignment <= ARCH_DMA_MINALIGN)
+			state->bounce_buffer = iobuf_alloc(state->len_aligned);
+		else
+			state->bounce_buffer = memalign(alignment,
+							state->len_aligned);
 		if (!state->bounce_buffer)
 			return -ENOMEM;
 
@@ -89,7 +94,7 @@ int bounce_buffer_stop(struct bounce_buffer *state)
 	if (state->flags & GEN_BB_WRITE)
 		memcpy(state->user_buffer, state->bounce_buffer, state->len);
 
-	free(state->bounce_buffer);
+	iobuf_free(state->bounce_buffer);
 
 	return 0;
 }
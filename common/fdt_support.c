@@ -16,6 +16,7 @@
 #include <linux/types.h>
 #include <asm/global_data.h>
 #include <linux/libfdt.h>
+#include <fdt_batch.h>
 #include <fdt_support.h>
 #include <exports.h>
 #include <fdtdec.h>
@@ -128,33 +129,29 @@ int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name)
 }
 
 #if defined(CONFIG_OF_STDOUT_VIA_ALIAS) && defined(CONFIG_CONS_INDEX)
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *b, int chosenoff)
 {
 	int err;
 	int aliasoff;
 	char sername[9] = { 0 };
 	const void *path;
 	int len;
-	char tmp[256]; /* long enough */
 
 	sprintf(sername, "serial%d", CONFIG_CONS_INDEX - 1);
 
-	aliasoff = fdt_path_offset(fdt, "/aliases");
+	aliasoff = fdt_path_offset(b->fdt, "/aliases");
 	if (aliasoff < 0) {
 		err = aliasoff;
 		goto noalias;
 	}
 
-	path = fdt_getprop(fdt, aliasoff, sername, &len);
+	path = fdt_batch_getprop(b, aliasoff, sername, &len);
 	if (!path) {
 		err = len;
 		goto noalias;
 	}
 
-	/* fdt_setprop may break "path" so we copy it to tmp buffer */
-	memcpy(tmp, path, len);
-
-	err = fdt_setprop(fdt, chosenoff, "linux,stdout-path", tmp, len);
+	err = fdt_batch_setprop(b, chosenoff, "linux,stdout-path", path, len);
 	if (err < 0)
 		printf("WARNING: could not set linux,stdout-path %s.\n",
 		       fdt_strerror(err));
@@ -168,36 +165,56 @@ noalias:
 	return 0;
 }
 #else
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *b, int chosenoff)
 {
 	return 0;
 }
 #endif
 
-static inline int fdt_setprop_uxx(void *fdt, int nodeoffset, const char *name,
-				  uint64_t val, int is_u64)
+static inline int fdt_batch_setprop_uxx(struct fdt_batch *b, int nodeoffset,
+					const char *name, uint64_t val,
+					int is_u64)
 {
 	if (is_u64)
-		return fdt_setprop_u64(fdt, nodeoffset, name, val);
+		return fdt_batch_setprop_u64(b, nodeoffset, name, val);
 	else
-		return fdt_setprop_u32(fdt, nodeoffset, name, (uint32_t)val);
+		return fdt_batch_setprop_u32(b, nodeoffset, name, (uint32_t)val);
 }
 
-int fdt_root(void *fdt)
+/* Find or create the /chosen node */
+static int fdt_batch_chosen(struct fdt_batch *b)
 {
-	char *serial;
-	int err;
+	int offset;
 
-	err = fdt_check_header(fdt);
-	if (err < 0) {
-		printf("fdt_root: %s\n", fdt_strerror(err));
-		return err;
+	offset = fdt_batch_find_or_add_subnode(b, 0, "chosen");
+	if (offset < 0)
+		printf("%s: chosen: %s\n", __func__, fdt_strerror(offset));
+
+	return offset;
+}
+
+/* Commit the edits in @b if @err is 0, then drop it */
+static int fdt_batch_finish(struct fdt_batch *b, int err)
+{
+	if (!err) {
+		err = fdt_batch_commit(b, NULL, 0);
+		if (err < 0)
+			printf("%s: %s\n", __func__, fdt_strerror(err));
 	}
+	fdt_batch_uninit(b);
+
+	return err;
+}
+
+int fdt_root_batch(struct fdt_batch *b)
+{
+	char *serial;
+	int err;
 
 	serial = env_get("serial#");
 	if (serial) {
-		err = fdt_setprop(fdt, 0, "serial-number", serial,
-				  strlen(serial) + 1);
+		err = fdt_batch_setprop(b, 0, "serial-number", serial,
+					strlen(serial) + 1);
 
 		if (err < 0) {
 			printf("WARNING: could not set serial-number %s.\n",
@@ -209,7 +226,22 @@ int fdt_root(void *fdt)
 	return 0;
 }
 
-int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
+int fdt_root(void *fdt)
+{
+	struct fdt_batch b;
+	int err;
+
+	err = fdt_batch_init(&b, fdt);
+	if (err < 0) {
+		printf("%s: %s\n", __func__, fdt_strerror(err));
+		return err;
+	}
+
+	return fdt_batch_finish(&b, fdt_root_batch(&b));
+}
+
+int fdt_initrd_batch(struct fdt_batch *b, ulong initrd_start,
+		     ulong initrd_end)
 {
 	int   nodeoffset;
 	int   err, j, total;
@@ -221,34 +253,34 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 		return 0;
 
 	/* find or create "/chosen" node. */
-	nodeoffset = fdt_find_or_add_subnode(fdt, 0, "chosen");
+	nodeoffset = fdt_batch_chosen(b);
 	if (nodeoffset < 0)
 		return nodeoffset;
 
-	total = fdt_num_mem_rsv(fdt);
+	total = fdt_batch_num_mem_rsv(b);
 
 	/*
 	 * Look for an existing entry and update it.  If we don't find
 	 * the entry, we will j be the next available slot.
 	 */
 	for (j = 0; j < total; j++) {
-		err = fdt_get_mem_rsv(fdt, j, &addr, &size);
+		err = fdt_batch_get_mem_rsv(b, j, &addr, &size);
 		if (addr == initrd_start) {
-			fdt_del_mem_rsv(fdt, j);
+			fdt_batch_del_mem_rsv(b, j);
 			break;
 		}
 	}
 
-	err = fdt_add_mem_rsv(fdt, initrd_start, initrd_end - initrd_start);
+	err = fdt_batch_add_mem_rsv(b, initrd_start, initrd_end - initrd_start);
 	if (err < 0) {
 		printf("fdt_initrd: %s\n", fdt_strerror(err));
 		return err;
 	}
 
-	is_u64 = (fdt_address_cells(fdt, 0) == 2);
+	is_u64 = (fdt_address_cells(b->fdt, 0) == 2);
 
-	err = fdt_setprop_uxx(fdt, nodeoffset, "linux,initrd-start",
-			      (uint64_t)initrd_start, is_u64);
+	err = fdt_batch_setprop_uxx(b, nodeoffset, "linux,initrd-start",
+				    (uint64_t)initrd_start, is_u64);
 
 	if (err < 0) {
 		printf("WARNING: could not set linux,initrd-start %s.\n",
@@ -256,8 +288,8 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 		return err;
 	}
 
-	err = fdt_setprop_uxx(fdt, nodeoffset, "linux,initrd-end",
-			      (uint64_t)initrd_end, is_u64);
+	err = fdt_batch_setprop_uxx(b, nodeoffset, "linux,initrd-end",
+				    (uint64_t)initrd_end, is_u64);
 
 	if (err < 0) {
 		printf("WARNING: could not set linux,initrd-end %s.\n",
@@ -269,27 +301,40 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 	return 0;
 }
 
-int fdt_chosen(void *fdt)
+int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 {
-	int   nodeoffset;
-	int   err;
-	char  *str;		/* used to set string properties */
+	struct fdt_batch b;
+	int err;
+
+	/* just return if the size of initrd is zero */
+	if (initrd_start == initrd_end)
+		return 0;
 
-	err = fdt_check_header(fdt);
+	err = fdt_batch_init(&b, fdt);
 	if (err < 0) {
-		printf("fdt_chosen: %s\n", fdt_strerror(err));
+		printf("%s: %s\n", __func__, fdt_strerror(err));
 		return err;
 	}
 
+	return fdt_batch_finish(&b, fdt_initrd_batch(&b, initrd_start,
+						     initrd_end));
+}
+
+int fdt_chosen_batch(struct fdt_batch *b)
+{
+	int   nodeoffset;
+	int   err;
+	char  *str;		/* used to set string properties */
+
 	/* find or create "/chosen" node. */
-	nodeoffset = fdt_find_or_add_subnode(fdt, 0, "chosen");
+	nodeoffset = fdt_batch_chosen(b);
 	if (nodeoffset < 0)
 		return nodeoffset;
 
 	str = env_get("bootargs");
 	if (str) {
-		err = fdt_setprop(fdt, nodeoffset, "bootargs", str,
-				  strlen(str) + 1);
+		err = fdt_batch_setprop(b, nodeoffset, "bootargs", str,
+					strlen(str) + 1);
 		if (err < 0) {
 			printf("WARNING: could not set bootargs %s.\n",
 			       fdt_strerror(err));
@@ -297,7 +342,21 @@ int fdt_chosen(void *fdt)
 		}
 	}
 
-	return fdt_fixup_stdout(fdt, nodeoffset);
+	return fdt_fixup_stdout(b, nodeoffset);
+}
+
+int fdt_chosen(void *fdt)
+{
+	struct fdt_batch b;
+	int err;
+
+	err = fdt_batch_init(&b, fdt);
+	if (err < 0) {
+		printf("%s: %s\n", __func__, fdt_strerror(err));
+		return err;
+	}
+
+	return fdt_batch_finish(&b, fdt_chosen_batch(&b));
 }
 
 void do_fixup_by_path(void *fdt, const char *path, const char *prop,
@@ -506,37 +565,48 @@ int fdt_fixup_memory(void *blob, u64 start, u64 size)
 	return fdt_fixup_memory_banks(blob, &start, &size, 1);
 }
 
-void fdt_fixup_ethernet(void *fdt)
+/* Batch version of do_fixup_by_path() */
+static void fdt_batch_fixup_by_path(struct fdt_batch *b, const char *path,
+				    const char *prop, const void *val, int len,
+				    int create)
+{
+	int rc;
+
+	rc = fdt_path_offset(b->fdt, path);
+	if (rc >= 0) {
+		int nodeoff = rc;
+
+		rc = 0;
+		if (create || fdt_batch_getprop(b, nodeoff, prop, NULL))
+			rc = fdt_batch_setprop(b, nodeoff, prop, val, len);
+	}
+	if (rc)
+		printf("Unable to update property %s:%s, err=%s\n",
+		       path, prop, fdt_strerror(rc));
+}
+
+void fdt_fixup_ethernet_batch(struct fdt_batch *b)
 {
-	int i = 0, j, prop;
+	int i = 0, j;
 	char *tmp, *end;
 	char mac[16];
 	const char *path;
 	unsigned char mac_addr[ARP_HLEN];
-	int offset;
+	int aliases, offset;
 #ifdef FDT_SEQ_MACADDR_FROM_ENV
 	int nodeoff;
-	const struct fdt_property *fdt_prop;
+	const char *status;
 #endif
 
-	if (fdt_path_offset(fdt, "/aliases") < 0)
+	aliases = fdt_path_offset(b->fdt, "/aliases");
+	if (aliases < 0)
 		return;
 
-	/* Cycle through all aliases */
-	for (prop = 0; ; prop++) {
+	/* Cycle through all aliases, the batch leaves the offsets alone */
+	fdt_for_each_property_offset(offset, b->fdt, aliases) {
 		const char *name;
 
-		/* FDT might have been edited, recompute the offset */
-		offset = fdt_first_property_offset(fdt,
-			fdt_path_offset(fdt, "/aliases"));
-		/* Select property number 'prop' */
-		for (j = 0; j < prop; j++)
-			offset = fdt_next_property_offset(fdt, offset);
-
-		if (offset < 0)
-			break;
-
-		path = fdt_getprop_by_offset(fdt, offset, &name, NULL);
+		path = fdt_getprop_by_offset(b->fdt, offset, &name, NULL);
 		if (!strncmp(name, "ethernet", 8)) {
 			/* Treat plain "ethernet" same as "ethernet0". */
 			if (!strcmp(name, "ethernet")
@@ -558,10 +628,9 @@ void fdt_fixup_ethernet(void *fdt)
 				continue;
 			}
 #ifdef FDT_SEQ_MACADDR_FROM_ENV
-			nodeoff = fdt_path_offset(fdt, path);
-			fdt_prop = fdt_get_property(fdt, nodeoff, "status",
-						    NULL);
-			if (fdt_prop && !strcmp(fdt_prop->data, "disabled"))
+			nodeoff = fdt_path_offset(b->fdt, path);
+			status = fdt_batch_getprop(b, nodeoff, "status", NULL);
+			if (status && !strcmp(status, "disabled"))
 				continue;
 			i++;
 #endif
@@ -576,14 +645,24 @@ void fdt_fixup_ethernet(void *fdt)
 					tmp = (*end) ? end + 1 : end;
 			}
 
-			do_fixup_by_path(fdt, path, "mac-address",
-					 &mac_addr, 6, 0);
-			do_fixup_by_path(fdt, path, "local-mac-address",
-					 &mac_addr, 6, 1);
+			fdt_batch_fixup_by_path(b, path, "mac-address",
+						&mac_addr, 6, 0);
+			fdt_batch_fixup_by_path(b, path, "local-mac-address",
+						&mac_addr, 6, 1);
 		}
 	}
 }
 
+void fdt_fixup_ethernet(void *fdt)
+{
+	struct fdt_batch b;
+
+	if (fdt_batch_init(&b, fdt))
+		return;
+	fdt_fixup_ethernet_batch(&b);
+	fdt_batch_finish(&b, 0);
+}
+
 int fdt_record_loadable(void *blob, u32 index, const char *name,
 			uintptr_t load_addr, u32 size, uintptr_t entry_point,
 			const char *type, const char *os)
@@ -1895,4 +1974,21 @@ int fdt_overlay_apply_verbose(void *fdt, void *fdto)
 	}
 	return err;
 }
+
+int fdt_overlay_batch_apply_verbose(struct fdt_overlay_batch *ob, void *fdto)
+{
+	bool has_symbols = ob->symbols_node >= 0;
+	int err;
+
+	err = fdt_overlay_batch_apply(ob, fdto);
+	if (err < 0) {
+		printf("failed on fdt_overlay_apply(): %s\n", fdt_strerror(err));
+		if (!has_symbols) {
+			printf("base fdt does did not have a /__symbols__ node\n");
+			printf("make sure you've compiled with -@\n");
+		}
+	}
+
+	return err;
+}
 #endif
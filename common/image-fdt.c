@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <fdt_batch.h>
 #include <fdt_support.h>
 #include <fdtdec.h>
 #include <env.h>
@@ -546,15 +547,29 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 {
 	ulong *initrd_start = &images->initrd_start;
 	ulong *initrd_end = &images->initrd_end;
+	struct fdt_batch batch;
 	int ret = -EPERM;
 	int fdt_ret;
 
-	if (fdt_root(blob) < 0) {
-		printf("ERROR: root node setup failed\n");
+	/* The root and /chosen fixups are written in one pass */
+	fdt_ret = fdt_batch_init(&batch, blob);
+	if (fdt_ret) {
+		printf("ERROR: invalid fdt: %s\n", fdt_strerror(fdt_ret));
 		goto err;
 	}
-	if (fdt_chosen(blob) < 0) {
+	if (fdt_root_batch(&batch) < 0) {
+		printf("ERROR: root node setup failed\n");
+		goto err_batch;
+	}
+	if (fdt_chosen_batch(&batch) < 0) {
 		printf("ERROR: /chosen node create failed\n");
+		goto err_batch;
+	}
+	fdt_ret = fdt_batch_commit(&batch, NULL, 0);
+	fdt_batch_uninit(&batch);
+	if (fdt_ret) {
+		printf("ERROR: root and /chosen fixup failed: %s\n",
+		       fdt_strerror(fdt_ret));
 		goto err;
 	}
 	if (arch_fixup_fdt(blob) < 0) {
@@ -574,6 +589,10 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 #if CONFIG_IS_ENABLED(CMD_PSTORE)
 	/* Append PStore configuration */
 	fdt_fixup_pstore(blob);
+#endif
+#if CONFIG_IS_ENABLED(LOG_BINARY_PSTORE)
+	/* Hand the U-Boot log over to Linux */
+	log_binary_to_pstore();
 #endif
 	if (IMAGE_OF_BOARD_SETUP) {
 		const char *skip_board_fixup;
@@ -627,6 +646,8 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 #endif
 
 	return 0;
+err_batch:
+	fdt_batch_uninit(&batch);
 err:
 	printf(" - must RESET the board to recover.\n\n");
 
@@ -19,8 +19,10 @@
 #include <linux/compiler.h>
 #include <common.h>
 #include <errno.h>
+#include <fdt_batch.h>
 #include <log.h>
 #include <mapmem.h>
+#include <time.h>
 #include <asm/io.h>
 #include <malloc.h>
 #include <asm/global_data.h>
@@ -2258,8 +2260,9 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 	char *next_config = NULL;
 	ulong load, len;
 #ifdef CONFIG_OF_LIBFDT_OVERLAY
+	struct fdt_overlay_batch ob;
 	ulong image_start, image_end;
-	ulong ovload, ovlen;
+	ulong ovload, ovlen, ovsize = 0, start;
 	const char *uconfig;
 	const char *uname;
 	void *base, *ov;
@@ -2315,7 +2318,18 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 		goto out;
 	}
 
+	/*
+	 * The overlays are merged into a batch as they are loaded, so each
+	 * can be loaded where the last one was, and the base is written once
+	 * at the end
+	 */
 	base = map_sysmem(load, len);
+	err = fdt_overlay_batch_init(&ob, base);
+	if (err < 0) {
+		printf("failed on fdt_overlay_batch_init\n");
+		fdt_noffset = err;
+		goto out_batch;
+	}
 
 	/* apply extra configs in FIT first, followed by args */
 	for (i = 1; ; i++) {
@@ -2361,22 +2375,30 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 				uname, ovload, ovlen);
 		ov = map_sysmem(ovload, ovlen);
 
-		base = map_sysmem(load, len + ovlen);
-		err = fdt_open_into(base, base, len + ovlen);
-		if (err < 0) {
-			printf("failed on fdt_open_into\n");
-			fdt_noffset = err;
-			goto out;
-		}
 		/* the verbose method prints out messages on error */
-		err = fdt_overlay_apply_verbose(base, ov);
+		start = timer_get_us();
+		err = fdt_overlay_batch_apply_verbose(&ob, ov);
 		if (err < 0) {
 			fdt_noffset = err;
-			goto out;
+			goto out_batch;
 		}
-		fdt_pack(base);
-		len = fdt_totalsize(base);
+		debug("%s applied in %lu us\n", uname, timer_get_us() - start);
+		ovsize += ovlen;
 	}
+
+	/* each overlay adds at most its own size to the base */
+	base = map_sysmem(load, len + ovsize);
+	err = fdt_overlay_batch_commit(&ob, base, len + ovsize);
+	if (err < 0) {
+		printf("failed on fdt_overlay_batch_commit\n");
+		fdt_noffset = err;
+		goto out_batch;
+	}
+	fdt_pack(base);
+	len = fdt_totalsize(base);
+
+out_batch:
+	fdt_overlay_batch_uninit(&ob);
 #else
 	printf("config with overlays but CONFIG_OF_LIBFDT_OVERLAY not set\n");
 	fdt_noffset = -EBADF;
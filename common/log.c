@@ -214,15 +214,36 @@ static int log_dispatch(struct log_rec *rec, const char *fmt, va_list args)
 
 	/* Emit message */
 	gd->processing_msg = true;
+	rec->fmt = fmt;
 	list_for_each_entry(ldev, &gd->log_head, sibling_node) {
-		if ((ldev->flags & LOGDF_ENABLE) &&
-		    log_passes_filters(ldev, rec)) {
+		va_list args_copy;
+
+		if (!(ldev->flags & LOGDF_ENABLE) ||
+		    !log_passes_filters(ldev, rec))
+			continue;
+
+		/*
+		 * Only format the message if some device needs the text, so
+		 * that raw devices can take records at full verbosity without
+		 * paying for vsnprintf()
+		 */
+		va_copy(args_copy, args);
+		if (ldev->flags & LOGDF_RAW) {
+			const char *msg = rec->msg;
+
+			rec->msg = NULL;
+			rec->args = &args_copy;
+			ldev->drv->emit(ldev, rec);
+			rec->args = NULL;
+			rec->msg = msg;
+		} else {
 			if (!rec->msg) {
-				vsnprintf(buf, sizeof(buf), fmt, args);
+				vsnprintf(buf, sizeof(buf), fmt, args_copy);
 				rec->msg = buf;
 			}
 			ldev->drv->emit(ldev, rec);
 		}
+		va_end(args_copy);
 	}
 	gd->processing_msg = false;
 	return 0;
@@ -250,6 +271,8 @@ int _log(enum log_category_t cat, enum log_level_t level, const char *file,
 	rec.line = line;
 	rec.func = func;
 	rec.msg = NULL;
+	rec.fmt = fmt;
+	rec.args = NULL;
 
 	if (!(gd->flags & GD_FLG_LOG_READY)) {
 		gd->log_drop_count++;
@@ -411,6 +434,8 @@ int log_init(void)
 		ldev->flags = drv->flags;
 		list_add_tail(&ldev->sibling_node,
 			      (struct list_head *)&gd->log_head);
+		if (drv->probe && drv->probe(ldev))
+			ldev->flags &= ~LOGDF_ENABLE;
 		drv++;
 	}
 	gd->flags |= GD_FLG_LOG_READY;
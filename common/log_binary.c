@@ -0,0 +1,742 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Binary log driver with deferred formatting
+ *
+ * Records are stored in a ring buffer as the address of the format string
+ * plus the raw arguments, so logging at full verbosity costs little more than
+ * a memcpy(). Formatting only happens when the buffer is dumped with
+ * 'log dump' or handed over to Linux through pstore.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <fdt_support.h>
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <version.h>
+#include <asm/global_data.h>
+#include <linux/ctype.h>
+#include <linux/errno.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define LOG_BIN_MAGIC		0x4e49424c	/* "LBIN" */
+#define LOG_BIN_ALIGN		8
+/* Largest record, including the header and the packed arguments */
+#define LOG_BIN_REC_MAX		256
+/* Largest conversion specification we rebuild, e.g. "%-#12.8llx" */
+#define LOG_BIN_SPEC_MAX	48
+/* Longest %p extension kept, e.g. "pUb" */
+#define LOG_BIN_EXT_MAX		4
+/* Largest formatted record */
+#define LOG_BIN_LINE_MAX	(CONFIG_SYS_CBSIZE + 128)
+
+/**
+ * struct log_bin_hdr - header at the start of the binary-log buffer
+ *
+ * Records are held in @data between @tail and @head, wrapping at @size.
+ *
+ * @magic: LOG_BIN_MAGIC
+ * @size: Size of @data in bytes
+ * @head: Offset in @data at which the next record is written
+ * @tail: Offset in @data of the oldest record
+ * @count: Number of records held
+ * @dropped: Number of records overwritten or too large to store
+ * @image: Link-time address of version_string, so that records written by
+ *	a different U-Boot image are not decoded
+ * @data: Records (struct log_bin_rec)
+ */
+struct log_bin_hdr {
+	u32 magic;
+	u32 size;
+	u32 head;
+	u32 tail;
+	u32 count;
+	u32 dropped;
+	ulong image;
+	u8 data[];
+};
+
+/**
+ * struct log_bin_rec - a log record as stored in the buffer
+ *
+ * The format string is stored as a link-time address so that records written
+ * before relocation can still be decoded afterwards. The file and function
+ * names are copied, since 'log rec' passes strings which do not last.
+ *
+ * @len: Length of the record including this header, a multiple of
+ *	LOG_BIN_ALIGN. A length of 0 means the buffer wraps at this point
+ * @level: Log level (enum log_level_t)
+ * @force_debug: 1 if the record was forced out by LOG_DEBUG
+ * @cat: Log category (enum log_category_t)
+ * @line: Line number where the log record was generated
+ * @time_us: Time the record was generated, in microseconds since boot
+ * @fmt: Link-time address of the format string
+ * @args: File name and function name as strings, followed by the packed
+ *	arguments, see log_bin_pack()
+ */
+struct log_bin_rec {
+	u16 len;
+	u8 level;
+	u8 force_debug;
+	u16 cat;
+	u16 line;
+	u64 time_us;
+	ulong fmt;
+	u8 args[];
+};
+
+/**
+ * struct log_bin_spec - a parsed printf() conversion specification
+ *
+ * @end: Last character of the specification in the format string
+ * @flags: Flag characters, e.g. "-0"
+ * @width: Field width, -1 if none
+ * @prec: Precision, -1 if none
+ * @width_arg: true if the width is given by an argument ('*')
+ * @prec_arg: true if the precision is given by an argument ('.*')
+ * @qualifier: Length qualifier as used by vsnprintf(): 'h', 'l', 'L' (for
+ *	"ll"), 'z', 'Z' or 't', or 0 if none
+ * @conv: Conversion character, 0 if the format string ends early
+ * @ext: Extension characters for %p, e.g. "M" for %pM
+ */
+struct log_bin_spec {
+	const char *end;
+	char flags[6];
+	int width;
+	int prec;
+	bool width_arg;
+	bool prec_arg;
+	char qualifier;
+	char conv;
+	char ext[LOG_BIN_EXT_MAX + 1];
+};
+
+/*
+ * The buffer may be set up before relocation, so keep the pointer out of BSS
+ * to carry it over
+ */
+static struct log_bin_hdr *log_bin __attribute__((section(".data")));
+
+static ulong log_bin_to_link(const void *ptr)
+{
+	return (ulong)ptr - gd->reloc_off;
+}
+
+static const char *log_bin_from_link(ulong addr)
+{
+	return (const char *)(addr + gd->reloc_off);
+}
+
+static int log_bin_atoi(const char **fmtp)
+{
+	int val = 0;
+
+	while (isdigit(**fmtp))
+		val = val * 10 + *(*fmtp)++ - '0';
+
+	return val;
+}
+
+/**
+ * log_bin_parse() - Parse a conversion specification
+ *
+ * This accepts the same syntax as vsnprintf(), so that both agree on which
+ * arguments are consumed.
+ *
+ * @fmt: Pointer to the '%' which starts the specification
+ * @spec: Returns the parsed specification
+ */
+static void log_bin_parse(const char *fmt, struct log_bin_spec *spec)
+{
+	int i;
+
+	memset(spec, '\0', sizeof(*spec));
+	spec->width = -1;
+	spec->prec = -1;
+	for (fmt++, i = 0; *fmt && strchr("-+ #0", *fmt); fmt++) {
+		if (i < sizeof(spec->flags) - 1)
+			spec->flags[i++] = *fmt;
+	}
+	if (*fmt == '*') {
+		spec->width_arg = true;
+		fmt++;
+	} else if (isdigit(*fmt)) {
+		spec->width = log_bin_atoi(&fmt);
+	}
+	if (*fmt == '.') {
+		fmt++;
+		if (*fmt == '*') {
+			spec->prec_arg = true;
+			fmt++;
+		} else {
+			spec->prec = log_bin_atoi(&fmt);
+		}
+	}
+	if (*fmt && strchr("hlLZzt", *fmt)) {
+		spec->qualifier = *fmt++;
+		if (spec->qualifier == 'l' && *fmt == 'l') {
+			spec->qualifier = 'L';
+			fmt++;
+		}
+	}
+	spec->conv = *fmt;
+	if (spec->conv == 'p') {
+		for (i = 0; isalnum(fmt[1]); fmt++) {
+			if (i < LOG_BIN_EXT_MAX)
+				spec->ext[i++] = fmt[1];
+		}
+	}
+	spec->end = spec->conv ? fmt : fmt - 1;
+}
+
+/**
+ * log_bin_spec_str() - Write out a specification for use with snprintf()
+ *
+ * Any '*' has been replaced with the value of its argument by this point.
+ *
+ * @spec: Specification to write
+ * @qual: Length qualifier to use
+ * @str: Returns the specification, at least LOG_BIN_SPEC_MAX bytes
+ */
+static void log_bin_spec_str(const struct log_bin_spec *spec,
+			     const char *qual, char *str)
+{
+	str += sprintf(str, "%%%s", spec->flags);
+	if (spec->width >= 0 || spec->width_arg)
+		str += sprintf(str, "%d", spec->width);
+	if (spec->prec >= 0)
+		str += sprintf(str, ".%d", spec->prec);
+	sprintf(str, "%s%c%s", qual, spec->conv, spec->ext);
+}
+
+/* Store a value, if there is room */
+static u8 *log_bin_put(u8 *p, u8 *end, u64 val)
+{
+	if (end - p < sizeof(val))
+		return end;
+	memcpy(p, &val, sizeof(val));
+
+	return p + sizeof(val);
+}
+
+/* Store a string, truncating it if there is not enough room */
+static u8 *log_bin_put_str(u8 *p, u8 *end, const char *str)
+{
+	int len;
+
+	if (p == end)
+		return end;
+	len = min_t(int, strlen(str), end - p - 1);
+	memcpy(p, str, len);
+	p[len] = '\0';
+
+	return p + len + 1;
+}
+
+static u64 log_bin_get(const u8 **pp, const u8 *end)
+{
+	u64 val = 0;
+
+	if (end - *pp >= sizeof(val)) {
+		memcpy(&val, *pp, sizeof(val));
+		*pp += sizeof(val);
+	}
+
+	return val;
+}
+
+static const char *log_bin_get_str(const u8 **pp, const u8 *end)
+{
+	const char *str = (const char *)*pp;
+	int len;
+
+	if (*pp == end)
+		return "";
+	len = strnlen(str, end - *pp);
+	if (len == end - *pp)
+		return "";
+	*pp += len + 1;
+
+	return str;
+}
+
+/**
+ * log_bin_pack() - Pack the arguments of a log message
+ *
+ * This consumes @args in the same way as vsnprintf() would for @fmt.
+ * Integers and plain pointers are stored as 64-bit values. Strings are copied
+ * since they may not outlive the call, and extended pointer formats such as
+ * %pM are formatted straight away since the data they point to may change.
+ * Anything which does not fit is silently truncated.
+ *
+ * @buf: Buffer for the packed arguments
+ * @size: Size of @buf
+ * @fmt: printf() format string
+ * @args: Arguments for @fmt
+ * Return: number of bytes used in @buf
+ */
+static int log_bin_pack(u8 *buf, int size, const char *fmt, va_list args)
+{
+	u8 *p = buf, *end = buf + size;
+	char spec_str[LOG_BIN_SPEC_MAX];
+	struct log_bin_spec spec;
+	char str[64];
+	u64 val;
+
+	for (; *fmt; fmt++) {
+		if (*fmt != '%')
+			continue;
+		log_bin_parse(fmt, &spec);
+		fmt = spec.end;
+		if (spec.width_arg) {
+			spec.width = va_arg(args, int);
+			p = log_bin_put(p, end, spec.width);
+		}
+		if (spec.prec_arg) {
+			spec.prec = va_arg(args, int);
+			p = log_bin_put(p, end, spec.prec);
+		}
+
+		switch (spec.conv) {
+		case 'c':
+			p = log_bin_put(p, end, va_arg(args, int));
+			continue;
+		case 's':
+			if (spec.qualifier == 'l' &&
+			    CONFIG_IS_ENABLED(EFI_LOADER)) {
+				log_bin_spec_str(&spec, "l", spec_str);
+				snprintf(str, sizeof(str), spec_str,
+					 va_arg(args, u16 *));
+				p = log_bin_put_str(p, end, str);
+			} else {
+				const char *s = va_arg(args, char *);
+
+				p = log_bin_put_str(p, end, s ? s : "<NULL>");
+			}
+			continue;
+		case 'p':
+			if (*spec.ext) {
+				log_bin_spec_str(&spec, "", spec_str);
+				snprintf(str, sizeof(str), spec_str,
+					 va_arg(args, void *));
+				p = log_bin_put_str(p, end, str);
+			} else {
+				p = log_bin_put(p, end,
+						(ulong)va_arg(args, void *));
+			}
+			continue;
+		case 'n':
+			va_arg(args, void *);
+			continue;
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			break;
+		default:
+			continue;
+		}
+
+		/* Same promotion rules as vsnprintf() */
+		if (spec.qualifier == 'L')
+			val = va_arg(args, long long);
+		else if (spec.qualifier == 'l')
+			val = va_arg(args, unsigned long);
+		else if (spec.qualifier == 'Z' || spec.qualifier == 'z')
+			val = va_arg(args, size_t);
+		else if (spec.qualifier == 't')
+			val = va_arg(args, ptrdiff_t);
+		else if (spec.qualifier == 'h')
+			val = (unsigned short)va_arg(args, int);
+		else
+			val = va_arg(args, unsigned int);
+		if (spec.conv == 'd' || spec.conv == 'i') {
+			if (spec.qualifier == 'l')
+				val = (long)val;
+			else if (spec.qualifier == 'h')
+				val = (short)val;
+			else if (!spec.qualifier)
+				val = (int)val;
+		}
+		p = log_bin_put(p, end, val);
+	}
+
+	return p - buf;
+}
+
+/**
+ * log_bin_format_msg() - Format a message from its packed arguments
+ *
+ * @str: Buffer for the message
+ * @size: Size of @str
+ * @fmt: printf() format string
+ * @args: Arguments packed by log_bin_pack()
+ * @args_len: Length of @args
+ * Return: length of the message, excluding the terminator
+ */
+static int log_bin_format_msg(char *str, int size, const char *fmt,
+			      const u8 *args, int args_len)
+{
+	const u8 *p = args, *end = args + args_len;
+	char spec_str[LOG_BIN_SPEC_MAX];
+	struct log_bin_spec spec;
+	int len = 0;
+
+	for (; *fmt && len < size - 1; fmt++) {
+		if (*fmt != '%') {
+			str[len++] = *fmt;
+			continue;
+		}
+		log_bin_parse(fmt, &spec);
+		fmt = spec.end;
+		if (spec.width_arg)
+			spec.width = (int)log_bin_get(&p, end);
+		if (spec.prec_arg) {
+			spec.prec = log_bin_get(&p, end);
+			if (spec.prec < 0)
+				spec.prec = 0;
+		}
+
+		switch (spec.conv) {
+		case 'c':
+			log_bin_spec_str(&spec, "", spec_str);
+			len += scnprintf(str + len, size - len, spec_str,
+					 (int)log_bin_get(&p, end));
+			break;
+		case 's':
+			spec.qualifier = 0;
+			log_bin_spec_str(&spec, "", spec_str);
+			len += scnprintf(str + len, size - len, spec_str,
+					 log_bin_get_str(&p, end));
+			break;
+		case 'p':
+			if (*spec.ext) {
+				len += scnprintf(str + len, size - len, "%s",
+						 log_bin_get_str(&p, end));
+			} else {
+				log_bin_spec_str(&spec, "", spec_str);
+				len += scnprintf(str + len, size - len,
+						 spec_str,
+						 (void *)(ulong)log_bin_get(&p,
+									    end));
+			}
+			break;
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			log_bin_spec_str(&spec, "ll", spec_str);
+			len += scnprintf(str + len, size - len, spec_str,
+					 log_bin_get(&p, end));
+			break;
+		case 'n':
+			break;
+		case '%':
+			str[len++] = '%';
+			break;
+		default:
+			str[len++] = '%';
+			if (spec.conv && len < size - 1)
+				str[len++] = spec.conv;
+			break;
+		}
+	}
+	str[len] = '\0';
+
+	return len;
+}
+
+/**
+ * log_bin_format_rec() - Format a record in the same way as log_console
+ *
+ * @rec: Record to format
+ * @str: Buffer for the formatted record
+ * @size: Size of @str
+ * Return: length of the formatted record, excluding the terminator
+ */
+static int log_bin_format_rec(const struct log_bin_rec *rec, char *str,
+			      int size)
+{
+	const u8 *args = rec->args, *end = (const u8 *)rec + rec->len;
+	const char *file = log_bin_get_str(&args, end);
+	const char *func = log_bin_get_str(&args, end);
+	ulong us = rec->time_us;
+	int fmt = gd->log_fmt;
+	int len;
+
+	len = scnprintf(str, size, "[%5lu.%06lu] ", us / 1000000, us % 1000000);
+	if (fmt & BIT(LOGF_LEVEL))
+		len += scnprintf(str + len, size - len, "%s.",
+				 log_get_level_name(rec->level));
+	if (fmt & BIT(LOGF_CAT))
+		len += scnprintf(str + len, size - len, "%s,",
+				 log_get_cat_name(rec->cat));
+	if (fmt & BIT(LOGF_FILE))
+		len += scnprintf(str + len, size - len, "%s:", file);
+	if (fmt & BIT(LOGF_LINE))
+		len += scnprintf(str + len, size - len, "%d-", rec->line);
+	if (fmt & BIT(LOGF_FUNC))
+		len += scnprintf(str + len, size - len, "%s()", func);
+	if (fmt & BIT(LOGF_MSG)) {
+		if (fmt != BIT(LOGF_MSG))
+			len += scnprintf(str + len, size - len, " ");
+		len += log_bin_format_msg(str + len, size - len,
+					  log_bin_from_link(rec->fmt), args,
+					  end - args);
+	}
+
+	return len;
+}
+
+static void log_bin_reset(struct log_bin_hdr *hdr)
+{
+	hdr->head = 0;
+	hdr->tail = 0;
+	hdr->count = 0;
+}
+
+/* Return the record at offset @pos, skipping the end of the buffer */
+static struct log_bin_rec *log_bin_rec_at(struct log_bin_hdr *hdr, u32 pos)
+{
+	struct log_bin_rec *rec;
+
+	if (pos == hdr->size)
+		return (struct log_bin_rec *)hdr->data;
+	rec = (struct log_bin_rec *)(hdr->data + pos);
+
+	return rec->len ? rec : (struct log_bin_rec *)hdr->data;
+}
+
+static u32 log_bin_space(struct log_bin_hdr *hdr)
+{
+	if (!hdr->count)
+		return hdr->size - hdr->head;
+	if (hdr->tail > hdr->head)
+		return hdr->tail - hdr->head;
+	if (hdr->tail == hdr->head)
+		return 0;
+
+	return hdr->size - hdr->head + hdr->tail;
+}
+
+static void log_bin_drop_oldest(struct log_bin_hdr *hdr)
+{
+	struct log_bin_rec *rec = log_bin_rec_at(hdr, hdr->tail);
+
+	hdr->tail = (u8 *)rec - hdr->data + rec->len;
+	hdr->dropped++;
+	if (!--hdr->count)
+		log_bin_reset(hdr);
+}
+
+/**
+ * log_bin_write() - Add a record to the buffer
+ *
+ * The oldest records are dropped to make room. A record which would run off
+ * the end of the buffer is placed at the start instead, leaving a zero length
+ * behind so the reader knows to wrap.
+ *
+ * @hdr: Buffer to write to
+ * @rec: Record to add, with @rec->len set
+ */
+static void log_bin_write(struct log_bin_hdr *hdr,
+			  const struct log_bin_rec *rec)
+{
+	u32 len = rec->len;
+	u32 need, pos;
+
+	if (len > hdr->size) {
+		hdr->dropped++;
+		return;
+	}
+	for (;;) {
+		pos = hdr->head;
+		need = len;
+		if (hdr->size - pos < len)
+			need += hdr->size - pos;
+		if (!hdr->count || log_bin_space(hdr) >= need)
+			break;
+		log_bin_drop_oldest(hdr);
+	}
+	if (hdr->size - pos < len) {
+		if (pos < hdr->size)
+			((struct log_bin_rec *)(hdr->data + pos))->len = 0;
+		pos = 0;
+	}
+	memcpy(hdr->data + pos, rec, len);
+	if (!hdr->count++)
+		hdr->tail = pos;
+	hdr->head = pos + len;
+}
+
+static int log_bin_emit(struct log_device *ldev, struct log_rec *rec)
+{
+	u64 buf[LOG_BIN_REC_MAX / sizeof(u64)];
+	struct log_bin_rec *brec = (struct log_bin_rec *)buf;
+	u8 *p, *end = (u8 *)buf + sizeof(buf);
+	int len, size;
+
+	if (!log_bin || !rec->args)
+		return -ENOENT;
+
+	brec->level = rec->level;
+	brec->force_debug = rec->force_debug;
+	brec->cat = rec->cat;
+	brec->line = rec->line;
+	brec->time_us = timer_get_boot_us();
+	brec->fmt = log_bin_to_link(rec->fmt);
+	p = log_bin_put_str(brec->args, end, rec->file);
+	p = log_bin_put_str(p, end, rec->func);
+	p += log_bin_pack(p, end - p, rec->fmt, *rec->args);
+	len = p - (u8 *)buf;
+	size = ALIGN(len, LOG_BIN_ALIGN);
+	memset((u8 *)buf + len, '\0', size - len);
+	brec->len = size;
+	log_bin_write(log_bin, brec);
+
+	return 0;
+}
+
+static int log_bin_probe(struct log_device *ldev)
+{
+	ulong size = CONFIG_LOG_BINARY_SIZE;
+	struct log_bin_hdr *hdr = log_bin;
+	ulong image = log_bin_to_link(version_string);
+	int ret;
+
+	if (!hdr) {
+		if (CONFIG_LOG_BINARY_ADDR)
+			hdr = map_sysmem(CONFIG_LOG_BINARY_ADDR, size);
+		else if (gd->flags & GD_FLG_RELOC)
+			hdr = malloc(size);
+
+		/* Too early for malloc(); try again after relocation */
+		if (!hdr)
+			return -ENOMEM;
+
+		/*
+		 * Start afresh on each boot. After relocation we only get
+		 * here if the pointer was not carried over, in which case the
+		 * records written before relocation can still be picked up
+		 */
+		if (!(gd->flags & GD_FLG_RELOC) || hdr->magic != LOG_BIN_MAGIC ||
+		    hdr->size != size - sizeof(*hdr) || hdr->image != image) {
+			hdr->magic = LOG_BIN_MAGIC;
+			hdr->size = rounddown(size - sizeof(*hdr),
+					      LOG_BIN_ALIGN);
+			hdr->image = image;
+			hdr->dropped = 0;
+			log_bin_reset(hdr);
+		}
+		log_bin = hdr;
+	}
+
+	/* Record at full verbosity, whatever the console shows */
+	ret = log_add_filter(ldev->drv->name, NULL, CONFIG_LOG_BINARY_LEVEL,
+			     NULL);
+
+	return ret < 0 ? ret : 0;
+}
+
+int log_binary_dump(bool clear)
+{
+	struct log_bin_hdr *hdr = log_bin;
+	char str[LOG_BIN_LINE_MAX];
+	u32 pos, i;
+
+	if (!hdr)
+		return -ENOENT;
+
+	for (i = 0, pos = hdr->tail; i < hdr->count; i++) {
+		struct log_bin_rec *rec = log_bin_rec_at(hdr, pos);
+
+		log_bin_format_rec(rec, str, sizeof(str));
+		puts(str);
+		pos = (u8 *)rec - hdr->data + rec->len;
+	}
+	if (hdr->dropped)
+		printf("(%u records dropped)\n", hdr->dropped);
+	if (clear) {
+		log_bin_reset(hdr);
+		hdr->dropped = 0;
+	}
+
+	return i;
+}
+
+#if CONFIG_IS_ENABLED(LOG_BINARY_PSTORE)
+/* Same layout as struct persistent_ram_buffer in Linux */
+struct log_bin_pstore {
+	u32 sig;
+	u32 start;
+	u32 size;
+	u8 data[];
+};
+
+#define LOG_BIN_PSTORE_SIG	0x43474244	/* DBGC */
+
+/* Append to a pstore zone, overwriting the oldest text once it is full */
+static void log_bin_pstore_write(struct log_bin_pstore *prz, u32 cap,
+				 const char *str, u32 len)
+{
+	u32 part;
+
+	if (len > cap) {
+		str += len - cap;
+		len = cap;
+	}
+	part = min(len, cap - prz->start);
+	memcpy(prz->data + prz->start, str, part);
+	memcpy(prz->data, str + part, len - part);
+	prz->start = (prz->start + len) % cap;
+	prz->size = min(prz->size + len, cap);
+}
+
+int log_binary_to_pstore(void)
+{
+	struct log_bin_hdr *hdr = log_bin;
+	char str[LOG_BIN_LINE_MAX];
+	struct log_bin_pstore *prz;
+	phys_addr_t addr;
+	phys_size_t size;
+	u32 pos, cap, i;
+
+	if (!hdr)
+		return -ENOENT;
+	if (pstore_get_pmsg_zone(&addr, &size) ||
+	    size <= sizeof(*prz))
+		return -ENOSPC;
+
+	prz = map_sysmem(addr, size);
+	cap = size - sizeof(*prz);
+	prz->sig = LOG_BIN_PSTORE_SIG;
+	prz->start = 0;
+	prz->size = 0;
+	for (i = 0, pos = hdr->tail; i < hdr->count; i++) {
+		struct log_bin_rec *rec = log_bin_rec_at(hdr, pos);
+		int len;
+
+		len = log_bin_format_rec(rec, str, sizeof(str));
+		log_bin_pstore_write(prz, cap, str, len);
+		pos = (u8 *)rec - hdr->data + rec->len;
+	}
+	unmap_sysmem(prz);
+
+	return 0;
+}
+#endif
+
+LOG_DRIVER(binary) = {
+	.name	= "binary",
+	.emit	= log_bin_emit,
+	.probe	= log_bin_probe,
+	.flags	= LOGDF_ENABLE | LOGDF_RAW,
+};
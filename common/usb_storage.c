@@ -87,6 +87,10 @@ struct us_data {
 	unsigned char	ep_in;			/* in endpoint */
 	unsigned char	ep_out;			/* out ....... */
 	unsigned char	ep_int;			/* interrupt . */
+	unsigned char	ep_cmd;			/* UAS command out */
+	unsigned char	ep_status;		/* UAS status in */
+	unsigned char	uas_streams;		/* UAS streams, 0 if none */
+	unsigned char	uas_cmds;		/* UAS commands queued at once */
 	unsigned char	subclass;		/* as in overview */
 	unsigned char	protocol;		/* .............. */
 	unsigned char	attention_done;		/* force attn on first cmd */
@@ -175,6 +179,10 @@ static unsigned int usb_get_max_lun(struct us_data *us)
 {
 	int len;
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, result, 1);
+
+	/* Get Max LUN is a Bulk-Only request, UAS only gets LUN 0 here */
+	if (us->protocol == US_PR_UAS)
+		return 0;
 	len = usb_control_msg(us->pusb_dev,
 			      usb_rcvctrlpipe(us->pusb_dev, 0),
 			      US_BBB_GET_MAX_LUN,
@@ -528,16 +536,13 @@ static int usb_stor_CB_reset(struct us_data *us)
 }
 
 /*
- * Set up the command for a BBB device. Note that the actual SCSI
+ * Fill in the CBW of a command, with a new tag. Note that the actual SCSI
  * command is copied into cbw.CBWCDB.
  */
-static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
+static int usb_stor_BBB_fill_cbw(struct scsi_cmd *srb,
+				 struct umass_bbb_cbw *cbw)
 {
-	int result;
-	int actlen;
 	int dir_in;
-	unsigned int pipe;
-	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
 
 	dir_in = US_DIRECTION(srb->cmd[0]);
 
@@ -546,8 +551,10 @@ static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
 		dir_in, srb->lun, srb->cmdlen, srb->cmd, srb->datalen,
 		srb->pdata);
 	if (srb->cmdlen) {
-		for (result = 0; result < srb->cmdlen; result++)
-			printf("cmd[%d] %#x ", result, srb->cmd[result]);
+		int i;
+
+		for (i = 0; i < srb->cmdlen; i++)
+			printf("cmd[%d] %#x ", i, srb->cmd[i]);
 		printf("\n");
 	}
 #endif
@@ -557,9 +564,6 @@ static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
 		return -1;
 	}
 
-	/* always OUT to the ep */
-	pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
-
 	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
 	cbw->dCBWTag = cpu_to_le32(CBWTag++);
 	cbw->dCBWDataTransferLength = cpu_to_le32(srb->datalen);
@@ -570,6 +574,25 @@ static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
 	/* DST SRC LEN!!! */
 
 	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
+
+	return 0;
+}
+
+/*
+ * Set up the command for a BBB device.
+ */
+static int usb_stor_BBB_comdat(struct scsi_cmd *srb, struct us_data *us)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
+	int result;
+	int actlen;
+	unsigned int pipe;
+
+	if (usb_stor_BBB_fill_cbw(srb, cbw))
+		return -1;
+
+	/* always OUT to the ep */
+	pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 	result = usb_bulk_msg(us->pusb_dev, pipe, cbw, UMASS_BBB_CBW_SIZE,
 			      &actlen, USB_CNTL_TIMEOUT * 5);
 	if (result < 0)
@@ -704,6 +727,83 @@ static int usb_stor_BBB_clear_endpt_stall(struct us_data *us, __u8 endpt)
 			       endpt, NULL, 0, USB_CNTL_TIMEOUT * 5);
 }
 
+/*
+ * Queue the CBW, data and CSW of a command at once, so that the controller
+ * goes from one phase to the next without waiting for us. The phases that do
+ * not fit in the controller's rings are done once the others have completed.
+ * Returns 0 with the CSW read, -EOPNOTSUPP if the controller cannot queue
+ * transfers (nothing was sent), -EPIPE if the data phase stalled (the stall
+ * is cleared and the CSW still to be read), other -ve on error.
+ */
+static int usb_stor_BBB_queue(struct scsi_cmd *srb, struct us_data *us,
+			      struct umass_bbb_csw *csw, int *data_actlen)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
+	struct usb_device *udev = us->pusb_dev;
+	struct usb_bulk_xfer xfer[3] = {};
+	int dir_in = US_DIRECTION(srb->cmd[0]);
+	int count = 0, queued, data = -1;
+	int result = 0, phase, i;
+
+	if (usb_stor_BBB_fill_cbw(srb, cbw))
+		return -EINVAL;
+
+	xfer[count].pipe = usb_sndbulkpipe(udev, us->ep_out);
+	xfer[count].buffer = cbw;
+	xfer[count++].length = UMASS_BBB_CBW_SIZE;
+	if (srb->datalen) {
+		data = count;
+		xfer[count].pipe = dir_in ? usb_rcvbulkpipe(udev, us->ep_in) :
+					    usb_sndbulkpipe(udev, us->ep_out);
+		xfer[count].buffer = srb->pdata;
+		xfer[count++].length = srb->datalen;
+	}
+	xfer[count].pipe = usb_rcvbulkpipe(udev, us->ep_in);
+	xfer[count].buffer = csw;
+	xfer[count++].length = UMASS_BBB_CSW_SIZE;
+
+	for (queued = 0; queued < count; queued++) {
+		if (usb_bulk_submit(udev, &xfer[queued]))
+			break;
+	}
+	if (!queued)
+		return -EOPNOTSUPP;
+
+	for (phase = 0; phase < count; phase++) {
+		if (phase < queued) {
+			result = usb_bulk_wait(udev, &xfer[phase],
+					       USB_CNTL_TIMEOUT * 5);
+		} else {
+			result = usb_bulk_msg(udev, xfer[phase].pipe,
+					      xfer[phase].buffer,
+					      xfer[phase].length,
+					      &xfer[phase].actual_length,
+					      USB_CNTL_TIMEOUT * 5);
+			if (result && (udev->status & USB_ST_STALLED))
+				result = -EPIPE;
+		}
+		if (result)
+			break;
+	}
+	if (data >= 0)
+		*data_actlen = xfer[data].actual_length;
+	if (!result)
+		return 0;
+
+	debug("BBB phase %d failed: %d\n", phase, result);
+	for (i = phase; i < queued; i++) {
+		if (xfer[i].status == -EINPROGRESS)
+			usb_bulk_cancel(udev, &xfer[i]);
+	}
+	if (result != -EPIPE || phase == 0)
+		return -EIO;
+	if (usb_stor_BBB_clear_endpt_stall(us, usb_pipein(xfer[phase].pipe) ?
+					   us->ep_in : us->ep_out) < 0)
+		return -EIO;
+
+	return -EPIPE;
+}
+
 static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 {
 	int result, retry;
@@ -717,6 +817,22 @@ static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 #endif
 
 	dir_in = US_DIRECTION(srb->cmd[0]);
+	pipein = usb_rcvbulkpipe(us->pusb_dev, us->ep_in);
+	pipeout = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
+	data_actlen = 0;
+
+	/* all three phases at once, once the device is known to be ready */
+	if (CONFIG_IS_ENABLED(DM_USB) && (us->flags & USB_READY)) {
+		result = usb_stor_BBB_queue(srb, us, csw, &data_actlen);
+		if (result == 0)
+			goto csw;
+		if (result == -EPIPE)
+			goto st;
+		if (result != -EOPNOTSUPP) {
+			usb_stor_BBB_reset(us);
+			return USB_STOR_TRANSPORT_FAILED;
+		}
+	}
 
 	/* COMMAND phase */
 	debug("COMMAND phase\n");
@@ -729,10 +845,7 @@ static int usb_stor_BBB_transport(struct scsi_cmd *srb, struct us_data *us)
 	}
 	if (!(us->flags & USB_READY))
 		mdelay(5);
-	pipein = usb_rcvbulkpipe(us->pusb_dev, us->ep_in);
-	pipeout = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 	/* DATA phase + error handling */
-	data_actlen = 0;
 	/* no data, go immediately to the STATUS phase */
 	if (srb->datalen == 0)
 		goto st;
@@ -789,6 +902,7 @@ again:
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
+csw:
 #ifdef BBB_XPORT_TRACE
 	ptr = (unsigned char *)csw;
 	for (index = 0; index < UMASS_BBB_CSW_SIZE; index++)
@@ -939,6 +1053,487 @@ do_retry:
 	return USB_STOR_TRANSPORT_FAILED;
 }
 
+#if CONFIG_IS_ENABLED(USB_UAS)
+/*
+ * USB Attached SCSI: commands go out on their own pipe, each with a tag.
+ * With streams (SuperSpeed) the data and the status of a command use the
+ * stream of the same number as its tag; without them the device tells which
+ * command it is ready for on the status pipe.
+ */
+
+/* Commands queued to a UAS device at once, numbered from tag 1 */
+#define UAS_MAX_CMDS	4
+
+static int usb_stor_UAS_send_cmd(struct scsi_cmd *srb, struct us_data *us,
+				 unsigned int tag)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_command_iu, iu, 1);
+	int actlen;
+
+	memset(iu, 0, sizeof(*iu));
+	iu->iu_id = UAS_IU_COMMAND;
+	iu->tag = cpu_to_be16(tag);
+	iu->lun[1] = srb->lun;
+	memcpy(iu->cdb, srb->cmd, sizeof(iu->cdb));
+
+	return usb_bulk_msg(us->pusb_dev,
+			    usb_sndbulkpipe(us->pusb_dev, us->ep_cmd), iu,
+			    sizeof(*iu), &actlen, USB_CNTL_TIMEOUT * 5);
+}
+
+static int usb_stor_UAS_data(struct scsi_cmd *srb, struct us_data *us,
+			     unsigned int stream_id)
+{
+	unsigned int pipe;
+	int actlen;
+
+	if (US_DIRECTION(srb->cmd[0]))
+		pipe = usb_rcvbulkpipe(us->pusb_dev, us->ep_in);
+	else
+		pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
+
+	return usb_bulk_stream_msg(us->pusb_dev, pipe, stream_id, srb->pdata,
+				   srb->datalen, &actlen,
+				   USB_CNTL_TIMEOUT * 5);
+}
+
+static int usb_stor_UAS_status(struct us_data *us, unsigned int stream_id,
+			       struct uas_sense_iu *siu)
+{
+	int actlen;
+	int ret;
+
+	ret = usb_bulk_stream_msg(us->pusb_dev,
+				  usb_rcvbulkpipe(us->pusb_dev, us->ep_status),
+				  stream_id, siu, sizeof(*siu), &actlen,
+				  USB_CNTL_TIMEOUT * 5);
+	if (ret < 0 || actlen < 4)
+		return -EIO;
+
+	return 0;
+}
+
+/* The Sense IU ending a command, as USB_STOR_TRANSPORT_... */
+static int usb_stor_UAS_sense(struct scsi_cmd *srb, struct uas_sense_iu *siu)
+{
+	if (siu->iu_id != UAS_IU_SENSE) {
+		debug("UAS: IU %#x instead of sense\n", siu->iu_id);
+		return USB_STOR_TRANSPORT_ERROR;
+	}
+
+	srb->status = siu->status;
+	if (!siu->status)
+		return USB_STOR_TRANSPORT_GOOD;
+
+	memcpy(srb->sense_buf, siu->sense,
+	       min_t(uint, be16_to_cpu(siu->len), sizeof(srb->sense_buf)));
+	debug("UAS: status %#x, sense %02X %02X %02X\n", siu->status,
+	      srb->sense_buf[2], srb->sense_buf[12], srb->sense_buf[13]);
+
+	return USB_STOR_TRANSPORT_FAILED;
+}
+
+/* Room for a Sense IU, not sharing its cache lines with the next one */
+#define UAS_SIU_SIZE	ALIGN(sizeof(struct uas_sense_iu), ARCH_DMA_MINALIGN)
+
+/* Cancel the transfers of @xfer still queued, endpoint by endpoint */
+static void usb_stor_UAS_cancel(struct us_data *us,
+				struct usb_bulk_xfer *xfer, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (xfer[i].status == -EINPROGRESS)
+			usb_bulk_cancel(us->pusb_dev, &xfer[i]);
+	}
+}
+
+/*
+ * With streams, queue the data and status transfers of all the commands
+ * before sending them, so that the device moves the data of any of them
+ * without waiting for us. Returns -EOPNOTSUPP if the controller cannot
+ * queue transfers, else as usb_stor_UAS_run().
+ */
+static int usb_stor_UAS_run_queued(struct scsi_cmd *srb, int count,
+				   struct us_data *us)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, sbuf, UAS_MAX_CMDS * UAS_SIU_SIZE);
+	struct usb_device *udev = us->pusb_dev;
+	struct usb_bulk_xfer data[UAS_MAX_CMDS] = {};
+	struct usb_bulk_xfer status[UAS_MAX_CMDS] = {};
+	int result = USB_STOR_TRANSPORT_GOOD;
+	struct uas_sense_iu *siu;
+	int ret;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		memset(srb[i].sense_buf, 0, sizeof(srb[i].sense_buf));
+		if (srb[i].datalen) {
+			if (US_DIRECTION(srb[i].cmd[0]))
+				data[i].pipe = usb_rcvbulkpipe(udev, us->ep_in);
+			else
+				data[i].pipe = usb_sndbulkpipe(udev,
+							       us->ep_out);
+			data[i].stream_id = i + 1;
+			data[i].buffer = srb[i].pdata;
+			data[i].length = srb[i].datalen;
+			ret = usb_bulk_submit(udev, &data[i]);
+			if (ret == -EOPNOTSUPP && !i)
+				return ret;
+			if (ret)
+				goto err;
+		}
+		status[i].pipe = usb_rcvbulkpipe(udev, us->ep_status);
+		status[i].stream_id = i + 1;
+		status[i].buffer = sbuf + i * UAS_SIU_SIZE;
+		status[i].length = sizeof(*siu);
+		ret = usb_bulk_submit(udev, &status[i]);
+		if (ret == -EOPNOTSUPP && !i && !srb[i].datalen)
+			return ret;
+		if (ret)
+			goto err;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (usb_stor_UAS_send_cmd(&srb[i], us, i + 1) < 0) {
+			debug("UAS: failed to send command %d\n", i + 1);
+			goto err;
+		}
+	}
+
+	/*
+	 * A command failing ends with its Sense IU alone, so wait on the status
+	 * and only then on the data, which is complete if the command is.
+	 */
+	for (i = 0; i < count; i++) {
+		if (usb_bulk_wait(udev, &status[i], USB_CNTL_TIMEOUT * 5) ||
+		    status[i].actual_length < 4)
+			goto err;
+		siu = status[i].buffer;
+		if (be16_to_cpu(siu->tag) != i + 1)
+			goto err;
+		ret = usb_stor_UAS_sense(&srb[i], siu);
+		if (ret == USB_STOR_TRANSPORT_ERROR)
+			goto err;
+		if (ret != USB_STOR_TRANSPORT_GOOD) {
+			result = ret;
+			continue;
+		}
+		if (srb[i].datalen &&
+		    usb_bulk_wait(udev, &data[i], USB_CNTL_TIMEOUT * 5))
+			goto err;
+	}
+
+	/* The data of the commands failing never comes */
+	usb_stor_UAS_cancel(us, data, count);
+
+	return result;
+
+err:
+	debug("UAS: queued transfer failed\n");
+	usb_stor_UAS_cancel(us, data, count);
+	usb_stor_UAS_cancel(us, status, count);
+	us->transport_reset(us);
+	return USB_STOR_TRANSPORT_ERROR;
+}
+
+/*
+ * Run the @count commands of @srb with tags 1 to @count, all of them queued
+ * before the first one completes. The sense data of a command failing is left
+ * in its sense_buf.
+ */
+static int usb_stor_UAS_run(struct scsi_cmd *srb, int count,
+			    struct us_data *us)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_sense_iu, siu, 1);
+	int result = USB_STOR_TRANSPORT_GOOD;
+	unsigned int pending = 0;
+	unsigned int tag;
+	int ret;
+	int i;
+
+	if (us->uas_streams) {
+		ret = usb_stor_UAS_run_queued(srb, count, us);
+		if (ret != -EOPNOTSUPP)
+			return ret;
+	}
+
+	for (i = 0; i < count; i++) {
+		memset(srb[i].sense_buf, 0, sizeof(srb[i].sense_buf));
+		if (usb_stor_UAS_send_cmd(&srb[i], us, i + 1) < 0) {
+			debug("UAS: failed to send command %d\n", i + 1);
+			us->transport_reset(us);
+			return USB_STOR_TRANSPORT_ERROR;
+		}
+		pending |= 1 << i;
+	}
+
+	/* With streams, complete the commands in order */
+	for (i = 0; us->uas_streams && i < count; i++) {
+		/* A command failing sends its Sense IU without the data */
+		if (srb[i].datalen &&
+		    usb_stor_UAS_data(&srb[i], us, i + 1) < 0) {
+			usb_clear_halt(us->pusb_dev,
+				       US_DIRECTION(srb[i].cmd[0]) ?
+				       usb_rcvbulkpipe(us->pusb_dev, us->ep_in) :
+				       usb_sndbulkpipe(us->pusb_dev,
+						       us->ep_out));
+			if (usb_stor_UAS_status(us, i + 1, siu) ||
+			    be16_to_cpu(siu->tag) != i + 1 ||
+			    usb_stor_UAS_sense(&srb[i], siu) !=
+			    USB_STOR_TRANSPORT_FAILED)
+				goto err;
+			result = USB_STOR_TRANSPORT_FAILED;
+			pending &= ~(1 << i);
+			continue;
+		}
+		if (usb_stor_UAS_status(us, i + 1, siu) ||
+		    be16_to_cpu(siu->tag) != i + 1)
+			goto err;
+		ret = usb_stor_UAS_sense(&srb[i], siu);
+		if (ret == USB_STOR_TRANSPORT_ERROR)
+			goto err;
+		if (ret != USB_STOR_TRANSPORT_GOOD)
+			result = ret;
+		pending &= ~(1 << i);
+	}
+
+	/* Without them, in the order the device chooses */
+	while (pending) {
+		if (usb_stor_UAS_status(us, 0, siu))
+			goto err;
+		tag = be16_to_cpu(siu->tag);
+		if (!tag || tag > count || !(pending & (1 << (tag - 1))))
+			goto err;
+
+		switch (siu->iu_id) {
+		case UAS_IU_READ_READY:
+		case UAS_IU_WRITE_READY:
+			if (usb_stor_UAS_data(&srb[tag - 1], us, 0) < 0)
+				goto err;
+			break;
+		default:
+			ret = usb_stor_UAS_sense(&srb[tag - 1], siu);
+			if (ret == USB_STOR_TRANSPORT_ERROR)
+				goto err;
+			if (ret != USB_STOR_TRANSPORT_GOOD)
+				result = ret;
+			pending &= ~(1 << (tag - 1));
+			break;
+		}
+	}
+
+	return result;
+
+err:
+	debug("UAS: transfer failed, status %ld\n", us->pusb_dev->status);
+	us->transport_reset(us);
+	return USB_STOR_TRANSPORT_ERROR;
+}
+
+static int usb_stor_UAS_transport(struct scsi_cmd *srb, struct us_data *us)
+{
+	return usb_stor_UAS_run(srb, 1, us);
+}
+
+/*
+ * Clear a stall on any of the four pipes, then reset the logical unit so that
+ * it drops the commands still queued, whose tags the next ones reuse. The
+ * task management function takes the tag following those of the commands,
+ * which has a stream of its own.
+ */
+static int usb_stor_UAS_reset(struct us_data *us)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_task_mgmt_iu, tmf, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_sense_iu, siu, 1);
+	struct uas_response_iu *riu = (struct uas_response_iu *)siu;
+	struct usb_device *dev = us->pusb_dev;
+	unsigned int tag = us->uas_cmds + 1;
+	int actlen;
+	int ret;
+	int i;
+
+	usb_clear_halt(dev, usb_sndbulkpipe(dev, us->ep_cmd));
+	usb_clear_halt(dev, usb_rcvbulkpipe(dev, us->ep_status));
+	usb_clear_halt(dev, usb_rcvbulkpipe(dev, us->ep_in));
+	usb_clear_halt(dev, usb_sndbulkpipe(dev, us->ep_out));
+
+	memset(tmf, 0, sizeof(*tmf));
+	tmf->iu_id = UAS_IU_TASK_MGMT;
+	tmf->tag = cpu_to_be16(tag);
+	tmf->function = UAS_TMF_LOGICAL_UNIT_RESET;
+	ret = usb_bulk_msg(dev, usb_sndbulkpipe(dev, us->ep_cmd), tmf,
+			   sizeof(*tmf), &actlen, USB_CNTL_TIMEOUT * 5);
+	if (ret < 0)
+		goto err;
+
+	/* Without streams, the Sense IU of a command may still come first */
+	for (i = 0; i <= UAS_MAX_CMDS; i++) {
+		ret = usb_bulk_stream_msg(dev,
+					  usb_rcvbulkpipe(dev, us->ep_status),
+					  us->uas_streams ? tag : 0, siu,
+					  sizeof(*siu), &actlen,
+					  USB_CNTL_TIMEOUT * 5);
+		if (ret < 0 || actlen < sizeof(*riu))
+			break;
+		if (riu->iu_id != UAS_IU_RESPONSE ||
+		    be16_to_cpu(riu->tag) != tag)
+			continue;
+		if (riu->response_code == UAS_RC_TMF_COMPLETE ||
+		    riu->response_code == UAS_RC_TMF_SUCCEEDED)
+			return 0;
+		debug("UAS: task management response %#x\n",
+		      riu->response_code);
+		break;
+	}
+
+err:
+	debug("UAS: logical unit reset failed\n");
+	return -EIO;
+}
+
+/*
+ * Find the alternate setting of interface @ifnum speaking UAS in the
+ * configuration descriptor @buf. Its four pipes are told apart by the pipe
+ * usage descriptors following the endpoints, which only the raw descriptor
+ * has. @eps is indexed by pipe ID - 1, and @max_streams returns the streams
+ * supported by all the pipes but the command one.
+ */
+static int usb_stor_UAS_find_alt(unsigned char *buf, int len, int ifnum,
+				 unsigned char *eps, int *max_streams)
+{
+	struct usb_descriptor_header *head;
+	struct usb_interface_descriptor *ifd;
+	struct usb_endpoint_descriptor *epd = NULL;
+	struct usb_ss_ep_comp_descriptor *comp;
+	struct uas_pipe_usage_desc *usage;
+	int streams = 0;
+	int alt = -1;
+	int index;
+
+	/* One more for the task management function of usb_stor_UAS_reset() */
+	*max_streams = UAS_MAX_CMDS + 1;
+	for (index = 0; index + 2 <= len; index += head->bLength) {
+		head = (struct usb_descriptor_header *)&buf[index];
+		if (head->bLength < 2 || index + head->bLength > len)
+			break;
+
+		switch (head->bDescriptorType) {
+		case USB_DT_INTERFACE:
+			/* The UAS alternate setting ends here */
+			if (alt >= 0)
+				return alt;
+			ifd = (struct usb_interface_descriptor *)head;
+			if (ifd->bInterfaceNumber == ifnum &&
+			    ifd->bInterfaceClass == USB_CLASS_MASS_STORAGE &&
+			    ifd->bInterfaceProtocol == US_PR_UAS)
+				alt = ifd->bAlternateSetting;
+			break;
+		case USB_DT_ENDPOINT:
+			epd = (struct usb_endpoint_descriptor *)head;
+			streams = 0;
+			break;
+		case USB_DT_SS_ENDPOINT_COMP:
+			comp = (struct usb_ss_ep_comp_descriptor *)head;
+			if (comp->bmAttributes & 0x1f)
+				streams = 1 << (comp->bmAttributes & 0x1f);
+			break;
+		case USB_DT_PIPE_USAGE:
+			usage = (struct uas_pipe_usage_desc *)head;
+			if (alt < 0 || !epd || !usage->bPipeID ||
+			    usage->bPipeID > UAS_PIPE_DATA_OUT)
+				break;
+			eps[usage->bPipeID - 1] = epd->bEndpointAddress &
+						  USB_ENDPOINT_NUMBER_MASK;
+			if (usage->bPipeID != UAS_PIPE_CMD)
+				*max_streams = min(*max_streams, streams);
+			break;
+		}
+	}
+
+	return alt >= 0 ? alt : -ENOENT;
+}
+
+/*
+ * Switch the interface to its UAS alternate setting, if it has one, and set
+ * up streams for a SuperSpeed device. On failure @ss is left unchanged.
+ */
+static int usb_stor_UAS_probe(struct usb_device *dev,
+			      struct usb_interface *iface, struct us_data *ss)
+{
+	int ifnum = iface->desc.bInterfaceNumber;
+	unsigned char eps[UAS_PIPE_DATA_OUT] = { 0 };
+	unsigned long pipes[3];
+	unsigned char *buf;
+	int max_streams;
+	int streams = 0;
+	int alt;
+	int len;
+	int ret;
+
+	len = usb_get_configuration_len(dev, 0);
+	if (len < 0)
+		return len;
+	buf = malloc_cache_aligned(len);
+	if (!buf)
+		return -ENOMEM;
+	ret = usb_get_configuration_no(dev, 0, buf, len);
+	if (ret == len)
+		alt = usb_stor_UAS_find_alt(buf, len, ifnum, eps, &max_streams);
+	else
+		alt = ret < 0 ? ret : -EIO;
+	free(buf);
+	if (alt < 0)
+		return alt;
+	if (!eps[0] || !eps[1] || !eps[2] || !eps[3]) {
+		debug("UAS: missing pipes\n");
+		return -EINVAL;
+	}
+
+	ret = usb_set_interface(dev, ifnum, alt);
+	if (ret)
+		return ret;
+
+	if (dev->speed >= USB_SPEED_SUPER) {
+		pipes[0] = usb_rcvbulkpipe(dev, eps[UAS_PIPE_STATUS - 1]);
+		pipes[1] = usb_rcvbulkpipe(dev, eps[UAS_PIPE_DATA_IN - 1]);
+		pipes[2] = usb_sndbulkpipe(dev, eps[UAS_PIPE_DATA_OUT - 1]);
+		streams = -EINVAL;
+		if (max_streams)
+			streams = usb_alloc_streams(dev, pipes,
+						    ARRAY_SIZE(pipes),
+						    max_streams);
+		if (streams < 0) {
+			debug("UAS: no streams (err=%d)\n", streams);
+			if (alt)
+				usb_set_interface(dev, ifnum, 0);
+			return streams;
+		}
+	}
+
+	ss->protocol = US_PR_UAS;
+	ss->transport = usb_stor_UAS_transport;
+	ss->transport_reset = usb_stor_UAS_reset;
+	ss->ep_cmd = eps[UAS_PIPE_CMD - 1];
+	ss->ep_status = eps[UAS_PIPE_STATUS - 1];
+	ss->ep_in = eps[UAS_PIPE_DATA_IN - 1];
+	ss->ep_out = eps[UAS_PIPE_DATA_OUT - 1];
+	ss->uas_streams = streams;
+	if (streams)
+		ss->uas_cmds = clamp(streams - 1, 1, UAS_MAX_CMDS);
+	else
+		ss->uas_cmds = UAS_MAX_CMDS;
+	debug("UAS: alt %d, endpoints %d %d %d %d, %d streams\n", alt,
+	      ss->ep_cmd, ss->ep_status, ss->ep_in, ss->ep_out, streams);
+
+	return 0;
+}
+#endif /* CONFIG_USB_UAS */
+
+/* Transfer sizes in blocks, see usb_stor_set_max_xfer_blk() */
+#define USB_STOR_SAFE_XFER_BLK	240
+#define USB_STOR_SS_XFER_BLK	2048
+
 static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 				      struct us_data *us)
 {
@@ -958,8 +1553,15 @@ static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 	 * Windows 7 limiting transfers to 128 sectors for both USB2 and USB3
 	 * and Apple Mac OS X 10.11 limiting transfers to 256 sectors for USB2
 	 * and 2048 for USB3 devices.
+	 *
+	 * USB3 devices start from the 2048 sectors Mac OS X uses, and fall
+	 * back towards 240 if a transfer fails in the transport, see
+	 * usb_stor_shrink_xfer().
 	 */
-	unsigned short blk = 240;
+	unsigned short blk = USB_STOR_SAFE_XFER_BLK;
+
+	if (udev->speed >= USB_SPEED_SUPER)
+		blk = USB_STOR_SS_XFER_BLK;
 
 #if CONFIG_IS_ENABLED(DM_USB)
 	size_t size;
@@ -973,6 +1575,33 @@ static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 	us->max_xfer_blk = blk;
 }
 
+/*
+ * Halve the transfer size of a device which failed a transfer larger than
+ * USB_STOR_SAFE_XFER_BLK, for this transfer to be retried and from then on.
+ * Only a failure of the transport, a stall or a timeout, is blamed on the
+ * size: if any of the @count commands of @srb came back with a sense key, a
+ * CHECK CONDITION for a medium error say, the device handled the size fine.
+ * Returns false once there is nothing left to try.
+ */
+static bool usb_stor_shrink_xfer(struct us_data *us, struct scsi_cmd *srb,
+				 int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (srb[i].sense_buf[2] & 0x0f)
+			return false;
+
+	if (us->max_xfer_blk <= USB_STOR_SAFE_XFER_BLK)
+		return false;
+
+	us->max_xfer_blk = max_t(unsigned short, us->max_xfer_blk / 2,
+				 USB_STOR_SAFE_XFER_BLK);
+	debug("%s: now %u blocks per transfer\n", __func__, us->max_xfer_blk);
+
+	return true;
+}
+
 static int usb_inquiry(struct scsi_cmd *srb, struct us_data *ss)
 {
 	int retry, i;
@@ -1001,7 +1630,13 @@ static int usb_request_sense(struct scsi_cmd *srb, struct us_data *ss)
 {
 	char *ptr;
 
+	/* A UAS device returns the sense data along with the status */
+	if (ss->protocol == US_PR_UAS)
+		return 0;
+
 	ptr = (char *)srb->pdata;
+	/* Not to leave the sense of an earlier command if this one fails */
+	memset(srb->sense_buf, 0, sizeof(srb->sense_buf));
 	memset(&srb->cmd[0], 0, 12);
 	srb->cmd[0] = SCSI_REQ_SENSE;
 	srb->cmd[1] = srb->lun << 5;
@@ -1066,11 +1701,11 @@ static int usb_read_capacity(struct scsi_cmd *srb, struct us_data *ss)
 	return -1;
 }
 
-static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
-		       unsigned long start, unsigned short blocks)
+static void usb_rw_10_cmd(struct scsi_cmd *srb, unsigned char opcode,
+			  unsigned long start, unsigned short blocks)
 {
 	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_READ10;
+	srb->cmd[0] = opcode;
 	srb->cmd[1] = srb->lun << 5;
 	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
 	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
@@ -1079,6 +1714,12 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
 	srb->cmd[8] = (unsigned char) blocks & 0xff;
 	srb->cmdlen = 12;
+}
+
+static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
+		       unsigned long start, unsigned short blocks)
+{
+	usb_rw_10_cmd(srb, SCSI_READ10, start, blocks);
 	debug("read10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
@@ -1086,20 +1727,61 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 static int usb_write_10(struct scsi_cmd *srb, struct us_data *ss,
 			unsigned long start, unsigned short blocks)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_WRITE10;
-	srb->cmd[1] = srb->lun << 5;
-	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
-	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
-	srb->cmd[4] = ((unsigned char) (start >> 8)) & 0xff;
-	srb->cmd[5] = ((unsigned char) (start)) & 0xff;
-	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
-	srb->cmd[8] = (unsigned char) blocks & 0xff;
-	srb->cmdlen = 12;
+	usb_rw_10_cmd(srb, SCSI_WRITE10, start, blocks);
 	debug("write10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
 
+#if CONFIG_IS_ENABLED(USB_UAS)
+/*
+ * Read or write @blkcnt blocks with up to uas_cmds commands of max_xfer_blk
+ * blocks in flight. Returns the number of blocks transferred.
+ */
+static lbaint_t usb_stor_UAS_rw(struct us_data *ss, struct blk_desc *block_dev,
+				lbaint_t start, lbaint_t blkcnt,
+				uintptr_t buf_addr, bool write)
+{
+	static struct scsi_cmd srbs[UAS_MAX_CMDS];
+	unsigned short smallblks;
+	lbaint_t blks = blkcnt;
+	lbaint_t done;
+	int retry = 2;
+	int n;
+
+	while (blks) {
+		for (n = 0, done = 0; n < ss->uas_cmds && done < blks; n++) {
+			smallblks = min_t(lbaint_t, blks - done,
+					  ss->max_xfer_blk);
+			if (smallblks == ss->max_xfer_blk)
+				usb_show_progress();
+			srbs[n].lun = block_dev->lun;
+			srbs[n].datalen = block_dev->blksz * smallblks;
+			srbs[n].pdata = (unsigned char *)buf_addr +
+					block_dev->blksz * done;
+			usb_rw_10_cmd(&srbs[n], write ? SCSI_WRITE10 :
+					SCSI_READ10, start + done, smallblks);
+			done += smallblks;
+		}
+		debug("uas %s: start " LBAF " blocks " LBAF " in %d commands\n",
+		      write ? "write" : "read", start, done, n);
+
+		if (usb_stor_UAS_run(srbs, n, ss)) {
+			debug("%s ERROR\n", write ? "Write" : "Read");
+			ss->flags &= ~USB_READY;
+			if (usb_stor_shrink_xfer(ss, srbs, n) || retry--)
+				continue;
+			break;
+		}
+		start += done;
+		blks -= done;
+		buf_addr += block_dev->blksz * done;
+		retry = 2;
+	}
+
+	return blkcnt - blks;
+}
+#endif
+
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1134,7 +1816,7 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *udev;
 	struct us_data *ss;
 	int retry;
@@ -1170,7 +1852,14 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
-	do {
+#if CONFIG_IS_ENABLED(USB_UAS)
+	if (ss->protocol == US_PR_UAS) {
+		blkcnt = usb_stor_UAS_rw(ss, block_dev, start, blks, buf_addr,
+					 false);
+		blks = 0;
+	}
+#endif
+	while (blks != 0) {
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1187,6 +1876,10 @@ retry_it:
 			debug("Read ERROR\n");
 			ss->flags &= ~USB_READY;
 			usb_request_sense(srb, ss);
+			if (usb_stor_shrink_xfer(ss, srb, 1)) {
+				smallblks = min(smallblks, ss->max_xfer_blk);
+				goto retry_it;
+			}
 			if (retry--)
 				goto retry_it;
 			blkcnt -= blks;
@@ -1195,7 +1888,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 
 	debug("usb_read: end startblk " LBAF ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
@@ -1217,7 +1910,7 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *udev;
 	struct us_data *ss;
 	int retry;
@@ -1255,7 +1948,14 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
-	do {
+#if CONFIG_IS_ENABLED(USB_UAS)
+	if (ss->protocol == US_PR_UAS) {
+		blkcnt = usb_stor_UAS_rw(ss, block_dev, start, blks, buf_addr,
+					 true);
+		blks = 0;
+	}
+#endif
+	while (blks != 0) {
 		/* If write fails retry for max retry count else
 		 * return with number of blocks written successfully.
 		 */
@@ -1274,6 +1974,10 @@ retry_it:
 			debug("Write ERROR\n");
 			ss->flags &= ~USB_READY;
 			usb_request_sense(srb, ss);
+			if (usb_stor_shrink_xfer(ss, srb, 1)) {
+				smallblks = min(smallblks, ss->max_xfer_blk);
+				goto retry_it;
+			}
 			if (retry--)
 				goto retry_it;
 			blkcnt -= blks;
@@ -1282,7 +1986,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 
 	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
@@ -1348,6 +2052,12 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		ss->transport = usb_stor_BBB_transport;
 		ss->transport_reset = usb_stor_BBB_reset;
 		break;
+#if CONFIG_IS_ENABLED(USB_UAS)
+	case US_PR_UAS:
+		/* set up by usb_stor_UAS_probe() below */
+		debug("UAS\n");
+		break;
+#endif
 	default:
 		printf("USB Storage Transport unknown / not yet implemented\n");
 		return 0;
@@ -1401,6 +2111,14 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		printf("Sorry, protocol %d not yet supported.\n", ss->subclass);
 		return 0;
 	}
+#if CONFIG_IS_ENABLED(USB_UAS)
+	/* Prefer UAS when the device offers it besides Bulk-Only */
+	if (usb_stor_UAS_probe(dev, iface, ss) &&
+	    ss->protocol == US_PR_UAS) {
+		debug("Problems with UAS device\n");
+		return 0;
+	}
+#endif
 	if (ss->ep_int) {
 		/* we had found an interrupt endpoint, prepare irq pipe
 		 * set up the IRQ pipe and handler
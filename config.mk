@@ -62,6 +62,10 @@ ifdef FTRACE
 PLATFORM_CPPFLAGS += -finstrument-functions -DFTRACE
 endif
 
+ifdef CONFIG_SAMPLE_PROF_CALLCHAIN
+PLATFORM_CPPFLAGS += -fno-omit-frame-pointer
+endif
+
 #########################################################################
 
 RELFLAGS := $(PLATFORM_RELFLAGS)
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Arena allocation of driver-model devices
+ *
+ * Each device is allocated as one bundle: a small header, the struct udevice
+ * and then space for its plat, uclass_plat, parent_plat, priv, uclass_priv and
+ * parent_priv, as needed. Bundles come from chunks owned by the uclass, which
+ * grow geometrically, so a device costs one header instead of up to seven
+ * malloc() chunks, and the devices of a uclass end up next to each other.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <dm/arena.h>
+#include <dm/uclass-internal.h>
+
+/* Alignment of bundles and of each area within them, as for malloc() */
+#define DM_ARENA_ALIGN		(2 * sizeof(size_t))
+
+/**
+ * struct dm_arena_bundle - header of a device bundle
+ *
+ * The struct udevice follows this header. While the bundle is free, the start
+ * of that space holds the node in the free list of the arena.
+ *
+ * @size: Size of the bundle in bytes, including this header
+ * @off: Offset of each data area from the start of the bundle, or 0 if the
+ *	area is not in the bundle. Each area extends to the next one.
+ */
+struct dm_arena_bundle {
+	u32 size;
+	u16 off[DM_ARENA_PART_COUNT];
+};
+
+#define DM_ARENA_HDR_SIZE	ALIGN(sizeof(struct dm_arena_bundle), \
+				      DM_ARENA_ALIGN)
+
+static struct dm_arena_bundle *dm_arena_bundle(const struct udevice *dev)
+{
+	return (void *)dev - DM_ARENA_HDR_SIZE;
+}
+
+static struct list_head *dm_arena_free_node(struct dm_arena_bundle *bundle)
+{
+	return (void *)bundle + DM_ARENA_HDR_SIZE;
+}
+
+void dm_arena_init(struct uclass *uc)
+{
+	INIT_LIST_HEAD(&uc->arena.free_head);
+}
+
+void dm_arena_uninit(struct uclass *uc)
+{
+	struct dm_arena *arena = &uc->arena;
+	void *chunk, *next;
+
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = *(void **)chunk;
+		free(chunk);
+	}
+	arena->chunks = NULL;
+	arena->cur = NULL;
+	arena->end = NULL;
+	arena->chunk_bytes = 0;
+	INIT_LIST_HEAD(&arena->free_head);
+}
+
+/* Work out the size of each data area that driver model allocates */
+static void dm_arena_sizes(struct uclass *uc, const struct driver *drv,
+			   struct udevice *parent, bool alloc_plat,
+			   int size[DM_ARENA_PART_COUNT])
+{
+	const struct uclass_driver *uc_drv = uc->uc_drv;
+	bool dma = drv->flags & DM_FLAG_ALLOC_PRIV_DMA;
+
+	memset(size, '\0', DM_ARENA_PART_COUNT * sizeof(int));
+	if (alloc_plat)
+		size[DM_ARENA_PLAT] = drv->plat_auto;
+	size[DM_ARENA_UCLASS_PLAT] = uc_drv->per_device_plat_auto;
+
+	/* Areas which need DMA alignment are left to alloc_priv() */
+	if (!dma)
+		size[DM_ARENA_PRIV] = drv->priv_auto;
+	if (!(uc_drv->flags & DM_UC_FLAG_ALLOC_PRIV_DMA))
+		size[DM_ARENA_UCLASS_PRIV] = uc_drv->per_device_auto;
+
+	if (parent) {
+		size[DM_ARENA_PARENT_PLAT] = parent->driver->per_child_plat_auto;
+		if (!size[DM_ARENA_PARENT_PLAT])
+			size[DM_ARENA_PARENT_PLAT] =
+				parent->uclass->uc_drv->per_child_plat_auto;
+		if (!dma) {
+			size[DM_ARENA_PARENT_PRIV] =
+				parent->driver->per_child_auto;
+			if (!size[DM_ARENA_PARENT_PRIV])
+				size[DM_ARENA_PARENT_PRIV] =
+					parent->uclass->uc_drv->per_child_auto;
+		}
+	}
+}
+
+/* Take @size bytes from the newest chunk, adding a chunk if needed */
+static void *dm_arena_carve(struct dm_arena *arena, uint size)
+{
+	ulong chunk_size;
+	void *ptr;
+
+	if (arena->end - arena->cur < size) {
+		/*
+		 * Start with room for just this device, since most uclasses
+		 * only have a few, then double the arena each time
+		 */
+		chunk_size = min_t(ulong, arena->chunk_bytes,
+				   CONFIG_DM_ARENA_CHUNK_SIZE);
+		chunk_size = max_t(ulong, chunk_size, size + DM_ARENA_ALIGN);
+		ptr = memalign(DM_ARENA_ALIGN, chunk_size);
+		if (!ptr)
+			return NULL;
+		*(void **)ptr = arena->chunks;
+		arena->chunks = ptr;
+		arena->cur = ptr + DM_ARENA_ALIGN;
+		arena->end = ptr + chunk_size;
+		arena->chunk_bytes += chunk_size;
+	}
+	ptr = arena->cur;
+	arena->cur += size;
+
+	return ptr;
+}
+
+struct udevice *dm_arena_alloc_dev(struct uclass *uc, const struct driver *drv,
+				   struct udevice *parent, bool alloc_plat)
+{
+	struct dm_arena *arena = &uc->arena;
+	struct dm_arena_bundle *bundle, *best = NULL;
+	int size[DM_ARENA_PART_COUNT];
+	u16 off[DM_ARENA_PART_COUNT];
+	struct list_head *node;
+	struct udevice *dev;
+	uint pos;
+	int i;
+
+	dm_arena_sizes(uc, drv, parent, alloc_plat, size);
+	pos = DM_ARENA_HDR_SIZE + ALIGN(sizeof(struct udevice), DM_ARENA_ALIGN);
+	for (i = 0; i < DM_ARENA_PART_COUNT; i++) {
+		/* Anything that does not fit the header is left to malloc() */
+		if (!size[i] || pos > U16_MAX) {
+			off[i] = 0;
+			continue;
+		}
+		off[i] = pos;
+		pos += ALIGN(size[i], DM_ARENA_ALIGN);
+	}
+
+	/* Reuse the best-fitting bundle of an unbound device, if any */
+	list_for_each(node, &arena->free_head) {
+		bundle = (void *)node - DM_ARENA_HDR_SIZE;
+		if (bundle->size >= pos && (!best || bundle->size < best->size))
+			best = bundle;
+	}
+	if (best) {
+		list_del(dm_arena_free_node(best));
+		bundle = best;
+		pos = best->size;
+	} else {
+		bundle = dm_arena_carve(arena, pos);
+		if (!bundle)
+			return NULL;
+	}
+
+	memset(bundle, '\0', pos);
+	bundle->size = pos;
+	memcpy(bundle->off, off, sizeof(off));
+	arena->used_bytes += pos;
+	arena->count++;
+
+	dev = (void *)bundle + DM_ARENA_HDR_SIZE;
+	dev_or_flags(dev, DM_FLAG_ARENA);
+
+	return dev;
+}
+
+void dm_arena_free_dev(struct udevice *dev)
+{
+	struct dm_arena *arena = &dev->uclass->arena;
+	struct dm_arena_bundle *bundle;
+
+	if (!(dev_get_flags(dev) & DM_FLAG_ARENA)) {
+		free(dev);
+		return;
+	}
+	bundle = dm_arena_bundle(dev);
+	arena->used_bytes -= bundle->size;
+	arena->count--;
+	list_add(dm_arena_free_node(bundle), &arena->free_head);
+}
+
+void *dm_arena_get(struct udevice *dev, enum dm_arena_part part, int size)
+{
+	struct dm_arena_bundle *bundle;
+	uint end;
+	void *ptr;
+	int i;
+
+	if (!(dev_get_flags(dev) & DM_FLAG_ARENA))
+		return NULL;
+	bundle = dm_arena_bundle(dev);
+	if (!bundle->off[part])
+		return NULL;
+
+	/* A reparented device may need a larger parent area than it has */
+	end = bundle->size;
+	for (i = part + 1; i < DM_ARENA_PART_COUNT; i++) {
+		if (bundle->off[i]) {
+			end = bundle->off[i];
+			break;
+		}
+	}
+	if (end - bundle->off[part] < size)
+		return NULL;
+
+	ptr = (void *)bundle + bundle->off[part];
+	memset(ptr, '\0', size);
+
+	return ptr;
+}
+
+void dm_arena_free(struct udevice *dev, void *ptr)
+{
+	struct dm_arena_bundle *bundle;
+
+	if (dev_get_flags(dev) & DM_FLAG_ARENA) {
+		bundle = dm_arena_bundle(dev);
+		if (ptr >= (void *)bundle && ptr < (void *)bundle + bundle->size)
+			return;
+	}
+	free(ptr);
+}
+
+uint dm_arena_dev_size(const struct udevice *dev)
+{
+	if (!(dev_get_flags(dev) & DM_FLAG_ARENA))
+		return 0;
+
+	return dm_arena_bundle(dev)->size;
+}
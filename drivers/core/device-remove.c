@@ -14,6 +14,7 @@
 #include <errno.h>
 #include <log.h>
 #include <malloc.h>
+#include <dm/arena.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/uclass.h>
@@ -96,15 +97,15 @@ int device_unbind(struct udevice *dev)
 		return log_msg_ret("child unbind", ret);
 
 	if (dev_get_flags(dev) & DM_FLAG_ALLOC_PDATA) {
-		free(dev_get_plat(dev));
+		dm_arena_free(dev, dev_get_plat(dev));
 		dev_set_plat(dev, NULL);
 	}
 	if (dev_get_flags(dev) & DM_FLAG_ALLOC_UCLASS_PDATA) {
-		free(dev_get_uclass_plat(dev));
+		dm_arena_free(dev, dev_get_uclass_plat(dev));
 		dev_set_uclass_plat(dev, NULL);
 	}
 	if (dev_get_flags(dev) & DM_FLAG_ALLOC_PARENT_PDATA) {
-		free(dev_get_parent_plat(dev));
+		dm_arena_free(dev, dev_get_parent_plat(dev));
 		dev_set_parent_plat(dev, NULL);
 	}
 	ret = uclass_unbind_device(dev);
@@ -118,7 +119,7 @@ int device_unbind(struct udevice *dev)
 
 	if (dev_get_flags(dev) & DM_FLAG_NAME_ALLOCED)
 		free((char *)dev->name);
-	free(dev);
+	dm_arena_free_dev(dev);
 
 	return 0;
 }
@@ -132,12 +133,12 @@ void device_free(struct udevice *dev)
 	int size;
 
 	if (dev->driver->priv_auto) {
-		free(dev_get_priv(dev));
+		dm_arena_free(dev, dev_get_priv(dev));
 		dev_set_priv(dev, NULL);
 	}
 	size = dev->uclass->uc_drv->per_device_auto;
 	if (size) {
-		free(dev_get_uclass_priv(dev));
+		dm_arena_free(dev, dev_get_uclass_priv(dev));
 		dev_set_uclass_priv(dev, NULL);
 	}
 	if (dev->parent) {
@@ -147,7 +148,7 @@ void device_free(struct udevice *dev)
 					per_child_auto;
 		}
 		if (size) {
-			free(dev_get_parent_priv(dev));
+			dm_arena_free(dev, dev_get_parent_priv(dev));
 			dev_set_parent_priv(dev, NULL);
 		}
 	}
@@ -18,6 +18,7 @@
 #include <fdt_support.h>
 #include <malloc.h>
 #include <asm/cache.h>
+#include <dm/arena.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -34,6 +35,19 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Allocate a zeroed plat area, in the device bundle if there is space */
+static void *device_alloc_area(struct udevice *dev, enum dm_arena_part part,
+			       int size)
+{
+	void *ptr;
+
+	ptr = dm_arena_get(dev, part, size);
+	if (!ptr)
+		ptr = calloc(1, size);
+
+	return ptr;
+}
+
 static int device_bind_common(struct udevice *parent, const struct driver *drv,
 			      const char *name, void *plat,
 			      ulong driver_data, ofnode node,
@@ -43,6 +57,7 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 	struct uclass *uc;
 	int size, ret = 0;
 	bool auto_seq = true;
+	bool alloc_plat = false;
 	void *ptr;
 
 	if (devp)
@@ -56,7 +71,23 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 		return ret;
 	}
 
-	dev = calloc(1, sizeof(struct udevice));
+	/* Check if we need to allocate plat */
+	if (drv->plat_auto) {
+		alloc_plat = !plat;
+
+		/*
+		 * For of-platdata, we try use the existing data, but if
+		 * plat_auto is larger, we must allocate a new space
+		 */
+		if (CONFIG_IS_ENABLED(OF_PLATDATA) &&
+		    of_plat_size < drv->plat_auto)
+			alloc_plat = true;
+	}
+
+	if (CONFIG_IS_ENABLED(DM_ARENA))
+		dev = dm_arena_alloc_dev(uc, drv, parent, alloc_plat);
+	else
+		dev = calloc(1, sizeof(struct udevice));
 	if (!dev)
 		return -ENOMEM;
 
@@ -92,23 +123,13 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 	if (auto_seq && !(uc->uc_drv->flags & DM_UC_FLAG_NO_AUTO_SEQ))
 		dev->seq_ = uclass_find_next_free_seq(uc);
 
-	/* Check if we need to allocate plat */
 	if (drv->plat_auto) {
-		bool alloc = !plat;
-
-		/*
-		 * For of-platdata, we try use the existing data, but if
-		 * plat_auto is larger, we must allocate a new space
-		 */
-		if (CONFIG_IS_ENABLED(OF_PLATDATA)) {
-			if (of_plat_size)
-				dev_or_flags(dev, DM_FLAG_OF_PLATDATA);
-			if (of_plat_size < drv->plat_auto)
-				alloc = true;
-		}
-		if (alloc) {
+		if (CONFIG_IS_ENABLED(OF_PLATDATA) && of_plat_size)
+			dev_or_flags(dev, DM_FLAG_OF_PLATDATA);
+		if (alloc_plat) {
 			dev_or_flags(dev, DM_FLAG_ALLOC_PDATA);
-			ptr = calloc(1, drv->plat_auto);
+			ptr = device_alloc_area(dev, DM_ARENA_PLAT,
+						drv->plat_auto);
 			if (!ptr) {
 				ret = -ENOMEM;
 				goto fail_alloc1;
@@ -127,7 +148,7 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 	size = uc->uc_drv->per_device_plat_auto;
 	if (size) {
 		dev_or_flags(dev, DM_FLAG_ALLOC_UCLASS_PDATA);
-		ptr = calloc(1, size);
+		ptr = device_alloc_area(dev, DM_ARENA_UCLASS_PLAT, size);
 		if (!ptr) {
 			ret = -ENOMEM;
 			goto fail_alloc2;
@@ -141,7 +162,8 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 			size = parent->uclass->uc_drv->per_child_plat_auto;
 		if (size) {
 			dev_or_flags(dev, DM_FLAG_ALLOC_PARENT_PDATA);
-			ptr = calloc(1, size);
+			ptr = device_alloc_area(dev, DM_ARENA_PARENT_PLAT,
+						size);
 			if (!ptr) {
 				ret = -ENOMEM;
 				goto fail_alloc3;
@@ -203,28 +225,28 @@ fail_uclass_bind:
 	if (CONFIG_IS_ENABLED(DM_DEVICE_REMOVE)) {
 		list_del(&dev->sibling_node);
 		if (dev_get_flags(dev) & DM_FLAG_ALLOC_PARENT_PDATA) {
-			free(dev_get_parent_plat(dev));
+			dm_arena_free(dev, dev_get_parent_plat(dev));
 			dev_set_parent_plat(dev, NULL);
 		}
 	}
 fail_alloc3:
 	if (CONFIG_IS_ENABLED(DM_DEVICE_REMOVE)) {
 		if (dev_get_flags(dev) & DM_FLAG_ALLOC_UCLASS_PDATA) {
-			free(dev_get_uclass_plat(dev));
+			dm_arena_free(dev, dev_get_uclass_plat(dev));
 			dev_set_uclass_plat(dev, NULL);
 		}
 	}
 fail_alloc2:
 	if (CONFIG_IS_ENABLED(DM_DEVICE_REMOVE)) {
 		if (dev_get_flags(dev) & DM_FLAG_ALLOC_PDATA) {
-			free(dev_get_plat(dev));
+			dm_arena_free(dev, dev_get_plat(dev));
 			dev_set_plat(dev, NULL);
 		}
 	}
 fail_alloc1:
 	devres_release_all(dev);
 
-	free(dev);
+	dm_arena_free_dev(dev);
 
 	return ret;
 }
@@ -292,10 +314,16 @@ int device_reparent(struct udevice *dev, struct udevice *new_parent)
 	return 0;
 }
 
-static void *alloc_priv(int size, uint flags)
+static void *alloc_priv(struct udevice *dev, enum dm_arena_part part,
+			int size, uint flags)
 {
 	void *priv;
 
+	/* Use the space kept for this in the device bundle, if any */
+	priv = dm_arena_get(dev, part, size);
+	if (priv)
+		return priv;
+
 	if (flags & DM_FLAG_ALLOC_PRIV_DMA) {
 		size = ROUND(size, ARCH_DMA_MINALIGN);
 		priv = memalign(ARCH_DMA_MINALIGN, size);
@@ -353,7 +381,8 @@ static int device_alloc_priv(struct udevice *dev)
 
 	/* Allocate private data if requested and not reentered */
 	if (drv->priv_auto && !dev_get_priv(dev)) {
-		ptr = alloc_priv(drv->priv_auto, drv->flags);
+		ptr = alloc_priv(dev, DM_ARENA_PRIV, drv->priv_auto,
+				 drv->flags);
 		if (!ptr)
 			return -ENOMEM;
 		dev_set_priv(dev, ptr);
@@ -362,7 +391,8 @@ static int device_alloc_priv(struct udevice *dev)
 	/* Allocate private data if requested and not reentered */
 	size = dev->uclass->uc_drv->per_device_auto;
 	if (size && !dev_get_uclass_priv(dev)) {
-		ptr = alloc_priv(size, dev->uclass->uc_drv->flags);
+		ptr = alloc_priv(dev, DM_ARENA_UCLASS_PRIV, size,
+				 dev->uclass->uc_drv->flags);
 		if (!ptr)
 			return -ENOMEM;
 		dev_set_uclass_priv(dev, ptr);
@@ -374,7 +404,8 @@ static int device_alloc_priv(struct udevice *dev)
 		if (!size)
 			size = dev->parent->uclass->uc_drv->per_child_auto;
 		if (size && !dev_get_parent_priv(dev)) {
-			ptr = alloc_priv(size, drv->flags);
+			ptr = alloc_priv(dev, DM_ARENA_PARENT_PRIV, size,
+					 drv->flags);
 			if (!ptr)
 				return -ENOMEM;
 			dev_set_parent_priv(dev, ptr);
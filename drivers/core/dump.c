@@ -161,6 +161,54 @@ void dm_dump_drivers(void)
 	}
 }
 
+#if CONFIG_IS_ENABLED(DM_ARENA)
+void dm_dump_mem(void)
+{
+	struct driver *d = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	ulong used = 0, total = 0, bytes;
+	struct driver *entry;
+	struct udevice *dev;
+	struct uclass *uc;
+	uint count = 0, i;
+	int id;
+
+	puts("uclass                Devices     Used    Arena\n");
+	puts("-----------------------------------------------\n");
+	for (id = 0; id < UCLASS_COUNT; id++) {
+		uc = uclass_find(id);
+		if (!uc || !uc->arena.chunk_bytes)
+			continue;
+		printf("%-20.20s %8u %8lu %8lu\n", uc->uc_drv->name,
+		       uc->arena.count, uc->arena.used_bytes,
+		       uc->arena.chunk_bytes);
+		count += uc->arena.count;
+		used += uc->arena.used_bytes;
+		total += uc->arena.chunk_bytes;
+	}
+
+	puts("\nDriver                Devices    Bytes\n");
+	puts("--------------------------------------\n");
+	for (entry = d; entry < d + n_ents; entry++) {
+		uc = uclass_find(entry->id);
+		if (!uc)
+			continue;
+		i = 0;
+		bytes = 0;
+		uclass_foreach_dev(dev, uc) {
+			if (dev->driver != entry)
+				continue;
+			bytes += dm_arena_dev_size(dev);
+			i++;
+		}
+		if (i)
+			printf("%-20.20s %8u %8lu\n", entry->name, i, bytes);
+	}
+	printf("\n%u devices use %lu bytes of %lu in arenas\n", count, used,
+	       total);
+}
+#endif
+
 void dm_dump_static_driver_info(void)
 {
 	struct driver_info *drv = ll_entry_start(struct driver_info,
@@ -14,6 +14,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <asm/global_data.h>
+#include <dm/arena.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -83,6 +84,7 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 		uclass_set_priv(uc, ptr);
 	}
 	uc->uc_drv = uc_drv;
+	dm_arena_init(uc);
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, DM_UCLASS_ROOT_NON_CONST);
@@ -137,6 +139,7 @@ int uclass_destroy(struct uclass *uc)
 	list_del(&uc->sibling_node);
 	if (uc_drv->priv_auto)
 		free(uclass_get_priv(uc));
+	dm_arena_uninit(uc);
 	free(uc);
 
 	return 0;
@@ -13,6 +13,9 @@
 #include <flash.h>
 #include <part.h>
 #include <stdlib.h>
+#include <time.h>
+#include <div64.h>
+#include <linux/sizes.h>
 
 /**
  * image_size - final fastboot image size
@@ -29,6 +32,22 @@ static u32 fastboot_bytes_received;
  */
 static u32 fastboot_bytes_expected;
 
+/**
+ * fastboot_download_start - time at which the current download started
+ */
+static ulong fastboot_download_start;
+
+/**
+ * fastboot_streaming - whether the download is written out as it arrives
+ */
+static bool fastboot_streaming;
+
+/* Streaming is never on without "oem stream", so its calls are dropped */
+static inline bool fastboot_is_streaming(void)
+{
+	return CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM) && fastboot_streaming;
+}
+
 static void okay(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
@@ -48,6 +67,9 @@ static void oem_partconf(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_BOOTBUS)
 static void oem_bootbus(char *, char *);
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+static void oem_stream(char *, char *);
+#endif
 
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 static void run_ucmd(char *, char *);
@@ -122,6 +144,12 @@ static const struct {
 		.dispatch = oem_bootbus,
 	},
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = oem_stream,
+	},
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 	[FASTBOOT_COMMAND_UCMD] = {
 		.command = "UCmd",
@@ -207,6 +235,11 @@ static void download(char *cmd_parameter, char *response)
 		fastboot_fail("Expected command parameter", response);
 		return;
 	}
+	/* A streamed download which did not complete cannot be resumed */
+	if (fastboot_is_streaming() && fastboot_bytes_expected) {
+		fastboot_mmc_stream_abort();
+		fastboot_streaming = false;
+	}
 	fastboot_bytes_received = 0;
 	fastboot_bytes_expected = simple_strtoul(cmd_parameter, &tmp, 16);
 	if (fastboot_bytes_expected == 0) {
@@ -219,11 +252,12 @@ static void download(char *cmd_parameter, char *response)
 	 *
 	 * where cmd_parameter is an 8 digit hexadecimal number
 	 */
-	if (fastboot_bytes_expected > fastboot_buf_size) {
+	if (fastboot_bytes_expected > fastboot_buf_size && !fastboot_is_streaming()) {
 		fastboot_fail(cmd_parameter, response);
 	} else {
 		printf("Starting download of %d bytes\n",
 		       fastboot_bytes_expected);
+		fastboot_download_start = get_timer(0);
 		fastboot_response("DATA", response, "%s", cmd_parameter);
 	}
 }
@@ -238,6 +272,94 @@ u32 fastboot_data_remaining(void)
 	return fastboot_bytes_expected - fastboot_bytes_received;
 }
 
+/* Size of the ring which the download buffer is used as while streaming */
+static u32 fastboot_ring_size(void)
+{
+	return ALIGN_DOWN(fastboot_buf_size, SZ_4K);
+}
+
+/**
+ * fastboot_data_dest() - Return where received data belongs
+ *
+ * @offset: Offset of the data from the start of the download
+ * @len: Length of the data, reduced to the room there is at that place
+ *
+ * Return: Pointer into the download buffer, or NULL if there is no room
+ */
+void *fastboot_data_dest(u32 offset, u32 *len)
+{
+	u32 ring = fastboot_ring_size();
+	u32 pos = offset;
+	u32 room = 0;
+
+	if (fastboot_is_streaming()) {
+		/* All the data before fastboot_bytes_received is written out */
+		pos = offset % ring;
+		if (offset - fastboot_bytes_received < ring)
+			room = min(ring - pos,
+				   fastboot_bytes_received + ring - offset);
+	} else if (offset < fastboot_buf_size) {
+		room = fastboot_buf_size - offset;
+	}
+
+	*len = min(*len, room);
+
+	return *len ? fastboot_buf_addr + pos : NULL;
+}
+
+static bool fastboot_data_len_ok(unsigned int fastboot_data_len)
+{
+	return fastboot_data_len &&
+	       fastboot_bytes_received + fastboot_data_len <=
+	       fastboot_bytes_expected;
+}
+
+/**
+ * fastboot_data_received() - Account for data placed in the download buffer
+ *
+ * @fastboot_data_len: Length of the data received after the previous data
+ * @response: Pointer to fastboot response buffer
+ *
+ * The data must be where fastboot_data_dest() said. Writes to response.
+ * fastboot_bytes_received is updated to indicate the number of bytes that
+ * have been transferred. While streaming, the data is written out first.
+ */
+void fastboot_data_received(unsigned int fastboot_data_len, char *response)
+{
+#define BYTES_PER_DOT	0x20000
+	u32 pre_dot_num, now_dot_num;
+	u32 len = fastboot_data_len;
+	void *data;
+
+	data = fastboot_data_dest(fastboot_bytes_received, &len);
+	if (!fastboot_data_len_ok(fastboot_data_len) ||
+	    len != fastboot_data_len) {
+		fastboot_fail("Received invalid data length",
+			      response);
+		return;
+	}
+
+	if (fastboot_is_streaming() &&
+	    fastboot_mmc_stream_write(data, fastboot_data_len, response)) {
+		fastboot_mmc_stream_abort();
+		fastboot_streaming = false;
+		fastboot_bytes_expected = 0;
+		fastboot_bytes_received = 0;
+		return;
+	}
+
+	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
+	fastboot_bytes_received += fastboot_data_len;
+	now_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
+
+	if (pre_dot_num != now_dot_num) {
+		putc('.');
+		if (!(now_dot_num % 74))
+			putc('\n');
+	}
+	*response = '\0';
+}
+
 /**
  * fastboot_data_download() - Copy image data to fastboot_buf_addr.
  *
@@ -256,30 +378,31 @@ void fastboot_data_download(const void *fastboot_data,
 			    unsigned int fastboot_data_len,
 			    char *response)
 {
-#define BYTES_PER_DOT	0x20000
-	u32 pre_dot_num, now_dot_num;
+	const void *src = fastboot_data;
+	u32 len;
+	void *dest;
 
-	if (fastboot_data_len == 0 ||
-	    (fastboot_bytes_received + fastboot_data_len) >
-	    fastboot_bytes_expected) {
+	if (!fastboot_data_len_ok(fastboot_data_len)) {
 		fastboot_fail("Received invalid data length",
 			      response);
 		return;
 	}
-	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
 
-	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
-	fastboot_bytes_received += fastboot_data_len;
-	now_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
-
-	if (pre_dot_num != now_dot_num) {
-		putc('.');
-		if (!(now_dot_num % 74))
-			putc('\n');
+	/* Download data to fastboot_buf_addr, which may wrap when streaming */
+	while (fastboot_data_len) {
+		len = fastboot_data_len;
+		dest = fastboot_data_dest(fastboot_bytes_received, &len);
+		if (!dest) {
+			fastboot_fail("No room for received data", response);
+			return;
+		}
+		memcpy(dest, src, len);
+		fastboot_data_received(len, response);
+		if (*response)
+			return;
+		src += len;
+		fastboot_data_len -= len;
 	}
-	*response = '\0';
 }
 
 /**
@@ -291,13 +414,24 @@ void fastboot_data_download(const void *fastboot_data,
  */
 void fastboot_data_complete(char *response)
 {
-	/* Download complete. Respond with "OKAY" */
-	fastboot_okay(NULL, response);
-	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
+	ulong ms = max(get_timer(fastboot_download_start), 1UL);
+	u32 rate = lldiv((u64)fastboot_bytes_received * 1000, ms) / 1024;
+
+	/* Download complete. Respond with "OKAY" and the throughput */
+	fastboot_response("OKAY", response, "%u KiB/s", rate);
+	printf("\ndownloading of %d bytes finished in %lu ms (%u KiB/s)\n",
+	       fastboot_bytes_received, ms, rate);
 	image_size = fastboot_bytes_received;
 	env_set_hex("filesize", image_size);
 	fastboot_bytes_expected = 0;
 	fastboot_bytes_received = 0;
+
+	/* The image is not in the buffer, so there is nothing to flash */
+	if (fastboot_is_streaming()) {
+		fastboot_streaming = false;
+		image_size = 0;
+		fastboot_mmc_stream_finish(response);
+	}
 }
 
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH)
@@ -514,3 +648,35 @@ static void oem_bootbus(char *cmd_parameter, char *response)
 		fastboot_okay(NULL, response);
 }
 #endif
+
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+/**
+ * oem_stream() - Execute the OEM stream command
+ *
+ * @cmd_parameter: Pointer to partition name
+ * @response: Pointer to fastboot response buffer
+ *
+ * Makes the next download be written to the partition while it is received.
+ */
+static void oem_stream(char *cmd_parameter, char *response)
+{
+	if (!cmd_parameter) {
+		fastboot_fail("Expected command parameter", response);
+		return;
+	}
+	if (fastboot_streaming)
+		fastboot_mmc_stream_abort();
+	fastboot_streaming = false;
+	fastboot_bytes_expected = 0;
+
+	if (!fastboot_ring_size()) {
+		fastboot_fail("Download buffer too small", response);
+		return;
+	}
+	if (fastboot_mmc_stream_start(cmd_parameter, response))
+		return;
+
+	fastboot_streaming = true;
+	fastboot_okay(NULL, response);
+}
+#endif
@@ -173,6 +173,55 @@ static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+static lbaint_t fb_mmc_sparse_erase(struct sparse_storage *info,
+				    lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+
+	if (fastboot_progress_callback)
+		fastboot_progress_callback("erasing");
+
+	return blk_derase(sparse->dev_desc, blk, blkcnt);
+}
+
+/**
+ * fb_mmc_sparse_init() - Set up writing a sparse image to a partition
+ *
+ * @sparse: Storage to set up
+ * @sparse_priv: Private data of @sparse
+ * @dev_desc: Block device the partition is on
+ * @info: Partition to write
+ */
+static void fb_mmc_sparse_init(struct sparse_storage *sparse,
+			       struct fb_mmc_sparse *sparse_priv,
+			       struct blk_desc *dev_desc,
+			       struct disk_partition *info)
+{
+	struct mmc *mmc;
+
+	sparse_priv->dev_desc = dev_desc;
+
+	memset(sparse, '\0', sizeof(*sparse));
+	sparse->blksz = info->blksz;
+	sparse->start = info->start;
+	sparse->size = info->size;
+	sparse->write = fb_mmc_sparse_write;
+	sparse->reserve = fb_mmc_sparse_reserve;
+	sparse->mssg = fastboot_fail;
+	sparse->priv = sparse_priv;
+
+	if (!IS_ENABLED(CONFIG_FASTBOOT_FLASH_MMC_SPARSE_ERASE))
+		return;
+
+	/* Erased blocks read back as ERASED_MEM_CONT, which must be zero */
+	mmc = find_mmc_device(dev_desc->devnum);
+	if (mmc && !IS_SD(mmc) && mmc->ext_csd &&
+	    !mmc->ext_csd[EXT_CSD_ERASED_MEM_CONT]) {
+		sparse->erase_grp = mmc->erase_grp_size;
+		sparse->erase = fb_mmc_sparse_erase;
+	}
+}
+
 static void write_raw_image(struct blk_desc *dev_desc,
 			    struct disk_partition *info, const char *part_name,
 			    void *buffer, u32 download_bytes, char *response)
@@ -607,19 +656,11 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 		struct sparse_storage sparse;
 		int err;
 
-		sparse_priv.dev_desc = dev_desc;
-
-		sparse.blksz = info.blksz;
-		sparse.start = info.start;
-		sparse.size = info.size;
-		sparse.write = fb_mmc_sparse_write;
-		sparse.reserve = fb_mmc_sparse_reserve;
-		sparse.mssg = fastboot_fail;
+		fb_mmc_sparse_init(&sparse, &sparse_priv, dev_desc, &info);
 
 		printf("Flashing sparse image at offset " LBAFU "\n",
 		       sparse.start);
 
-		sparse.priv = &sparse_priv;
 		err = write_sparse_image(&sparse, cmd, download_buffer,
 					 response);
 		if (!err)
@@ -630,6 +671,67 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+static struct fb_mmc_sparse stream_priv;
+static struct sparse_storage stream_storage;
+static struct sparse_stream stream;
+static char stream_part[PART_NAME_LEN];
+
+/**
+ * fastboot_mmc_stream_start() - Prepare to write a partition as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @response: Pointer to fastboot response buffer
+ */
+int fastboot_mmc_stream_start(const char *cmd, char *response)
+{
+	struct blk_desc *dev_desc;
+	struct disk_partition info;
+
+	if (fastboot_mmc_get_part_info(cmd, &dev_desc, &info, response) < 0)
+		return -ENOENT;
+
+	fb_mmc_sparse_init(&stream_storage, &stream_priv, dev_desc, &info);
+	strlcpy(stream_part, cmd, sizeof(stream_part));
+
+	printf("Streaming image to partition '%s' at offset " LBAFU "\n",
+	       stream_part, stream_storage.start);
+
+	return sparse_stream_init(&stream, &stream_storage, stream_part,
+				  response);
+}
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a streamed image
+ *
+ * @data: Data following what was given before
+ * @len: Length of the data
+ * @response: Pointer to fastboot response buffer
+ */
+int fastboot_mmc_stream_write(const void *data, u32 len, char *response)
+{
+	return sparse_stream_write(&stream, data, len, response);
+}
+
+/**
+ * fastboot_mmc_stream_finish() - Finish writing a streamed image
+ *
+ * @response: Pointer to fastboot response buffer
+ */
+int fastboot_mmc_stream_finish(char *response)
+{
+	return sparse_stream_finish(&stream, response);
+}
+
+/**
+ * fastboot_mmc_stream_abort() - Stop writing a streamed image
+ */
+void fastboot_mmc_stream_abort(void)
+{
+	sparse_stream_abort(&stream);
+}
+#endif
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
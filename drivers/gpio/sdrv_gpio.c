@@ -160,19 +160,21 @@ static int sdrv_gpio_of_to_plat(struct udevice *dev)
 	int ret;
 	ofnode subnode;
 
+	/* The ports are bound below, with their settings as plat */
+	if (dev_read_bool(dev, "gpio-controller")) {
+		port_priv = dev_get_plat(dev);
+		uc_priv->bank_name = port_priv->name;
+		uc_priv->gpio_base = port_priv->gpio_ranges[2];
+		uc_priv->gpio_count = port_priv->ngpio;
+		return 0;
+	}
+
 	addr = dev_read_addr(dev);
 	gpio_bank->base = (unsigned long)map_physmem(addr, 0, MAP_NOCACHE);
 
-	if (strstr(dev->name,"30420000"))
-	    uc_priv->bank_name = "gpio4";
-	else if (strstr(dev->name,"30430000"))
-	    uc_priv->bank_name = "gpio5";
-	else {
-	    port_priv = dev_get_plat(dev);
-	    uc_priv->bank_name = port_priv->name;
-	    uc_priv->gpio_base = port_priv->gpio_ranges[2];
-	    uc_priv->gpio_count = port_priv->ngpio;
-	}
+	uc_priv->bank_name = dev_read_string(dev, "gpio-bank-name");
+	if (!uc_priv->bank_name)
+		uc_priv->bank_name = dev->name;
 
 	for (subnode = dev_read_first_subnode(dev); ofnode_valid(subnode);
 	     subnode = dev_read_next_subnode(subnode)) {
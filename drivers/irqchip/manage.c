@@ -19,6 +19,13 @@
 #include <dm/device-internal.h>
 
 static struct irq_desc g_irq_desc[CONFIG_NR_IRQS];
+/* Registers of the interrupted context, valid while a handler runs */
+static struct pt_regs *g_irq_regs;
+
+struct pt_regs *get_irq_regs(void)
+{
+	return g_irq_regs;
+}
 
 void enable_irq(unsigned int irq)
 {
@@ -115,6 +122,7 @@ void handle_irq_event(struct pt_regs *pt_regs, unsigned int esr)
 	struct irq_chip *irq_chip = NULL;
 	unsigned int irqnr;
 
+	g_irq_regs = pt_regs;
 	do {
 		irqnr = gic_get_irqinfo();
 		irq_desc = &g_irq_desc[irqnr];
@@ -150,6 +158,7 @@ void handle_irq_event(struct pt_regs *pt_regs, unsigned int esr)
 			break;
 		}
 	} while (1);
+	g_irq_regs = NULL;
 }
 
 int register_irqchip(const struct irq_chip *chip)
@@ -11,6 +11,7 @@
 #include <cpu_func.h>
 #include <dm.h>
 #include <errno.h>
+#include <iobuf.h>
 #include <log.h>
 #include <malloc.h>
 #include <mmc.h>
@@ -836,7 +837,8 @@ static int sdhci_init(struct mmc *mmc)
 #else
 #ifdef CONFIG_MMC_SDHCI_DWCMSHC
 	if (host->quirks & SDHCI_QUIRK_64BIT_DMA_ADDR) {
-		host->align_buffer = memalign(16, 512 * 1024);
+		if (!host->align_buffer)
+			host->align_buffer = iobuf_alloc(512 * 1024);
 		if (!host->align_buffer) {
 			printf("%s: Aligned buffer alloc failed!!!\n",
 			       __func__);
@@ -845,7 +847,8 @@ static int sdhci_init(struct mmc *mmc)
 	} else {
 #endif
 	if (host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) {
-		host->align_buffer = memalign(8, 512 * 1024);
+		if (!host->align_buffer)
+			host->align_buffer = iobuf_alloc(512 * 1024);
 		if (!host->align_buffer) {
 			printf("%s: Aligned buffer alloc failed!!!\n",
 			       __func__);
@@ -114,6 +114,24 @@ int mmc_get_env_addr(struct mmc *mmc, int copy, u32 *env_addr)
 	return 0;
 }
 
+int mmc_get_env_end(struct mmc *mmc, int copy, u64 *env_end)
+{
+	struct partitions *partition = NULL;
+
+	if (!mmc)
+		return -EINVAL;
+
+	partition = find_mmc_partition_by_name(copy ? "env_b" : "env_a");
+	if (!partition) {
+		pr_err("env partition is not found\n");
+		return -EINVAL;
+	}
+
+	*env_end = (partition->offset + partition->size) * mmc->read_bl_len;
+
+	return 0;
+}
+
 int mmc_device_init(struct mmc *mmc)
 {
 	int ret = 0, i = 0;
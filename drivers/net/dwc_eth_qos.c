@@ -25,6 +25,9 @@
  *    AHB slave/register bus, contains the DMA, MTL, and MAC sub-blocks, and
  *    supports a single RGMII PHY. This configuration also has SW control over
  *    all clock and reset signals to the HW block.
+ * semidrive:
+ *    Semidrive's D9 series SoCs. The clocks and resets are optional, and the
+ *    RGMII delays are left to the PHY, as selected by phy-mode.
  */
 
 #include <common.h>
@@ -243,11 +246,13 @@ struct eqos_tegra186_regs {
 /* We assume ARCH_DMA_MINALIGN >= 16; 16 is the EQOS HW minimum */
 #define EQOS_DESCRIPTOR_ALIGN	ARCH_DMA_MINALIGN
 #define EQOS_DESCRIPTORS_TX	4
-#define EQOS_DESCRIPTORS_RX	4
-#define EQOS_DESCRIPTORS_NUM	(EQOS_DESCRIPTORS_TX + EQOS_DESCRIPTORS_RX)
+#define EQOS_DESCRIPTORS_RX_MIN	4
+#define EQOS_DESCRIPTORS_RX_MAX	512
 #define EQOS_BUFFER_ALIGN	ARCH_DMA_MINALIGN
 #define EQOS_MAX_PACKET_SIZE	ALIGN(1568, ARCH_DMA_MINALIGN)
-#define EQOS_RX_BUFFER_SIZE	(EQOS_DESCRIPTORS_RX * EQOS_MAX_PACKET_SIZE)
+
+/* Received frames are given back to the DMA in batches of 1/8 of the ring */
+#define EQOS_RX_BATCH_SHIFT	3
 
 struct eqos_desc {
 	u32 des0;
@@ -265,6 +270,9 @@ struct eqos_desc {
 #define EQOS_AXI_WIDTH_64	8
 #define EQOS_AXI_WIDTH_128	16
 
+/* Rate of the CSR clock of the Semidrive EQOS, unless the DT gives one */
+#define EQOS_SEMIDRIVE_CSR_CLK_RATE	(250 * 1000 * 1000)
+
 struct eqos_config {
 	bool reg_access_always_ok;
 	int mdio_wait;
@@ -316,6 +324,10 @@ struct eqos_priv {
 	void *descs;
 	int tx_desc_idx, rx_desc_idx;
 	unsigned int desc_size;
+	unsigned int rx_descs;	/* number of RX descriptors */
+	unsigned int rx_batch;	/* RX descriptors handled at once */
+	unsigned int rx_ready;	/* frames known to be received at rx_desc_idx */
+	unsigned int rx_free;	/* frames before rx_desc_idx to give back */
 	void *tx_dma_buf;
 	void *rx_dma_buf;
 	void *rx_pkt;
@@ -410,6 +422,21 @@ static void eqos_flush_buffer_generic(void *buf, size_t size)
 	flush_dcache_range(start, end);
 }
 
+/* Applies a buffer cache operation to @count consecutive RX ring entries of
+ * @size bytes at @base, starting at @first and wrapping at the end of the
+ * ring. Being padded to whole cache lines, descriptors use this too.
+ */
+static void eqos_rx_cache_op(struct eqos_priv *eqos,
+			     void (*op)(void *buf, size_t size), void *base,
+			     size_t size, unsigned int first, unsigned int count)
+{
+	unsigned int n = min(count, eqos->rx_descs - first);
+
+	op(base + first * size, n * size);
+	if (n < count)
+		op(base, (count - n) * size);
+}
+
 static int eqos_mdio_wait_idle(struct eqos_priv *eqos)
 {
 	return wait_for_bit_le32(&eqos->mac_regs->mdio_address,
@@ -621,6 +648,27 @@ static int eqos_start_clks_imx(struct udevice *dev)
 	return 0;
 }
 
+static int eqos_start_clks_semidrive(struct udevice *dev)
+{
+#ifdef CONFIG_CLK
+	struct eqos_priv *eqos = dev_get_priv(dev);
+	int ret;
+
+	debug("%s(dev=%p):\n", __func__, dev);
+
+	if (clk_valid(&eqos->clk_tx)) {
+		ret = clk_enable(&eqos->clk_tx);
+		if (ret < 0) {
+			pr_err("clk_enable(clk_tx) failed: %d", ret);
+			return ret;
+		}
+	}
+#endif
+
+	debug("%s: OK\n", __func__);
+	return 0;
+}
+
 static void eqos_stop_clks_tegra186(struct udevice *dev)
 {
 #ifdef CONFIG_CLK
@@ -660,6 +708,20 @@ static void eqos_stop_clks_imx(struct udevice *dev)
 	/* empty */
 }
 
+static void eqos_stop_clks_semidrive(struct udevice *dev)
+{
+#ifdef CONFIG_CLK
+	struct eqos_priv *eqos = dev_get_priv(dev);
+
+	debug("%s(dev=%p):\n", __func__, dev);
+
+	if (clk_valid(&eqos->clk_tx))
+		clk_disable(&eqos->clk_tx);
+#endif
+
+	debug("%s: OK\n", __func__);
+}
+
 static int eqos_start_resets_tegra186(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -732,6 +794,38 @@ static int eqos_start_resets_imx(struct udevice *dev)
 	return 0;
 }
 
+static int eqos_start_resets_semidrive(struct udevice *dev)
+{
+	struct eqos_priv *eqos = dev_get_priv(dev);
+	int ret;
+
+	debug("%s(dev=%p):\n", __func__, dev);
+
+	/* The PHY is reset as on STM32, by its optional GPIO */
+	ret = eqos_start_resets_stm32(dev);
+	if (ret < 0)
+		return ret;
+
+	if (reset_valid(&eqos->reset_ctl)) {
+		ret = reset_assert(&eqos->reset_ctl);
+		if (ret < 0) {
+			pr_err("reset_assert() failed: %d", ret);
+			return ret;
+		}
+
+		udelay(2);
+
+		ret = reset_deassert(&eqos->reset_ctl);
+		if (ret < 0) {
+			pr_err("reset_deassert() failed: %d", ret);
+			return ret;
+		}
+	}
+
+	debug("%s: OK\n", __func__);
+	return 0;
+}
+
 static int eqos_stop_resets_tegra186(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -764,6 +858,16 @@ static int eqos_stop_resets_imx(struct udevice *dev)
 	return 0;
 }
 
+static int eqos_stop_resets_semidrive(struct udevice *dev)
+{
+	struct eqos_priv *eqos = dev_get_priv(dev);
+
+	if (reset_valid(&eqos->reset_ctl))
+		reset_assert(&eqos->reset_ctl);
+
+	return eqos_stop_resets_stm32(dev);
+}
+
 static int eqos_calibrate_pads_tegra186(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -852,6 +956,13 @@ static ulong eqos_get_tick_clk_rate_imx(struct udevice *dev)
 	return imx_get_eqos_csr_clk();
 }
 
+static ulong eqos_get_tick_clk_rate_semidrive(struct udevice *dev)
+{
+	/* The CSR clock is not described, so its rate comes from the DT */
+	return dev_read_u32_default(dev, "clock-frequency",
+				    EQOS_SEMIDRIVE_CSR_CLK_RATE);
+}
+
 static int eqos_calibrate_pads_stm32(struct udevice *dev)
 {
 	return 0;
@@ -872,6 +983,16 @@ static int eqos_disable_calibration_imx(struct udevice *dev)
 	return 0;
 }
 
+static int eqos_calibrate_pads_semidrive(struct udevice *dev)
+{
+	return 0;
+}
+
+static int eqos_disable_calibration_semidrive(struct udevice *dev)
+{
+	return 0;
+}
+
 static int eqos_set_full_duplex(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -1005,6 +1126,44 @@ static int eqos_set_tx_clk_speed_imx(struct udevice *dev)
 	return 0;
 }
 
+static int eqos_set_tx_clk_speed_semidrive(struct udevice *dev)
+{
+#ifdef CONFIG_CLK
+	struct eqos_priv *eqos = dev_get_priv(dev);
+	ulong rate;
+	int ret;
+
+	debug("%s(dev=%p):\n", __func__, dev);
+
+	/* Without a TX clock, it is set up before U-Boot runs */
+	if (!clk_valid(&eqos->clk_tx))
+		return 0;
+
+	switch (eqos->phy->speed) {
+	case SPEED_1000:
+		rate = 125 * 1000 * 1000;
+		break;
+	case SPEED_100:
+		rate = 25 * 1000 * 1000;
+		break;
+	case SPEED_10:
+		rate = 2.5 * 1000 * 1000;
+		break;
+	default:
+		pr_err("invalid speed %d", eqos->phy->speed);
+		return -EINVAL;
+	}
+
+	ret = clk_set_rate(&eqos->clk_tx, rate);
+	if (ret < 0) {
+		pr_err("clk_set_rate(tx_clk, %lu) failed: %d", rate, ret);
+		return ret;
+	}
+#endif
+
+	return 0;
+}
+
 static int eqos_adjust_link(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -1402,24 +1561,29 @@ static int eqos_start(struct udevice *dev)
 
 	/* Set up descriptors */
 
-	memset(eqos->descs, 0, eqos->desc_size * EQOS_DESCRIPTORS_NUM);
+	memset(eqos->descs, 0,
+	       eqos->desc_size * (EQOS_DESCRIPTORS_TX + eqos->rx_descs));
 
 	for (i = 0; i < EQOS_DESCRIPTORS_TX; i++) {
 		struct eqos_desc *tx_desc = eqos_get_desc(eqos, i, false);
 		eqos->config->ops->eqos_flush_desc(tx_desc);
 	}
 
-	for (i = 0; i < EQOS_DESCRIPTORS_RX; i++) {
+	for (i = 0; i < eqos->rx_descs; i++) {
 		struct eqos_desc *rx_desc = eqos_get_desc(eqos, i, true);
 		rx_desc->des0 = (u32)(ulong)(eqos->rx_dma_buf +
 					     (i * EQOS_MAX_PACKET_SIZE));
 		rx_desc->des3 = EQOS_DESC3_OWN | EQOS_DESC3_BUF1V;
-		mb();
-		eqos->config->ops->eqos_flush_desc(rx_desc);
-		eqos->config->ops->eqos_inval_buffer(eqos->rx_dma_buf +
-						(i * EQOS_MAX_PACKET_SIZE),
-						EQOS_MAX_PACKET_SIZE);
 	}
+	mb();
+	/* The whole ring and all its buffers at once, not an entry at a time */
+	eqos->config->ops->eqos_flush_buffer(eqos_get_desc(eqos, 0, true),
+					     eqos->desc_size * eqos->rx_descs);
+	eqos->config->ops->eqos_inval_buffer(eqos->rx_dma_buf,
+					     EQOS_MAX_PACKET_SIZE *
+					     eqos->rx_descs);
+	eqos->rx_ready = 0;
+	eqos->rx_free = 0;
 
 	writel(0, &eqos->dma_regs->ch0_txdesc_list_haddress);
 	writel((ulong)eqos_get_desc(eqos, 0, false),
@@ -1430,8 +1594,7 @@ static int eqos_start(struct udevice *dev)
 	writel(0, &eqos->dma_regs->ch0_rxdesc_list_haddress);
 	writel((ulong)eqos_get_desc(eqos, 0, true),
 		&eqos->dma_regs->ch0_rxdesc_list_address);
-	writel(EQOS_DESCRIPTORS_RX - 1,
-	       &eqos->dma_regs->ch0_rxdesc_ring_length);
+	writel(eqos->rx_descs - 1, &eqos->dma_regs->ch0_rxdesc_ring_length);
 
 	/* Enable everything */
 	setbits_le32(&eqos->dma_regs->ch0_tx_control,
@@ -1448,7 +1611,7 @@ static int eqos_start(struct udevice *dev)
 	 * that's not distinguishable from none of the descriptors being
 	 * available.
 	 */
-	last_rx_desc = (ulong)eqos_get_desc(eqos, EQOS_DESCRIPTORS_RX - 1, true);
+	last_rx_desc = (ulong)eqos_get_desc(eqos, eqos->rx_descs - 1, true);
 	writel(last_rx_desc, &eqos->dma_regs->ch0_rxdesc_tail_pointer);
 
 	eqos->started = true;
@@ -1571,13 +1734,32 @@ static int eqos_recv(struct udevice *dev, int flags, uchar **packetp)
 
 	debug("%s(dev=%p, flags=%x):\n", __func__, dev, flags);
 
-	rx_desc = eqos_get_desc(eqos, eqos->rx_desc_idx, true);
-	eqos->config->ops->eqos_inval_desc(rx_desc);
-	if (rx_desc->des3 & EQOS_DESC3_OWN) {
+	/* Look at up to rx_batch descriptors with one cache invalidation, and
+	 * remember how many of them hold frames so that they need not be
+	 * looked at again.
+	 */
+	if (!eqos->rx_ready) {
+		unsigned int i, n;
+
+		n = min(eqos->rx_batch, eqos->rx_descs - eqos->rx_desc_idx);
+		rx_desc = eqos_get_desc(eqos, eqos->rx_desc_idx, true);
+		eqos->config->ops->eqos_inval_buffer(rx_desc,
+						     eqos->desc_size * n);
+		for (i = 0; i < n; i++) {
+			rx_desc = eqos_get_desc(eqos, eqos->rx_desc_idx + i,
+						true);
+			if (rx_desc->des3 & EQOS_DESC3_OWN)
+				break;
+		}
+		eqos->rx_ready = i;
+	}
+	if (!eqos->rx_ready) {
 		debug("%s: RX packet not available\n", __func__);
 		return -EAGAIN;
 	}
 
+	rx_desc = eqos_get_desc(eqos, eqos->rx_desc_idx, true);
+
 	*packetp = eqos->rx_dma_buf +
 		(eqos->rx_desc_idx * EQOS_MAX_PACKET_SIZE);
 	length = rx_desc->des3 & 0x7fff;
@@ -1588,11 +1770,59 @@ static int eqos_recv(struct udevice *dev, int flags, uchar **packetp)
 	return length;
 }
 
+/* Gives the rx_free descriptors before rx_desc_idx back to the DMA, with one
+ * cache operation on the descriptors and buffers for all of them and one
+ * write of the tail pointer.
+ */
+static void eqos_rx_refill(struct eqos_priv *eqos)
+{
+	const struct eqos_ops *ops = eqos->config->ops;
+	void *descs = eqos_get_desc(eqos, 0, true);
+	unsigned int first, i, idx;
+	struct eqos_desc *rx_desc;
+
+	first = (eqos->rx_desc_idx + eqos->rx_descs - eqos->rx_free) %
+		eqos->rx_descs;
+
+	for (i = 0; i < eqos->rx_free; i++) {
+		rx_desc = eqos_get_desc(eqos, (first + i) % eqos->rx_descs,
+					true);
+		rx_desc->des0 = 0;
+	}
+	mb();
+	eqos_rx_cache_op(eqos, ops->eqos_flush_buffer, descs, eqos->desc_size,
+			 first, eqos->rx_free);
+	eqos_rx_cache_op(eqos, ops->eqos_inval_buffer, eqos->rx_dma_buf,
+			 EQOS_MAX_PACKET_SIZE, first, eqos->rx_free);
+
+	for (i = 0; i < eqos->rx_free; i++) {
+		idx = (first + i) % eqos->rx_descs;
+		rx_desc = eqos_get_desc(eqos, idx, true);
+		rx_desc->des0 = (u32)(ulong)(eqos->rx_dma_buf +
+					     idx * EQOS_MAX_PACKET_SIZE);
+		rx_desc->des1 = 0;
+		rx_desc->des2 = 0;
+	}
+	/* Make sure that if HW sees the _OWN writes below, it will see all the
+	 * writes to the rest of the descriptors too.
+	 */
+	mb();
+	for (i = 0; i < eqos->rx_free; i++) {
+		rx_desc = eqos_get_desc(eqos, (first + i) % eqos->rx_descs,
+					true);
+		rx_desc->des3 = EQOS_DESC3_OWN | EQOS_DESC3_BUF1V;
+	}
+	eqos_rx_cache_op(eqos, ops->eqos_flush_buffer, descs, eqos->desc_size,
+			 first, eqos->rx_free);
+
+	writel((ulong)rx_desc, &eqos->dma_regs->ch0_rxdesc_tail_pointer);
+	eqos->rx_free = 0;
+}
+
 static int eqos_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
 	uchar *packet_expected;
-	struct eqos_desc *rx_desc;
 
 	debug("%s(packet=%p, length=%d)\n", __func__, packet, length);
 
@@ -1604,29 +1834,15 @@ static int eqos_free_pkt(struct udevice *dev, uchar *packet, int length)
 		return -EINVAL;
 	}
 
-	eqos->config->ops->eqos_inval_buffer(packet, length);
-
-	rx_desc = eqos_get_desc(eqos, eqos->rx_desc_idx, true);
-
-	rx_desc->des0 = 0;
-	mb();
-	eqos->config->ops->eqos_flush_desc(rx_desc);
-	eqos->config->ops->eqos_inval_buffer(packet, length);
-	rx_desc->des0 = (u32)(ulong)packet;
-	rx_desc->des1 = 0;
-	rx_desc->des2 = 0;
-	/*
-	 * Make sure that if HW sees the _OWN write below, it will see all the
-	 * writes to the rest of the descriptor too.
-	 */
-	mb();
-	rx_desc->des3 = EQOS_DESC3_OWN | EQOS_DESC3_BUF1V;
-	eqos->config->ops->eqos_flush_desc(rx_desc);
-
-	writel((ulong)rx_desc, &eqos->dma_regs->ch0_rxdesc_tail_pointer);
-
 	eqos->rx_desc_idx++;
-	eqos->rx_desc_idx %= EQOS_DESCRIPTORS_RX;
+	eqos->rx_desc_idx %= eqos->rx_descs;
+	if (eqos->rx_ready)
+		eqos->rx_ready--;
+	eqos->rx_free++;
+
+	/* The DMA always keeps more than rx_batch descriptors to fill */
+	if (eqos->rx_free >= eqos->rx_batch)
+		eqos_rx_refill(eqos);
 
 	return 0;
 }
@@ -1638,7 +1854,8 @@ static int eqos_probe_resources_core(struct udevice *dev)
 
 	debug("%s(dev=%p):\n", __func__, dev);
 
-	eqos->descs = eqos_alloc_descs(eqos, EQOS_DESCRIPTORS_NUM);
+	eqos->descs = eqos_alloc_descs(eqos,
+				       EQOS_DESCRIPTORS_TX + eqos->rx_descs);
 	if (!eqos->descs) {
 		debug("%s: eqos_alloc_descs() failed\n", __func__);
 		ret = -ENOMEM;
@@ -1653,7 +1870,8 @@ static int eqos_probe_resources_core(struct udevice *dev)
 	}
 	debug("%s: tx_dma_buf=%p\n", __func__, eqos->tx_dma_buf);
 
-	eqos->rx_dma_buf = memalign(EQOS_BUFFER_ALIGN, EQOS_RX_BUFFER_SIZE);
+	eqos->rx_dma_buf = memalign(EQOS_BUFFER_ALIGN,
+				    EQOS_MAX_PACKET_SIZE * eqos->rx_descs);
 	if (!eqos->rx_dma_buf) {
 		debug("%s: memalign(rx_dma_buf) failed\n", __func__);
 		ret = -ENOMEM;
@@ -1670,7 +1888,7 @@ static int eqos_probe_resources_core(struct udevice *dev)
 	debug("%s: rx_pkt=%p\n", __func__, eqos->rx_pkt);
 
 	eqos->config->ops->eqos_inval_buffer(eqos->rx_dma_buf,
-			EQOS_MAX_PACKET_SIZE * EQOS_DESCRIPTORS_RX);
+			EQOS_MAX_PACKET_SIZE * eqos->rx_descs);
 
 	debug("%s: OK\n", __func__);
 	return 0;
@@ -1954,6 +2172,104 @@ static int eqos_remove_resources_imx(struct udevice *dev)
 	return 0;
 }
 
+static phy_interface_t eqos_get_interface_semidrive(struct udevice *dev)
+{
+	const char *phy_mode;
+	phy_interface_t interface = PHY_INTERFACE_MODE_NONE;
+
+	debug("%s(dev=%p):\n", __func__, dev);
+
+	phy_mode = dev_read_prop(dev, "phy-mode", NULL);
+	if (phy_mode)
+		interface = phy_get_interface_by_name(phy_mode);
+
+	return interface;
+}
+
+static int eqos_probe_resources_semidrive(struct udevice *dev)
+{
+	struct eqos_priv *eqos = dev_get_priv(dev);
+	struct ofnode_phandle_args phandle_args;
+	phy_interface_t interface;
+	int ret;
+
+	debug("%s(dev=%p):\n", __func__, dev);
+
+	interface = eqos->config->interface(dev);
+
+	if (interface == PHY_INTERFACE_MODE_NONE) {
+		pr_err("Invalid PHY interface\n");
+		return -EINVAL;
+	}
+
+	/* "rgmii-id", "rgmii-rxid" and "rgmii-txid" have the PHY add the
+	 * RGMII delays; anything done in the SoC belongs to the board.
+	 */
+	ret = board_interface_eth_init(dev, interface);
+	if (ret)
+		return -EINVAL;
+
+	eqos->max_speed = dev_read_u32_default(dev, "max-speed", 0);
+
+	/* The reset and the TX clock are optional */
+	ret = reset_get_by_index(dev, 0, &eqos->reset_ctl);
+	if (ret)
+		debug("%s: no reset: %d\n", __func__, ret);
+
+#ifdef CONFIG_CLK
+	ret = clk_get_by_name(dev, "stmmaceth", &eqos->clk_tx);
+	if (ret)
+		debug("%s: no TX clock: %d\n", __func__, ret);
+#endif
+
+	/* The PHY reset GPIO is in the PHY node or in its MDIO bus node */
+	eqos->phyaddr = -1;
+	ret = dev_read_phandle_with_args(dev, "phy-handle", NULL, 0, 0,
+					 &phandle_args);
+	if (!ret) {
+		ret = gpio_request_by_name_nodev(phandle_args.node,
+						 "reset-gpios", 0,
+						 &eqos->phy_reset_gpio,
+						 GPIOD_IS_OUT |
+						 GPIOD_IS_OUT_ACTIVE);
+		if (ret) {
+			ofnode mdio = ofnode_get_parent(phandle_args.node);
+
+			ret = gpio_request_by_name_nodev(mdio, "reset-gpios", 0,
+							 &eqos->phy_reset_gpio,
+							 GPIOD_IS_OUT |
+							 GPIOD_IS_OUT_ACTIVE);
+		}
+		if (ret)
+			debug("%s: no PHY reset: %d\n", __func__, ret);
+
+		eqos->phyaddr = ofnode_read_u32_default(phandle_args.node,
+							"reg", -1);
+	}
+
+	debug("%s: OK\n", __func__);
+	return 0;
+}
+
+static int eqos_remove_resources_semidrive(struct udevice *dev)
+{
+	struct eqos_priv *eqos = dev_get_priv(dev);
+
+	debug("%s(dev=%p):\n", __func__, dev);
+
+#ifdef CONFIG_CLK
+	if (clk_valid(&eqos->clk_tx))
+		clk_free(&eqos->clk_tx);
+#endif
+	if (dm_gpio_is_valid(&eqos->phy_reset_gpio))
+		dm_gpio_free(dev, &eqos->phy_reset_gpio);
+	if (reset_valid(&eqos->reset_ctl))
+		reset_free(&eqos->reset_ctl);
+
+	debug("%s: OK\n", __func__);
+	return 0;
+}
+
 static int eqos_probe(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -1974,6 +2290,16 @@ static int eqos_probe(struct udevice *dev)
 	eqos->dma_regs = (void *)(eqos->regs + EQOS_DMA_REGS_BASE);
 	eqos->tegra186_regs = (void *)(eqos->regs + EQOS_TEGRA186_REGS_BASE);
 
+	eqos->rx_descs = dev_read_u32_default(dev, "rx-descriptors",
+					      CONFIG_DWC_ETH_QOS_RX_DESCRIPTORS);
+	if (eqos->rx_descs < EQOS_DESCRIPTORS_RX_MIN ||
+	    eqos->rx_descs > EQOS_DESCRIPTORS_RX_MAX) {
+		pr_warn("rx-descriptors %u out of range, using %u\n",
+			eqos->rx_descs, CONFIG_DWC_ETH_QOS_RX_DESCRIPTORS);
+		eqos->rx_descs = CONFIG_DWC_ETH_QOS_RX_DESCRIPTORS;
+	}
+	eqos->rx_batch = max(eqos->rx_descs >> EQOS_RX_BATCH_SHIFT, 1U);
+
 	ret = eqos_probe_resources_core(dev);
 	if (ret < 0) {
 		pr_err("eqos_probe_resources_core() failed: %d", ret);
@@ -2136,6 +2462,34 @@ struct eqos_config __maybe_unused eqos_imx_config = {
 	.ops = &eqos_imx_ops
 };
 
+static struct eqos_ops eqos_semidrive_ops = {
+	.eqos_inval_desc = eqos_inval_desc_generic,
+	.eqos_flush_desc = eqos_flush_desc_generic,
+	.eqos_inval_buffer = eqos_inval_buffer_generic,
+	.eqos_flush_buffer = eqos_flush_buffer_generic,
+	.eqos_probe_resources = eqos_probe_resources_semidrive,
+	.eqos_remove_resources = eqos_remove_resources_semidrive,
+	.eqos_stop_resets = eqos_stop_resets_semidrive,
+	.eqos_start_resets = eqos_start_resets_semidrive,
+	.eqos_stop_clks = eqos_stop_clks_semidrive,
+	.eqos_start_clks = eqos_start_clks_semidrive,
+	.eqos_calibrate_pads = eqos_calibrate_pads_semidrive,
+	.eqos_disable_calibration = eqos_disable_calibration_semidrive,
+	.eqos_set_tx_clk_speed = eqos_set_tx_clk_speed_semidrive,
+	.eqos_get_tick_clk_rate = eqos_get_tick_clk_rate_semidrive
+};
+
+static const struct eqos_config __maybe_unused eqos_semidrive_config = {
+	.reg_access_always_ok = false,
+	.mdio_wait = 10000,
+	.swr_wait = 50,
+	.config_mac = EQOS_MAC_RXQ_CTRL0_RXQ0EN_ENABLED_DCB,
+	.config_mac_mdio = EQOS_MAC_MDIO_ADDRESS_CR_250_300,
+	.axi_bus_width = EQOS_AXI_WIDTH_64,
+	.interface = eqos_get_interface_semidrive,
+	.ops = &eqos_semidrive_ops
+};
+
 static const struct udevice_id eqos_ids[] = {
 #if IS_ENABLED(CONFIG_DWC_ETH_QOS_TEGRA186)
 	{
@@ -2155,6 +2509,12 @@ static const struct udevice_id eqos_ids[] = {
 		.data = (ulong)&eqos_imx_config
 	},
 #endif
+#if IS_ENABLED(CONFIG_DWC_ETH_QOS_SEMIDRIVE)
+	{
+		.compatible = "semidrive,dwc-qos-ethernet",
+		.data = (ulong)&eqos_semidrive_config
+	},
+#endif
 
 	{ }
 };
@@ -198,10 +198,55 @@ static void _serial_putc(struct udevice *dev, char ch)
 	} while (err == -EAGAIN);
 }
 
+static int __serial_puts(struct udevice *dev, const char *str, size_t len)
+{
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+
+	do {
+		ssize_t written = ops->puts(dev, str, len);
+
+		if (written == -EAGAIN)
+			continue;
+		if (written < 0)
+			return written;
+		str += written;
+		len -= written;
+	} while (len);
+
+	return 0;
+}
+
 static void _serial_puts(struct udevice *dev, const char *str)
 {
-	while (*str)
-		_serial_putc(dev, *str++);
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+
+	if (!ops->puts) {
+		while (*str)
+			_serial_putc(dev, *str++);
+		return;
+	}
+
+	/* Send a line at a time, adding a '\r' before each '\n' */
+	while (*str) {
+		const char *newline = strchrnul(str, '\n');
+		size_t len = newline - str;
+
+		if (len && __serial_puts(dev, str, len))
+			return;
+		if (*newline && __serial_puts(dev, "\r\n", 2))
+			return;
+		str = *newline ? newline + 1 : newline;
+	}
+}
+
+static void _serial_flush(struct udevice *dev)
+{
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+
+	if (!ops->pending)
+		return;
+	while (ops->pending(dev, false) > 0)
+		WATCHDOG_RESET();
 }
 
 static int __serial_getc(struct udevice *dev)
@@ -281,6 +326,12 @@ void serial_puts(const char *str)
 		_serial_puts(gd->cur_serial_dev, str);
 }
 
+void serial_flush(void)
+{
+	if (gd->cur_serial_dev)
+		_serial_flush(gd->cur_serial_dev);
+}
+
 int serial_getc(void)
 {
 	if (!gd->cur_serial_dev)
@@ -9,12 +9,25 @@
 #include <common.h>
 #include <dm.h>
 #include <dt-structs.h>
+#include <interrupts.h>
 #include <log.h>
+#include <malloc.h>
 #include <serial.h>
 #include <clk.h>
+#include <asm/global_data.h>
+#include <linux/bug.h>
+#include <linux/compiler.h>
 #include <linux/err.h>
 #include <watchdog.h>
 
+/*
+ * linux/compat.h, pulled in by the headers above, stubs out request_irq()
+ * for the Linux drivers; use the real one from interrupts.h
+ */
+#undef request_irq
+
+DECLARE_GLOBAL_DATA_PTR;
+
 #ifndef CONFIG_SYS_NS16550_CLK
 #define CONFIG_SYS_NS16550_CLK  0
 #endif
@@ -24,6 +37,8 @@
 #define CONFIG_SYS_NS16550_IER  0x00
 #endif
 
+#define UART_IER_THRI	0x02		/* Xmit holding register empty int. */
+
 #define UART_LCR_WLS_8	0x03		/* 8 bit character length */
 #define UART_LCR_DLAB	0x80		/* Divisor latch access bit */
 
@@ -40,6 +55,17 @@
 #define UART_MCRVAL 0x00
 #define UART_LCRVAL UART_LCR_8N1
 
+/* FIFO depth in units of 16 characters, 0 if there is no FIFO */
+#define UART_CPR_FIFO_MODE(cpr)	(((cpr) >> 16) & 0xff)
+
+/* IRQ mask bit in DAIF */
+#define DAIF_IRQ	BIT(7)
+
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+#define TX_BUF_SIZE	CONFIG_SEMIDRIVE_SERIAL_TX_BUF_SIZE
+#define TX_BUF_MASK	(TX_BUF_SIZE - 1)
+#endif
+
 /* Clear & enable FIFOs */
 #define UART_FCRVAL (UART_FCR_FIFO_EN | \
 		     UART_FCR_RXSR |	\
@@ -89,6 +115,18 @@ struct semidrive_serial_regs {
 struct semidrive_priv {
 	struct semidrive_serial_regs __iomem *regs;
 	u32 clock;
+	u32 fifo_size;		/* TX FIFO depth, 1 if there is no FIFO */
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+	/*
+	 * Output ring, drained by the TX-empty interrupt. The indexes run
+	 * freely: tx_head is only written by the producer and tx_tail by
+	 * whoever moves characters into the FIFO.
+	 */
+	char *tx_buf;		/* NULL if output is polled */
+	u32 tx_head;
+	u32 tx_tail;
+	int irq;
+#endif
 };
 
 static void _semidrive_serial_setbrg(struct semidrive_priv *priv, int baud)
@@ -110,12 +148,121 @@ static void _semidrive_serial_setbrg(struct semidrive_priv *priv, int baud)
 	writel(UART_LCR_WLS_8, &priv->regs->lcr);
 }
 
-static int _semidrive_serial_putc(struct semidrive_priv *priv, const char ch)
+/* Fill the FIFO from @s if it is empty, so the status is checked once */
+static int _semidrive_serial_tx_fifo(struct semidrive_priv *priv,
+				     const char *s, int len)
 {
+	int i;
+
 	if (!(readl(&priv->regs->lsr) & UART_LSR_THRE))
 		return -EAGAIN;
 
-	writel(ch, &priv->regs->thr);
+	len = min_t(int, len, priv->fifo_size);
+	for (i = 0; i < len; i++)
+		writel(s[i], &priv->regs->thr);
+
+	return len;
+}
+
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+static bool semidrive_serial_irqs_on(void)
+{
+	ulong daif;
+
+	asm volatile("mrs %0, daif" : "=r" (daif));
+
+	return !(daif & DAIF_IRQ);
+}
+
+static u32 semidrive_serial_tx_pending(struct semidrive_priv *priv)
+{
+	return READ_ONCE(priv->tx_head) - READ_ONCE(priv->tx_tail);
+}
+
+/* Move characters from the ring into the FIFO, if it is empty */
+static void semidrive_serial_tx_kick(struct semidrive_priv *priv)
+{
+	u32 tail = priv->tx_tail;
+	u32 count = READ_ONCE(priv->tx_head) - tail;
+	u32 i;
+
+	if (!count || !(readl(&priv->regs->lsr) & UART_LSR_THRE))
+		return;
+
+	count = min(count, priv->fifo_size);
+	for (i = 0; i < count; i++)
+		writel(priv->tx_buf[(tail + i) & TX_BUF_MASK],
+		       &priv->regs->thr);
+	WRITE_ONCE(priv->tx_tail, tail + count);
+}
+
+/* Drain the ring by polling, for use while interrupts are masked */
+static void semidrive_serial_tx_poll(struct semidrive_priv *priv)
+{
+	semidrive_serial_tx_kick(priv);
+	if (!semidrive_serial_tx_pending(priv))
+		writel(0, &priv->regs->ier);
+}
+
+static void semidrive_serial_tx_irq(void *arg)
+{
+	struct semidrive_priv *priv = arg;
+
+	/* Reading IIR acknowledges the TX-empty interrupt */
+	readl(&priv->regs->iir);
+	semidrive_serial_tx_kick(priv);
+	if (!semidrive_serial_tx_pending(priv))
+		writel(0, &priv->regs->ier);
+}
+
+static int semidrive_serial_tx_queue(struct semidrive_priv *priv,
+				     const char *s, int len)
+{
+	u32 head = priv->tx_head;
+	u32 space = TX_BUF_SIZE - (head - READ_ONCE(priv->tx_tail));
+	int i;
+
+	/* The caller retries, while the interrupt handler makes room */
+	if (!space)
+		return -EAGAIN;
+
+	len = min_t(u32, len, space);
+	for (i = 0; i < len; i++)
+		priv->tx_buf[(head + i) & TX_BUF_MASK] = s[i];
+	/* The handler must not see the new head before the characters */
+	barrier();
+	WRITE_ONCE(priv->tx_head, head + len);
+	writel(UART_IER_THRI, &priv->regs->ier);
+
+	return len;
+}
+#endif
+
+static int _semidrive_serial_write(struct semidrive_priv *priv, const char *s,
+				   int len)
+{
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+	if (priv->tx_buf) {
+		if (semidrive_serial_irqs_on())
+			return semidrive_serial_tx_queue(priv, s, len);
+
+		/* Keep the output in order by sending queued characters first */
+		if (semidrive_serial_tx_pending(priv)) {
+			semidrive_serial_tx_poll(priv);
+			return -EAGAIN;
+		}
+	}
+#endif
+	return _semidrive_serial_tx_fifo(priv, s, len);
+}
+
+static int _semidrive_serial_putc(struct semidrive_priv *priv, const char ch)
+{
+	int ret;
+
+	ret = _semidrive_serial_write(priv, &ch, 1);
+	if (ret < 0)
+		return ret;
 
 	if (ch == '\n')
 		WATCHDOG_RESET();
@@ -133,6 +280,15 @@ static int _semidrive_serial_getc(struct semidrive_priv *priv)
 
 static int _semidrive_serial_pending(struct semidrive_priv *priv, bool input)
 {
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+	if (!input && priv->tx_buf && semidrive_serial_tx_pending(priv)) {
+		/* Nothing else will send the queued characters */
+		if (!semidrive_serial_irqs_on())
+			semidrive_serial_tx_poll(priv);
+
+		return semidrive_serial_tx_pending(priv);
+	}
+#endif
 	if (input)
 		return (readl(&priv->regs->lsr) & UART_LSR_DR) ? 1 : 0;
 	else
@@ -159,6 +315,19 @@ static int semidrive_serial_putc(struct udevice *dev, const char ch)
 	return _semidrive_serial_putc(priv, ch);
 }
 
+static ssize_t semidrive_serial_puts(struct udevice *dev, const char *s,
+				     size_t len)
+{
+	struct semidrive_priv *priv = dev_get_priv(dev);
+	int ret;
+
+	ret = _semidrive_serial_write(priv, s, min_t(size_t, len, INT_MAX));
+	if (ret > 0 && memchr(s, '\n', ret))
+		WATCHDOG_RESET();
+
+	return ret;
+}
+
 static int semidrive_serial_getc(struct udevice *dev)
 {
 	struct semidrive_priv *priv = dev_get_priv(dev);
@@ -173,6 +342,57 @@ static int semidrive_serial_pending(struct udevice *dev, bool input)
 	return _semidrive_serial_pending(priv, input);
 }
 
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+static int semidrive_serial_setup_irq(struct udevice *dev)
+{
+	struct semidrive_priv *priv = dev_get_priv(dev);
+	u32 cells[3];
+	int ret;
+
+	BUILD_BUG_ON(TX_BUF_SIZE & TX_BUF_MASK);
+
+	/* GIC binding: <type number flags>, where type 0 is an SPI */
+	ret = dev_read_u32_array(dev, "interrupts", cells, ARRAY_SIZE(cells));
+	if (ret)
+		return ret;
+	priv->irq = cells[1] + (cells[0] ? 16 : 32);
+	if (priv->irq >= CONFIG_NR_IRQS)
+		return -EINVAL;
+
+	priv->tx_buf = malloc(TX_BUF_SIZE);
+	if (!priv->tx_buf)
+		return -ENOMEM;
+
+	ret = request_irq(priv->irq, semidrive_serial_tx_irq, priv, cells[2]);
+	if (ret) {
+		free(priv->tx_buf);
+		priv->tx_buf = NULL;
+		return ret;
+	}
+	enable_irq(priv->irq);
+
+	return 0;
+}
+
+static int semidrive_serial_remove(struct udevice *dev)
+{
+	struct semidrive_priv *priv = dev_get_priv(dev);
+
+	if (!priv->tx_buf)
+		return 0;
+
+	while (_semidrive_serial_pending(priv, false))
+		;
+	writel(0, &priv->regs->ier);
+	disable_irq(priv->irq);
+	(free_irq)(priv->irq);
+	free(priv->tx_buf);
+	priv->tx_buf = NULL;
+
+	return 0;
+}
+#endif
+
 static int semidrive_serial_probe(struct udevice *dev)
 {
 	struct semidrive_priv *priv = dev_get_priv(dev);
@@ -204,6 +424,10 @@ static int semidrive_serial_probe(struct udevice *dev)
 		return -EINVAL;
 	}
 
+	priv->fifo_size = UART_CPR_FIFO_MODE(readl(&priv->regs->cpr)) * 16;
+	if (!priv->fifo_size)
+		priv->fifo_size = 1;
+
 	/* Disable interrupt */
 	writel(CONFIG_SYS_NS16550_IER, &priv->regs->ier);
 
@@ -212,6 +436,15 @@ static int semidrive_serial_probe(struct udevice *dev)
 
 	_semidrive_serial_setbrg(priv, CONFIG_BAUDRATE);
 
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+	/* Interrupts are only set up after relocation */
+	if (gd->flags & GD_FLG_RELOC) {
+		err = semidrive_serial_setup_irq(dev);
+		if (err)
+			log_debug("Polling for output (err=%d)\n", err);
+	}
+#endif
+
 	return 0;
 }
 
@@ -222,6 +455,7 @@ static const struct udevice_id semidrive_serial_ids[] = {
 
 static const struct dm_serial_ops semidrive_serial_ops = {
 	.putc = semidrive_serial_putc,
+	.puts = semidrive_serial_puts,
 	.pending = semidrive_serial_pending,
 	.getc = semidrive_serial_getc,
 	.setbrg = semidrive_serial_setbrg,
@@ -234,23 +468,29 @@ U_BOOT_DRIVER(semidrive_serial) = {
 	.plat_auto	= sizeof(struct semidrive_priv),
 	.priv_auto	= sizeof(struct semidrive_priv),
 	.probe = semidrive_serial_probe,
+#if CONFIG_IS_ENABLED(SEMIDRIVE_SERIAL_TX_IRQ)
+	.remove = semidrive_serial_remove,
+#endif
 	.ops	= &semidrive_serial_ops,
 	.flags	= DM_FLAG_PRE_RELOC,
 };
 
 #else
 
-DECLARE_GLOBAL_DATA_PTR;
-
 #define DECLARE_UART_PRIV(port) \
 	static struct semidrive_priv semidrive_uart##port = { \
 	.regs = (struct semidrive_serial_regs *)CONFIG_SYS_NS16550_COM##port, \
-	.clock = CONFIG_SYS_NS16550_CLK \
+	.clock = CONFIG_SYS_NS16550_CLK, \
+	.fifo_size = 1, \
 };
 
 #define DECLARE_UART_FUNCTIONS(port) \
 	static int semidrive_serial##port##_init(void) \
 	{ \
+		u32 cpr = readl(&semidrive_uart##port.regs->cpr); \
+		if (UART_CPR_FIFO_MODE(cpr)) \
+			semidrive_uart##port.fifo_size = \
+				UART_CPR_FIFO_MODE(cpr) * 16; \
 		writel(0, &semidrive_uart##port.regs->ier); \
 		writel(UART_MCRVAL, &semidrive_uart##port.regs->mcr); \
 		writel(UART_FCRVAL, &semidrive_uart##port.regs->fcr); \
@@ -287,7 +527,16 @@ DECLARE_GLOBAL_DATA_PTR;
 	static void semidrive_serial##port##_puts(const char *s) \
 	{ \
 		while (*s) { \
-			semidrive_serial##port##_putc(*s++); \
+			int len = strchrnul(s, '\n') - s; \
+			int err; \
+			if (!len) { \
+				semidrive_serial##port##_putc(*s++); \
+				continue; \
+			} \
+			err = _semidrive_serial_write(&semidrive_uart##port, \
+						      s, len); \
+			if (err > 0) \
+				s += err; \
 		} \
 	}
 
@@ -751,7 +751,11 @@ static int asix_eth_start(struct udevice *dev)
 
 void asix_eth_stop(struct udevice *dev)
 {
+	struct asix_private *priv = dev_get_priv(dev);
+
 	debug("** %s()\n", __func__);
+
+	usb_ether_cancel_rx(&priv->ueth);
 }
 
 int asix_eth_send(struct udevice *dev, void *packet, int length)
@@ -862,6 +866,13 @@ err:
 	return usb_ether_deregister(ss);
 }
 
+static int asix_eth_remove(struct udevice *dev)
+{
+	struct asix_private *priv = dev_get_priv(dev);
+
+	return usb_ether_deregister(&priv->ueth);
+}
+
 static const struct eth_ops asix_eth_ops = {
 	.start	= asix_eth_start,
 	.send	= asix_eth_send,
@@ -875,6 +886,7 @@ U_BOOT_DRIVER(asix_eth) = {
 	.name	= "asix_eth",
 	.id	= UCLASS_ETH,
 	.probe = asix_eth_probe,
+	.remove = asix_eth_remove,
 	.ops	= &asix_eth_ops,
 	.priv_auto	= sizeof(struct asix_private),
 	.plat_auto	= sizeof(struct eth_pdata),
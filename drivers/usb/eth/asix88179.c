@@ -763,6 +763,7 @@ void ax88179_eth_stop(struct udevice *dev)
 	debug("** %s()\n", __func__);
 
 	usb_ether_advance_rxbuf(ueth, -1);
+	usb_ether_cancel_rx(ueth);
 	priv->pkt_cnt = 0;
 	priv->pkt_data = NULL;
 	priv->pkt_hdr = NULL;
@@ -881,13 +882,22 @@ static int ax88179_eth_probe(struct udevice *dev)
 
 	/* Get the MAC address */
 	ret = asix_read_mac(&priv->ueth, pdata->enetaddr);
-	if (ret)
+	if (ret) {
+		usb_ether_deregister(&priv->ueth);
 		return ret;
+	}
 	debug("MAC %pM\n", pdata->enetaddr);
 
 	return 0;
 }
 
+static int ax88179_eth_remove(struct udevice *dev)
+{
+	struct asix_private *priv = dev_get_priv(dev);
+
+	return usb_ether_deregister(&priv->ueth);
+}
+
 static const struct eth_ops ax88179_eth_ops = {
 	.start = ax88179_eth_start,
 	.send = ax88179_eth_send,
@@ -901,6 +911,7 @@ U_BOOT_DRIVER(ax88179_eth) = {
 	.name = "ax88179_eth",
 	.id = UCLASS_ETH,
 	.probe = ax88179_eth_probe,
+	.remove = ax88179_eth_remove,
 	.ops = &ax88179_eth_ops,
 	.priv_auto	= sizeof(struct asix_private),
 	.plat_auto	= sizeof(struct eth_pdata),
@@ -914,6 +914,13 @@ static int mcs7830_eth_probe(struct udevice *dev)
 	return usb_ether_register(dev, ueth, MCS7830_RX_URB_SIZE);
 }
 
+static int mcs7830_eth_remove(struct udevice *dev)
+{
+	struct mcs7830_private *priv = dev_get_priv(dev);
+
+	return usb_ether_deregister(&priv->ueth);
+}
+
 static const struct eth_ops mcs7830_eth_ops = {
 	.start	= mcs7830_eth_start,
 	.send	= mcs7830_eth_send,
@@ -927,6 +934,7 @@ U_BOOT_DRIVER(mcs7830_eth) = {
 	.name	= "mcs7830_eth",
 	.id	= UCLASS_ETH,
 	.probe = mcs7830_eth_probe,
+	.remove = mcs7830_eth_remove,
 	.ops	= &mcs7830_eth_ops,
 	.priv_auto	= sizeof(struct mcs7830_private),
 	.plat_auto	= sizeof(struct eth_pdata),
@@ -1730,6 +1730,7 @@ void r8152_eth_stop(struct udevice *dev)
 
 	debug("** %s (%d)\n", __func__, __LINE__);
 
+	usb_ether_cancel_rx(&tp->ueth);
 	tp->rtl_ops.disable(tp);
 }
 
@@ -1845,6 +1846,13 @@ static int r8152_eth_probe(struct udevice *dev)
 	return usb_ether_register(dev, ueth, RTL8152_AGG_BUF_SZ);
 }
 
+static int r8152_eth_remove(struct udevice *dev)
+{
+	struct r8152 *tp = dev_get_priv(dev);
+
+	return usb_ether_deregister(&tp->ueth);
+}
+
 static const struct eth_ops r8152_eth_ops = {
 	.start	= r8152_eth_start,
 	.send	= r8152_eth_send,
@@ -1859,6 +1867,7 @@ U_BOOT_DRIVER(r8152_eth) = {
 	.name	= "r8152_eth",
 	.id	= UCLASS_ETH,
 	.probe = r8152_eth_probe,
+	.remove = r8152_eth_remove,
 	.ops	= &r8152_eth_ops,
 	.priv_auto	= sizeof(struct r8152),
 	.plat_auto	= sizeof(struct eth_pdata),
@@ -947,7 +947,11 @@ static int smsc95xx_eth_start(struct udevice *dev)
 
 void smsc95xx_eth_stop(struct udevice *dev)
 {
+	struct smsc95xx_private *priv = dev_get_priv(dev);
+
 	debug("** %s()\n", __func__);
+
+	usb_ether_cancel_rx(&priv->ueth);
 }
 
 int smsc95xx_eth_send(struct udevice *dev, void *packet, int length)
@@ -1047,6 +1051,13 @@ static int smsc95xx_eth_probe(struct udevice *dev)
 	return usb_ether_register(dev, ueth, RX_URB_SIZE);
 }
 
+static int smsc95xx_eth_remove(struct udevice *dev)
+{
+	struct smsc95xx_private *priv = dev_get_priv(dev);
+
+	return usb_ether_deregister(&priv->ueth);
+}
+
 static const struct eth_ops smsc95xx_eth_ops = {
 	.start	= smsc95xx_eth_start,
 	.send	= smsc95xx_eth_send,
@@ -1061,6 +1072,7 @@ U_BOOT_DRIVER(smsc95xx_eth) = {
 	.name	= "smsc95xx_eth",
 	.id	= UCLASS_ETH,
 	.probe = smsc95xx_eth_probe,
+	.remove = smsc95xx_eth_remove,
 	.ops	= &smsc95xx_eth_ops,
 	.priv_auto	= sizeof(struct smsc95xx_private),
 	.plat_auto	= sizeof(struct eth_pdata),
@@ -19,6 +19,17 @@
 
 #define USB_BULK_RECV_TIMEOUT 500
 
+static void usb_ether_free_rx(struct ueth_data *ueth)
+{
+	int i;
+
+	for (i = 0; i < USB_ETHER_RX_XFERS; i++) {
+		free(ueth->rx_xfer[i].buffer);
+		ueth->rx_xfer[i].buffer = NULL;
+	}
+	ueth->rxbuf = NULL;
+}
+
 int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 {
 	struct usb_device *udev = dev_get_parent_priv(dev);
@@ -75,14 +86,20 @@ int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 	}
 
 	ueth->rxsize = rxsize;
-	ueth->rxbuf = memalign(ARCH_DMA_MINALIGN, rxsize);
-	if (!ueth->rxbuf)
-		return -ENOMEM;
+	for (i = 0; i < USB_ETHER_RX_XFERS; i++) {
+		ueth->rx_xfer[i].buffer = memalign(ARCH_DMA_MINALIGN, rxsize);
+		if (!ueth->rx_xfer[i].buffer) {
+			usb_ether_free_rx(ueth);
+			return -ENOMEM;
+		}
+	}
+	ueth->rxbuf = ueth->rx_xfer[0].buffer;
 
 	ret = usb_set_interface(udev, iface_desc->bInterfaceNumber, ifnum);
 	if (ret) {
 		debug("%s: %s: Cannot set interface: %d\n", __func__, dev->name,
 		      ret);
+		usb_ether_free_rx(ueth);
 		return ret;
 	}
 	ueth->pusb_dev = udev;
@@ -92,16 +109,100 @@ int usb_ether_register(struct udevice *dev, struct ueth_data *ueth, int rxsize)
 
 int usb_ether_deregister(struct ueth_data *ueth)
 {
+	usb_ether_cancel_rx(ueth);
+	usb_ether_free_rx(ueth);
+
 	return 0;
 }
 
+/* Queue all the receive transfers, returning -EOPNOTSUPP if we cannot */
+static int usb_ether_queue_rx(struct ueth_data *ueth, int rxsize)
+{
+	struct usb_bulk_xfer *xfer;
+	int ret, i;
+
+	for (i = 0; i < USB_ETHER_RX_XFERS; i++) {
+		xfer = &ueth->rx_xfer[i];
+		xfer->pipe = usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in);
+		xfer->length = rxsize;
+		ret = usb_bulk_submit(ueth->pusb_dev, xfer);
+		if (ret) {
+			if (i)
+				usb_bulk_cancel(ueth->pusb_dev, xfer);
+			return ret;
+		}
+	}
+	ueth->rx_next = 0;
+	ueth->rx_queued = true;
+	ueth->rx_held = false;
+
+	return 0;
+}
+
+/* Queue again the transfer whose buffer has been processed */
+static void usb_ether_requeue_rx(struct ueth_data *ueth)
+{
+	struct usb_bulk_xfer *xfer = &ueth->rx_xfer[ueth->rx_next];
+	int ret;
+
+	ueth->rx_held = false;
+	ueth->rx_next = (ueth->rx_next + 1) % USB_ETHER_RX_XFERS;
+	ret = usb_bulk_submit(ueth->pusb_dev, xfer);
+	if (ret) {
+		debug("Rx: failed to queue: %d\n", ret);
+		usb_ether_cancel_rx(ueth);
+	}
+}
+
+void usb_ether_cancel_rx(struct ueth_data *ueth)
+{
+	if (!ueth->rx_queued)
+		return;
+
+	usb_bulk_cancel(ueth->pusb_dev, &ueth->rx_xfer[0]);
+	ueth->rx_queued = false;
+	ueth->rx_held = false;
+	ueth->rxlen = 0;
+}
+
 int usb_ether_receive(struct ueth_data *ueth, int rxsize)
 {
+	struct usb_bulk_xfer *xfer;
 	int actual_len;
 	int ret;
 
 	if (rxsize > ueth->rxsize)
 		return -EINVAL;
+
+	/* Whatever is left of the previous buffer is dropped, as below */
+	if (ueth->rx_held)
+		usb_ether_requeue_rx(ueth);
+	if (!ueth->rx_queued)
+		usb_ether_queue_rx(ueth, rxsize);
+	if (ueth->rx_queued) {
+		xfer = &ueth->rx_xfer[ueth->rx_next];
+		ret = usb_bulk_wait(ueth->pusb_dev, xfer, 0);
+		if (ret == -EINPROGRESS)
+			return -EAGAIN;
+		if (ret) {
+			printf("Rx: failed to receive: %d\n", ret);
+			usb_ether_cancel_rx(ueth);
+			return ret;
+		}
+		debug("Rx: len = %u, actual = %u\n", rxsize,
+		      xfer->actual_length);
+		if (!xfer->actual_length) {
+			usb_ether_requeue_rx(ueth);
+			return -EAGAIN;
+		}
+		ueth->rxbuf = xfer->buffer;
+		ueth->rxlen = xfer->actual_length;
+		ueth->rxptr = 0;
+		ueth->rx_held = true;
+
+		return 0;
+	}
+
 	ret = usb_bulk_msg(ueth->pusb_dev,
 			   usb_rcvbulkpipe(ueth->pusb_dev, ueth->ep_in),
 			   ueth->rxbuf, rxsize, &actual_len,
@@ -124,8 +225,11 @@ int usb_ether_receive(struct ueth_data *ueth, int rxsize)
 void usb_ether_advance_rxbuf(struct ueth_data *ueth, int num_bytes)
 {
 	ueth->rxptr += num_bytes;
-	if (num_bytes < 0 || ueth->rxptr >= ueth->rxlen)
+	if (num_bytes < 0 || ueth->rxptr >= ueth->rxlen) {
 		ueth->rxlen = 0;
+		if (ueth->rx_held)
+			usb_ether_requeue_rx(ueth);
+	}
 }
 
 int usb_ether_get_rx_bytes(struct ueth_data *ueth, uint8_t **ptrp)
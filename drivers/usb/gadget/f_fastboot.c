@@ -44,6 +44,13 @@ struct f_fastboot {
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+
+	/* OUT requests receiving the download phase into the download buffer */
+	struct usb_request *dl_req[CONFIG_FASTBOOT_USB_DL_REQS];
+	/* Offset in the buffer and length of the data not yet queued */
+	u32 dl_offset, dl_left;
+	/* Number of dl_req which are queued */
+	int dl_busy;
 };
 
 static char fb_ext_prop_name[] = "DeviceInterfaceGUID";
@@ -193,6 +200,8 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_direct(struct usb_ep *ep, struct usb_request *req);
 
 static void fastboot_complete(struct usb_ep *ep, struct usb_request *req)
 {
@@ -277,10 +286,18 @@ static void fastboot_unbind(struct usb_configuration *c, struct usb_function *f)
 static void fastboot_disable(struct usb_function *f)
 {
 	struct f_fastboot *f_fb = func_to_fastboot(f);
+	int i;
 
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
 
+	for (i = 0; i < CONFIG_FASTBOOT_USB_DL_REQS; i++) {
+		if (f_fb->dl_req[i]) {
+			usb_ep_free_request(f_fb->out_ep, f_fb->dl_req[i]);
+			f_fb->dl_req[i] = NULL;
+		}
+	}
+
 	if (f_fb->out_req) {
 		free(f_fb->out_req->buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
@@ -315,7 +332,7 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 static int fastboot_set_alt(struct usb_function *f,
 			    unsigned interface, unsigned alt)
 {
-	int ret;
+	int ret, i;
 	struct usb_composite_dev *cdev = f->config->cdev;
 	struct usb_gadget *gadget = cdev->gadget;
 	struct f_fastboot *f_fb = func_to_fastboot(f);
@@ -339,6 +356,13 @@ static int fastboot_set_alt(struct usb_function *f,
 	}
 	f_fb->out_req->complete = rx_handler_command;
 
+	/* These get their buffers when a download starts */
+	for (i = 0; i < CONFIG_FASTBOOT_USB_DL_REQS; i++) {
+		f_fb->dl_req[i] = usb_ep_alloc_request(f_fb->out_ep, 0);
+		if (f_fb->dl_req[i])
+			f_fb->dl_req[i]->complete = rx_handler_dl_direct;
+	}
+
 	d = fb_ep_desc(gadget, &fs_ep_in, &hs_ep_in, &ss_ep_in);
 	ret = usb_ep_enable(f_fb->in_ep, d);
 	if (ret) {
@@ -447,6 +471,124 @@ static unsigned int rx_bytes_expected(struct usb_ep *ep)
 	return rx_remain;
 }
 
+static void fastboot_rx_command(struct usb_ep *ep)
+{
+	struct usb_request *req = fastboot_func->out_req;
+
+	req->complete = rx_handler_command;
+	req->length = EP_BUFFER_SIZE;
+	req->actual = 0;
+	usb_ep_queue(ep, req, 0);
+}
+
+/*
+ * Queues @req to receive the next part of the download straight into the
+ * download buffer. Returns false if nothing is left to queue, or if there is
+ * no room for a whole packet where the next part belongs.
+ */
+static bool fastboot_dl_queue(struct usb_ep *ep, struct usb_request *req)
+{
+	struct f_fastboot *f_fb = fastboot_func;
+	unsigned int maxpacket = usb_endpoint_maxp(ep->desc);
+	u32 room, len;
+	u8 *buf;
+
+	if (!f_fb->dl_left)
+		return false;
+
+	len = min_t(u32, f_fb->dl_left,
+		    rounddown(CONFIG_FASTBOOT_USB_DL_REQ_SIZE, maxpacket));
+	room = roundup(len, maxpacket);
+	buf = fastboot_data_dest(f_fb->dl_offset, &room);
+	if (!buf || room < maxpacket ||
+	    !IS_ALIGNED((ulong)buf, CONFIG_SYS_CACHELINE_SIZE))
+		return false;
+	/* Take what fits now, the rest follows when a request completes */
+	if (room < roundup(len, maxpacket))
+		len = rounddown(room, maxpacket);
+	req->length = roundup(len, maxpacket);
+	req->buf = buf;
+	req->actual = 0;
+	if (usb_ep_queue(ep, req, 0))
+		return false;
+
+	f_fb->dl_offset += len;
+	f_fb->dl_left -= len;
+	f_fb->dl_busy++;
+
+	return true;
+}
+
+/* Returns true if at least one request now receives into the buffer */
+static bool fastboot_dl_start(struct usb_ep *ep)
+{
+	struct f_fastboot *f_fb = fastboot_func;
+	int i;
+
+	f_fb->dl_offset = 0;
+	f_fb->dl_left = fastboot_data_remaining();
+	f_fb->dl_busy = 0;
+	for (i = 0; i < CONFIG_FASTBOOT_USB_DL_REQS; i++) {
+		if (!f_fb->dl_req[i] || !fastboot_dl_queue(ep, f_fb->dl_req[i]))
+			break;
+	}
+
+	return f_fb->dl_busy;
+}
+
+static void fastboot_dl_abort(struct usb_ep *ep)
+{
+	struct f_fastboot *f_fb = fastboot_func;
+	int i;
+
+	f_fb->dl_left = 0;
+	for (i = 0; i < CONFIG_FASTBOOT_USB_DL_REQS; i++) {
+		if (f_fb->dl_req[i])
+			usb_ep_dequeue(ep, f_fb->dl_req[i]);
+	}
+}
+
+static void rx_handler_dl_direct(struct usb_ep *ep, struct usb_request *req)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	struct f_fastboot *f_fb = fastboot_func;
+	unsigned int transfer_size = fastboot_data_remaining();
+
+	f_fb->dl_busy--;
+	if (req->status != 0) {
+		if (req->status != -ECONNRESET)
+			printf("Bad status: %d\n", req->status);
+		return;
+	}
+
+	/* Requests complete in order, so the data follows what came before */
+	if (req->actual < transfer_size)
+		transfer_size = req->actual;
+	fastboot_data_received(transfer_size, response);
+
+	/* Anything after a short packet would be in the wrong place */
+	if (!response[0] && req->actual < req->length &&
+	    fastboot_data_remaining())
+		fastboot_fail("Short transfer", response);
+
+	if (response[0]) {
+		fastboot_dl_abort(ep);
+		fastboot_tx_write_str(response);
+		fastboot_rx_command(ep);
+	} else if (!fastboot_data_remaining()) {
+		fastboot_data_complete(response);
+		fastboot_tx_write_str(response);
+		fastboot_rx_command(ep);
+	} else if (!fastboot_dl_queue(ep, req) && !f_fb->dl_busy) {
+		/* Receive the rest through the bounce buffer */
+		req = f_fb->out_req;
+		req->complete = rx_handler_dl_image;
+		req->length = rx_bytes_expected(ep);
+		req->actual = 0;
+		usb_ep_queue(ep, req, 0);
+	}
+}
+
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
 	char response[FASTBOOT_RESPONSE_LEN] = {0};
@@ -524,6 +666,11 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 	}
 
 	if (!strncmp("DATA", response, 4)) {
+		/* The command request waits until the download is done */
+		if (fastboot_dl_start(ep)) {
+			fastboot_tx_write_str(response);
+			return;
+		}
 		req->complete = rx_handler_dl_image;
 		req->length = rx_bytes_expected(ep);
 	}
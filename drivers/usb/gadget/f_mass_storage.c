@@ -303,6 +303,21 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
 
+	/* Data read ahead of the next READ, see fsg_read_ahead() */
+	void			*ra_buf;
+	unsigned int		ra_lun;
+	loff_t			ra_offset;
+	u32			ra_len;		/* 0 if nothing was read */
+	unsigned int		last_read_lun;
+	loff_t			last_read_end;
+	u32			last_read_len;
+
+	/* Last buffer of a WRITE, see fsg_flush_write() */
+	void			*wb_buf;
+	unsigned int		wb_lun;
+	loff_t			wb_offset;
+	u32			wb_len;		/* 0 if nothing is left */
+
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
 
@@ -327,6 +342,7 @@ struct fsg_common {
 	unsigned int		short_packet_received:1;
 	unsigned int		bad_lun_okay:1;
 	unsigned int		running:1;
+	unsigned int		read_sequential:1;
 
 	int			thread_wakeup_needed;
 	struct completion	thread_notifier;
@@ -652,16 +668,24 @@ static void busy_indicator(void)
 		state = 0;
 }
 
-static int sleep_thread(struct fsg_common *common)
+/* How long the host may be idle before a write behind is done, in ms */
+#define FSG_WRITE_BEHIND_IDLE	10
+
+/* Like sleep_thread(), but give up after @timeout ms unless it is 0 */
+static int sleep_thread_timeout(struct fsg_common *common, ulong timeout)
 {
 	int	rc = 0;
 	int i = 0, k = 0;
+	ulong start = get_timer(0);
 
 	/* Wait until a signal arrives or we are woken up */
 	for (;;) {
 		if (common->thread_wakeup_needed)
 			break;
 
+		if (timeout && get_timer(start) >= timeout)
+			return -ETIMEDOUT;
+
 		if (++i == 20000) {
 			busy_indicator();
 			i = 0;
@@ -686,6 +710,109 @@ static int sleep_thread(struct fsg_common *common)
 	return rc;
 }
 
+static int sleep_thread(struct fsg_common *common)
+{
+	return sleep_thread_timeout(common, 0);
+}
+
+/*-------------------------------------------------------------------------*/
+
+/* Exchange the memory of @bh with the one at *@buf */
+static void fsg_swap_buf(struct fsg_buffhd *bh, void **buf)
+{
+	void *tmp = bh->buf;
+
+	bh->buf = *buf;
+	*buf = tmp;
+	bh->inreq->buf = bh->buf;
+	bh->outreq->buf = bh->buf;
+}
+
+/* Write the last buffer of a WRITE whose status was sent already.  The
+ * storage is written while nothing else needs it, so a failure can only be
+ * reported by the next command to the LUN.
+ */
+static void fsg_flush_write(struct fsg_common *common)
+{
+	struct fsg_lun	*curlun;
+	struct ums	*ums_dev;
+	int		rc;
+
+	if (!common->wb_len)
+		return;
+
+	curlun = &common->luns[common->wb_lun];
+	ums_dev = &ums[common->wb_lun];
+	rc = ums_dev->write_sector(ums_dev, common->wb_offset / SECTOR_SIZE,
+				   common->wb_len / SECTOR_SIZE,
+				   common->wb_buf);
+	if (rc < 0 || rc < common->wb_len / SECTOR_SIZE) {
+		LDBG(curlun, "error in write behind: %d\n", rc);
+		curlun->write_error = 1;
+		curlun->write_error_lba = common->wb_offset / SECTOR_SIZE +
+					  max(rc, 0);
+	}
+	common->wb_len = 0;
+}
+
+/* After a READ starting where the previous one ended, read as much again
+ * past its end, while the host receives the data and the status and sends
+ * the next command.  do_read() takes it from there if it is what comes
+ * next.
+ */
+static void fsg_read_ahead(struct fsg_common *common)
+{
+	struct fsg_lun	*curlun = &common->luns[common->last_read_lun];
+	struct ums	*ums_dev = &ums[common->last_read_lun];
+	loff_t		file_offset = common->last_read_end;
+	u32		amount;
+	int		rc;
+
+	if (!IS_ENABLED(CONFIG_USB_FUNCTION_MASS_STORAGE_READ_AHEAD) ||
+	    !common->read_sequential || common->wb_len)
+		return;
+	common->read_sequential = 0;
+
+	if (common->ra_len && common->ra_lun == common->last_read_lun &&
+	    common->ra_offset == file_offset)
+		return;			/* Already there */
+
+	amount = min_t(loff_t, common->last_read_len,
+		       (curlun->num_sectors << 9) - file_offset);
+	amount = min(amount, FSG_BUFLEN);
+	common->ra_len = 0;
+	if (!amount)
+		return;
+
+	rc = ums_dev->read_sector(ums_dev, file_offset / SECTOR_SIZE,
+				  amount / SECTOR_SIZE, common->ra_buf);
+	if (rc <= 0)
+		return;
+
+	common->ra_lun = common->last_read_lun;
+	common->ra_offset = file_offset;
+	common->ra_len = min_t(u32, amount, rc * SECTOR_SIZE);
+}
+
+/* Put in @bh the data read ahead for @file_offset, if there is some, and
+ * lower *@amount to its length
+ */
+static int fsg_take_read_ahead(struct fsg_common *common,
+			       struct fsg_buffhd *bh, loff_t file_offset,
+			       unsigned int *amount)
+{
+	if (!common->ra_len || common->ra_lun != common->lun ||
+	    common->ra_offset != file_offset)
+		return 0;
+
+	*amount = min(*amount, common->ra_len);
+	/* Whatever is not used goes away with the buffer swapped out */
+	fsg_swap_buf(bh, &common->ra_buf);
+	common->ra_len = 0;
+
+	return 1;
+}
+
 /*-------------------------------------------------------------------------*/
 
 static int do_read(struct fsg_common *common)
@@ -699,6 +826,7 @@ static int do_read(struct fsg_common *common)
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nread;
+	int			sequential;
 
 	/* Get the starting Logical Block Address and check that it's
 	 * not too big */
@@ -720,6 +848,8 @@ static int do_read(struct fsg_common *common)
 		return -EINVAL;
 	}
 	file_offset = ((loff_t) lba) << 9;
+	sequential = common->lun == common->last_read_lun &&
+		     file_offset == common->last_read_end;
 
 	/* Carry out the file reads */
 	amount_left = common->data_size_from_cmnd;
@@ -761,13 +891,17 @@ static int do_read(struct fsg_common *common)
 			break;
 		}
 
-		/* Perform the read */
-		rc = ums[common->lun].read_sector(&ums[common->lun],
-				      file_offset / SECTOR_SIZE,
-				      amount / SECTOR_SIZE,
-				      (char __user *)bh->buf);
-		if (!rc)
-			return -EIO;
+		/* Perform the read, unless it was done ahead */
+		if (fsg_take_read_ahead(common, bh, file_offset, &amount)) {
+			rc = amount / SECTOR_SIZE;
+		} else {
+			rc = ums[common->lun].read_sector(&ums[common->lun],
+					      file_offset / SECTOR_SIZE,
+					      amount / SECTOR_SIZE,
+					      (char __user *)bh->buf);
+			if (!rc)
+				return -EIO;
+		}
 
 		nread = rc * SECTOR_SIZE;
 
@@ -810,6 +944,12 @@ static int do_read(struct fsg_common *common)
 		common->next_buffhd_to_fill = bh->next;
 	}
 
+	/* Read what follows while the host takes this, if it is streaming */
+	common->last_read_lun = common->lun;
+	common->last_read_end = file_offset;
+	common->last_read_len = common->data_size_from_cmnd;
+	common->read_sequential = sequential && !amount_left;
+
 	return -EIO;		/* No default reply */
 }
 
@@ -826,6 +966,8 @@ static int do_write(struct fsg_common *common)
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nwritten;
+	struct ums		*ums_dev = &ums[common->lun];
+	int			write_behind;
 	int			rc;
 
 	if (curlun->ro) {
@@ -854,6 +996,19 @@ static int do_write(struct fsg_common *common)
 		return -EINVAL;
 	}
 
+	/* Whatever was read ahead may be overwritten */
+	if (common->ra_lun == common->lun)
+		common->ra_len = 0;
+	common->read_sequential = 0;
+
+	/* The last buffer may be written after the status is sent, unless
+	 * FUA asks for the data to be on the medium first
+	 */
+	write_behind = IS_ENABLED(CONFIG_USB_FUNCTION_MASS_STORAGE_WRITE_BEHIND);
+	if (common->cmnd[0] != SC_WRITE_6 && (common->cmnd[1] & 0x08) &&
+	    !curlun->nofua)
+		write_behind = 0;
+
 	/* Carry out the file writes */
 	get_some_more = 1;
 	file_offset = usb_offset = ((loff_t) lba) << 9;
@@ -935,13 +1090,27 @@ static int do_write(struct fsg_common *common)
 
 			amount = bh->outreq->actual;
 
-			/* Perform the write */
-			rc = ums[common->lun].write_sector(&ums[common->lun],
-					       file_offset / SECTOR_SIZE,
-					       amount / SECTOR_SIZE,
-					       (char __user *)bh->buf);
-			if (!rc)
-				return -EIO;
+			/* The previous command's last buffer goes first */
+			fsg_flush_write(common);
+
+			/* Perform the write, or keep the last buffer for
+			 * later
+			 */
+			if (write_behind && amount == amount_left_to_write &&
+			    !(amount & 511)) {
+				fsg_swap_buf(bh, &common->wb_buf);
+				common->wb_lun = common->lun;
+				common->wb_offset = file_offset;
+				common->wb_len = amount;
+				rc = amount / SECTOR_SIZE;
+			} else {
+				rc = ums_dev->write_sector(ums_dev,
+						file_offset / SECTOR_SIZE,
+						amount / SECTOR_SIZE,
+						(char __user *)bh->buf);
+				if (!rc)
+					return -EIO;
+			}
 			nwritten = rc * SECTOR_SIZE;
 
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
@@ -1751,6 +1920,19 @@ static int check_command(struct fsg_common *common, int cmnd_size,
 			return -EINVAL;
 		}
 	}
+
+	/* A write done after its status was sent failed: report it as a
+	 * deferred error to the next command but INQUIRY or REQUEST SENSE
+	 */
+	if (curlun && curlun->write_error &&
+	    common->cmnd[0] != SC_INQUIRY &&
+	    common->cmnd[0] != SC_REQUEST_SENSE) {
+		curlun->sense_data = SS_WRITE_ERROR;
+		curlun->sense_data_info = curlun->write_error_lba;
+		curlun->info_valid = 1;
+		curlun->write_error = 0;
+		return -EINVAL;
+	}
 #if 0
 	/* If a unit attention condition exists, only INQUIRY and
 	 * REQUEST SENSE commands are allowed; anything else must fail. */
@@ -1787,6 +1969,11 @@ static int do_scsi_command(struct fsg_common *common)
 
 	dump_cdb(common);
 
+	/* Only a WRITE may leave the storage busy with the previous one */
+	if (common->cmnd[0] != SC_WRITE_6 && common->cmnd[0] != SC_WRITE_10 &&
+	    common->cmnd[0] != SC_WRITE_12)
+		fsg_flush_write(common);
+
 	/* Wait for the next buffer to become available for data or status */
 	bh = common->next_buffhd_to_fill;
 	common->next_buffhd_to_drain = bh;
@@ -2136,9 +2323,23 @@ static int get_next_command(struct fsg_common *common)
 	 * can reuse it for the next filling.  No need to advance
 	 * next_buffhd_to_fill. */
 
-	/* Wait for the CBW to arrive */
+	/* The host is busy with the previous data and status */
+	fsg_read_ahead(common);
+
+	/* Wait for the CBW to arrive, writing what is left of the
+	 * previous WRITE if the host goes quiet for a while
+	 */
 	while (bh->state != BUF_STATE_FULL) {
-		rc = sleep_thread(common);
+		if (common->wb_len) {
+			rc = sleep_thread_timeout(common,
+						  FSG_WRITE_BEHIND_IDLE);
+			if (rc == -ETIMEDOUT) {
+				fsg_flush_write(common);
+				continue;
+			}
+		} else {
+			rc = sleep_thread(common);
+		}
 		if (rc)
 			return rc;
 	}
@@ -2291,6 +2492,11 @@ static void handle_exception(struct fsg_common *common)
 	struct fsg_lun		*curlun;
 	unsigned int		exception_req_tag;
 
+	/* Nothing is kept across a reset or a configuration change */
+	fsg_flush_write(common);
+	common->ra_len = 0;
+	common->read_sequential = 0;
+
 	/* Cancel all the pending transfers */
 	if (common->fsg) {
 		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
@@ -2404,15 +2610,20 @@ int fsg_main_thread(void *common_)
 
 		if (!common->running) {
 			ret = sleep_thread(common);
-			if (ret)
+			if (ret) {
+				fsg_flush_write(common);
 				return ret;
+			}
 
 			continue;
 		}
 
 		ret = get_next_command(common);
-		if (ret)
+		if (ret) {
+			/* The user or the cable ends it: finish writing */
+			fsg_flush_write(common);
 			return ret;
+		}
 
 		if (!exception_in_progress(common))
 			common->state = FSG_STATE_DATA_PHASE;
@@ -2516,6 +2727,24 @@ buffhds_first_it:
 	} while (--i);
 	bh->next = common->buffhds;
 
+	/* Spare buffers, swapped with the ones above */
+	if (IS_ENABLED(CONFIG_USB_FUNCTION_MASS_STORAGE_READ_AHEAD)) {
+		common->ra_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+					  FSG_BUFLEN);
+		if (unlikely(!common->ra_buf)) {
+			rc = -ENOMEM;
+			goto error_release;
+		}
+	}
+	if (IS_ENABLED(CONFIG_USB_FUNCTION_MASS_STORAGE_WRITE_BEHIND)) {
+		common->wb_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+					  FSG_BUFLEN);
+		if (unlikely(!common->wb_buf)) {
+			rc = -ENOMEM;
+			goto error_release;
+		}
+	}
+
 	snprintf(common->inquiry_string, sizeof common->inquiry_string,
 		 "%-8s%-16s%04x",
 		 "Linux   ",
@@ -2581,6 +2810,8 @@ static void fsg_common_release(struct kref *ref)
 			kfree(bh->buf);
 		} while (++bh, --i);
 	}
+	kfree(common->ra_buf);
+	kfree(common->wb_buf);
 
 	if (common->free_storage_on_release)
 		kfree(common);
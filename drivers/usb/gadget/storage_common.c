@@ -286,6 +286,9 @@ struct fsg_lun {
 	unsigned int	registered:1;
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
+	unsigned int	write_error:1;	/* a write after its status failed */
+
+	u32		write_error_lba;
 
 	u32		sense_data;
 	u32		sense_data_info;
@@ -307,7 +310,7 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
 /* Number of buffers we will use.  2 is enough for double-buffering */
-#define FSG_NUM_BUFFERS	2
+#define FSG_NUM_BUFFERS	CONFIG_USB_FUNCTION_MASS_STORAGE_BUFFERS
 
 /* Default size of buffer length. */
 #define FSG_BUFLEN	((u32)131072)
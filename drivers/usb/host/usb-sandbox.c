@@ -10,8 +10,24 @@
 #include <usb.h>
 #include <dm/root.h>
 
+/* Bulk transfers queued at once */
+#define SANDBOX_USB_XFERS	16
+
+/**
+ * struct sandbox_usb_ctrl - sandbox USB controller
+ *
+ * @rootdev:	Address of the root hub
+ * @queue:	Bulk transfers queued with sandbox_bulk_submit(), oldest first.
+ *		They are done when waited for, in the order they were queued.
+ * @queued:	Number of transfers in @queue
+ */
 struct sandbox_usb_ctrl {
 	int rootdev;
+	struct {
+		struct usb_device *udev;
+		struct usb_bulk_xfer *xfer;
+	} queue[SANDBOX_USB_XFERS];
+	int queued;
 };
 
 static void usbmon_trace(struct udevice *bus, ulong pipe,
@@ -98,6 +114,70 @@ static int sandbox_submit_bulk(struct udevice *bus, struct usb_device *udev,
 	return ret;
 }
 
+static int sandbox_bulk_submit(struct udevice *bus, struct usb_device *udev,
+			       struct usb_bulk_xfer *xfer)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+
+	if (ctrl->queued == SANDBOX_USB_XFERS)
+		return -EBUSY;
+	ctrl->queue[ctrl->queued].udev = udev;
+	ctrl->queue[ctrl->queued].xfer = xfer;
+	ctrl->queued++;
+
+	return 0;
+}
+
+/* Remove entry @i of the queue */
+static void sandbox_bulk_dequeue(struct sandbox_usb_ctrl *ctrl, int i)
+{
+	ctrl->queued--;
+	memmove(&ctrl->queue[i], &ctrl->queue[i + 1],
+		(ctrl->queued - i) * sizeof(ctrl->queue[0]));
+}
+
+static int sandbox_bulk_wait(struct udevice *bus, struct usb_device *udev,
+			     struct usb_bulk_xfer *xfer, int timeout)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	struct usb_bulk_xfer *first;
+	int ret;
+
+	while (ctrl->queued && xfer->status == -EINPROGRESS) {
+		first = ctrl->queue[0].xfer;
+		ret = sandbox_submit_bulk(bus, ctrl->queue[0].udev, first->pipe,
+					  first->buffer, first->length);
+		first->actual_length = ret < 0 ? 0 : ret;
+		first->status = ret < 0 ? ret : 0;
+		sandbox_bulk_dequeue(ctrl, 0);
+	}
+
+	return 0;
+}
+
+static int sandbox_bulk_cancel(struct udevice *bus, struct usb_device *udev,
+			       struct usb_bulk_xfer *xfer)
+{
+	struct sandbox_usb_ctrl *ctrl = dev_get_priv(bus);
+	struct usb_bulk_xfer *queued;
+	int i = 0;
+
+	while (i < ctrl->queued) {
+		queued = ctrl->queue[i].xfer;
+		if (ctrl->queue[i].udev != udev ||
+		    usb_pipeendpoint(queued->pipe) !=
+		    usb_pipeendpoint(xfer->pipe) ||
+		    usb_pipein(queued->pipe) != usb_pipein(xfer->pipe)) {
+			i++;
+			continue;
+		}
+		queued->status = -ECONNRESET;
+		sandbox_bulk_dequeue(ctrl, i);
+	}
+
+	return 0;
+}
+
 static int sandbox_submit_int(struct udevice *bus, struct usb_device *udev,
 			      unsigned long pipe, void *buffer, int length,
 			      int interval, bool nonblock)
@@ -142,6 +222,9 @@ static const struct dm_usb_ops sandbox_usb_ops = {
 	.bulk		= sandbox_submit_bulk,
 	.interrupt	= sandbox_submit_int,
 	.alloc_device	= sandbox_alloc_device,
+	.bulk_submit	= sandbox_bulk_submit,
+	.bulk_wait	= sandbox_bulk_wait,
+	.bulk_cancel	= sandbox_bulk_cancel,
 };
 
 static const struct udevice_id sandbox_usb_ids[] = {
@@ -171,6 +171,85 @@ int usb_get_max_xfer_size(struct usb_device *udev, size_t *size)
 	return ops->get_max_xfer_size(bus, size);
 }
 
+int usb_alloc_streams(struct usb_device *udev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->alloc_streams)
+		return -EOPNOTSUPP;
+
+	return ops->alloc_streams(bus, udev, pipes, num_pipes, num_streams);
+}
+
+int usb_bulk_stream_msg(struct usb_device *udev, unsigned int pipe,
+			unsigned int stream_id, void *data, int len,
+			int *actual_length, int timeout)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!stream_id)
+		return usb_bulk_msg(udev, pipe, data, len, actual_length,
+				    timeout);
+	if (!ops->bulk_stream)
+		return -EOPNOTSUPP;
+	if (len < 0)
+		return -EINVAL;
+
+	udev->status = USB_ST_NOT_PROC;
+	if (ops->bulk_stream(bus, udev, pipe, stream_id, data, len) < 0)
+		return -EIO;
+	*actual_length = udev->act_len;
+
+	return udev->status ? -EIO : 0;
+}
+
+int usb_bulk_submit(struct usb_device *udev, struct usb_bulk_xfer *xfer)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->bulk_submit)
+		return -EOPNOTSUPP;
+	if (xfer->length < 0)
+		return -EINVAL;
+
+	xfer->actual_length = 0;
+	xfer->status = -EINPROGRESS;
+
+	return ops->bulk_submit(bus, udev, xfer);
+}
+
+int usb_bulk_wait(struct usb_device *udev, struct usb_bulk_xfer *xfer,
+		  int timeout)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+	int ret;
+
+	if (xfer->status != -EINPROGRESS)
+		return xfer->status;
+
+	ret = ops->bulk_wait(bus, udev, xfer, timeout);
+	if (ret)
+		return ret;
+
+	return xfer->status;
+}
+
+int usb_bulk_cancel(struct usb_device *udev, struct usb_bulk_xfer *xfer)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->bulk_cancel)
+		return -EOPNOTSUPP;
+
+	return ops->bulk_cancel(bus, udev, xfer);
+}
+
 int usb_stop(void)
 {
 	struct udevice *bus;
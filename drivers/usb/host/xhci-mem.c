@@ -97,6 +97,27 @@ static void xhci_ring_free(struct xhci_ring *ring)
 	free(ring);
 }
 
+/**
+ * Frees the stream context array and the stream rings of an endpoint
+ *
+ * @param ep	endpoint set up by xhci_alloc_stream_info()
+ * @return none
+ */
+void xhci_free_stream_info(struct xhci_virt_ep *ep)
+{
+	unsigned int i;
+
+	if (!ep->stream_ctx)
+		return;
+
+	for (i = 1; i < ep->num_streams; i++)
+		xhci_ring_free(ep->stream_rings[i]);
+	free(ep->stream_ctx);
+	ep->stream_ctx = NULL;
+	ep->num_streams = 0;
+	ep->ep_state &= ~EP_HAS_STREAMS;
+}
+
 /**
  * Free the scratchpad buffer array and scratchpad buffers
  *
@@ -151,9 +172,11 @@ static void xhci_free_virt_devices(struct xhci_ctrl *ctrl)
 
 		ctrl->dcbaa->dev_context_ptrs[slot_id] = 0;
 
-		for (i = 0; i < 31; ++i)
+		for (i = 0; i < 31; ++i) {
 			if (virt_dev->eps[i].ring)
 				xhci_ring_free(virt_dev->eps[i].ring);
+			xhci_free_stream_info(&virt_dev->eps[i]);
+		}
 
 		if (virt_dev->in_ctx)
 			xhci_free_container_ctx(virt_dev->in_ctx);
@@ -174,6 +197,14 @@ static void xhci_free_virt_devices(struct xhci_ctrl *ctrl)
  */
 void xhci_cleanup(struct xhci_ctrl *ctrl)
 {
+	struct xhci_bulk_td *td, *tmp;
+
+	list_for_each_entry_safe(td, tmp, &ctrl->bulk_tds, node) {
+		td->xfer->status = -ESHUTDOWN;
+		td->xfer->hcpriv = NULL;
+		free(td);
+	}
+
 	xhci_ring_free(ctrl->event_ring);
 	xhci_ring_free(ctrl->cmd_ring);
 	xhci_scratchpad_free(ctrl);
@@ -344,6 +375,41 @@ struct xhci_ring *xhci_ring_alloc(struct xhci_ctrl *ctrl, unsigned int num_segs,
 	return ring;
 }
 
+/**
+ * Allocates a linear stream context array for an endpoint, and a transfer
+ * ring for each of its streams but stream 0, which is reserved.
+ * See section 4.12.2 of the XHCI spec.
+ *
+ * @param ctrl		Host controller data structure
+ * @param ep		endpoint to set up
+ * @param num_streams	number of entries of the array, a power of two no
+ *			larger than XHCI_MAX_STREAMS
+ * @return none
+ */
+void xhci_alloc_stream_info(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			    unsigned int num_streams)
+{
+	struct xhci_ring *ring;
+	unsigned int i;
+	u64 val_64;
+
+	ep->stream_ctx = xhci_malloc(num_streams *
+				     sizeof(struct xhci_stream_ctx));
+	for (i = 1; i < num_streams; i++) {
+		ring = xhci_ring_alloc(ctrl, 1, true);
+		ep->stream_rings[i] = ring;
+
+		val_64 = xhci_virt_to_bus(ctrl, ring->enqueue);
+		ep->stream_ctx[i].stream_ring = cpu_to_le64(val_64 |
+					SCT_FOR_CTX(SCT_PRI_TR) |
+					ring->cycle_state);
+	}
+	xhci_flush_cache((uintptr_t)ep->stream_ctx,
+			 num_streams * sizeof(struct xhci_stream_ctx));
+
+	ep->num_streams = num_streams;
+}
+
 /**
  * Set up the scratchpad buffer array and scratchpad buffers
  *
@@ -518,6 +584,8 @@ int xhci_mem_init(struct xhci_ctrl *ctrl, struct xhci_hccr *hccr,
 	int i;
 	struct xhci_segment *seg;
 
+	INIT_LIST_HEAD(&ctrl->bulk_tds);
+
 	/* DCBAA initialization */
 	ctrl->dcbaa = xhci_malloc(sizeof(struct xhci_device_context_array));
 	if (ctrl->dcbaa == NULL) {
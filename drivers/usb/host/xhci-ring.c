@@ -16,6 +16,7 @@
 #include <common.h>
 #include <cpu_func.h>
 #include <log.h>
+#include <malloc.h>
 #include <asm/byteorder.h>
 #include <usb.h>
 #include <asm/unaligned.h>
@@ -301,6 +302,42 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr, u32 slot_id,
 	xhci_writel(&ctrl->dba->doorbell[0], DB_VALUE_HOST);
 }
 
+/**
+ * Queues a Set TR Dequeue Pointer command moving the dequeue pointer of a
+ * stream to its enqueue pointer
+ *
+ * @param ctrl		Host controller data structure
+ * @param slot_id	Slot ID of the device
+ * @param ep_index	Endpoint index
+ * @param stream_id	Stream of the endpoint
+ * @param ring		Transfer ring of the stream
+ * @return none
+ */
+static void xhci_queue_set_deq(struct xhci_ctrl *ctrl, u32 slot_id,
+			       u32 ep_index, unsigned int stream_id,
+			       struct xhci_ring *ring)
+{
+	u32 fields[4];
+	u64 val_64;
+
+	if (WARN_ON(prepare_ring(ctrl, ctrl->cmd_ring, EP_STATE_RUNNING)))
+		return;
+
+	val_64 = xhci_virt_to_bus(ctrl, ring->enqueue) |
+		 SCT_FOR_CTX(SCT_PRI_TR) | ring->cycle_state;
+
+	fields[0] = lower_32_bits(val_64);
+	fields[1] = upper_32_bits(val_64);
+	fields[2] = STREAM_ID_FOR_TRB(stream_id);
+	fields[3] = TRB_TYPE(TRB_SET_DEQ) | SLOT_ID_FOR_TRB(slot_id) |
+		    EP_ID_FOR_TRB(ep_index) | ctrl->cmd_ring->cycle_state;
+
+	queue_trb(ctrl, ctrl->cmd_ring, false, fields);
+
+	/* Ring the command ring doorbell */
+	xhci_writel(&ctrl->dba->doorbell[0], DB_VALUE_HOST);
+}
+
 /*
  * For xHCI 1.0 host controllers, TD size is the number of max packet sized
  * packets remaining in the TD (*not* including this TRB).
@@ -359,12 +396,13 @@ static u32 xhci_td_remainder(struct xhci_ctrl *ctrl, int transferred,
  *
  * @param udev		pointer to the USB device structure
  * @param ep_index	index of the endpoint
+ * @param stream_id	stream of the endpoint, 0 if it has none
  * @param start_cycle	cycle flag of the first TRB
  * @param start_trb	pionter to the first TRB
  * @return none
  */
 static void giveback_first_trb(struct usb_device *udev, int ep_index,
-				int start_cycle,
+				unsigned int stream_id, int start_cycle,
 				struct xhci_generic_trb *start_trb)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
@@ -382,7 +420,7 @@ static void giveback_first_trb(struct usb_device *udev, int ep_index,
 
 	/* Ringing EP doorbell here */
 	xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
-				DB_VALUE(ep_index, 0));
+				DB_VALUE(ep_index, stream_id));
 
 	return;
 }
@@ -430,10 +468,98 @@ static int event_ready(struct xhci_ctrl *ctrl)
 	return 1;
 }
 
+/**
+ * Checks if a TRB is on a transfer ring
+ *
+ * @param ctrl	Host controller data structure
+ * @param ring	transfer ring
+ * @param addr	bus address of the TRB
+ * @return true if the TRB is on the ring
+ */
+static bool xhci_ring_has_trb(struct xhci_ctrl *ctrl, struct xhci_ring *ring,
+			      u64 addr)
+{
+	struct xhci_segment *seg = ring->first_seg;
+	u64 start;
+
+	do {
+		start = xhci_virt_to_bus(ctrl, seg->trbs);
+		if (addr >= start && addr < start + SEGMENT_SIZE)
+			return true;
+		seg = seg->next;
+	} while (seg && seg != ring->first_seg);
+
+	return false;
+}
+
+/**
+ * Handles a transfer event for a TD queued by xhci_bulk_submit(), completing
+ * its transfer when the event is for the last TRB of the TD. Events for the
+ * TRBs before it report short packets, which are always for the oldest TD of
+ * the ring since the xHC works through them in order.
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	transfer event TRB
+ * @return true if the event was for a queued TD, false if it is not ours
+ */
+static bool xhci_bulk_td_event(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u32 flags = le32_to_cpu(event->trans_event.flags);
+	u32 len = le32_to_cpu(event->trans_event.transfer_len);
+	u64 addr = le64_to_cpu(event->trans_event.buffer);
+	struct xhci_bulk_td *td, *found = NULL;
+	struct usb_bulk_xfer *xfer;
+
+	list_for_each_entry(td, &ctrl->bulk_tds, node) {
+		if (td->udev->slot_id != TRB_TO_SLOT_ID(flags) ||
+		    td->ep_index != TRB_TO_EP_INDEX(flags) ||
+		    !xhci_ring_has_trb(ctrl, td->ring, addr))
+			continue;
+		if (addr == xhci_virt_to_bus(ctrl, td->last_trb)) {
+			found = td;
+			break;
+		}
+		if (!found)
+			found = td;
+	}
+	if (!found)
+		return false;
+
+	td = found;
+	if (addr != xhci_virt_to_bus(ctrl, td->last_trb)) {
+		td->available -= (int)EVENT_TRB_LEN(len);
+		return true;
+	}
+
+	xfer = td->xfer;
+	xfer->actual_length = min(td->available,
+				  td->available - (int)EVENT_TRB_LEN(len));
+	switch (GET_COMP_CODE(len)) {
+	case COMP_SUCCESS:
+	case COMP_SHORT_TX:
+		xfer->status = 0;
+		break;
+	case COMP_STALL:
+		xfer->status = -EPIPE;
+		break;
+	default:
+		xfer->status = -EIO;
+	}
+	if (usb_pipein(xfer->pipe))
+		xhci_inval_cache((uintptr_t)xfer->buffer, xfer->length);
+
+	xfer->hcpriv = NULL;
+	list_del(&td->node);
+	free(td);
+
+	return true;
+}
+
 /**
  * Waits for a specific type of event and returns it. Discards unexpected
- * events. Caller *must* call xhci_acknowledge_event() after it is finished
- * processing the event, and must not access the returned pointer afterwards.
+ * events, and handles those for TDs queued by xhci_bulk_submit(). Caller
+ * *must* call xhci_acknowledge_event() after it is finished processing the
+ * event, and must not access the returned pointer afterwards.
  *
  * @param ctrl		Host controller data structure
  * @param expected	TRB type expected from Event TRB
@@ -451,6 +577,10 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 			continue;
 
 		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
+		if (type == TRB_TRANSFER && xhci_bulk_td_event(ctrl, event)) {
+			xhci_acknowledge_event(ctrl);
+			continue;
+		}
 		if (type == expected)
 			return event;
 
@@ -488,16 +618,26 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
  * ring the doorbell, causing this endpoint to start working again.
  * (Careful: This will BUG() when there was no transfer in progress. Shouldn't
  * happen in practice for current uses and is too complicated to fix right now.)
+ *
+ * On an endpoint with streams, the TD being stopped may belong to another
+ * stream, or there may be none: the transfer event, if any, is skipped while
+ * waiting for the command to complete.
  */
-static void abort_td(struct usb_device *udev, int ep_index)
+static void abort_td(struct usb_device *udev, int ep_index,
+		     unsigned int stream_id)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
-	struct xhci_ring *ring =  ctrl->devs[udev->slot_id]->eps[ep_index].ring;
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_ring *ring = stream_id ? ep->stream_rings[stream_id] :
+					     ep->ring;
 	union xhci_trb *event;
 	u32 field;
 
 	xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index, TRB_STOP_RING);
 
+	if (stream_id)
+		goto stopped;
+
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	field = le32_to_cpu(event->trans_event.flags);
 	BUG_ON(TRB_TO_SLOT_ID(field) != udev->slot_id);
@@ -506,14 +646,20 @@ static void abort_td(struct usb_device *udev, int ep_index)
 		!= COMP_STOP)));
 	xhci_acknowledge_event(ctrl);
 
+stopped:
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
 	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
 		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
 		event->event_cmd.status)) != COMP_SUCCESS);
 	xhci_acknowledge_event(ctrl);
 
-	xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
-		ring->cycle_state), udev->slot_id, ep_index, TRB_SET_DEQ);
+	if (stream_id)
+		xhci_queue_set_deq(ctrl, udev->slot_id, ep_index, stream_id,
+				   ring);
+	else
+		xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
+			ring->cycle_state), udev->slot_id, ep_index,
+			TRB_SET_DEQ);
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
 	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
 		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
@@ -551,16 +697,43 @@ static void record_transfer_result(struct usb_device *udev,
 
 /**** Bulk and Control transfer methods ****/
 /**
- * Queues up the BULK Request
+ * Returns the number of TRBs of the TDs queued by xhci_bulk_submit() on a ring
+ *
+ * @param ctrl	Host controller data structure
+ * @param ring	transfer ring
+ * @return number of TRBs
+ */
+static int xhci_bulk_trbs_queued(struct xhci_ctrl *ctrl,
+				 struct xhci_ring *ring)
+{
+	struct xhci_bulk_td *td;
+	int num_trbs = 0;
+
+	list_for_each_entry(td, &ctrl->bulk_tds, node) {
+		if (td->ring == ring)
+			num_trbs += td->num_trbs;
+	}
+
+	return num_trbs;
+}
+
+/**
+ * Queues up the TRBs of a BULK Request and rings the doorbell, without
+ * waiting for the transfer.
  *
  * @param udev		pointer to the USB device structure
  * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param stream_id	stream of the endpoint, 0 if it has none
  * @param length	length of the buffer
  * @param buffer	buffer to be read/written based on the request
- * @return returns 0 if successful else -1 on failure
+ * @param td		TD to fill in, with its xfer set for xhci_bulk_submit()
+ *			or NULL for xhci_bulk_tx()
+ * @return returns 0 if successful, -EBUSY if the TDs queued on the ring
+ *	   leave no room for this one, else -ve on failure
  */
-int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-			int length, void *buffer)
+static int xhci_queue_bulk_td(struct usb_device *udev, unsigned long pipe,
+			      unsigned int stream_id, int length, void *buffer,
+			      struct xhci_bulk_td *td)
 {
 	int num_trbs = 0;
 	struct xhci_generic_trb *start_trb;
@@ -573,8 +746,9 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	int ep_index;
 	struct xhci_virt_device *virt_dev;
 	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_virt_ep *ep;
 	struct xhci_ring *ring;		/* EP transfer ring */
-	union xhci_trb *event;
+	int queued;
 
 	int running_total, trb_buff_len;
 	bool more_trbs_coming = true;
@@ -584,12 +758,10 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	u32 trb_fields[4];
 	u64 val_64 = xhci_virt_to_bus(ctrl, buffer);
 	void *last_transfer_trb_addr;
-	int available_length;
 
 	debug("dev=%p, pipe=%lx, buffer=%p, length=%d\n",
 		udev, pipe, buffer, length);
 
-	available_length = length;
 	ep_index = usb_pipe_ep_index(pipe);
 	virt_dev = ctrl->devs[slot_id];
 
@@ -598,7 +770,18 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 
 	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
 
-	ring = virt_dev->eps[ep_index].ring;
+	/* Once streams are set up, the endpoint ring is no longer used */
+	ep = &virt_dev->eps[ep_index];
+	if (stream_id) {
+		if (!(ep->ep_state & EP_HAS_STREAMS) ||
+		    stream_id >= ep->num_streams)
+			return -EINVAL;
+		ring = ep->stream_rings[stream_id];
+	} else {
+		if (ep->ep_state & EP_HAS_STREAMS)
+			return -EINVAL;
+		ring = ep->ring;
+	}
 	/*
 	 * How much data is (potentially) left before the 64KB boundary?
 	 * XHCI Spec puts restriction( TABLE 49 and 6.4.1 section of XHCI Spec)
@@ -623,6 +806,21 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		running_total += TRB_MAX_BUFF_SIZE;
 	}
 
+	/*
+	 * The ring holds TRBS_PER_SEGMENT - 1 TRBs besides its link TRB. A TD
+	 * waited for at once must not follow queued ones, whose events would
+	 * be taken for its own.
+	 */
+	queued = xhci_bulk_trbs_queued(ctrl, ring);
+	if (queued && (!td->xfer || queued + num_trbs > TRBS_PER_SEGMENT - 1))
+		return -EBUSY;
+
+	td->udev = udev;
+	td->ep_index = ep_index;
+	td->ring = ring;
+	td->num_trbs = num_trbs;
+	td->available = length;
+
 	/*
 	 * XXX: Calling routine prepare_ring() called in place of
 	 * prepare_trasfer() as there in 'Linux' since we are not
@@ -658,7 +856,8 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 
 	first_trb = true;
 
-	/* flush the buffer before use */
+	/* flush the buffer and the TRBs together, once they are all queued */
+	dcache_batch_start();
 	xhci_flush_cache((uintptr_t)buffer, length);
 
 	/* Queue the first TRB, even if it's zero-length */
@@ -714,21 +913,52 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_buff_len = min((length - running_total), TRB_MAX_BUFF_SIZE);
 	} while (running_total < length);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	dcache_batch_end();
+	td->last_trb = last_transfer_trb_addr;
+	giveback_first_trb(udev, ep_index, stream_id, start_cycle, start_trb);
+
+	return 0;
+}
+
+/**
+ * Queues up the BULK Request and waits for it
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param stream_id	stream of the endpoint, 0 if it has none
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * @return returns 0 if successful else -1 on failure
+ */
+int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
+		 unsigned int stream_id, int length, void *buffer)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_bulk_td td = { .xfer = NULL };
+	int slot_id = udev->slot_id;
+	int ep_index;
+	union xhci_trb *event;
+	u32 field;
+	int ret;
+
+	ret = xhci_queue_bulk_td(udev, pipe, stream_id, length, buffer, &td);
+	if (ret)
+		return ret;
+	ep_index = td.ep_index;
 
 again:
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event) {
 		debug("XHCI bulk transfer timed out, aborting...\n");
-		abort_td(udev, ep_index);
+		abort_td(udev, ep_index, stream_id);
 		udev->status = USB_ST_NAK_REC;  /* closest thing to a timeout */
 		udev->act_len = 0;
 		return -ETIMEDOUT;
 	}
 
 	if ((uintptr_t)(le64_to_cpu(event->trans_event.buffer)) !=
-	    (uintptr_t)xhci_virt_to_bus(ctrl, last_transfer_trb_addr)) {
-		available_length -=
+	    (uintptr_t)xhci_virt_to_bus(ctrl, td.last_trb)) {
+		td.available -=
 			(int)EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len));
 		xhci_acknowledge_event(ctrl);
 		goto again;
@@ -738,13 +968,185 @@ again:
 	BUG_ON(TRB_TO_SLOT_ID(field) != slot_id);
 	BUG_ON(TRB_TO_EP_INDEX(field) != ep_index);
 
-	record_transfer_result(udev, event, available_length);
+	record_transfer_result(udev, event, td.available);
 	xhci_acknowledge_event(ctrl);
 	xhci_inval_cache((uintptr_t)buffer, length);
 
 	return (udev->status != USB_ST_NOT_PROC) ? 0 : -1;
 }
 
+/**
+ * Handles the events pending on the event ring, completing the transfers of
+ * the TDs queued by xhci_bulk_submit(). Other events are skipped, as
+ * xhci_wait_for_event() would do.
+ *
+ * @param ctrl	Host controller data structure
+ * @return none
+ */
+static void xhci_poll_events(struct xhci_ctrl *ctrl)
+{
+	union xhci_trb *event;
+	trb_type type;
+
+	while (event_ready(ctrl)) {
+		event = ctrl->event_ring->dequeue;
+		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
+		if (type != TRB_TRANSFER || !xhci_bulk_td_event(ctrl, event))
+			debug("XHCI event TRB type %d skipped\n", type);
+		xhci_acknowledge_event(ctrl);
+	}
+}
+
+/**
+ * Waits for a command queued by xhci_queue_command() to complete
+ *
+ * @param ctrl	Host controller data structure
+ * @return completion code of the command
+ */
+static u32 xhci_wait_for_command(struct xhci_ctrl *ctrl)
+{
+	union xhci_trb *event;
+	u32 code;
+
+	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
+	code = GET_COMP_CODE(le32_to_cpu(event->event_cmd.status));
+	xhci_acknowledge_event(ctrl);
+
+	return code;
+}
+
+/**
+ * Queues up a BULK Request without waiting for it. Its transfer is completed
+ * by xhci_bulk_wait(), or while waiting for any other event.
+ *
+ * @param udev	pointer to the USB device structure
+ * @param xfer	transfer to queue
+ * @return returns 0 if successful, -EBUSY if the ring has no room left for
+ *	   the transfer, else -ve on failure
+ */
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_xfer *xfer)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_bulk_td *td;
+	int ret;
+
+	td = calloc(1, sizeof(*td));
+	if (!td)
+		return -ENOMEM;
+
+	td->xfer = xfer;
+	ret = xhci_queue_bulk_td(udev, xfer->pipe, xfer->stream_id,
+				 xfer->length, xfer->buffer, td);
+	if (ret) {
+		free(td);
+		return ret;
+	}
+	xfer->hcpriv = td;
+	list_add_tail(&td->node, &ctrl->bulk_tds);
+
+	return 0;
+}
+
+/**
+ * Completes the queued BULK Requests the xHC is done with, until a transfer
+ * completes or the time is up
+ *
+ * @param udev		pointer to the USB device structure
+ * @param xfer		transfer to wait for
+ * @param timeout	time to wait, in milliseconds
+ * @return 0
+ */
+int xhci_bulk_wait(struct usb_device *udev, struct usb_bulk_xfer *xfer,
+		   int timeout)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	ulong start = get_timer(0);
+
+	do {
+		xhci_poll_events(ctrl);
+		if (xfer->status != -EINPROGRESS)
+			break;
+	} while (get_timer(start) < timeout);
+
+	return 0;
+}
+
+/**
+ * Cancels the BULK Requests queued on the endpoint of a transfer. As in
+ * abort_td(), the endpoint is stopped and the xHC's dequeue pointers are set
+ * to our enqueue pointers; an endpoint halted by a stall is reset instead,
+ * which leaves it stopped as well. The transfers queued are unlinked and
+ * failed even if the xHC refuses a command, so that none of them is left
+ * behind for a caller which is about to return.
+ *
+ * @param udev	pointer to the USB device structure
+ * @param xfer	transfer giving the endpoint
+ * @return returns 0 if successful else -EIO
+ */
+int xhci_bulk_cancel(struct usb_device *udev, struct usb_bulk_xfer *xfer)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	int ep_index = usb_pipe_ep_index(xfer->pipe);
+	struct xhci_virt_ep *ep = &virt_dev->eps[ep_index];
+	struct xhci_bulk_td *td, *tmp;
+	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_ring *ring;
+	unsigned int i;
+	int ret = 0;
+	u32 state;
+	u32 code;
+
+	/* The stop event of the TD in progress is handled while waiting */
+	xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index, TRB_STOP_RING);
+	code = xhci_wait_for_command(ctrl);
+	if (code == COMP_CTX_STATE) {
+		xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
+				 virt_dev->out_ctx->size);
+		ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
+		state = le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK;
+		if (state == EP_STATE_HALTED) {
+			xhci_queue_command(ctrl, NULL, udev->slot_id, ep_index,
+					   TRB_RESET_EP);
+			code = xhci_wait_for_command(ctrl);
+		} else if (state == EP_STATE_STOPPED) {
+			code = COMP_SUCCESS;
+		}
+	}
+	if (code != COMP_SUCCESS) {
+		ret = -EIO;
+		goto unlink;
+	}
+
+	if (ep->ep_state & EP_HAS_STREAMS) {
+		for (i = 1; i < ep->num_streams; i++) {
+			xhci_queue_set_deq(ctrl, udev->slot_id, ep_index, i,
+					   ep->stream_rings[i]);
+			if (xhci_wait_for_command(ctrl) != COMP_SUCCESS)
+				ret = -EIO;
+		}
+	} else {
+		ring = ep->ring;
+		xhci_queue_command(ctrl, (void *)((uintptr_t)ring->enqueue |
+				   ring->cycle_state), udev->slot_id, ep_index,
+				   TRB_SET_DEQ);
+		if (xhci_wait_for_command(ctrl) != COMP_SUCCESS)
+			ret = -EIO;
+	}
+
+unlink:
+	list_for_each_entry_safe(td, tmp, &ctrl->bulk_tds, node) {
+		if (td->udev != udev || td->ep_index != ep_index)
+			continue;
+		td->xfer->status = ret ? ret : -ECONNRESET;
+		td->xfer->hcpriv = NULL;
+		list_del(&td->node);
+		free(td);
+	}
+
+	return ret;
+}
+
 /**
  * Queues up the Control Transfer Request
  *
@@ -832,6 +1234,9 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 	debug("start_trb %p, start_cycle %d\n", start_trb, start_cycle);
 
+	/* flush the TRBs and the buffer together, once they are all queued */
+	dcache_batch_start();
+
 	/* Queue setup TRB - see section 6.4.1.2.1 */
 	/* FIXME better way to translate setup_packet into two u32 fields? */
 	field = 0;
@@ -919,7 +1324,8 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 	queue_trb(ctrl, ep_ring, false, trb_fields);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	dcache_batch_end();
+	giveback_first_trb(udev, ep_index, 0, start_cycle, start_trb);
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event)
@@ -951,7 +1357,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 abort:
 	debug("XHCI control transfer timed out, aborting...\n");
-	abort_td(udev, ep_index);
+	abort_td(udev, ep_index, 0);
 	udev->status = USB_ST_NAK_REC;
 	udev->act_len = 0;
 	return -ETIMEDOUT;
@@ -36,6 +36,7 @@
 #include <linux/delay.h>
 #include <linux/errno.h>
 #include <linux/iopoll.h>
+#include <linux/log2.h>
 
 #ifndef CONFIG_USB_MAX_CONTROLLER_COUNT
 #define CONFIG_USB_MAX_CONTROLLER_COUNT 1
@@ -1164,7 +1165,7 @@ static int _xhci_submit_int_msg(struct usb_device *udev, unsigned long pipe,
 	 * (at most) one TD. A TD (comprised of sg list entries) can
 	 * take several service intervals to transmit.
 	 */
-	return xhci_bulk_tx(udev, pipe, length, buffer);
+	return xhci_bulk_tx(udev, pipe, 0, length, buffer);
 }
 
 /**
@@ -1184,7 +1185,7 @@ static int _xhci_submit_bulk_msg(struct usb_device *udev, unsigned long pipe,
 		return -EINVAL;
 	}
 
-	return xhci_bulk_tx(udev, pipe, length, buffer);
+	return xhci_bulk_tx(udev, pipe, 0, length, buffer);
 }
 
 /**
@@ -1427,6 +1428,49 @@ static int xhci_submit_bulk_msg(struct udevice *dev, struct usb_device *udev,
 	return _xhci_submit_bulk_msg(udev, pipe, buffer, length);
 }
 
+static int xhci_submit_bulk_stream_msg(struct udevice *dev,
+				       struct usb_device *udev,
+				       unsigned long pipe,
+				       unsigned int stream_id, void *buffer,
+				       int length)
+{
+	debug("%s: dev='%s', udev=%p, stream %u\n", __func__, dev->name,
+	      udev, stream_id);
+	if (usb_pipetype(pipe) != PIPE_BULK) {
+		printf("non-bulk pipe (type=%lu)", usb_pipetype(pipe));
+		return -EINVAL;
+	}
+
+	return xhci_bulk_tx(udev, pipe, stream_id, length, buffer);
+}
+
+static int xhci_submit_bulk_async(struct udevice *dev,
+				  struct usb_device *udev,
+				  struct usb_bulk_xfer *xfer)
+{
+	debug("%s: dev='%s', udev=%p\n", __func__, dev->name, udev);
+	if (usb_pipetype(xfer->pipe) != PIPE_BULK) {
+		printf("non-bulk pipe (type=%lu)", usb_pipetype(xfer->pipe));
+		return -EINVAL;
+	}
+
+	return xhci_bulk_submit(udev, xfer);
+}
+
+static int xhci_wait_bulk_async(struct udevice *dev, struct usb_device *udev,
+				struct usb_bulk_xfer *xfer, int timeout)
+{
+	return xhci_bulk_wait(udev, xfer, timeout);
+}
+
+static int xhci_cancel_bulk_async(struct udevice *dev,
+				  struct usb_device *udev,
+				  struct usb_bulk_xfer *xfer)
+{
+	debug("%s: dev='%s', udev=%p\n", __func__, dev->name, udev);
+	return xhci_bulk_cancel(udev, xfer);
+}
+
 static int xhci_submit_int_msg(struct udevice *dev, struct usb_device *udev,
 			       unsigned long pipe, void *buffer, int length,
 			       int interval, bool nonblock)
@@ -1522,6 +1566,89 @@ static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
 	return 0;
 }
 
+/*
+ * Give bulk endpoints a linear stream context array and a ring per stream,
+ * with one Configure Endpoint command dropping and adding them again. See
+ * section 4.12.2 of the XHCI spec.
+ */
+static int xhci_alloc_streams(struct udevice *dev, struct usb_device *udev,
+			      unsigned long *pipes, int num_pipes,
+			      unsigned int num_streams)
+{
+	struct xhci_ctrl *ctrl = dev_get_priv(dev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_input_control_ctx *ctrl_ctx;
+	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_virt_ep *ep;
+	u32 hcc_params = xhci_readl(&ctrl->hccr->cr_hccparams);
+	u32 ep_flags = 0;
+	unsigned int max;
+	int ep_index;
+	int ret;
+	int i;
+
+	if (!HCC_STREAMS(hcc_params) || udev->speed < USB_SPEED_SUPER)
+		return -EOPNOTSUPP;
+
+	/* Stream 0 is reserved, and the array size is a power of two */
+	max = min_t(unsigned int, HCC_MAX_PSA(hcc_params), XHCI_MAX_STREAMS);
+	num_streams = min_t(unsigned int, roundup_pow_of_two(num_streams + 1),
+			    max);
+	if (num_streams < 2)
+		return -EINVAL;
+
+	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+
+	for (i = 0; i < num_pipes; i++) {
+		if (usb_pipetype(pipes[i]) != PIPE_BULK)
+			return -EINVAL;
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		if (virt_dev->eps[ep_index].ep_state & EP_HAS_STREAMS)
+			return -EBUSY;
+		ep_flags |= 1 << (ep_index + 1);
+	}
+
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		ep = &virt_dev->eps[ep_index];
+		xhci_alloc_stream_info(ctrl, ep, num_streams);
+
+		xhci_endpoint_copy(ctrl, virt_dev->in_ctx, virt_dev->out_ctx,
+				   ep_index);
+		ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->in_ctx, ep_index);
+		ep_ctx->ep_info &= cpu_to_le32(~(EP_MAXPSTREAMS_MASK |
+						 EP_STATE_MASK));
+		ep_ctx->ep_info |= cpu_to_le32(EP_MAXPSTREAMS(ilog2(num_streams)
+							      - 1) |
+					       EP_HAS_LSA);
+		ep_ctx->deq = cpu_to_le64(xhci_virt_to_bus(ctrl,
+							   ep->stream_ctx));
+	}
+
+	ctrl_ctx = xhci_get_input_control_ctx(virt_dev->in_ctx);
+	ctrl_ctx->drop_flags = cpu_to_le32(ep_flags);
+	ctrl_ctx->add_flags = cpu_to_le32(ep_flags | SLOT_FLAG);
+	xhci_slot_copy(ctrl, virt_dev->in_ctx, virt_dev->out_ctx);
+
+	ret = xhci_configure_endpoints(udev, false);
+
+	/* Leave the input context as xhci_set_configuration() expects it */
+	ctrl_ctx->drop_flags = 0;
+
+	for (i = 0; i < num_pipes; i++) {
+		ep = &virt_dev->eps[usb_pipe_ep_index(pipes[i])];
+		if (ret)
+			xhci_free_stream_info(ep);
+		else
+			ep->ep_state |= EP_HAS_STREAMS;
+	}
+	if (ret)
+		return ret;
+
+	return num_streams - 1;
+}
+
 int xhci_register(struct udevice *dev, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor)
 {
@@ -1576,10 +1703,15 @@ int xhci_deregister(struct udevice *dev)
 struct dm_usb_ops xhci_usb_ops = {
 	.control = xhci_submit_control_msg,
 	.bulk = xhci_submit_bulk_msg,
+	.bulk_stream = xhci_submit_bulk_stream_msg,
 	.interrupt = xhci_submit_int_msg,
 	.alloc_device = xhci_alloc_device,
 	.update_hub_device = xhci_update_hub_device,
 	.get_max_xfer_size  = xhci_get_max_xfer_size,
+	.alloc_streams = xhci_alloc_streams,
+	.bulk_submit = xhci_submit_bulk_async,
+	.bulk_wait = xhci_wait_bulk_async,
+	.bulk_cancel = xhci_cancel_bulk_async,
 };
 
 #endif
@@ -19,6 +19,7 @@
 #include <part.h>
 #include <search.h>
 #include <errno.h>
+#include <u-boot/crc.h>
 #ifdef CONFIG_MMC_SDRV
 #include <emmc_partitions.h>
 #endif
@@ -29,7 +30,8 @@
 DECLARE_GLOBAL_DATA_PTR;
 
 #if CONFIG_IS_ENABLED(OF_CONTROL)
-static inline int mmc_offset_try_partition(const char *str, int copy, s64 *val)
+static inline int mmc_offset_try_partition(const char *str, int copy, s64 *val,
+					   s64 *end)
 {
 	struct disk_partition info;
 	struct blk_desc *desc;
@@ -55,6 +57,8 @@ static inline int mmc_offset_try_partition(const char *str, int copy, s64 *val)
 
 	/* use the top of the partion for the environment */
 	*val = (info.start + info.size - (1 + copy) * len) * info.blksz;
+	if (end)
+		*end = (info.start + info.size) * info.blksz;
 
 	return 0;
 }
@@ -79,7 +83,7 @@ static inline s64 mmc_offset(int copy)
 	str = fdtdec_get_config_string(gd->fdt_blob, dt_prop.partition);
 	if (str) {
 		/* try to place the environment at end of the partition */
-		err = mmc_offset_try_partition(str, copy, &val);
+		err = mmc_offset_try_partition(str, copy, &val, NULL);
 		if (!err)
 			return val;
 	}
@@ -95,6 +99,19 @@ static inline s64 mmc_offset(int copy)
 #endif
 	return fdtdec_get_config_int(gd->fdt_blob, propname, defvalue);
 }
+
+static inline s64 mmc_end(struct mmc *mmc, int copy)
+{
+	s64 val, end;
+	const char *str;
+
+	str = fdtdec_get_config_string(gd->fdt_blob,
+				       "u-boot,mmc-env-partition");
+	if (str && !mmc_offset_try_partition(str, copy, &val, &end))
+		return end;
+
+	return mmc->capacity;
+}
 #else
 static inline s64 mmc_offset(int copy)
 {
@@ -106,6 +123,11 @@ static inline s64 mmc_offset(int copy)
 #endif
 	return offset;
 }
+
+static inline s64 mmc_end(struct mmc *mmc, int copy)
+{
+	return mmc->capacity;
+}
 #endif
 
 __weak int mmc_get_env_addr(struct mmc *mmc, int copy, u32 *env_addr)
@@ -120,6 +142,13 @@ __weak int mmc_get_env_addr(struct mmc *mmc, int copy, u32 *env_addr)
 	return 0;
 }
 
+__weak int mmc_get_env_end(struct mmc *mmc, int copy, u64 *env_end)
+{
+	*env_end = mmc_end(mmc, copy);
+
+	return 0;
+}
+
 #ifdef CONFIG_SYS_MMC_ENV_PART
 __weak uint mmc_get_env_part(struct mmc *mmc)
 {
@@ -174,6 +203,55 @@ static void fini_mmc_for_env(struct mmc *mmc)
 #endif
 }
 
+#ifdef CONFIG_ENV_MMC_JOURNAL
+#define ENV_JOURNAL_MAGIC	0x4a564e45	/* "ENVJ" */
+
+/*
+ * A journal record holds the variables changed by one "saveenv", in the same
+ * "name=value\0...\0" form as the environment itself; a bare "name" deletes
+ * the variable. Each record starts on a block boundary.
+ */
+struct env_jrec {
+	u32 magic;
+	u32 base_crc;	/* CRC of the environment the record applies to */
+	u32 seq;	/* Position of the record in the journal */
+	u32 len;	/* Length of data[] */
+	u32 crc;	/* CRC32 of data[] */
+	char data[];
+};
+
+/* Journal state, found by env_mmc_load() and updated by env_mmc_save() */
+static struct {
+	u32 base_crc;
+	u32 seq;	/* Number of records in the journal */
+	u32 size;	/* Size of the journal, as far as there is room for it */
+	u32 next;	/* Offset of the first free block in the journal */
+	char *synced;	/* Exported environment as stored, NULL if unknown */
+} env_jr;
+
+static inline u32 env_journal_offset(u32 env_offset)
+{
+	return env_offset + CONFIG_ENV_SIZE;
+}
+
+/*
+ * The journal takes up to CONFIG_ENV_MMC_JOURNAL_SIZE bytes, but never runs
+ * past the end of the area holding the environment, e.g. its partition.
+ */
+static u32 env_journal_size(struct mmc *mmc, u32 env_offset)
+{
+	uint blksz = mmc_get_blk_desc(mmc)->blksz;
+	u64 start = env_journal_offset(env_offset);
+	u64 end;
+
+	if (mmc_get_env_end(mmc, 0, &end) || end <= start)
+		return 0;
+
+	return rounddown(min_t(u64, end - start, CONFIG_ENV_MMC_JOURNAL_SIZE),
+			 blksz);
+}
+#endif
+
 #if defined(CONFIG_CMD_SAVEENV) && !defined(CONFIG_SPL_BUILD)
 static inline int write_env(struct mmc *mmc, unsigned long size,
 			    unsigned long offset, const void *buffer)
@@ -189,6 +267,217 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 	return (n == blk_cnt) ? 0 : -1;
 }
 
+#ifdef CONFIG_ENV_MMC_JOURNAL
+/* Remember the environment as now stored on the MMC */
+static void env_journal_sync(void)
+{
+	char *res;
+
+	if (!env_jr.synced) {
+		env_jr.synced = malloc(ENV_SIZE);
+		if (!env_jr.synced)
+			return;
+	}
+
+	res = env_jr.synced;
+	if (hexport_r(&env_htab, '\0', 0, &res, ENV_SIZE, 0, NULL) < 0) {
+		free(env_jr.synced);
+		env_jr.synced = NULL;
+	}
+}
+
+/* Compare the variable names at @a and @b, each ended by '=' or '\0' */
+static int env_journal_cmpkey(const char *a, const char *b)
+{
+	uchar ca, cb;
+
+	do {
+		ca = *a == '=' ? '\0' : *a;
+		cb = *b == '=' ? '\0' : *b;
+		a++;
+		b++;
+	} while (ca && ca == cb);
+
+	return ca - cb;
+}
+
+/**
+ * env_journal_diff() - Collect the differences between two exports
+ *
+ * Both exports are sorted by name, so a single pass over them finds all
+ * variables which were added, changed or deleted.
+ *
+ * @old:	Environment as stored
+ * @new:	Current environment
+ * @out:	Returns the data for a journal record
+ * @size:	Size of @out
+ * @return length of the data in @out, 0 if there are no differences, or
+ *	-ENOSPC if it does not fit in @size bytes
+ */
+static int env_journal_diff(const char *old, const char *new, char *out,
+			    int size)
+{
+	int len = 0;
+
+	while (*old || *new) {
+		const char *add = NULL;
+		int cmp, n;
+
+		if (!*old)
+			cmp = 1;
+		else if (!*new)
+			cmp = -1;
+		else
+			cmp = env_journal_cmpkey(old, new);
+
+		if (cmp < 0) {
+			/* Deleted, so record just the name */
+			n = strchrnul(old, '=') - old;
+			if (len + n + 1 > size)
+				return -ENOSPC;
+			memcpy(out + len, old, n);
+			out[len + n] = '\0';
+			len += n + 1;
+			old += strlen(old) + 1;
+			continue;
+		}
+		if (cmp > 0 || strcmp(old, new))
+			add = new;
+		if (!cmp)
+			old += strlen(old) + 1;
+		n = strlen(new) + 1;
+		if (add) {
+			if (len + n > size)
+				return -ENOSPC;
+			memcpy(out + len, add, n);
+			len += n;
+		}
+		new += n;
+	}
+
+	return len;
+}
+
+/**
+ * env_journal_append() - Write the changed variables as a journal record
+ *
+ * @mmc:	MMC device
+ * @env_offset:	Offset of the environment on @mmc
+ * @return 0 if OK, -ENOSPC if the whole environment must be written instead,
+ *	other -ve on error
+ */
+static int env_journal_append(struct mmc *mmc, u32 env_offset)
+{
+	uint blksz = mmc_get_blk_desc(mmc)->blksz;
+	struct env_jrec *rec;
+	u32 space, size;
+	char *new, *res;
+	int len, ret;
+
+	if (!env_jr.synced)
+		return -ENOSPC;
+	space = env_jr.size - env_jr.next;
+	if (space < blksz)
+		return -ENOSPC;
+
+	new = malloc(ENV_SIZE);
+	rec = malloc_cache_aligned(space);
+	if (!new || !rec) {
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	res = new;
+	if (hexport_r(&env_htab, '\0', 0, &res, ENV_SIZE, 0, NULL) < 0) {
+		ret = -ENOSPC;
+		goto out;
+	}
+	len = env_journal_diff(env_jr.synced, new, rec->data,
+			       space - sizeof(*rec));
+	if (len <= 0) {
+		if (!len)
+			printf("No changes to write to MMC(%d)... ",
+			       mmc_get_env_dev());
+		ret = len;
+		goto out;
+	}
+
+	rec->magic = ENV_JOURNAL_MAGIC;
+	rec->base_crc = env_jr.base_crc;
+	rec->seq = env_jr.seq;
+	rec->len = len;
+	rec->crc = crc32(0, (uchar *)rec->data, len);
+	size = ALIGN(sizeof(*rec) + len, blksz);
+	memset(rec->data + len, '\0', size - sizeof(*rec) - len);
+
+	printf("Writing journal record %u to MMC(%d)... ", rec->seq,
+	       mmc_get_env_dev());
+	if (write_env(mmc, size, env_journal_offset(env_offset) + env_jr.next,
+		      rec)) {
+		puts("failed\n");
+		ret = -EIO;
+		goto out;
+	}
+	env_jr.seq++;
+	env_jr.next += size;
+	swap(env_jr.synced, new);
+	ret = 0;
+out:
+	free(rec);
+	free(new);
+
+	return ret;
+}
+
+/**
+ * env_journal_reset() - Clear the journal after writing the environment
+ *
+ * Only the part of the journal known to be in use is cleared, or all of it
+ * if that is not known. The size of the journal is found again, as the
+ * environment may have been written because it was not known either.
+ *
+ * @mmc:	MMC device
+ * @env_offset:	Offset of the environment on @mmc
+ * @env:	Environment just written
+ */
+static void env_journal_reset(struct mmc *mmc, u32 env_offset,
+			      const env_t *env)
+{
+	void *zero = NULL;
+	int ret = 0;
+	u32 size;
+
+	env_jr.size = env_journal_size(mmc, env_offset);
+	size = env_jr.synced ? env_jr.next : env_jr.size;
+
+	/*
+	 * Records left behind no longer match the CRC of the environment, so
+	 * this is only needed in the unlikely case of the new environment
+	 * having the same CRC as the old one
+	 */
+	if (size) {
+		zero = malloc_cache_aligned(size);
+		ret = -ENOMEM;
+	}
+	if (zero) {
+		memset(zero, '\0', size);
+		ret = write_env(mmc, size, env_journal_offset(env_offset),
+				zero);
+		free(zero);
+	}
+	if (ret)
+		puts("cannot clear journal... ");
+
+	env_jr.base_crc = env->crc;
+	env_jr.seq = 0;
+	env_jr.next = 0;
+	if (!env_jr.synced)
+		env_jr.synced = malloc(ENV_SIZE);
+	if (env_jr.synced)
+		memcpy(env_jr.synced, env->data, ENV_SIZE);
+}
+#endif
+
 static int env_mmc_save(void)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(env_t, env_new, 1);
@@ -204,6 +493,18 @@ static int env_mmc_save(void)
 		return 1;
 	}
 
+#ifdef CONFIG_ENV_MMC_JOURNAL
+	if (mmc_get_env_addr(mmc, 0, &offset)) {
+		ret = 1;
+		goto fini;
+	}
+	ret = env_journal_append(mmc, offset);
+	if (ret != -ENOSPC) {
+		ret = ret ? 1 : 0;
+		goto fini;
+	}
+#endif
+
 	ret = env_export(env_new);
 	if (ret)
 		goto fini;
@@ -230,6 +531,9 @@ static int env_mmc_save(void)
 #ifdef CONFIG_ENV_OFFSET_REDUND
 	gd->env_valid = gd->env_valid == ENV_REDUND ? ENV_VALID : ENV_REDUND;
 #endif
+#ifdef CONFIG_ENV_MMC_JOURNAL
+	env_journal_reset(mmc, offset, env_new);
+#endif
 
 fini:
 	fini_mmc_for_env(mmc);
@@ -258,6 +562,9 @@ static int env_mmc_erase(void)
 	struct mmc *mmc = find_mmc_device(dev);
 	int	ret, copy = 0;
 	u32	offset;
+#ifdef CONFIG_ENV_MMC_JOURNAL
+	u32	size;
+#endif
 	const char *errmsg;
 
 	errmsg = init_mmc_for_env(mmc);
@@ -271,6 +578,14 @@ static int env_mmc_erase(void)
 
 	ret = erase_env(mmc, CONFIG_ENV_SIZE, offset);
 
+#ifdef CONFIG_ENV_MMC_JOURNAL
+	size = env_journal_size(mmc, offset);
+	if (size)
+		ret |= erase_env(mmc, size, env_journal_offset(offset));
+	free(env_jr.synced);
+	env_jr.synced = NULL;
+#endif
+
 #ifdef CONFIG_ENV_OFFSET_REDUND
 	copy = 1;
 
@@ -283,6 +598,8 @@ static int env_mmc_erase(void)
 	return ret;
 }
 #endif /* CONFIG_CMD_ERASEENV */
+#elif defined(CONFIG_ENV_MMC_JOURNAL)
+static inline void env_journal_sync(void) {}
 #endif /* CONFIG_CMD_SAVEENV && !CONFIG_SPL_BUILD */
 
 static inline int read_env(struct mmc *mmc, unsigned long size,
@@ -299,6 +616,67 @@ static inline int read_env(struct mmc *mmc, unsigned long size,
 	return (n == blk_cnt) ? 0 : -1;
 }
 
+#ifdef CONFIG_ENV_MMC_JOURNAL
+/**
+ * env_journal_replay() - Apply the journal to the environment just imported
+ *
+ * Records are applied in order until one is missing, torn or belongs to an
+ * earlier copy of the environment.
+ *
+ * @mmc:	MMC device
+ * @env_offset:	Offset of the environment on @mmc
+ * @ep:		Environment as read from @mmc
+ * @return number of records applied, or -ve on error
+ */
+static int env_journal_replay(struct mmc *mmc, u32 env_offset,
+			      const env_t *ep)
+{
+	uint blksz = mmc_get_blk_desc(mmc)->blksz;
+	u32 pos = 0;
+	char *buf;
+
+	memcpy(&env_jr.base_crc, &ep->crc, sizeof(env_jr.base_crc));
+	env_jr.size = env_journal_size(mmc, env_offset);
+	env_jr.seq = 0;
+	env_jr.next = 0;
+	if (!env_jr.size)
+		return 0;
+
+	buf = malloc_cache_aligned(env_jr.size);
+	if (!buf)
+		return -ENOMEM;
+	if (read_env(mmc, env_jr.size, env_journal_offset(env_offset), buf)) {
+		free(buf);
+		return -EIO;
+	}
+
+	while (pos + sizeof(struct env_jrec) <= env_jr.size) {
+		struct env_jrec *rec = (struct env_jrec *)(buf + pos);
+
+		if (rec->magic != ENV_JOURNAL_MAGIC ||
+		    rec->base_crc != env_jr.base_crc ||
+		    rec->seq != env_jr.seq ||
+		    rec->len > env_jr.size - pos - sizeof(*rec) ||
+		    crc32(0, (uchar *)rec->data, rec->len) != rec->crc)
+			break;
+		if (!himport_r(&env_htab, rec->data, rec->len, '\0',
+			       H_NOCLEAR | H_EXTERNAL, 0, 0, NULL)) {
+			pr_err("Cannot apply journal record %u: errno = %d\n",
+			       rec->seq, errno);
+			break;
+		}
+		env_jr.seq++;
+		pos += ALIGN(sizeof(*rec) + rec->len, blksz);
+	}
+	env_jr.next = pos;
+	free(buf);
+	debug("%s: %u journal records, next at %#x\n", __func__, env_jr.seq,
+	      env_jr.next);
+
+	return env_jr.seq;
+}
+#endif
+
 #ifdef CONFIG_MMC_SDRV
 static int env_mmc_modify(void)
 {
@@ -448,6 +826,10 @@ static int env_mmc_load(void)
 	if (!ret) {
 		ep = (env_t *)buf;
 		gd->env_addr = (ulong)&ep->data;
+#ifdef CONFIG_ENV_MMC_JOURNAL
+		if (env_journal_replay(mmc, offset, ep) >= 0)
+			env_journal_sync();
+#endif
 	}
 
 fini:
@@ -421,6 +421,12 @@ struct global_data {
 	 */
 	struct bloblist_hdr *new_bloblist;
 #endif
+#ifdef CONFIG_IOBUF
+	/**
+	 * @iobuf_base: start of the region reserved for the I/O buffer pool
+	 */
+	unsigned long iobuf_base;
+#endif
 #if CONFIG_IS_ENABLED(HANDOFF)
 	/**
 	 * @spl_handoff: SPL hand-off information
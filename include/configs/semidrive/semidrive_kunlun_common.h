@@ -47,6 +47,9 @@
 #define CONFIG_SYS_MALLOC_LEN		(32 << 20)
 #define CONFIG_SYS_CBSIZE		1024
 
+/* Frames taken from the ethernet receive ring in one poll */
+#define CONFIG_SYS_RX_ETH_BUFFER	64
+
 #define CONFIG_ARMV8_SWITCH_TO_EL1
 
 #ifdef CONFIG_TARGET_D9LITE_REF
@@ -69,6 +69,32 @@ void invalidate_dcache_range(unsigned long start, unsigned long stop);
 void invalidate_dcache_all(void);
 void invalidate_icache_all(void);
 
+#if IS_ENABLED(CONFIG_ARMV8_DCACHE_RANGES) && !CONFIG_IS_ENABLED(SYS_DCACHE_OFF)
+/* arch/arm/cpu/armv8/cache_v8.c */
+void dcache_batch_start(void);
+void dcache_batch_end(void);
+void dcache_mark_dirty(ulong start, ulong size);
+void dcache_disable_dirty(ulong stack_top);
+#else
+static inline void dcache_batch_start(void)
+{
+}
+
+static inline void dcache_batch_end(void)
+{
+}
+
+static inline void dcache_mark_dirty(ulong start, ulong size)
+{
+}
+
+static inline void dcache_disable_dirty(ulong stack_top)
+{
+	dcache_disable();
+	invalidate_dcache_all();
+}
+#endif
+
 enum {
 	/* Disable caches (else flush caches but leave them active) */
 	CBL_DISABLE_CACHES		= 1 << 0,
@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Arena allocation of driver-model devices
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef _DM_ARENA_H
+#define _DM_ARENA_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+struct driver;
+struct uclass;
+struct udevice;
+
+/**
+ * enum dm_arena_part - data areas kept with a device in its arena bundle
+ *
+ * These are the areas which driver model allocates for a device, in the
+ * order they are laid out after the struct udevice.
+ */
+enum dm_arena_part {
+	DM_ARENA_PLAT,
+	DM_ARENA_UCLASS_PLAT,
+	DM_ARENA_PARENT_PLAT,
+	DM_ARENA_PRIV,
+	DM_ARENA_UCLASS_PRIV,
+	DM_ARENA_PARENT_PRIV,
+
+	DM_ARENA_PART_COUNT,
+};
+
+/**
+ * struct dm_arena - arena holding the devices of a uclass
+ *
+ * With CONFIG_DM_ARENA each device is allocated as a single bundle holding
+ * the struct udevice followed by its plat and priv areas. The bundles of a
+ * uclass are carved out of larger chunks, so they avoid the per-allocation
+ * overhead of malloc() and sit next to each other in memory.
+ *
+ * @chunks: Most recently allocated chunk; each chunk starts with a pointer to
+ *	the previous one
+ * @cur: Next free byte in the newest chunk
+ * @end: End of the newest chunk
+ * @free_head: Bundles of unbound devices, which are reused by later binds
+ * @chunk_bytes: Total size of the chunks in bytes
+ * @used_bytes: Total size of the bundles of bound devices in bytes
+ * @count: Number of bound devices
+ */
+struct dm_arena {
+	void *chunks;
+	char *cur;
+	char *end;
+	struct list_head free_head;
+	ulong chunk_bytes;
+	ulong used_bytes;
+	uint count;
+};
+
+/**
+ * dm_arena_alloc_dev() - allocate a device bundle
+ *
+ * This allocates a zeroed struct udevice and reserves space after it for
+ * each of the data areas that driver model allocates for the device. Priv
+ * areas which need DMA-aligned memory are left to alloc_priv(). The device
+ * gets DM_FLAG_ARENA.
+ *
+ * @uc: Uclass of the device
+ * @drv: Driver of the device
+ * @parent: Parent of the device, or NULL for the root
+ * @alloc_plat: true if plat must be allocated for the device
+ * @return new device, or NULL if out of memory
+ */
+struct udevice *dm_arena_alloc_dev(struct uclass *uc, const struct driver *drv,
+				   struct udevice *parent, bool alloc_plat);
+
+/**
+ * dm_arena_dev_size() - get the number of bytes used by a device bundle
+ *
+ * @dev: Device to check
+ * @return size of its bundle in bytes, or 0 if it is not an arena device
+ */
+uint dm_arena_dev_size(const struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(DM_ARENA)
+/**
+ * dm_arena_init() - set up the arena of a new uclass
+ *
+ * @uc: Uclass to set up
+ */
+void dm_arena_init(struct uclass *uc);
+
+/**
+ * dm_arena_uninit() - free the memory of a uclass arena
+ *
+ * All devices in the uclass must have been unbound first.
+ *
+ * @uc: Uclass being destroyed
+ */
+void dm_arena_uninit(struct uclass *uc);
+
+/**
+ * dm_arena_free_dev() - free a device
+ *
+ * The bundle of an arena device is kept for reuse by a later bind in the
+ * same uclass. Other devices are passed to free().
+ *
+ * @dev: Device to free, which must not be used afterwards
+ */
+void dm_arena_free_dev(struct udevice *dev);
+
+/**
+ * dm_arena_get() - get space for a data area from a device bundle
+ *
+ * @dev: Device to check
+ * @part: Data area required
+ * @size: Size of the area in bytes
+ * @return zeroed space, or NULL if none is reserved in the bundle
+ */
+void *dm_arena_get(struct udevice *dev, enum dm_arena_part part, int size);
+
+/**
+ * dm_arena_free() - free a data area of a device
+ *
+ * Space in the bundle of the device is just left for reuse. Anything else is
+ * passed to free().
+ *
+ * @dev: Device which owns the area
+ * @ptr: Pointer to the area
+ */
+void dm_arena_free(struct udevice *dev, void *ptr);
+#else
+static inline void dm_arena_init(struct uclass *uc)
+{
+}
+
+static inline void dm_arena_uninit(struct uclass *uc)
+{
+}
+
+static inline void *dm_arena_get(struct udevice *dev,
+				 enum dm_arena_part part, int size)
+{
+	return NULL;
+}
+
+#define dm_arena_free_dev(dev)		free(dev)
+#define dm_arena_free(dev, ptr)		free(ptr)
+#endif
+
+#endif
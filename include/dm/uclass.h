@@ -9,6 +9,7 @@
 #ifndef _DM_UCLASS_H
 #define _DM_UCLASS_H
 
+#include <dm/arena.h>
 #include <dm/ofnode.h>
 #include <dm/uclass-id.h>
 #include <linker_lists.h>
@@ -30,12 +31,16 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @arena: Memory for the devices in this uclass (with CONFIG_DM_ARENA)
  */
 struct uclass {
 	void *priv_;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#if CONFIG_IS_ENABLED(DM_ARENA)
+	struct dm_arena arena;
+#endif
 };
 
 struct driver;
@@ -42,6 +42,15 @@ static inline void dm_dump_devres(void)
 /* Dump out a list of drivers */
 void dm_dump_drivers(void);
 
+#if CONFIG_IS_ENABLED(DM_ARENA)
+/* Dump out the memory used by the devices of each uclass and driver */
+void dm_dump_mem(void);
+#else
+static inline void dm_dump_mem(void)
+{
+}
+#endif
+
 /* Dump out a list with each driver's compatibility strings */
 void dm_dump_driver_compat(void);
 
@@ -44,6 +44,9 @@ enum {
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_BOOTBUS)
 	FASTBOOT_COMMAND_OEM_BOOTBUS,
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+	FASTBOOT_COMMAND_OEM_STREAM,
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 	FASTBOOT_COMMAND_ACMD,
 	FASTBOOT_COMMAND_UCMD,
@@ -150,6 +153,32 @@ int fastboot_handle_command(char *cmd_string, char *response);
  */
 u32 fastboot_data_remaining(void);
 
+/**
+ * fastboot_data_dest() - Return where received data belongs
+ *
+ * Transports which can receive straight into the download buffer use this
+ * with fastboot_data_received() instead of fastboot_data_download(). While
+ * streaming, the buffer is a ring and only has room for data up to its size
+ * after the data received so far.
+ *
+ * @offset: Offset of the data from the start of the download
+ * @len: Length of the data, reduced to the room there is at that place
+ *
+ * Return: Pointer into the download buffer, or NULL if there is no room
+ */
+void *fastboot_data_dest(u32 offset, u32 *len);
+
+/**
+ * fastboot_data_received() - Account for data placed in the download buffer
+ *
+ * @fastboot_data_len: Length of the data received after the previous data
+ * @response: Pointer to fastboot response buffer
+ *
+ * The data must already be where fastboot_data_dest() said for it. Writes to
+ * response if the length is invalid or, while streaming, writing it failed.
+ */
+void fastboot_data_received(unsigned int fastboot_data_len, char *response);
+
 /**
  * fastboot_data_download() - Copy image data to fastboot_buf_addr.
  *
@@ -170,6 +199,8 @@ void fastboot_data_download(const void *fastboot_data,
  * @response: Pointer to fastboot response buffer
  *
  * Set image_size and ${filesize} to the total size of the downloaded image.
+ * The OKAY response reports the throughput of the download, which is also
+ * printed on the console.
  */
 void fastboot_data_complete(char *response);
 
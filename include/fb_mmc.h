@@ -39,4 +39,39 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_mmc_erase(const char *cmd, char *response);
+
+/**
+ * fastboot_mmc_stream_start() - Prepare to write a partition as it arrives
+ *
+ * The image may be sparse or raw, and is written by the following calls to
+ * fastboot_mmc_stream_write().
+ *
+ * @cmd: Named partition to write image to
+ * @response: Pointer to fastboot response buffer
+ * @return 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, char *response);
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a streamed image
+ *
+ * @data: Data following what was given before
+ * @len: Length of the data
+ * @response: Pointer to fastboot response buffer
+ * @return 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_write(const void *data, u32 len, char *response);
+
+/**
+ * fastboot_mmc_stream_finish() - Finish writing a streamed image
+ *
+ * @response: Pointer to fastboot response buffer
+ * @return 0 if the whole image was written, -ve on error
+ */
+int fastboot_mmc_stream_finish(char *response);
+
+/**
+ * fastboot_mmc_stream_abort() - Stop writing a streamed image
+ */
+void fastboot_mmc_stream_abort(void);
 #endif
@@ -0,0 +1,418 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Batched edits to a flattened device tree
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef __FDT_BATCH_H
+#define __FDT_BATCH_H
+
+#include <linux/libfdt.h>
+
+/*
+ * Every fdt_setprop() or fdt_add_subnode() which changes the size of the
+ * tree moves everything after it, so a fixup pass making N edits to a blob
+ * of size S costs O(N * S). A batch instead records the edits against the
+ * unchanged tree and writes the result in a single pass when it is
+ * committed.
+ *
+ * The committed tree is byte-for-byte the same as if the edits had been
+ * made one at a time with fdt_rw.c, provided the original has its blocks in
+ * the usual order (memory reservations, structure, strings) with no gaps
+ * between them, as written by dtc or fdt_create(). The only exception is
+ * the padding after property values, which fdt_rw.c leaves as it finds it
+ * and a batch zeroes.
+ *
+ * Nodes are referred to by handle: the offset of an existing node, as
+ * returned by fdt_path_offset() etc., or a value returned by
+ * fdt_batch_add_subnode() for a new one. Offsets are not updated as edits
+ * are recorded, since the tree itself does not change until the commit.
+ */
+
+/* Node handles at or above this refer to nodes added in the batch */
+#define FDT_BATCH_NEW_NODE	0x40000000
+
+struct fdt_batch_prop;
+struct fdt_batch_node;
+struct fdt_batch_child;
+
+/**
+ * struct fdt_batch - A set of edits to be made to a tree
+ *
+ * @fdt:	Tree being edited
+ * @props:	Properties which are changed, added or deleted
+ * @num_props:	Number of entries used in @props
+ * @max_props:	Number of entries allocated in @props
+ * @nodes:	Nodes which are added, handle FDT_BATCH_NEW_NODE + index
+ * @num_nodes:	Number of entries used in @nodes
+ * @max_nodes:	Number of entries allocated in @nodes
+ * @strings:	Property names to be added to the strings block
+ * @strings_len: Number of bytes used in @strings
+ * @strings_max: Number of bytes allocated in @strings
+ * @rsv:	Memory reservations, initially those of @fdt
+ * @num_rsv:	Number of entries used in @rsv
+ * @max_rsv:	Number of entries allocated in @rsv
+ * @seq:	Sequence number of the last addition, used to put new
+ *		properties and nodes in the order fdt_rw.c would
+ * @tree:	Nodes of @fdt in tree order, built on the first lookup
+ * @children:	The same, sorted by parent and name for lookups
+ * @num_tree:	Number of entries in @tree, 0 if not built yet or -1 if
+ *		@fdt could not be indexed
+ */
+struct fdt_batch {
+	void *fdt;
+	struct fdt_batch_prop *props;
+	int num_props;
+	int max_props;
+	struct fdt_batch_node *nodes;
+	int num_nodes;
+	int max_nodes;
+	char *strings;
+	int strings_len;
+	int strings_max;
+	struct fdt_reserve_entry *rsv;
+	int num_rsv;
+	int max_rsv;
+	int seq;
+	struct fdt_batch_child *tree;
+	struct fdt_batch_child *children;
+	int num_tree;
+};
+
+/**
+ * fdt_batch_init() - Start a batch of edits
+ *
+ * @b:		Batch to set up
+ * @fdt:	Tree to edit, which is not changed until fdt_batch_commit()
+ * @return 0 if OK, -FDT_ERR_... if @fdt is not valid or on out of memory
+ */
+int fdt_batch_init(struct fdt_batch *b, void *fdt);
+
+/**
+ * fdt_batch_uninit() - Drop a batch, without making any of its edits
+ *
+ * This must be called once the batch is finished with, whether or not it
+ * was committed.
+ *
+ * @b:		Batch to free
+ */
+void fdt_batch_uninit(struct fdt_batch *b);
+
+/**
+ * fdt_batch_commit() - Write out the tree with all edits made
+ *
+ * The blocks of the output follow each other with no gaps, as after
+ * fdt_pack(), but its total size is @bufsize, leaving any remaining space
+ * free for later edits. If the commit fails, the batch is unchanged and the
+ * original tree is left alone.
+ *
+ * @b:		Batch to commit
+ * @buf:	Buffer for the new tree, which must not overlap the original
+ *		unless it is the original: that updates it in place, using
+ *		@bufsize bytes. NULL updates it in place within its current
+ *		total size.
+ * @bufsize:	Size of @buf, ignored if @buf is NULL
+ * @return 0 if OK, -FDT_ERR_NOSPACE if the new tree does not fit
+ */
+int fdt_batch_commit(struct fdt_batch *b, void *buf, int bufsize);
+
+/**
+ * fdt_batch_subnode_offset() - Look up a subnode, including added ones
+ *
+ * @b:		Batch
+ * @parent:	Node handle of the parent
+ * @name:	Name of the subnode, matched as by fdt_subnode_offset()
+ * @return node handle, or -FDT_ERR_NOTFOUND
+ */
+int fdt_batch_subnode_offset(struct fdt_batch *b, int parent,
+			     const char *name);
+
+/**
+ * fdt_batch_path_offset() - Look up a node by path, including added ones
+ *
+ * An alias at the start of @path is resolved using /aliases as it will be
+ * after the commit.
+ *
+ * @b:		Batch
+ * @path:	Full path or alias of the node, as for fdt_path_offset()
+ * @return node handle, -FDT_ERR_NOTFOUND or -FDT_ERR_BADPATH
+ */
+int fdt_batch_path_offset(struct fdt_batch *b, const char *path);
+
+/**
+ * fdt_batch_get_path() - Get the full path of a node
+ *
+ * @b:		Batch
+ * @node:	Node handle
+ * @buf:	Returns the path, nul-terminated
+ * @buflen:	Size of @buf
+ * @return 0 if OK, -FDT_ERR_NOSPACE if @buf is too small, or other
+ * -FDT_ERR_... value
+ */
+int fdt_batch_get_path(struct fdt_batch *b, int node, char *buf, int buflen);
+
+/**
+ * fdt_batch_get_phandle() - Get the phandle of a node
+ *
+ * @b:		Batch
+ * @node:	Node handle
+ * @return phandle as it will be after the commit, or 0 if none
+ */
+u32 fdt_batch_get_phandle(struct fdt_batch *b, int node);
+
+/**
+ * fdt_batch_add_subnode() - Add a subnode
+ *
+ * @b:		Batch
+ * @parent:	Node handle of the parent
+ * @name:	Name of the new subnode
+ * @return handle of the new node, -FDT_ERR_EXISTS if the parent already has
+ * a subnode of that name, or other -FDT_ERR_... value
+ */
+int fdt_batch_add_subnode(struct fdt_batch *b, int parent, const char *name);
+
+/**
+ * fdt_batch_find_or_add_subnode() - Look up a subnode, adding it if needed
+ *
+ * This is the batch version of fdt_find_or_add_subnode().
+ *
+ * @b:		Batch
+ * @parent:	Node handle of the parent
+ * @name:	Name of the subnode
+ * @return node handle, or -FDT_ERR_... on error
+ */
+int fdt_batch_find_or_add_subnode(struct fdt_batch *b, int parent,
+				  const char *name);
+
+/**
+ * fdt_batch_getprop() - Read a property, as it will be after the commit
+ *
+ * @b:		Batch
+ * @node:	Node handle
+ * @name:	Property name
+ * @lenp:	Returns the length of the property, or -FDT_ERR_NOTFOUND if it
+ *		does not exist (may be NULL)
+ * @return pointer to the property value, valid until the next edit of the
+ * property, or NULL if not found
+ */
+const void *fdt_batch_getprop(struct fdt_batch *b, int node, const char *name,
+			      int *lenp);
+
+/**
+ * fdt_batch_setprop() - Set a property, adding it if needed
+ *
+ * @b:		Batch
+ * @node:	Node handle
+ * @name:	Property name
+ * @val:	Value, which is copied
+ * @len:	Length of @val in bytes
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_batch_setprop(struct fdt_batch *b, int node, const char *name,
+		      const void *val, int len);
+
+/**
+ * fdt_batch_appendprop() - Append to a property, adding it if needed
+ *
+ * @b:		Batch
+ * @node:	Node handle
+ * @name:	Property name
+ * @val:	Value to append, which is copied
+ * @len:	Length of @val in bytes
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_batch_appendprop(struct fdt_batch *b, int node, const char *name,
+			 const void *val, int len);
+
+/**
+ * fdt_batch_delprop() - Delete a property
+ *
+ * @b:		Batch
+ * @node:	Node handle
+ * @name:	Property name
+ * @return 0 if OK, -FDT_ERR_NOTFOUND if there is no such property
+ */
+int fdt_batch_delprop(struct fdt_batch *b, int node, const char *name);
+
+static inline int fdt_batch_setprop_u32(struct fdt_batch *b, int node,
+					const char *name, u32 val)
+{
+	fdt32_t tmp = cpu_to_fdt32(val);
+
+	return fdt_batch_setprop(b, node, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_u64(struct fdt_batch *b, int node,
+					const char *name, u64 val)
+{
+	fdt64_t tmp = cpu_to_fdt64(val);
+
+	return fdt_batch_setprop(b, node, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_string(struct fdt_batch *b, int node,
+					   const char *name, const char *str)
+{
+	return fdt_batch_setprop(b, node, name, str, strlen(str) + 1);
+}
+
+/**
+ * fdt_batch_num_mem_rsv() - Get the number of memory reservations
+ *
+ * @b:		Batch
+ * @return number of reservations, including those added in the batch
+ */
+static inline int fdt_batch_num_mem_rsv(struct fdt_batch *b)
+{
+	return b->num_rsv;
+}
+
+/**
+ * fdt_batch_get_mem_rsv() - Read a memory reservation
+ *
+ * @b:		Batch
+ * @n:		Index of the reservation
+ * @address:	Returns the start address
+ * @size:	Returns the size
+ * @return 0 if OK, -FDT_ERR_NOTFOUND if @n is out of range
+ */
+int fdt_batch_get_mem_rsv(struct fdt_batch *b, int n, u64 *address,
+			  u64 *size);
+
+/**
+ * fdt_batch_add_mem_rsv() - Add a memory reservation at the end of the list
+ *
+ * @b:		Batch
+ * @address:	Start address
+ * @size:	Size in bytes
+ * @return 0 if OK, -FDT_ERR_NOSPACE if out of memory
+ */
+int fdt_batch_add_mem_rsv(struct fdt_batch *b, u64 address, u64 size);
+
+/**
+ * fdt_batch_del_mem_rsv() - Delete a memory reservation
+ *
+ * Later reservations move down to fill the gap, as with fdt_del_mem_rsv().
+ *
+ * @b:		Batch
+ * @n:		Index of the reservation
+ * @return 0 if OK, -FDT_ERR_NOTFOUND if @n is out of range
+ */
+int fdt_batch_del_mem_rsv(struct fdt_batch *b, int n);
+
+/**
+ * fdt_batch_grow() - Grow an array so it has room for one more entry
+ *
+ * The array doubles in size when full, starting from 16 entries.
+ *
+ * @array:	Pointer to the array, which is reallocated if needed
+ * @num:	Number of entries in use
+ * @max:	Number of entries allocated, updated if the array grows
+ * @size:	Size of an entry
+ * @return 0 if OK, -FDT_ERR_NOSPACE if out of memory
+ */
+int fdt_batch_grow(void **array, int num, int *max, int size);
+
+struct fdt_overlay_phandle;
+struct fdt_overlay_symbol;
+
+/**
+ * struct fdt_overlay_batch - Overlays being applied to a tree in a batch
+ *
+ * The phandles and symbols of the base tree are indexed once, when the
+ * batch is set up, and kept up to date as overlays are merged, so that
+ * resolving fixups and fragment targets does not walk the tree. The result
+ * is written out once all overlays are applied.
+ *
+ * @b:		Edits to the base tree
+ * @phandles:	Phandles in use, sorted by phandle and then node handle
+ * @num_phandles: Number of entries used in @phandles
+ * @max_phandles: Number of entries allocated in @phandles
+ * @symbols:	Properties of /__symbols__, sorted by name
+ * @num_symbols: Number of entries used in @symbols
+ * @max_symbols: Number of entries allocated in @symbols
+ * @symbols_node: Node handle of /__symbols__, or -FDT_ERR_NOTFOUND
+ * @path:	Buffer for building symbol paths
+ * @path_max:	Number of bytes allocated in @path
+ */
+struct fdt_overlay_batch {
+	struct fdt_batch b;
+	struct fdt_overlay_phandle *phandles;
+	int num_phandles;
+	int max_phandles;
+	struct fdt_overlay_symbol *symbols;
+	int num_symbols;
+	int max_symbols;
+	int symbols_node;
+	char *path;
+	int path_max;
+};
+
+/**
+ * fdt_overlay_batch_init() - Start applying overlays to a tree
+ *
+ * @ob:		Batch to set up
+ * @fdt:	Base tree, which is not changed until fdt_overlay_batch_commit()
+ * @return 0 if OK, -FDT_ERR_... if @fdt is not valid or on out of memory
+ */
+int fdt_overlay_batch_init(struct fdt_overlay_batch *ob, void *fdt);
+
+/**
+ * fdt_overlay_batch_uninit() - Drop a batch of overlays
+ *
+ * This must be called once the batch is finished with, whether or not it
+ * was committed.
+ *
+ * @ob:		Batch to free
+ */
+void fdt_overlay_batch_uninit(struct fdt_overlay_batch *ob);
+
+/**
+ * fdt_overlay_batch_apply() - Add an overlay to a batch
+ *
+ * This has the same effect as fdt_overlay_apply() on the tree as it will
+ * be after the commit. The overlay is no longer needed once this returns,
+ * so the next one can be loaded in its place.
+ *
+ * The overlay is damaged either way, as with fdt_overlay_apply(), and its
+ * magic is erased. On error the batch holds some of the changes from the
+ * overlay and should be dropped, but unlike fdt_overlay_apply() the base
+ * tree is left alone.
+ *
+ * @ob:		Batch
+ * @fdto:	Overlay to apply
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_overlay_batch_apply(struct fdt_overlay_batch *ob, void *fdto);
+
+/**
+ * fdt_overlay_batch_commit() - Write out the tree with all overlays applied
+ *
+ * See fdt_batch_commit() for the arguments.
+ */
+static inline int fdt_overlay_batch_commit(struct fdt_overlay_batch *ob,
+					   void *buf, int bufsize)
+{
+	return fdt_batch_commit(&ob->b, buf, bufsize);
+}
+
+/**
+ * fdt_overlay_apply_list() - Apply a list of overlays in one pass
+ *
+ * This has the same effect as calling fdt_overlay_apply() for each overlay
+ * in turn, but the base tree is only written once, at the end, and is left
+ * alone if any overlay fails.
+ *
+ * @fdt:	Base tree, updated in place
+ * @bufsize:	Size of the buffer holding @fdt, which becomes its total size
+ * @fdtos:	Overlays to apply, in order
+ * @count:	Number of overlays
+ * @times_us:	If not NULL, returns the time taken to resolve and merge each
+ *		overlay, in microseconds (@count entries)
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_overlay_apply_list(void *fdt, int bufsize, void *const fdtos[],
+			   int count, ulong *times_us);
+
+#endif /* __FDT_BATCH_H */
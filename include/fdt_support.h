@@ -12,6 +12,9 @@
 #include <asm/u-boot.h>
 #include <linux/libfdt.h>
 
+struct fdt_batch;
+struct fdt_overlay_batch;
+
 /**
  * arch_fixup_fdt() - Write arch-specific information to fdt
  *
@@ -41,6 +44,14 @@ u32 fdt_getprop_u32_default(const void *fdt, const char *path,
  */
 int fdt_root(void *fdt);
 
+/**
+ * fdt_root_batch() - Record the fdt_root() edits in a batch
+ *
+ * @b:		Batch to add to, see fdt_batch_init()
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_root_batch(struct fdt_batch *b);
+
 /**
  * Add chosen data the FDT before booting the OS.
  *
@@ -51,6 +62,14 @@ int fdt_root(void *fdt);
  */
 int fdt_chosen(void *fdt);
 
+/**
+ * fdt_chosen_batch() - Record the fdt_chosen() edits in a batch
+ *
+ * @b:		Batch to add to, see fdt_batch_init()
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_chosen_batch(struct fdt_batch *b);
+
 /**
  * Add initrd information to the FDT before booting the OS.
  *
@@ -59,6 +78,17 @@ int fdt_chosen(void *fdt);
  */
 int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end);
 
+/**
+ * fdt_initrd_batch() - Record the fdt_initrd() edits in a batch
+ *
+ * @b:			Batch to add to, see fdt_batch_init()
+ * @initrd_start:	Start address of the initrd
+ * @initrd_end:		End address of the initrd
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_initrd_batch(struct fdt_batch *b, ulong initrd_start,
+		     ulong initrd_end);
+
 void do_fixup_by_path(void *fdt, const char *path, const char *prop,
 		      const void *val, int len, int create);
 void do_fixup_by_path_u32(void *fdt, const char *path, const char *prop,
@@ -119,6 +149,7 @@ static inline int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[],
 #endif
 
 void fdt_fixup_ethernet(void *fdt);
+void fdt_fixup_ethernet_batch(struct fdt_batch *b);
 int fdt_find_and_setprop(void *fdt, const char *node, const char *prop,
 			 const void *val, int len, int create);
 void fdt_fixup_qe_firmware(void *fdt);
@@ -342,6 +373,19 @@ int fdt_setup_simplefb_node(void *fdt, int node, u64 base_address, u32 width,
 
 int fdt_overlay_apply_verbose(void *fdt, void *fdto);
 
+/**
+ * fdt_overlay_batch_apply_verbose() - Add an overlay to a batch, reporting
+ * errors
+ *
+ * This is fdt_overlay_batch_apply() with the same messages on error as
+ * fdt_overlay_apply_verbose().
+ *
+ * @ob:		Batch of overlays, see fdt_overlay_batch_init()
+ * @fdto:	Overlay to apply
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_overlay_batch_apply_verbose(struct fdt_overlay_batch *ob, void *fdto);
+
 /**
  * fdt_get_cells_len() - Get the length of a type of cell in top-level nodes
  *
@@ -375,5 +419,14 @@ void fdt_fixup_board_enet(void *blob);
 #endif
 #ifdef CONFIG_CMD_PSTORE
 void fdt_fixup_pstore(void *blob);
+
+/**
+ * pstore_get_pmsg_zone() - Get the location of the ramoops pmsg zone
+ *
+ * @addr: Returns the physical address of the zone
+ * @size: Returns the size of the zone in bytes
+ * @return 0 if OK, -ENOSPC if there is no pmsg zone or it is ECC-protected
+ */
+int pstore_get_pmsg_zone(phys_addr_t *addr, phys_size_t *size);
 #endif
 #endif /* ifndef __FDT_SUPPORT_H */
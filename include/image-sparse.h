@@ -24,6 +24,15 @@ struct sparse_storage {
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
 
+	/*
+	 * Optional, erases whole groups of erase_grp blocks so that they read
+	 * back as zeroes. Used instead of writing zero-filled chunks.
+	 */
+	lbaint_t	erase_grp;
+	lbaint_t	(*erase)(struct sparse_storage *info,
+				 lbaint_t blk,
+				 lbaint_t blkcnt);
+
 	void		(*mssg)(const char *str, char *response);
 };
 
@@ -38,5 +47,129 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * write_sparse_image() - Write a sparse image held in memory
+ *
+ * Raw chunks are written from where they are in @data, which is left as it
+ * is, so the same image can be written again.
+ *
+ * @info: Storage to write to
+ * @part_name: Name of the partition, for messages
+ * @data: Sparse image
+ * @response: Written with a message on error
+ * @return 0 if OK, -1 on error
+ */
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
+
+/**
+ * sparse_erase_span() - Find the whole erase groups in a range of blocks
+ *
+ * @info: Storage with erase groups of @info->erase_grp blocks
+ * @blk: First block of the range
+ * @blkcnt: Number of blocks in the range
+ * @first: Returns the first block of the first whole erase group
+ * @return number of blocks in whole erase groups, 0 if there are none or
+ *	@info cannot erase
+ */
+lbaint_t sparse_erase_span(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt, lbaint_t *first);
+
+enum sparse_stream_state {
+	SPARSE_STREAM_HEADER,	/* collecting the file header */
+	SPARSE_STREAM_CHUNK,	/* collecting a chunk header */
+	SPARSE_STREAM_RAW,	/* data of a raw chunk */
+	SPARSE_STREAM_FILL,	/* collecting the value of a fill chunk */
+	SPARSE_STREAM_IMAGE,	/* data of an image which is not sparse */
+	SPARSE_STREAM_DONE,	/* all chunks are written */
+};
+
+/**
+ * struct sparse_stream - an image written while it is received
+ *
+ * The image may be sparse or raw, which is decided from its first bytes. Its
+ * data is given to sparse_stream_write() in pieces of any size, and written
+ * as soon as whole blocks are available, so only headers and partial blocks
+ * are kept between calls.
+ *
+ * @info: Storage to write to
+ * @part_name: Name of the partition, for messages
+ * @state: What the next bytes of the image are
+ * @header: File header of a sparse image
+ * @chunk: Header of the current chunk
+ * @got: Bytes of @header or @chunk collected so far
+ * @skip: Bytes to skip before the next state, e.g. of a longer header
+ * @left: Bytes of data left in the current raw chunk
+ * @chunks: Number of chunks handled so far
+ * @blk: Next block to write
+ * @total_blocks: Blocks of the output image covered so far
+ * @bytes_written: Bytes written so far
+ * @fill_val: Value of the current fill chunk
+ * @carry: Partial block waiting for the rest of its data
+ * @carry_len: Number of bytes in @carry
+ * @fill_buf: Buffer for writing fill chunks, allocated when first needed
+ * @err: true once writing failed, after which the data is ignored
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	const char *part_name;
+	enum sparse_stream_state state;
+	sparse_header_t header;
+	chunk_header_t chunk;
+	uint got;
+	u64 skip;
+	u64 left;
+	uint chunks;
+	lbaint_t blk;
+	u32 total_blocks;
+	u64 bytes_written;
+	u32 fill_val;
+	u8 *carry;
+	uint carry_len;
+	u32 *fill_buf;
+	bool err;
+};
+
+/**
+ * sparse_stream_init() - Start writing an image as it is received
+ *
+ * @ss: Stream to set up
+ * @info: Storage to write to
+ * @part_name: Name of the partition, for messages
+ * @response: Written with a message on error
+ * @return 0 if OK, -ENOMEM if the buffer for partial blocks cannot be
+ *	allocated
+ */
+int sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+		       const char *part_name, char *response);
+
+/**
+ * sparse_stream_write() - Write the next part of the image
+ *
+ * @ss: Stream to write
+ * @data: Data following what was given before
+ * @len: Length of @data in bytes
+ * @response: Written with a message on error
+ * @return 0 if OK, -1 on error, including any previous one
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *data, ulong len,
+			char *response);
+
+/**
+ * sparse_stream_finish() - Write the end of the image and check it
+ *
+ * A partial block at the end of a raw image is padded with zeroes. The
+ * stream is freed in any case.
+ *
+ * @ss: Stream to finish
+ * @response: Written with a message on error
+ * @return 0 if OK, -1 on error or if the sparse image is incomplete
+ */
+int sparse_stream_finish(struct sparse_stream *ss, char *response);
+
+/**
+ * sparse_stream_abort() - Free a stream without finishing it
+ *
+ * @ss: Stream to free
+ */
+void sparse_stream_abort(struct sparse_stream *ss);
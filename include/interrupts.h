@@ -41,6 +41,8 @@ void disable_irq(unsigned int irq);
 int request_irq(unsigned int irq, interrupt_handler_t handler, void *arg, unsigned long type);
 void free_irq(unsigned int irq);
 void handle_irq_event(struct pt_regs *pt_regs, unsigned int esr);
+/* Return the interrupted registers, or NULL outside an irq handler */
+struct pt_regs *get_irq_regs(void);
 int register_irqchip(const struct irq_chip *chip);
 
 #endif
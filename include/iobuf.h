@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Page-granular allocator for large I/O and DMA buffers
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef __IOBUF_H
+#define __IOBUF_H
+
+#include <linux/types.h>
+
+/* Allocation unit of a pool; buffers start and end on this boundary */
+#define IOBUF_PAGE_SIZE		4096
+
+/**
+ * struct iobuf_pool - a pool of page-granular buffers
+ *
+ * Each run of free or allocated pages is an extent, whose length is recorded
+ * in the tag of its first and last page. This lets iobuf_pool_free() merge a
+ * freed buffer with its neighbours without searching, so free space does not
+ * fragment into pieces that are too small for the next large buffer.
+ *
+ * @base: Address of the first page available for buffers
+ * @tags: Tag of each page, which is the length of the extent if the page is
+ *	the first or last one of it, plus IOBUF_TAG_USED if it is allocated and
+ *	IOBUF_TAG_HEAD if it is the first
+ * @pages: Number of pages available for buffers
+ * @used_pages: Number of pages currently allocated
+ * @peak_pages: Largest value that @used_pages has reached
+ * @count: Number of buffers currently allocated
+ * @allocs: Number of successful allocations
+ * @fails: Number of allocations which did not fit in the pool
+ */
+struct iobuf_pool {
+	ulong base;
+	u32 *tags;
+	uint pages;
+	uint used_pages;
+	uint peak_pages;
+	uint count;
+	ulong allocs;
+	ulong fails;
+};
+
+/**
+ * struct iobuf_stats - allocation statistics of a pool
+ *
+ * @size: Number of bytes available for buffers
+ * @used: Number of bytes currently allocated
+ * @peak: Largest number of bytes allocated at once
+ * @largest_free: Size of the largest buffer which can be allocated now
+ * @count: Number of buffers currently allocated
+ * @allocs: Number of successful allocations
+ * @fails: Number of allocations which did not fit in the pool
+ */
+struct iobuf_stats {
+	ulong size;
+	ulong used;
+	ulong peak;
+	ulong largest_free;
+	uint count;
+	ulong allocs;
+	ulong fails;
+};
+
+/**
+ * iobuf_pool_init() - set up a pool over a region of memory
+ *
+ * The start of the region is used for the page tags, so a pool needs a few
+ * bytes of overhead per page. The region must not be used for anything else
+ * while the pool is in use.
+ *
+ * @pool: Pool to set up
+ * @base: Start of the region
+ * @size: Size of the region in bytes
+ * @return 0 if OK, -ENOSPC if the region is too small for a single page
+ */
+int iobuf_pool_init(struct iobuf_pool *pool, void *base, ulong size);
+
+/**
+ * iobuf_pool_alloc() - allocate a buffer from a pool
+ *
+ * The buffer is rounded up to a whole number of pages and uses the smallest
+ * free extent that it fits in. Since the buffer does not share a cache line
+ * with anything else, it is safe to use for DMA.
+ *
+ * @pool: Pool to allocate from
+ * @size: Size of the buffer in bytes
+ * @return buffer, or NULL if there is no free extent large enough
+ */
+void *iobuf_pool_alloc(struct iobuf_pool *pool, ulong size);
+
+/**
+ * iobuf_pool_free() - free a buffer allocated from a pool
+ *
+ * @pool: Pool which the buffer came from
+ * @ptr: Buffer to free
+ * @return 0 if OK, -ENOENT if @ptr is not an allocated buffer in the pool
+ */
+int iobuf_pool_free(struct iobuf_pool *pool, void *ptr);
+
+/**
+ * iobuf_pool_get_stats() - get the allocation statistics of a pool
+ *
+ * @pool: Pool to check
+ * @stats: Returns the statistics
+ */
+void iobuf_pool_get_stats(struct iobuf_pool *pool, struct iobuf_stats *stats);
+
+#if CONFIG_IS_ENABLED(IOBUF)
+/**
+ * iobuf_init() - set up the global pool
+ *
+ * This uses the region reserved by board_init_f(), which lies above the stack
+ * and is therefore reserved in the LMB of bootm and the load commands.
+ *
+ * @return 0 if OK, -ve on error
+ */
+int iobuf_init(void);
+
+/**
+ * iobuf_alloc() - allocate a DMA-safe buffer
+ *
+ * The buffer comes from the global pool if there is room. Otherwise it comes
+ * from the malloc() heap, aligned and padded to ARCH_DMA_MINALIGN.
+ *
+ * @size: Size of the buffer in bytes
+ * @return buffer, or NULL if out of memory
+ */
+void *iobuf_alloc(ulong size);
+
+/**
+ * iobuf_free() - free a buffer allocated by iobuf_alloc()
+ *
+ * @ptr: Buffer to free, or NULL to do nothing
+ */
+void iobuf_free(void *ptr);
+
+/**
+ * iobuf_get_stats() - get the allocation statistics of the global pool
+ *
+ * @stats: Returns the statistics
+ */
+void iobuf_get_stats(struct iobuf_stats *stats);
+#else
+#include <malloc.h>
+#include <memalign.h>
+
+static inline int iobuf_init(void)
+{
+	return 0;
+}
+
+static inline void *iobuf_alloc(ulong size)
+{
+	return malloc_cache_aligned(size);
+}
+
+static inline void iobuf_free(void *ptr)
+{
+	free(ptr);
+}
+#endif
+
+#endif /* __IOBUF_H */
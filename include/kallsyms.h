@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Helper functions for working with the builtin symbol table
+ *
+ * Copyright (c) 2008-2009 Analog Devices Inc.
+ */
+
+#ifndef __KALLSYMS_H
+#define __KALLSYMS_H
+
+/**
+ * symbol_lookup() - Find the symbol containing an address
+ *
+ * This only works with CONFIG_KALLSYMS, which links a copy of System.map
+ * into U-Boot. Addresses are link-time addresses, so relocated addresses
+ * must have gd->reloc_off subtracted first.
+ *
+ * @addr:	Address to look up
+ * @caddr:	Returns the start address of the symbol
+ * @return pointer to the symbol name, or NULL if not found
+ */
+const char *symbol_lookup(unsigned long addr, unsigned long *caddr);
+
+#endif
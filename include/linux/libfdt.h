@@ -10,4 +10,7 @@
 /* U-Boot local hacks */
 extern struct fdt_header *working_fdt;  /* Pointer to the working fdt */
 
+/* Drop lookups cached for the control FDT, see CONFIG_OF_LIBFDT_CACHE */
+void fdt_cache_invalidate(void);
+
 #endif /* _INCLUDE_LIBFDT_H_ */
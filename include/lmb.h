@@ -12,6 +12,7 @@
  * Copyright (C) 2001 Peter Bergner, IBM Corp.
  */
 
+/* Number of regions held in struct lmb_region before using the heap */
 #define MAX_LMB_REGIONS 8
 
 struct lmb_property {
@@ -19,10 +20,25 @@ struct lmb_property {
 	phys_size_t size;
 };
 
+/**
+ * struct lmb_region - a sorted list of regions
+ *
+ * The regions are kept sorted by address, without overlaps, so that they can
+ * be found by binary search. The list starts out in @initial and moves to the
+ * heap when it outgrows it, so there is no limit on the number of regions.
+ *
+ * @cnt: Number of regions in use
+ * @size: Unused
+ * @max: Number of regions that @region has room for
+ * @region: Regions, sorted by base address
+ * @initial: Space for the first MAX_LMB_REGIONS regions
+ */
 struct lmb_region {
 	unsigned long cnt;
 	phys_size_t size;
-	struct lmb_property region[MAX_LMB_REGIONS+1];
+	unsigned long max;
+	struct lmb_property *region;
+	struct lmb_property initial[MAX_LMB_REGIONS];
 };
 
 struct lmb {
@@ -31,6 +47,15 @@ struct lmb {
 };
 
 extern void lmb_init(struct lmb *lmb);
+/**
+ * lmb_uninit() - free the memory used by the regions of an LMB
+ *
+ * This must be called once an LMB is finished with, in case it has outgrown
+ * the space in struct lmb_region. The LMB is left empty.
+ *
+ * @lmb: LMB to free, which must be set up or zeroed
+ */
+void lmb_uninit(struct lmb *lmb);
 extern void lmb_init_and_reserve(struct lmb *lmb, struct bd_info *bd,
 				 void *fdt_blob);
 extern void lmb_init_and_reserve_range(struct lmb *lmb, phys_addr_t base,
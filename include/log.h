@@ -341,7 +341,10 @@ void __assert_fail(const char *assertion, const char *file, unsigned int line,
  * @file: Name of file where the log record was generated (not allocated)
  * @line: Line number where the log record was generated
  * @func: Function where the log record was generated (not allocated)
- * @msg: Log message (allocated)
+ * @msg: Log message (allocated), NULL for drivers with %LOGDF_RAW
+ * @fmt: printf() format string of the message (not allocated)
+ * @args: Arguments for @fmt. This is only set for drivers with %LOGDF_RAW
+ *	and is only valid while the driver's emit() method runs
  */
 struct log_rec {
 	enum log_category_t cat;
@@ -351,12 +354,15 @@ struct log_rec {
 	int line;
 	const char *func;
 	const char *msg;
+	const char *fmt;
+	va_list *args;
 };
 
 struct log_device;
 
 enum log_device_flags {
 	LOGDF_ENABLE		= BIT(0),	/* Device is enabled */
+	LOGDF_RAW		= BIT(1),	/* Device formats @fmt/@args itself */
 };
 
 /**
@@ -364,11 +370,22 @@ enum log_device_flags {
  *
  * @name: Name of driver
  * @emit: Method to call to emit a log record via this device
+ * @probe: Method to call when the device is set up, may be NULL
  * @flags: Initial value for flags (use LOGDF_ENABLE to enable on start-up)
  */
 struct log_driver {
 	const char *name;
 
+	/**
+	 * @probe: set up a log device
+	 *
+	 * Called by log_init() once the device has been added to the list of
+	 * log devices, so it may add filters to itself. This happens before
+	 * and again after relocation. A non-zero return value disables the
+	 * device.
+	 */
+	int (*probe)(struct log_device *ldev);
+
 	/**
 	 * @emit: emit a log record
 	 *
@@ -632,4 +649,27 @@ static inline int log_get_default_format(void)
 	       (IS_ENABLED(CONFIG_LOGF_FUNC) ? BIT(LOGF_FUNC) : 0);
 }
 
+/**
+ * log_binary_dump() - Format and print the records held by the binary log
+ *
+ * Records are stored unformatted by the 'binary' log driver and are only
+ * formatted here, oldest first, using the current log format (gd->log_fmt).
+ *
+ * @clear: true to discard the records once they are printed
+ * Return: number of records printed, or -%ENOENT if there is no binary log
+ */
+int log_binary_dump(bool clear);
+
+/**
+ * log_binary_to_pstore() - Hand the binary log to Linux as a pstore record
+ *
+ * Formats all records into the pmsg zone of the ramoops area set up with the
+ * 'pstore' command, so that they show up as /sys/fs/pstore/pmsg-ramoops-0 in
+ * Linux. This is called when the devicetree for the OS is set up.
+ *
+ * Return: 0 if OK, -%ENOENT if there is no binary log, -%ENOSPC if there is
+ *	no usable pmsg zone
+ */
+int log_binary_to_pstore(void);
+
 #endif
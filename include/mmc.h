@@ -231,6 +231,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
 #define EXT_CSD_BOOT_BUS_WIDTH		177
 #define EXT_CSD_PART_CONF		179	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BUS_WIDTH		183	/* R/W */
 #define EXT_CSD_STROBE_SUPPORT		184	/* R/W */
 #define EXT_CSD_HS_TIMING		185	/* R/W */
@@ -952,6 +953,19 @@ void board_mmc_power_init(void);
 int board_mmc_init(struct bd_info *bis);
 int cpu_mmc_init(struct bd_info *bis);
 int mmc_get_env_addr(struct mmc *mmc, int copy, u32 *env_addr);
+
+/**
+ * mmc_get_env_end() - Find where the area holding the environment ends
+ *
+ * The environment journal, which follows the environment, must stay within
+ * that area, be it the partition of the environment or the whole device.
+ *
+ * @mmc:	MMC device
+ * @copy:	Copy of the environment, 1 for the redundant one
+ * @env_end:	Returns the offset in bytes of the end of the area
+ * @return 0 if OK, -ve on error
+ */
+int mmc_get_env_end(struct mmc *mmc, int copy, u64 *env_end);
 # ifdef CONFIG_SYS_MMC_ENV_PART
 extern uint mmc_get_env_part(struct mmc *mmc);
 # endif
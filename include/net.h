@@ -44,8 +44,11 @@ struct udevice;
 
 #define PKTALIGN	ARCH_DMA_MINALIGN
 
-/* Number of packets processed together */
-#define ETH_PACKETS_BATCH_RECV	32
+/*
+ * Number of packets processed together, enough to drain a receive ring of
+ * PKTBUFSRX frames in one poll
+ */
+#define ETH_PACKETS_BATCH_RECV	(PKTBUFSRX > 32 ? PKTBUFSRX : 32)
 
 /* ARP hardware address length */
 #define ARP_HLEN 6
@@ -369,6 +372,7 @@ struct vlan_ethernet_hdr {
 #define PROT_NCSI	0x88f8		/* NC-SI control packets        */
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -560,7 +564,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, UDP
+	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, UDP, WGET
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
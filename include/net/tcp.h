@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+#include <net.h>
+
+/*
+ *	Internet Protocol (IP) + TCP header, without options.
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgment number	*/
+	u8		tcp_hlen;	/* Header length (in words) << 4 */
+	u8		tcp_flags;	/* Control flags		*/
+	u16		tcp_win;	/* Window			*/
+	u16		tcp_xsum;	/* Checksum			*/
+	u16		tcp_urg;	/* Urgent pointer		*/
+} __packed;
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+/* Control flags */
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PUSH	0x08
+#define TCP_ACK		0x10
+
+/* Largest segment received, for an Ethernet MTU of 1500 bytes */
+#define TCP_MSS		(1500 - IP_TCP_HDR_SIZE)
+
+/* What happened to the connection, as told to tcp_event_f */
+enum tcp_event {
+	TCP_CONNECTED,		/* The handshake completed */
+	TCP_CLOSED,		/* All the data was received, then a FIN */
+	TCP_RESET,		/* The peer refused or reset the connection */
+	TCP_TIMEOUT,		/* The peer stopped answering */
+};
+
+/**
+ * typedef tcp_rx_f - receive the data of the connection
+ *
+ * Called with the data received in order. Once tcp_set_rx_buffer() has been
+ * called, @data points to where the data was placed in that buffer.
+ *
+ * @data:	Data received
+ * @len:	Length of the data, in bytes
+ */
+typedef void tcp_rx_f(const uchar *data, unsigned int len);
+
+/**
+ * typedef tcp_event_f - be told about a change of state of the connection
+ *
+ * @event:	What happened
+ */
+typedef void tcp_event_f(enum tcp_event event);
+
+/**
+ * tcp_connect() - open a connection
+ *
+ * The handshake is done in the network loop, which must be running. Only one
+ * connection is open at a time, so this forgets any earlier one.
+ *
+ * @dest:	Address of the peer
+ * @dport:	Port of the peer
+ * @rx:		Called with the data received
+ * @event:	Called when the connection changes state
+ * @return 0 if the SYN was sent or is waiting for an ARP reply, -ve on error
+ */
+int tcp_connect(struct in_addr dest, u16 dport, tcp_rx_f *rx,
+		tcp_event_f *event);
+
+/**
+ * tcp_send() - send data on the connection
+ *
+ * The data is sent in one segment, which is retransmitted until it is
+ * acknowledged. Only one segment may be in flight at a time.
+ *
+ * @data:	Data to send
+ * @len:	Length of the data, at most TCP_MSS bytes
+ * @return 0 if OK, -ENOTCONN if the connection is not established, -EBUSY
+ * if a segment is still in flight, -E2BIG if @len is too large
+ */
+int tcp_send(const void *data, unsigned int len);
+
+/**
+ * tcp_set_rx_buffer() - receive the rest of the data straight into a buffer
+ *
+ * From then on, data received in order or not is copied from the packet to
+ * its place in @buf, without being buffered anywhere else. The receive window
+ * is shrunk so that the peer never sends more than @size bytes.
+ *
+ * This may be called from the tcp_rx_f callback.
+ *
+ * @buf:	Buffer for the data following what was received so far
+ * @size:	Size of the buffer, in bytes
+ */
+void tcp_set_rx_buffer(void *buf, ulong size);
+
+/**
+ * tcp_close() - close the connection
+ *
+ * A FIN is sent and the connection is forgotten, without waiting for the peer
+ * to acknowledge it.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_abort() - reset the connection
+ *
+ * A RST is sent and the connection is forgotten. Use this to stop receiving
+ * data the peer has not finished sending.
+ */
+void tcp_abort(void);
+
+/**
+ * tcp_reset() - forget the connection without telling the peer
+ *
+ * Called when the network loop ends, so that segments arriving later are
+ * ignored.
+ */
+void tcp_reset(void);
+
+/**
+ * tcp_set_tcp_header() - set the IP and TCP headers of a segment
+ *
+ * Called by net_send_ip_packet(), with the payload already in place after
+ * IP_TCP_HDR_SIZE bytes, or with the options of a SYN there.
+ *
+ * @pkt:	Start of the IP header
+ * @dest:	Address of the peer
+ * @dport:	Port of the peer
+ * @sport:	Our port
+ * @payload_len: Length of the options and data after the TCP header
+ * @action:	Control flags
+ * @seq:	Sequence number
+ * @ack:	Acknowledgment number
+ * @return size of the IP and TCP headers
+ */
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 seq, u32 ack);
+
+/**
+ * tcp_receive() - process a received TCP segment
+ *
+ * @ip:		IP header of the segment
+ * @len:	Length of the IP packet
+ * @src:	Source address
+ */
+void tcp_receive(struct ip_tcp_hdr *ip, int len, struct in_addr src);
+
+#endif /* __TCP_H__ */
@@ -25,6 +25,20 @@ void tftp_start_server(void);	/* Wait for incoming TFTP put */
 extern ulong tftp_timeout_ms;
 extern int tftp_timeout_count_max;
 
+/*
+ * Statistics of the last TFTP get: blocks received ahead of a missing one and
+ * kept, blocks received more than once, timeouts and re-acknowledgments sent
+ * to have the server resend from a missing block.
+ */
+struct tftp_stats {
+	ulong ooo;
+	ulong dups;
+	ulong timeouts;
+	ulong nacks;
+};
+
+extern struct tftp_stats tftp_stats;
+
 /**********************************************************************/
 
 #endif /* __TFTP_H__ */
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * HTTP/1.1 client
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+/*
+ * Part of the file to load, in bytes. A size of 0 loads up to the end of the
+ * file. Set by the wget command before net_loop(WGET).
+ */
+extern ulong wget_range_offset;
+extern ulong wget_range_size;
+
+/**
+ * wget_start() - start loading net_boot_file_name to image_load_addr
+ */
+void wget_start(void);
+
+#endif /* __WGET_H__ */
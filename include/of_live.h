@@ -9,15 +9,156 @@
 #ifndef _OF_LIVE_H
 #define _OF_LIVE_H
 
+#include <linux/libfdt_env.h>
+
 struct device_node;
 
+/*
+ * Pre-unflattened live tree image
+ *
+ * tools/mklivetree appends this after the control DTB (at an 8-byte aligned
+ * offset) so that the live tree can be set up at boot without walking the
+ * flat tree. It describes the struct device_node / struct property lists in
+ * tree order, using indexes instead of pointers. All values are big-endian,
+ * like the FDT itself.
+ *
+ * Names and values normally live in the DTB and are given as offsets from
+ * its start. Strings that only the unflattening creates (full node paths and
+ * the "name" properties of nodes without one) are kept in the image's own
+ * string table; their offsets have OF_LIVE_IMAGE_LOCAL set.
+ */
+#define OF_LIVE_IMAGE_MAGIC	0x4f464c54	/* "OFLT" */
+#define OF_LIVE_IMAGE_VERSION	1
+#define OF_LIVE_IMAGE_ALIGN	8
+#define OF_LIVE_IMAGE_LOCAL	0x80000000	/* offset is in the image */
+#define OF_LIVE_IMAGE_NONE	0xffffffff	/* no node / string */
+
+/**
+ * struct of_live_image_header - header of a live tree image
+ *
+ * @magic: OF_LIVE_IMAGE_MAGIC
+ * @version: OF_LIVE_IMAGE_VERSION
+ * @totalsize: Size of the image in bytes, including this header
+ * @fdt_size: fdt_totalsize() of the DTB that the image describes
+ * @fdt_size_struct: fdt_size_dt_struct() of that DTB
+ * @fdt_size_strings: fdt_size_dt_strings() of that DTB
+ * @num_nodes: Number of entries in the node table; the first is the root
+ * @num_props: Number of entries in the property table
+ * @off_nodes: Offset of the node table from the start of the image
+ * @off_props: Offset of the property table
+ * @off_strings: Offset of the string table
+ * @size_strings: Size of the string table in bytes
+ */
+struct of_live_image_header {
+	fdt32_t magic;
+	fdt32_t version;
+	fdt32_t totalsize;
+	fdt32_t fdt_size;
+	fdt32_t fdt_size_struct;
+	fdt32_t fdt_size_strings;
+	fdt32_t num_nodes;
+	fdt32_t num_props;
+	fdt32_t off_nodes;
+	fdt32_t off_props;
+	fdt32_t off_strings;
+	fdt32_t size_strings;
+};
+
+/**
+ * struct of_live_image_node - a struct device_node in a live tree image
+ *
+ * @name: Offset of the node name (the value of its "name" property)
+ * @type: Offset of the device_type value, or OF_LIVE_IMAGE_NONE
+ * @phandle: Phandle of the node, or 0 if none
+ * @full_name: Offset of the full path of the node
+ * @parent: Index of the parent node, or OF_LIVE_IMAGE_NONE for the root
+ * @child: Index of the first child, or OF_LIVE_IMAGE_NONE
+ * @sibling: Index of the next sibling, or OF_LIVE_IMAGE_NONE
+ * @props: Index of the first property of the node
+ * @num_props: Number of properties, which are consecutive in the table
+ */
+struct of_live_image_node {
+	fdt32_t name;
+	fdt32_t type;
+	fdt32_t phandle;
+	fdt32_t full_name;
+	fdt32_t parent;
+	fdt32_t child;
+	fdt32_t sibling;
+	fdt32_t props;
+	fdt32_t num_props;
+};
+
+/**
+ * struct of_live_image_prop - a struct property in a live tree image
+ *
+ * @name: Offset of the property name
+ * @length: Length of the value in bytes
+ * @value: Offset of the value
+ */
+struct of_live_image_prop {
+	fdt32_t name;
+	fdt32_t length;
+	fdt32_t value;
+};
+
 /**
  * of_live_build() - build a live (hierarchical) tree from a flat DT
  *
+ * If CONFIG_OF_LIVE_IMAGE is enabled and a live tree image for @fdt_blob
+ * follows it, that is used instead of unflattening the tree.
+ *
  * @fdt_blob: Input tree to convert
  * @rootp: Returns live tree that was created
  * @return 0 if OK, -ve on error
  */
 int of_live_build(const void *fdt_blob, struct device_node **rootp);
 
+/**
+ * of_live_map() - build a live tree from a live tree image
+ *
+ * This sets up the nodes and properties in a single pass over the image,
+ * without looking at the flat tree. Names and values still point into
+ * @fdt_blob, so it must stay where it is.
+ *
+ * @fdt_blob: Flat tree that the image was created from
+ * @image: Live tree image, e.g. from of_live_image_find()
+ * @rootp: Returns live tree that was created
+ * @return 0 if OK, -EINVAL if the image is not valid, -ENOMEM if out of memory
+ */
+int of_live_map(const void *fdt_blob, const void *image,
+		struct device_node **rootp);
+
+/**
+ * of_live_image_create() - create a live tree image for a flat tree
+ *
+ * This is used by tools/mklivetree and by tests.
+ *
+ * @fdt: Flat tree to describe
+ * @buf: Buffer for the image, or NULL to just work out its size
+ * @size: Size of @buf in bytes
+ * @return size of the image in bytes, or -FDT_ERR_... on error
+ */
+int of_live_image_create(const void *fdt, void *buf, int size);
+
+/**
+ * of_live_image_find() - find the live tree image following a flat tree
+ *
+ * @fdt: Flat tree, which must be followed by readable memory
+ * @return pointer to the image, or NULL if there is none for this tree
+ */
+const void *of_live_image_find(const void *fdt);
+
+/**
+ * of_live_image_size() - get the number of bytes used by a live tree image
+ *
+ * This includes the padding between the end of the flat tree and the image,
+ * so that fdt_totalsize(fdt) + of_live_image_size(fdt) bytes need to be
+ * copied to keep the image with the tree, e.g. when relocating.
+ *
+ * @fdt: Flat tree, which must be followed by readable memory
+ * @return size in bytes, or 0 if there is no live tree image for this tree
+ */
+int of_live_image_size(const void *fdt);
+
 #endif
@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Timer-driven sampling profiler
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef __SAMPLE_PROF_H
+#define __SAMPLE_PROF_H
+
+#include <trace.h>
+
+/* Flags for sample_prof_start() */
+enum sample_prof_flags {
+	SAMPLE_PROF_LR		= 1 << 0,	/* record the link register */
+	SAMPLE_PROF_FP		= 1 << 1,	/* walk the frame-pointer chain */
+};
+
+/**
+ * sample_prof_start() - Start taking samples
+ *
+ * The sample buffer is allocated on first use and kept until
+ * sample_prof_reset() is called. Starting an already-running profiler just
+ * updates the rate and flags.
+ *
+ * @hz:		Sample rate in Hz, 0 for CONFIG_SAMPLE_PROF_HZ
+ * @flags:	Mask of enum sample_prof_flags
+ * @return 0 if OK, -ENOMEM if the buffer cannot be allocated, other -ve on
+ *	error
+ */
+int sample_prof_start(uint hz, uint flags);
+
+/**
+ * sample_prof_stop() - Stop taking samples
+ *
+ * This leaves the recorded samples in place. It must be called before
+ * handing over to another program, since the timer interrupt stays armed
+ * otherwise.
+ */
+void sample_prof_stop(void);
+
+/**
+ * sample_prof_reset() - Stop sampling and discard all samples
+ */
+void sample_prof_reset(void);
+
+/* Print sampling statistics, including the measured overhead */
+void sample_prof_print_stats(void);
+
+/**
+ * sample_prof_print_hist() - Print a histogram of the sampled PCs
+ *
+ * PCs are symbolised using the built-in symbol table if CONFIG_KALLSYMS is
+ * enabled. Otherwise the raw text offsets are shown.
+ *
+ * @max_lines:	Maximum number of entries to print, 0 for all
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int sample_prof_print_hist(uint max_lines);
+
+/**
+ * sample_prof_list() - Dump the samples into a buffer
+ *
+ * The buffer receives a struct trace_output_hdr of type TRACE_CHUNK_SAMPLES
+ * followed by the samples (struct trace_sample), oldest first. This can be
+ * decoded by 'proftool dump-samples'.
+ *
+ * @buff:	Buffer in which to place data
+ * @buff_size:	Size of buffer
+ * @needed:	Returns number of bytes used / needed
+ * @return 0 if OK, -ENOSPC if the buffer is too small
+ */
+int sample_prof_list(void *buff, size_t buff_size, size_t *needed);
+
+#endif
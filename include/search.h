@@ -47,6 +47,14 @@ struct hsearch_data {
 	struct env_entry_node *table;
 	unsigned int size;
 	unsigned int filled;
+/*
+ * With CONFIG_ENV_INPLACE, entries imported by himport_r() point into "blob"
+ * instead of being copied, and "order" holds the indexes of all used table
+ * entries sorted by key, so that hexport_r() need not sort them.
+ */
+	char *blob;
+	size_t blob_size;
+	unsigned int *order;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
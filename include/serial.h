@@ -194,6 +194,25 @@ struct dm_serial_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*putc)(struct udevice *dev, const char ch);
+	/**
+	 * puts() - Write a string
+	 *
+	 * This writes as many characters of @s as the device can take at
+	 * once, e.g. a whole FIFO's worth, so the status need not be checked
+	 * for every character. The characters are written as they are. The
+	 * uclass splits a string at each '\n' and passes "\r\n" in a call of
+	 * its own in its place, so @s is either a run of characters without
+	 * '\n' or exactly that pair.
+	 *
+	 * This method is optional. If it is not provided, putc() is used.
+	 *
+	 * @dev: Device pointer
+	 * @s: characters to write (not nul-terminated)
+	 * @len: number of characters in @s
+	 * @return number of characters written (at least 1), -EAGAIN if the
+	 *	device cannot take any yet, other -ve on error
+	 */
+	ssize_t (*puts)(struct udevice *dev, const char *s, size_t len);
 	/**
 	 * pending() - Check if input/output characters are waiting
 	 *
@@ -346,4 +365,13 @@ void serial_puts(const char *str);
 int serial_getc(void);
 int serial_tstc(void);
 
+/**
+ * serial_flush() - Wait until all output has been sent
+ *
+ * This uses the pending() method of the current serial device. It must be
+ * called before handing over to another program, since a driver may be
+ * sending buffered output from its interrupt handler.
+ */
+void serial_flush(void);
+
 #endif
@@ -23,11 +23,15 @@ enum {
 	 * this value.
 	 */
 	FUNC_SITE_SIZE	= 4,	/* distance between function sites */
+
+	/* Number of frame-pointer return addresses kept in each sample */
+	TRACE_SAMPLE_DEPTH	= 4,
 };
 
 enum trace_chunk_type {
 	TRACE_CHUNK_FUNCS,
 	TRACE_CHUNK_CALLS,
+	TRACE_CHUNK_SAMPLES,
 };
 
 /* A trace record for a function, as written to the profile output file */
@@ -79,6 +83,17 @@ struct trace_call {
 
 int trace_list_calls(void *buff, size_t buff_size, size_t *needed);
 
+/*
+ * A single sample taken by the sampling profiler. All addresses are stored
+ * as offsets from the start of the U-Boot text, like struct trace_call. An
+ * offset of 0 means that the entry was not recorded.
+ */
+struct trace_sample {
+	uint32_t pc;		/* Interrupted program counter */
+	uint32_t lr;		/* Link register at the time of the sample */
+	uint32_t caller[TRACE_SAMPLE_DEPTH];	/* Return addresses (FP chain) */
+};
+
 /**
  * Turn function tracing on and off
  *
@@ -595,6 +595,34 @@ struct usb_hub_device {
 	struct usb_tt tt;		/* Transaction Translator */
 };
 
+/**
+ * struct usb_bulk_xfer - a bulk transfer queued with usb_bulk_submit()
+ *
+ * Several of these may be queued on the same endpoint, the controller
+ * working through them in order while the caller gets on with something
+ * else. The caller fills in the fields up to @length and must keep the
+ * structure and the buffer in place until the transfer completes or is
+ * cancelled.
+ *
+ * @pipe:	Bulk pipe
+ * @stream_id:	Stream allocated by usb_alloc_streams(), or 0
+ * @buffer:	Buffer to send or receive, DMA-aligned
+ * @length:	Length of the buffer, in bytes
+ * @actual_length: Number of bytes transferred, once completed
+ * @status:	-EINPROGRESS while queued, then 0 if OK, -ECONNRESET if
+ *		cancelled, other -ve on error
+ * @hcpriv:	Private to the controller driver
+ */
+struct usb_bulk_xfer {
+	unsigned long pipe;
+	unsigned int stream_id;
+	void *buffer;
+	int length;
+	int actual_length;
+	int status;
+	void *hcpriv;
+};
+
 #if CONFIG_IS_ENABLED(DM_USB)
 /**
  * struct usb_plat - Platform data about a USB controller
@@ -802,6 +830,69 @@ struct dm_usb_ops {
 	 * driver to do just that.
 	 */
 	int (*lock_async)(struct udevice *udev, int lock);
+
+	/**
+	 * alloc_streams() - Allocate streams on bulk endpoints (XHCI)
+	 *
+	 * USB 3.0 bulk endpoints may carry several streams, each with its
+	 * own transfer ring, so that a device such as a UAS disk can answer
+	 * commands in any order. This should be NULL if the controller does
+	 * not support streams.
+	 *
+	 * @pipes: Bulk pipes to allocate the streams on
+	 * @num_pipes: Number of pipes
+	 * @num_streams: Number of streams wanted, not counting stream 0
+	 * @return number of streams allocated (which may be fewer than
+	 *	requested), or -ve on error
+	 */
+	int (*alloc_streams)(struct udevice *bus, struct usb_device *udev,
+			     unsigned long *pipes, int num_pipes,
+			     unsigned int num_streams);
+
+	/**
+	 * bulk_stream() - Send a bulk message on a stream
+	 *
+	 * Parameters are as for bulk().
+	 *
+	 * @stream_id: Stream to use, from 1 to the number allocated
+	 */
+	int (*bulk_stream)(struct udevice *bus, struct usb_device *udev,
+			   unsigned long pipe, unsigned int stream_id,
+			   void *buffer, int length);
+
+	/**
+	 * bulk_submit() - Queue a bulk transfer and return at once
+	 *
+	 * The transfer is completed by later calls to bulk_wait(), which
+	 * set xfer->status. This should be NULL if the controller cannot
+	 * have several transfers in flight.
+	 *
+	 * @xfer: Transfer to queue, with its status set to -EINPROGRESS
+	 */
+	int (*bulk_submit)(struct udevice *bus, struct usb_device *udev,
+			   struct usb_bulk_xfer *xfer);
+
+	/**
+	 * bulk_wait() - Process completed transfers
+	 *
+	 * This completes the queued transfers that the controller has
+	 * finished with, until @xfer is done or @timeout has passed.
+	 *
+	 * @xfer: Transfer to wait for
+	 * @timeout: Time to wait, in milliseconds, 0 to just poll
+	 */
+	int (*bulk_wait)(struct udevice *bus, struct usb_device *udev,
+			 struct usb_bulk_xfer *xfer, int timeout);
+
+	/**
+	 * bulk_cancel() - Cancel the transfers queued on an endpoint
+	 *
+	 * All the transfers still queued on the endpoint of @xfer, on any
+	 * stream, end with a status of -ECONNRESET. A halted endpoint is
+	 * reset on the controller side.
+	 */
+	int (*bulk_cancel)(struct udevice *bus, struct usb_device *udev,
+			   struct usb_bulk_xfer *xfer);
 };
 
 #define usb_get_ops(dev)	((struct dm_usb_ops *)(dev)->driver->ops)
@@ -1006,6 +1097,73 @@ int usb_update_hub_device(struct usb_device *dev);
  */
 int usb_get_max_xfer_size(struct usb_device *dev, size_t *size);
 
+/**
+ * usb_alloc_streams() - Allocate streams on bulk endpoints
+ *
+ * @dev:		USB device
+ * @pipes:		Bulk pipes to allocate the streams on
+ * @num_pipes:		Number of pipes
+ * @num_streams:	Number of streams wanted, not counting stream 0
+ * @return number of streams allocated, -EOPNOTSUPP if the controller or
+ * device does not support streams, other -ve on error
+ */
+int usb_alloc_streams(struct usb_device *dev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams);
+
+/**
+ * usb_bulk_stream_msg() - Send a bulk message on a stream
+ *
+ * With a @stream_id of 0 this is the same as usb_bulk_msg().
+ *
+ * @dev:		USB device
+ * @pipe:		Bulk pipe
+ * @stream_id:		Stream allocated by usb_alloc_streams(), or 0
+ * @data:		Buffer to send or receive
+ * @len:		Length of the buffer, in bytes
+ * @actual_length:	Returns the number of bytes transferred
+ * @timeout:		Timeout in milliseconds, for a @stream_id of 0
+ * @return 0 if OK, -ve on error
+ */
+int usb_bulk_stream_msg(struct usb_device *dev, unsigned int pipe,
+			unsigned int stream_id, void *data, int len,
+			int *actual_length, int timeout);
+
+/**
+ * usb_bulk_submit() - Queue a bulk transfer without waiting for it
+ *
+ * Callers should fall back to usb_bulk_msg() when this returns -EOPNOTSUPP.
+ *
+ * @dev:		USB device
+ * @xfer:		Transfer to queue
+ * @return 0 if queued, -EOPNOTSUPP if the controller cannot queue
+ * transfers, -EBUSY if there is no room left on the endpoint, other -ve
+ * on error
+ */
+int usb_bulk_submit(struct usb_device *dev, struct usb_bulk_xfer *xfer);
+
+/**
+ * usb_bulk_wait() - Wait for a queued bulk transfer to complete
+ *
+ * Transfers queued before @xfer on any endpoint may complete as well.
+ *
+ * @dev:		USB device
+ * @xfer:		Transfer queued with usb_bulk_submit()
+ * @timeout:		Time to wait, in milliseconds, 0 to just poll
+ * @return xfer->status, i.e. -EINPROGRESS if @xfer is still queued, 0 if
+ * it completed, other -ve on error
+ */
+int usb_bulk_wait(struct usb_device *dev, struct usb_bulk_xfer *xfer,
+		  int timeout);
+
+/**
+ * usb_bulk_cancel() - Cancel the bulk transfers queued on an endpoint
+ *
+ * @dev:		USB device
+ * @xfer:		Transfer giving the endpoint
+ * @return 0 if OK, -ve on error
+ */
+int usb_bulk_cancel(struct usb_device *dev, struct usb_bulk_xfer *xfer);
+
 /**
  * usb_emul_setup_device() - Set up a new USB device emulation
  *
@@ -142,6 +142,8 @@ struct xhci_hccr {
 #define HCC_NSS(p)		((p) & (1 << 7))
 /* Max size for Primary Stream Arrays - 2^(n+1), where n is bits 12:15 */
 #define HCC_MAX_PSA(p)		(1 << ((((p) >> 12) & 0xf) + 1))
+/* true: HC supports streams (n above is not 0) */
+#define HCC_STREAMS(p)		((p) & (0xf << 12))
 /* Extended Capabilities pointer from PCI base - section 5.3.6 */
 #define HCC_EXT_CAPS(p)		XHCI_HCC_EXT_CAPS(p)
 
@@ -668,6 +670,30 @@ struct xhci_ep_ctx {
 #define EP_BPKTS(p)	(((p) & 0x7f) << 0)
 #define EP_BBM(p)	(((p) & 0x1) << 11)
 
+/**
+ * struct xhci_stream_ctx
+ * Stream context, one per stream of an endpoint; see section 6.2.4.1.
+ *
+ * @stream_ring:	64-bit address of the transfer ring of the stream, with
+ *			its dequeue cycle state and context type
+ */
+struct xhci_stream_ctx {
+	__le64	stream_ring;
+	/* offset 0x8 - 0xf reserved for HC internal use */
+	__le32	reserved[2];
+};
+
+/* Stream Context Type - bits 3:1 of stream_ring */
+#define SCT_FOR_CTX(p)		(((p) & 0x7) << 1)
+/* Primary stream array, pointing to a transfer ring */
+#define SCT_PRI_TR		1
+
+/*
+ * Size of the linear stream context arrays set up, stream 0 included. It
+ * must be a power of two.
+ */
+#define XHCI_MAX_STREAMS	16
+
 /**
  * struct xhci_input_control_context
  * Input control context; see section 6.2.5.
@@ -1061,6 +1087,10 @@ struct xhci_virt_ep {
 #define EP_HAS_STREAMS		(1 << 4)
 /* Transitioning the endpoint to not using streams, don't enqueue URBs */
 #define EP_GETTING_NO_STREAMS	(1 << 5)
+	/* With EP_HAS_STREAMS, the context array and a ring per stream */
+	struct xhci_stream_ctx		*stream_ctx;
+	struct xhci_ring		*stream_rings[XHCI_MAX_STREAMS];
+	unsigned int			num_streams;
 };
 
 #define CTX_SIZE(_hcc) (HCC_64BYTE_CONTEXT(_hcc) ? 64 : 32)
@@ -1196,6 +1226,18 @@ void xhci_hcd_stop(int index);
 /* true: Controller Not Ready to accept doorbell or op reg writes after reset */
 #define XHCI_STS_CNR		(1 << 11)
 
+/* A bulk TD queued by xhci_bulk_submit(), on the list of the controller */
+struct xhci_bulk_td {
+	struct list_head node;
+	struct usb_bulk_xfer *xfer;
+	struct usb_device *udev;
+	int ep_index;
+	struct xhci_ring *ring;
+	union xhci_trb *last_trb;
+	int num_trbs;
+	int available;		/* bytes left, less short packets */
+};
+
 struct xhci_ctrl {
 #if CONFIG_IS_ENABLED(DM_USB)
 	struct udevice *dev;
@@ -1216,6 +1258,7 @@ struct xhci_ctrl {
 	struct xhci_erst_entry entry[ERST_NUM_SEGS];
 	struct xhci_scratchpad *scratchpad;
 	struct xhci_virt_device *devs[MAX_HC_SLOTS];
+	struct list_head bulk_tds;	/* struct xhci_bulk_td, oldest first */
 	int rootdev;
 	u16 hci_version;
 	u32 quirks;
@@ -1250,7 +1293,11 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, u8 *ptr,
 void xhci_acknowledge_event(struct xhci_ctrl *ctrl);
 union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected);
 int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-		 int length, void *buffer);
+		 unsigned int stream_id, int length, void *buffer);
+int xhci_bulk_submit(struct usb_device *udev, struct usb_bulk_xfer *xfer);
+int xhci_bulk_wait(struct usb_device *udev, struct usb_bulk_xfer *xfer,
+		   int timeout);
+int xhci_bulk_cancel(struct usb_device *udev, struct usb_bulk_xfer *xfer);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer);
 int xhci_check_maxpacket(struct usb_device *udev);
@@ -1259,6 +1306,9 @@ void xhci_inval_cache(uintptr_t addr, u32 type_len);
 void xhci_cleanup(struct xhci_ctrl *ctrl);
 struct xhci_ring *xhci_ring_alloc(struct xhci_ctrl *ctrl, unsigned int num_segs,
 				  bool link_trbs);
+void xhci_alloc_stream_info(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			    unsigned int num_streams);
+void xhci_free_stream_info(struct xhci_virt_ep *ep);
 int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id);
 int xhci_mem_init(struct xhci_ctrl *ctrl, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor);
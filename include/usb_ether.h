@@ -7,6 +7,10 @@
 #define __USB_ETHER_H__
 
 #include <net.h>
+#include <usb.h>
+
+/* Receive transfers kept queued on the bulk in endpoint */
+#define USB_ETHER_RX_XFERS	4
 
 /* TODO(sjg@chromium.org): Remove @pusb_dev when all boards use CONFIG_DM_ETH */
 struct ueth_data {
@@ -16,6 +20,10 @@ struct ueth_data {
 	int rxsize;
 	int rxlen;			/* Total bytes available in rxbuf */
 	int rxptr;			/* Current position in rxbuf */
+	struct usb_bulk_xfer rx_xfer[USB_ETHER_RX_XFERS];
+	int rx_next;			/* rx_xfer[] completing next */
+	bool rx_queued;			/* rx_xfer[] are on the controller */
+	bool rx_held;			/* rxbuf is rx_xfer[rx_next].buffer */
 #else
 	struct eth_device eth_dev;	/* used with eth_register */
 	/* driver private */
@@ -58,7 +66,10 @@ int usb_ether_deregister(struct ueth_data *ueth);
 /**
  * usb_ether_receive() - recieve a packet from the bulk in endpoint
  *
- * The packet is stored in the internal buffer ready for processing.
+ * The packet is stored in the internal buffer ready for processing. When the
+ * controller can queue transfers, USB_ETHER_RX_XFERS of them are kept queued
+ * so that packets keep arriving while earlier ones are processed, and this
+ * returns at once if none has completed yet.
  *
  * @ueth:	USB Ethernet device
  * @rxsize:	Maximum size to receive
@@ -92,6 +103,16 @@ int usb_ether_get_rx_bytes(struct ueth_data *ueth, uint8_t **ptrp);
  * @num_bytes:	Number of bytes to skip, or -1 to skip all bytes
  */
 void usb_ether_advance_rxbuf(struct ueth_data *ueth, int num_bytes);
+
+/**
+ * usb_ether_cancel_rx() - cancel the receive transfers still queued
+ *
+ * Call this when the device is stopped, so that the controller no longer
+ * writes to the receive buffers. usb_ether_receive() queues them again.
+ *
+ * @ueth:	USB Ethernet device
+ */
+void usb_ether_cancel_rx(struct ueth_data *ueth);
 #else
 /*
  * Function definitions for each USB ethernet driver go here
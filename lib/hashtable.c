@@ -70,6 +70,81 @@ struct env_entry_node {
 static void _hdelete(const char *key, struct hsearch_data *htab,
 		     struct env_entry *ep, int idx);
 
+/*
+ * Strings imported in place point into htab->blob. They are never freed on
+ * their own; a changed value gets a copy of its own instead.
+ */
+static bool hin_blob(struct hsearch_data *htab, const char *str)
+{
+	return htab->blob && str >= htab->blob &&
+	       str < htab->blob + htab->blob_size;
+}
+
+static void hfree(struct hsearch_data *htab, const char *str)
+{
+	if (!hin_blob(htab, str))
+		free((void *)str);
+}
+
+static char *hdup(struct hsearch_data *htab, const char *str)
+{
+	return hin_blob(htab, str) ? (char *)str : strdup(str);
+}
+
+/*
+ * Return the position of @key in the first @count entries of the sorted
+ * index, or where it would be inserted.
+ */
+static unsigned int horder_pos(struct hsearch_data *htab, unsigned int count,
+			       const char *key)
+{
+	unsigned int lo = 0, hi = count;
+
+	/* Importing an exported environment adds keys in order */
+	if (count &&
+	    strcmp(htab->table[htab->order[count - 1]].entry.key, key) < 0)
+		return count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (strcmp(htab->table[htab->order[mid]].entry.key, key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Add a new entry to the sorted index; htab->filled already counts it */
+static void horder_insert(struct hsearch_data *htab, unsigned int idx)
+{
+	unsigned int count = htab->filled - 1;
+	unsigned int pos;
+
+	if (!htab->order)
+		return;
+
+	pos = horder_pos(htab, count, htab->table[idx].entry.key);
+	memmove(&htab->order[pos + 1], &htab->order[pos],
+		(count - pos) * sizeof(*htab->order));
+	htab->order[pos] = idx;
+}
+
+/* Drop an entry from the sorted index; htab->filled still counts it */
+static void horder_remove(struct hsearch_data *htab, const char *key)
+{
+	unsigned int pos;
+
+	if (!htab->order)
+		return;
+
+	pos = horder_pos(htab, htab->filled, key);
+	memmove(&htab->order[pos], &htab->order[pos + 1],
+		(htab->filled - pos - 1) * sizeof(*htab->order));
+}
+
 /*
  * hcreate()
  */
@@ -131,6 +206,16 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 		return 0;
 	}
 
+	if (CONFIG_IS_ENABLED(ENV_INPLACE)) {
+		htab->order = calloc(htab->size, sizeof(*htab->order));
+		if (!htab->order) {
+			free(htab->table);
+			htab->table = NULL;
+			__set_errno(ENOMEM);
+			return 0;
+		}
+	}
+
 	/* everything went alright */
 	return 1;
 }
@@ -160,14 +245,19 @@ void hdestroy_r(struct hsearch_data *htab)
 		if (htab->table[i].used > 0) {
 			struct env_entry *ep = &htab->table[i].entry;
 
-			free((void *)ep->key);
-			free(ep->data);
+			hfree(htab, ep->key);
+			hfree(htab, ep->data);
 		}
 	}
 	free(htab->table);
+	free(htab->order);
+	free(htab->blob);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->order = NULL;
+	htab->blob = NULL;
+	htab->blob_size = 0;
 }
 
 /*
@@ -272,7 +362,7 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 				return 0;
 			}
 
-			free(htab->table[idx].entry.data);
+			hfree(htab, htab->table[idx].entry.data);
 			htab->table[idx].entry.data = strdup(item.data);
 			if (!htab->table[idx].entry.data) {
 				__set_errno(ENOMEM);
@@ -382,14 +472,15 @@ int hsearch_r(struct env_entry item, enum env_action action,
 
 		/*
 		 * Create new entry;
-		 * create copies of item.key and item.data
+		 * create copies of item.key and item.data, unless they are
+		 * being imported in place
 		 */
 		if (first_deleted)
 			idx = first_deleted;
 
 		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
+		htab->table[idx].entry.key = hdup(htab, item.key);
+		htab->table[idx].entry.data = hdup(htab, item.data);
 		if (!htab->table[idx].entry.key ||
 		    !htab->table[idx].entry.data) {
 			__set_errno(ENOMEM);
@@ -398,6 +489,7 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		}
 
 		++htab->filled;
+		horder_insert(htab, idx);
 
 		/* This is a new entry, so look up a possible callback */
 		env_callback_init(&htab->table[idx].entry);
@@ -452,8 +544,9 @@ static void _hdelete(const char *key, struct hsearch_data *htab,
 {
 	/* free used entry */
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
+	horder_remove(htab, ep->key);
+	hfree(htab, ep->key);
+	hfree(htab, ep->data);
 	ep->flags = 0;
 	htab->table[idx].used = USED_DELETED;
 
@@ -614,7 +707,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	struct env_entry *list[htab->size];
 	char *res, *p;
 	size_t totlen;
-	int i, n;
+	int i, n, nent;
 
 	/* Test for correct arguments.  */
 	if ((resp == NULL) || (htab == NULL)) {
@@ -627,12 +720,15 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	/*
 	 * Pass 1:
 	 * search used entries,
-	 * save addresses and compute total length
+	 * save addresses and compute total length; with a sorted index the
+	 * entries come out in order already
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
+	nent = htab->order ? htab->filled : htab->size;
+	for (i = 0, n = 0, totlen = 0; i < nent; ++i) {
+		int idx = htab->order ? htab->order[i] : i + 1;
 
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
+		if (htab->table[idx].used > 0) {
+			struct env_entry *ep = &htab->table[idx].entry;
 			int found = match_entry(ep, flag, argc, argv);
 
 			if ((argc > 0) && (found == 0))
@@ -672,7 +768,8 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 #endif
 
 	/* Sort list by keys */
-	qsort(list, n, sizeof(struct env_entry *), cmpkey);
+	if (!htab->order)
+		qsort(list, n, sizeof(struct env_entry *), cmpkey);
 
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
@@ -803,6 +900,7 @@ int himport_r(struct hsearch_data *htab,
 {
 	char *data, *sp, *dp, *name, *value;
 	char *localvars[nvars];
+	bool inplace;
 	int i;
 
 	/* Test for correct arguments.  */
@@ -829,6 +927,13 @@ int himport_r(struct hsearch_data *htab,
 	flag |= H_NOCLEAR;
 #endif
 
+	/*
+	 * When a whole '\0'-separated environment replaces the table, keep
+	 * the copy around and point the entries straight into it
+	 */
+	inplace = CONFIG_IS_ENABLED(ENV_INPLACE) && sep == '\0' &&
+		  !crlf_is_lf && !nvars && !(flag & H_NOCLEAR);
+
 	if ((flag & H_NOCLEAR) == 0 && !nvars) {
 		/* Destroy old hash table if one exists */
 		debug("Destroy Hash Table: %p table = %p\n", htab,
@@ -873,6 +978,10 @@ int himport_r(struct hsearch_data *htab,
 		free(data);
 		return 1;		/* everything OK */
 	}
+	if (inplace) {
+		htab->blob = data;
+		htab->blob_size = size + 1;
+	}
 	if(crlf_is_lf) {
 		/* Remove Carriage Returns in front of Line Feeds */
 		unsigned ignored_crs = 0;
@@ -936,7 +1045,8 @@ int himport_r(struct hsearch_data *htab,
 		if (*name == 0) {
 			debug("INSERT: unable to use an empty key\n");
 			__set_errno(EINVAL);
-			free(data);
+			if (!inplace)
+				free(data);
 			return 0;
 		}
 
@@ -961,8 +1071,10 @@ int himport_r(struct hsearch_data *htab,
 			rv, name, value);
 	} while ((dp < data + size) && *dp);	/* size check needed for text */
 						/* without '\0' termination */
-	debug("INSERT: free(data = %p)\n", data);
-	free(data);
+	if (!inplace) {
+		debug("INSERT: free(data = %p)\n", data);
+		free(data);
+	}
 
 	if (flag & H_NOCLEAR)
 		goto end;
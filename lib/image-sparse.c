@@ -39,6 +39,7 @@
 #include <blk.h>
 #include <image-sparse.h>
 #include <div64.h>
+#include <errno.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
@@ -49,12 +50,93 @@
 
 static void default_log(const char *ignored, char *response) {}
 
+lbaint_t sparse_erase_span(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt, lbaint_t *first)
+{
+	lbaint_t grp = info->erase_grp;
+	lbaint_t start, end;
+
+	if (!info->erase || !grp)
+		return 0;
+
+	start = lldiv(blk + grp - 1, grp) * grp;
+	end = lldiv(blk + blkcnt, grp) * grp;
+	if (end <= start)
+		return 0;
+	*first = start;
+
+	return end - start;
+}
+
+/*
+ * Writes @blkcnt blocks from *@blk with the value in @fill_buf, which holds
+ * @fill_buf_num_blks blocks of it. If the value is zero, whole erase groups
+ * are erased instead. *@blk is advanced past the blocks used.
+ */
+static int sparse_write_fill(struct sparse_storage *info, lbaint_t *blk,
+			     lbaint_t blkcnt, const u32 *fill_buf,
+			     int fill_buf_num_blks)
+{
+	lbaint_t first = 0;
+	lbaint_t span = 0;
+	lbaint_t blks;
+	lbaint_t i, j;
+
+	if (!fill_buf[0])
+		span = sparse_erase_span(info, *blk, blkcnt, &first);
+
+	for (i = 0; i < blkcnt; i += j) {
+		if (span && *blk == first) {
+			if (info->erase(info, first, span) != span) {
+				printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+				       "Erase failed, block #", first, span);
+				return -1;
+			}
+			*blk += span;
+			j = span;
+			continue;
+		}
+
+		j = min_t(lbaint_t, blkcnt - i, fill_buf_num_blks);
+		/* Stop at the first erase group */
+		if (span && *blk < first)
+			j = min_t(lbaint_t, j, first - *blk);
+		blks = info->write(info, *blk, j, fill_buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (blks < j) {
+			printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+			       "Write failed, block #", *blk, j);
+			return -1;
+		}
+		*blk += blks;
+	}
+
+	return 0;
+}
+
+/* Writes the data of a raw chunk where it is in the image */
+static int write_raw_chunk(struct sparse_storage *info, lbaint_t *blk,
+			   const void *buf, lbaint_t blkcnt)
+{
+	lbaint_t blks;
+
+	blks = info->write(info, *blk, blkcnt, buf);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", *blk, blks);
+		return -1;
+	}
+	*blk += blks;
+
+	return 0;
+}
+
 int write_sparse_image(struct sparse_storage *info,
 		       const char *part_name, void *data, char *response)
 {
 	lbaint_t blk;
 	lbaint_t blkcnt;
-	lbaint_t blks;
 	uint32_t bytes_written = 0;
 	unsigned int chunk;
 	unsigned int offset;
@@ -66,7 +148,6 @@ int write_sparse_image(struct sparse_storage *info,
 	uint32_t total_blocks = 0;
 	int fill_buf_num_blks;
 	int i;
-	int j;
 
 	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
 
@@ -152,16 +233,10 @@ int write_sparse_image(struct sparse_storage *info,
 				return -1;
 			}
 
-			blks = info->write(info, blk, blkcnt, data);
-			/* blks might be > blkcnt (eg. NAND bad-blocks) */
-			if (blks < blkcnt) {
-				printf("%s: %s" LBAFU " [" LBAFU "]\n",
-				       __func__, "Write failed, block #",
-				       blk, blks);
+			if (write_raw_chunk(info, &blk, data, blkcnt)) {
 				info->mssg("flash write failure", response);
 				return -1;
 			}
-			blk += blks;
 			bytes_written += blkcnt * info->blksz;
 			total_blocks += chunk_header->chunk_sz;
 			data += chunk_data_sz;
@@ -203,24 +278,11 @@ int write_sparse_image(struct sparse_storage *info,
 				return -1;
 			}
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
+			if (sparse_write_fill(info, &blk, blkcnt, fill_buf,
+					      fill_buf_num_blks)) {
+				info->mssg("flash write failure", response);
+				free(fill_buf);
+				return -1;
 			}
 			bytes_written += blkcnt * info->blksz;
 			total_blocks += chunk_data_sz / sparse_header->blk_sz;
@@ -262,3 +324,363 @@ int write_sparse_image(struct sparse_storage *info,
 
 	return 0;
 }
+
+/* Copies up to @size - @ss->got bytes into @buf, returns true once it is full */
+static bool sparse_stream_collect(struct sparse_stream *ss, void *buf,
+				  uint size, const u8 **data, ulong *len)
+{
+	uint n = min_t(ulong, size - ss->got, *len);
+
+	memcpy(buf + ss->got, *data, n);
+	ss->got += n;
+	*data += n;
+	*len -= n;
+	if (ss->got < size)
+		return false;
+	ss->got = 0;
+
+	return true;
+}
+
+static int sparse_stream_fail(struct sparse_stream *ss, const char *msg,
+			      char *response)
+{
+	ss->info->mssg(msg, response);
+	ss->err = true;
+
+	return -1;
+}
+
+static int sparse_stream_blocks(struct sparse_stream *ss, const void *buf,
+				lbaint_t blkcnt, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blks;
+
+	if (ss->state == SPARSE_STREAM_IMAGE &&
+	    ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: too large for partition: '%s'\n", __func__,
+		       ss->part_name);
+		return sparse_stream_fail(ss, "too large for partition",
+					  response);
+	}
+
+	blks = info->write(info, ss->blk, blkcnt, buf);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", ss->blk, blks);
+		return sparse_stream_fail(ss, "flash write failure", response);
+	}
+	ss->blk += blks;
+	ss->bytes_written += blkcnt * info->blksz;
+
+	return 0;
+}
+
+/* Writes whole blocks straight from @data, keeping any partial block */
+static int sparse_stream_data(struct sparse_stream *ss, const u8 *data,
+			      ulong len, char *response)
+{
+	lbaint_t blksz = ss->info->blksz;
+	lbaint_t blkcnt;
+	uint n;
+
+	while (len) {
+		if (!ss->carry_len && len >= blksz) {
+			blkcnt = len / blksz;
+			if (sparse_stream_blocks(ss, data, blkcnt, response))
+				return -1;
+			data += blkcnt * blksz;
+			len -= blkcnt * blksz;
+			continue;
+		}
+
+		n = min_t(ulong, blksz - ss->carry_len, len);
+		memcpy(ss->carry + ss->carry_len, data, n);
+		ss->carry_len += n;
+		data += n;
+		len -= n;
+		if (ss->carry_len == blksz) {
+			ss->carry_len = 0;
+			if (sparse_stream_blocks(ss, ss->carry, 1, response))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Writes the blocks of the current fill chunk */
+static int sparse_stream_fill(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	int fill_buf_num_blks;
+	lbaint_t blkcnt, i;
+
+	blkcnt = lldiv((u64)ss->header.blk_sz * ss->chunk.chunk_sz,
+		       info->blksz);
+
+	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	if (!ss->fill_buf) {
+		ss->fill_buf = memalign(ARCH_DMA_MINALIGN,
+					ROUNDUP(info->blksz * fill_buf_num_blks,
+						ARCH_DMA_MINALIGN));
+		if (!ss->fill_buf)
+			return sparse_stream_fail(ss,
+				"Malloc failed for: CHUNK_TYPE_FILL", response);
+	}
+	for (i = 0; i < info->blksz * fill_buf_num_blks / sizeof(u32); i++)
+		ss->fill_buf[i] = ss->fill_val;
+
+	if (sparse_write_fill(info, &ss->blk, blkcnt, ss->fill_buf,
+			      fill_buf_num_blks))
+		return sparse_stream_fail(ss, "flash write failure", response);
+	ss->bytes_written += blkcnt * info->blksz;
+
+	return 0;
+}
+
+static void sparse_stream_next_chunk(struct sparse_stream *ss)
+{
+	ss->total_blocks += ss->chunk.chunk_sz;
+	if (++ss->chunks == ss->header.total_chunks)
+		ss->state = SPARSE_STREAM_DONE;
+	else
+		ss->state = SPARSE_STREAM_CHUNK;
+}
+
+/* Checks the file header, or falls back to writing a raw image */
+static int sparse_stream_start(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *sparse_header = &ss->header;
+	u32 offset;
+
+	if (!is_sparse_image(sparse_header)) {
+		puts("Flashing Raw Image\n");
+		ss->state = SPARSE_STREAM_IMAGE;
+		return sparse_stream_data(ss, (u8 *)sparse_header, ss->got,
+					  response);
+	}
+
+	div_u64_rem(sparse_header->blk_sz, ss->info->blksz, &offset);
+	if (!sparse_header->blk_sz || offset) {
+		printf("%s: Sparse image block size issue [%u]\n",
+		       __func__, sparse_header->blk_sz);
+		return sparse_stream_fail(ss, "sparse image block size issue",
+					  response);
+	}
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_stream_fail(ss, "Bogus sparse image header",
+					  response);
+
+	puts("Flashing Sparse Image\n");
+	ss->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	ss->state = sparse_header->total_chunks ? SPARSE_STREAM_CHUNK :
+		    SPARSE_STREAM_DONE;
+
+	return 0;
+}
+
+static int sparse_stream_chunk(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	chunk_header_t *chunk_header = &ss->chunk;
+	u32 hdr_sz = ss->header.chunk_hdr_sz;
+	u64 chunk_data_sz;
+	lbaint_t blkcnt;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	ss->skip = hdr_sz - sizeof(chunk_header_t);
+	chunk_data_sz = (u64)ss->header.blk_sz * chunk_header->chunk_sz;
+	blkcnt = lldiv(chunk_data_sz, info->blksz);
+	if ((chunk_header->chunk_type == CHUNK_TYPE_RAW ||
+	     chunk_header->chunk_type == CHUNK_TYPE_FILL) &&
+	    ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		return sparse_stream_fail(ss,
+			"Request would exceed partition size!", response);
+	}
+
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz != hdr_sz + chunk_data_sz)
+			return sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type Raw", response);
+		ss->left = chunk_data_sz;
+		ss->state = SPARSE_STREAM_RAW;
+		if (!ss->left)
+			sparse_stream_next_chunk(ss);
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz != hdr_sz + sizeof(u32))
+			return sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type FILL", response);
+		ss->state = SPARSE_STREAM_FILL;
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		if (chunk_header->total_sz != hdr_sz)
+			return sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type Dont Care",
+				response);
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		sparse_stream_next_chunk(ss);
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		/* The checksum itself is not checked */
+		if (chunk_header->total_sz != hdr_sz + sizeof(u32))
+			return sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type CRC32",
+				response);
+		ss->skip += sizeof(u32);
+		sparse_stream_next_chunk(ss);
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_stream_fail(ss, "Unknown chunk type", response);
+	}
+
+	return 0;
+}
+
+int sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+		       const char *part_name, char *response)
+{
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->part_name = part_name;
+	ss->blk = info->start;
+	ss->state = SPARSE_STREAM_HEADER;
+	if (!info->mssg)
+		info->mssg = default_log;
+
+	ss->carry = memalign(ARCH_DMA_MINALIGN,
+			     ROUNDUP(info->blksz, ARCH_DMA_MINALIGN));
+	if (!ss->carry) {
+		info->mssg("Malloc failed for partial blocks", response);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int sparse_stream_write(struct sparse_stream *ss, const void *data, ulong len,
+			char *response)
+{
+	const u8 *p = data;
+	ulong n;
+	int ret = 0;
+
+	while (len && !ss->err && !ret) {
+		if (ss->skip) {
+			n = min_t(u64, ss->skip, len);
+			ss->skip -= n;
+			p += n;
+			len -= n;
+			continue;
+		}
+
+		switch (ss->state) {
+		case SPARSE_STREAM_HEADER:
+			if (sparse_stream_collect(ss, &ss->header,
+						  sizeof(ss->header), &p, &len)) {
+				ss->got = sizeof(ss->header);
+				ret = sparse_stream_start(ss, response);
+				ss->got = 0;
+			}
+			break;
+
+		case SPARSE_STREAM_CHUNK:
+			if (sparse_stream_collect(ss, &ss->chunk,
+						  sizeof(ss->chunk), &p, &len))
+				ret = sparse_stream_chunk(ss, response);
+			break;
+
+		case SPARSE_STREAM_RAW:
+			n = min_t(u64, ss->left, len);
+			ret = sparse_stream_data(ss, p, n, response);
+			ss->left -= n;
+			p += n;
+			len -= n;
+			if (!ss->left)
+				sparse_stream_next_chunk(ss);
+			break;
+
+		case SPARSE_STREAM_FILL:
+			if (sparse_stream_collect(ss, &ss->fill_val,
+						  sizeof(ss->fill_val), &p,
+						  &len))
+				ret = sparse_stream_fill(ss, response);
+			if (!ret && !ss->got)
+				sparse_stream_next_chunk(ss);
+			break;
+
+		case SPARSE_STREAM_IMAGE:
+			ret = sparse_stream_data(ss, p, len, response);
+			len = 0;
+			break;
+
+		case SPARSE_STREAM_DONE:
+			/* Ignore anything after the last chunk */
+			len = 0;
+			break;
+		}
+	}
+
+	return ss->err ? -1 : 0;
+}
+
+void sparse_stream_abort(struct sparse_stream *ss)
+{
+	free(ss->carry);
+	free(ss->fill_buf);
+	ss->carry = NULL;
+	ss->fill_buf = NULL;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, char *response)
+{
+	int ret = ss->err ? -1 : 0;
+
+	/* An image shorter than a sparse header can only be raw */
+	if (!ret && ss->state == SPARSE_STREAM_HEADER && ss->got) {
+		ss->state = SPARSE_STREAM_IMAGE;
+		ret = sparse_stream_data(ss, (u8 *)&ss->header, ss->got,
+					 response);
+	}
+
+	if (!ret && ss->state == SPARSE_STREAM_IMAGE && ss->carry_len) {
+		memset(ss->carry + ss->carry_len, '\0',
+		       ss->info->blksz - ss->carry_len);
+		ss->carry_len = 0;
+		ret = sparse_stream_blocks(ss, ss->carry, 1, response);
+	}
+
+	if (!ret && ss->state != SPARSE_STREAM_IMAGE &&
+	    (ss->state != SPARSE_STREAM_DONE || ss->skip ||
+	     ss->total_blocks != ss->header.total_blks)) {
+		debug("Wrote %d blocks, expected to write %d blocks\n",
+		      ss->total_blocks, ss->header.total_blks);
+		ss->info->mssg("sparse image write failure", response);
+		ret = -1;
+	}
+
+	if (!ret)
+		printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+		       ss->part_name);
+	sparse_stream_abort(ss);
+
+	return ret;
+}
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Page-granular allocator for large I/O and DMA buffers
+ *
+ * Image loaders, download buffers and bounce buffers need a few large buffers
+ * which must not share cache lines with anything else. Taking them from the
+ * malloc() heap forces the heap to be sized for the worst case and leaves it
+ * fragmented, so they come from a separate pool of whole pages instead.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <iobuf.h>
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <memalign.h>
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Set in the tags of an allocated extent */
+#define IOBUF_TAG_USED		BIT(31)
+/* Set in the tag of the first page of an extent, not in that of the last */
+#define IOBUF_TAG_HEAD		BIT(30)
+
+static uint iobuf_tag_len(u32 tag)
+{
+	return tag & ~(IOBUF_TAG_USED | IOBUF_TAG_HEAD);
+}
+
+static void iobuf_set_extent(struct iobuf_pool *pool, uint page, uint len,
+			     u32 used)
+{
+	pool->tags[page + len - 1] = len | used;
+	pool->tags[page] = len | used | IOBUF_TAG_HEAD;
+}
+
+int iobuf_pool_init(struct iobuf_pool *pool, void *base, ulong size)
+{
+	ulong start = ALIGN((ulong)base, IOBUF_PAGE_SIZE);
+	ulong end = ALIGN_DOWN((ulong)base + size, IOBUF_PAGE_SIZE);
+	uint total, tag_pages;
+
+	memset(pool, '\0', sizeof(*pool));
+	if (end <= start)
+		return -ENOSPC;
+	total = (end - start) / IOBUF_PAGE_SIZE;
+	tag_pages = DIV_ROUND_UP(total * sizeof(u32), IOBUF_PAGE_SIZE);
+	if (total <= tag_pages)
+		return -ENOSPC;
+
+	pool->tags = (u32 *)start;
+	pool->base = start + tag_pages * IOBUF_PAGE_SIZE;
+	pool->pages = total - tag_pages;
+	iobuf_set_extent(pool, 0, pool->pages, 0);
+
+	return 0;
+}
+
+void *iobuf_pool_alloc(struct iobuf_pool *pool, ulong size)
+{
+	uint pages = DIV_ROUND_UP(size, IOBUF_PAGE_SIZE);
+	uint page, len, best = 0, best_len = 0;
+
+	if (!pages)
+		pages = 1;
+
+	/* Use the smallest free extent, to keep the large ones for later */
+	for (page = 0; page < pool->pages; page += len) {
+		len = iobuf_tag_len(pool->tags[page]);
+		if (pool->tags[page] & IOBUF_TAG_USED || len < pages)
+			continue;
+		if (!best_len || len < best_len) {
+			best = page;
+			best_len = len;
+			if (len == pages)
+				break;
+		}
+	}
+	if (!best_len) {
+		pool->fails++;
+		return NULL;
+	}
+
+	iobuf_set_extent(pool, best, pages, IOBUF_TAG_USED);
+	/* Make sure that iobuf_pool_free() rejects pointers inside the buffer */
+	if (pages > 2)
+		memset(&pool->tags[best + 1], '\0', (pages - 2) * sizeof(u32));
+	if (best_len > pages)
+		iobuf_set_extent(pool, best + pages, best_len - pages, 0);
+
+	pool->used_pages += pages;
+	pool->peak_pages = max(pool->peak_pages, pool->used_pages);
+	pool->count++;
+	pool->allocs++;
+
+	return (void *)(pool->base + (ulong)best * IOBUF_PAGE_SIZE);
+}
+
+int iobuf_pool_free(struct iobuf_pool *pool, void *ptr)
+{
+	ulong offset = (ulong)ptr - pool->base;
+	uint page, len, next;
+
+	if ((ulong)ptr < pool->base || offset % IOBUF_PAGE_SIZE ||
+	    offset / IOBUF_PAGE_SIZE >= pool->pages)
+		return -ENOENT;
+	page = offset / IOBUF_PAGE_SIZE;
+	/* The last page of a buffer carries its length too, but no head bit */
+	if ((pool->tags[page] & (IOBUF_TAG_USED | IOBUF_TAG_HEAD)) !=
+	    (IOBUF_TAG_USED | IOBUF_TAG_HEAD))
+		return -ENOENT;
+	len = iobuf_tag_len(pool->tags[page]);
+	pool->used_pages -= len;
+	pool->count--;
+	pool->tags[page] = 0;
+	pool->tags[page + len - 1] = 0;
+
+	/* Merge with the free extents on either side */
+	next = page + len;
+	if (next < pool->pages && !(pool->tags[next] & IOBUF_TAG_USED))
+		len += iobuf_tag_len(pool->tags[next]);
+	if (page && !(pool->tags[page - 1] & IOBUF_TAG_USED)) {
+		page -= iobuf_tag_len(pool->tags[page - 1]);
+		len += iobuf_tag_len(pool->tags[page]);
+	}
+	iobuf_set_extent(pool, page, len, 0);
+
+	return 0;
+}
+
+void iobuf_pool_get_stats(struct iobuf_pool *pool, struct iobuf_stats *stats)
+{
+	uint page, len, largest = 0;
+
+	for (page = 0; page < pool->pages; page += len) {
+		len = iobuf_tag_len(pool->tags[page]);
+		if (!(pool->tags[page] & IOBUF_TAG_USED))
+			largest = max(largest, len);
+	}
+
+	stats->size = (ulong)pool->pages * IOBUF_PAGE_SIZE;
+	stats->used = (ulong)pool->used_pages * IOBUF_PAGE_SIZE;
+	stats->peak = (ulong)pool->peak_pages * IOBUF_PAGE_SIZE;
+	stats->largest_free = (ulong)largest * IOBUF_PAGE_SIZE;
+	stats->count = pool->count;
+	stats->allocs = pool->allocs;
+	stats->fails = pool->fails;
+}
+
+static struct iobuf_pool iobuf_pool;
+
+int iobuf_init(void)
+{
+	void *base = map_sysmem(gd->iobuf_base, CONFIG_IOBUF_SIZE);
+	int ret;
+
+	ret = iobuf_pool_init(&iobuf_pool, base, CONFIG_IOBUF_SIZE);
+	if (ret)
+		log_err("Cannot set up I/O buffer pool (err=%d)\n", ret);
+
+	return ret;
+}
+
+void *iobuf_alloc(ulong size)
+{
+	void *ptr;
+
+	ptr = iobuf_pool_alloc(&iobuf_pool, size);
+	if (!ptr) {
+		log_debug("No room in pool for %#lx bytes\n", size);
+		ptr = malloc_cache_aligned(size);
+	}
+
+	return ptr;
+}
+
+void iobuf_free(void *ptr)
+{
+	if (ptr && iobuf_pool_free(&iobuf_pool, ptr))
+		free(ptr);
+}
+
+void iobuf_get_stats(struct iobuf_stats *stats)
+{
+	iobuf_pool_get_stats(&iobuf_pool, stats);
+}
@@ -0,0 +1,1066 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Batched edits to a flattened device tree
+ *
+ * Edits are recorded against the original tree, which is left alone until
+ * the commit. That copies the tree once, in order, writing replaced and new
+ * properties and new nodes where fdt_rw.c would have put them: new
+ * properties go at the start of their node, newest first, and new subnodes
+ * after the existing properties of their parent, also newest first. New
+ * property names are found in or appended to the strings block the same
+ * way as fdt_find_add_string_() does.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <fdt_batch.h>
+#include <malloc.h>
+#include <sort.h>
+#include "libfdt_internal.h"
+
+/* Nesting limit for the tree being copied */
+#define FDT_BATCH_MAX_DEPTH	64
+
+/* Longest alias name looked up by fdt_batch_path_offset() */
+#define FDT_BATCH_MAX_ALIAS	64
+
+enum fdt_batch_state {
+	FDT_BATCH_SET,		/* Existing property with a new value */
+	FDT_BATCH_NEW,		/* Property added at the start of its node */
+	FDT_BATCH_DEL,		/* Property deleted */
+};
+
+struct fdt_batch_prop {
+	int node;		/* Node handle */
+	int offset;		/* Offset of the original property, or -1 */
+	int nameoff;		/* Offset of the name in the new strings block */
+	int seq;		/* Order of addition, for FDT_BATCH_NEW */
+	enum fdt_batch_state state;
+	void *val;
+	int len;
+};
+
+struct fdt_batch_node {
+	int parent;		/* Node handle of the parent */
+	int seq;		/* Order of addition */
+	char *name;
+};
+
+/* A node of the original tree, indexed for lookups by name */
+struct fdt_batch_child {
+	int node;		/* Offset of the node */
+	int parent;		/* Offset of its parent, or -1 for the root */
+	const char *name;	/* Name, in the original tree */
+	int len;		/* Length of the name */
+	int baselen;		/* Length of the name without unit address */
+};
+
+/* State while writing out the structure block */
+struct fdt_batch_out {
+	struct fdt_batch *b;
+	const char *src;	/* Original structure block */
+	int copied;		/* Offset in src up to which it has been copied */
+	char *buf;		/* New structure block */
+	int len;		/* Bytes written to buf */
+	int max;		/* Space available in buf */
+	struct fdt_batch_node **nodes;	/* New nodes, sorted by parent */
+};
+
+static bool fdt_batch_is_new(int node)
+{
+	return node >= FDT_BATCH_NEW_NODE;
+}
+
+static int fdt_batch_check_node(struct fdt_batch *b, int node)
+{
+	if (fdt_batch_is_new(node))
+		return node - FDT_BATCH_NEW_NODE < b->num_nodes ? 0 :
+			-FDT_ERR_BADOFFSET;
+	if (fdt_check_node_offset_(b->fdt, node) < 0)
+		return -FDT_ERR_BADOFFSET;
+
+	return 0;
+}
+
+int fdt_batch_grow(void **array, int num, int *max, int size)
+{
+	void *tmp;
+	int new_max;
+
+	if (num < *max)
+		return 0;
+	new_max = *max ? *max * 2 : 16;
+	tmp = realloc(*array, new_max * size);
+	if (!tmp)
+		return -FDT_ERR_NOSPACE;
+	*array = tmp;
+	*max = new_max;
+
+	return 0;
+}
+
+static const char *fdt_batch_string(struct fdt_batch *b, int nameoff)
+{
+	int orig_size = fdt_size_dt_strings(b->fdt);
+
+	if (nameoff < orig_size)
+		return (char *)b->fdt + fdt_off_dt_strings(b->fdt) + nameoff;
+
+	return b->strings + nameoff - orig_size;
+}
+
+/* Find or add a string, as fdt_find_add_string_() would */
+static int fdt_batch_add_string(struct fdt_batch *b, const char *s)
+{
+	const char *strtab = (char *)b->fdt + fdt_off_dt_strings(b->fdt);
+	int orig_size = fdt_size_dt_strings(b->fdt);
+	int len = strlen(s) + 1;
+	const char *p;
+	int ret;
+
+	p = fdt_find_string_(strtab, orig_size, s);
+	if (p)
+		return p - strtab;
+	if (b->strings) {
+		p = fdt_find_string_(b->strings, b->strings_len, s);
+		if (p)
+			return orig_size + (p - b->strings);
+	}
+
+	while (b->strings_len + len > b->strings_max) {
+		ret = fdt_batch_grow((void **)&b->strings, b->strings_max,
+				     &b->strings_max, 1);
+		if (ret)
+			return ret;
+	}
+	memcpy(b->strings + b->strings_len, s, len);
+	b->strings_len += len;
+
+	return orig_size + b->strings_len - len;
+}
+
+static struct fdt_batch_prop *fdt_batch_find_prop(struct fdt_batch *b,
+						  int node, const char *name)
+{
+	struct fdt_batch_prop *p;
+	int i;
+
+	for (i = 0, p = b->props; i < b->num_props; i++, p++) {
+		if (p->node == node &&
+		    !strcmp(fdt_batch_string(b, p->nameoff), name))
+			return p;
+	}
+
+	return NULL;
+}
+
+/* Find a property in the original tree, returning its offset or -1 */
+static int fdt_batch_orig_prop(struct fdt_batch *b, int node,
+			       const char *name, int *nameoff)
+{
+	const struct fdt_property *prop;
+
+	if (fdt_batch_is_new(node))
+		return -1;
+	prop = fdt_get_property(b->fdt, node, name, NULL);
+	if (!prop)
+		return -1;
+	*nameoff = fdt32_to_cpu(prop->nameoff);
+
+	return (char *)prop - (char *)b->fdt - fdt_off_dt_struct(b->fdt);
+}
+
+int fdt_batch_init(struct fdt_batch *b, void *fdt)
+{
+	int ret;
+
+	memset(b, '\0', sizeof(*b));
+	ret = fdt_check_header(fdt);
+	if (ret)
+		return ret;
+	b->fdt = fdt;
+
+	ret = fdt_num_mem_rsv(fdt);
+	if (ret < 0)
+		return ret;
+	if (ret) {
+		b->rsv = malloc(ret * sizeof(*b->rsv));
+		if (!b->rsv)
+			return -FDT_ERR_NOSPACE;
+		memcpy(b->rsv, (char *)fdt + fdt_off_mem_rsvmap(fdt),
+		       ret * sizeof(*b->rsv));
+		b->num_rsv = ret;
+		b->max_rsv = ret;
+	}
+
+	return 0;
+}
+
+void fdt_batch_uninit(struct fdt_batch *b)
+{
+	int i;
+
+	for (i = 0; i < b->num_props; i++)
+		free(b->props[i].val);
+	for (i = 0; i < b->num_nodes; i++)
+		free(b->nodes[i].name);
+	free(b->props);
+	free(b->nodes);
+	free(b->strings);
+	free(b->rsv);
+	free(b->tree);
+	free(b->children);
+	memset(b, '\0', sizeof(*b));
+}
+
+/* Compare names ignoring the unit address, then by parent and position */
+static int fdt_batch_cmp_child(const void *v1, const void *v2)
+{
+	const struct fdt_batch_child *c1 = v1, *c2 = v2;
+	int ret;
+
+	if (c1->parent != c2->parent)
+		return c1->parent < c2->parent ? -1 : 1;
+	ret = memcmp(c1->name, c2->name, min(c1->baselen, c2->baselen));
+	if (ret)
+		return ret;
+	if (c1->baselen != c2->baselen)
+		return c1->baselen - c2->baselen;
+
+	return c1->node - c2->node;
+}
+
+/*
+ * Index the nodes of the original tree, the first time a lookup needs it.
+ * Looking up a subnode with libfdt scans all the children of the parent,
+ * which for the root of a large tree is most of it. Returns false if the
+ * tree cannot be indexed, in which case libfdt is used.
+ */
+static bool fdt_batch_index_tree(struct fdt_batch *b)
+{
+	int stack[FDT_BATCH_MAX_DEPTH];
+	struct fdt_batch_child *c;
+	int node, depth, max = 0;
+	const char *at;
+
+	if (b->num_tree)
+		return b->num_tree > 0;
+
+	/* The depth goes negative at the end of the root node */
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(b->fdt, node, &depth)) {
+		if (depth >= FDT_BATCH_MAX_DEPTH ||
+		    fdt_batch_grow((void **)&b->tree, b->num_tree, &max,
+				   sizeof(*b->tree)))
+			goto err;
+		stack[depth] = node;
+		c = &b->tree[b->num_tree++];
+		c->node = node;
+		c->parent = depth ? stack[depth - 1] : -1;
+		c->name = fdt_get_name(b->fdt, node, &c->len);
+		if (!c->name)
+			goto err;
+		at = memchr(c->name, '@', c->len);
+		c->baselen = at ? at - c->name : c->len;
+	}
+	if (node < 0 && node != -FDT_ERR_NOTFOUND)
+		goto err;
+
+	b->children = malloc(b->num_tree * sizeof(*b->children));
+	if (!b->children)
+		goto err;
+	memcpy(b->children, b->tree, b->num_tree * sizeof(*b->children));
+	qsort(b->children, b->num_tree, sizeof(*b->children),
+	      fdt_batch_cmp_child);
+
+	return true;
+
+err:
+	free(b->tree);
+	b->tree = NULL;
+	b->num_tree = -1;
+
+	return false;
+}
+
+/* As fdt_subnode_offset_namelen() for the original tree, using the index */
+static int fdt_batch_find_child(struct fdt_batch *b, int parent,
+				const char *name, int len)
+{
+	struct fdt_batch_child key, *c;
+	int lo = 0, hi = b->num_tree;
+	const char *at;
+
+	at = memchr(name, '@', len);
+	key.node = -1;
+	key.parent = parent;
+	key.name = name;
+	key.baselen = at ? at - name : len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (fdt_batch_cmp_child(&b->children[mid], &key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Without a unit address the first match in the tree is wanted */
+	for (c = &b->children[lo]; c < b->children + b->num_tree; c++) {
+		if (c->parent != parent || c->baselen != key.baselen ||
+		    memcmp(c->name, name, key.baselen))
+			break;
+		if (!at || (c->len == len && !memcmp(c->name, name, len)))
+			return c->node;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+/* As fdt_get_path() for the original tree, using the index */
+static int fdt_batch_tree_path(struct fdt_batch *b, int node, char *buf,
+			       int buflen)
+{
+	int stack[FDT_BATCH_MAX_DEPTH];
+	const struct fdt_batch_child *c;
+	int lo = 0, hi = b->num_tree;
+	int depth = 0, len = 0;
+
+	while (node > 0) {
+		while (lo < hi) {
+			int mid = lo + (hi - lo) / 2;
+
+			if (b->tree[mid].node < node)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == b->num_tree || b->tree[lo].node != node ||
+		    depth == FDT_BATCH_MAX_DEPTH)
+			return -FDT_ERR_BADOFFSET;
+		stack[depth++] = lo;
+		node = b->tree[lo].parent;
+		lo = 0;
+	}
+
+	if (buflen < 2)
+		return -FDT_ERR_NOSPACE;
+	buf[len++] = '/';
+	while (depth--) {
+		c = &b->tree[stack[depth]];
+		if (len + c->len + 1 > buflen)
+			return -FDT_ERR_NOSPACE;
+		memcpy(buf + len, c->name, c->len);
+		len += c->len;
+		if (depth)
+			buf[len++] = '/';
+	}
+	buf[len] = '\0';
+
+	return 0;
+}
+
+/* Compare node names as fdt_subnode_offset() does, ignoring a unit address */
+static bool fdt_batch_name_eq(const char *name, const char *s, int len)
+{
+	if (strncmp(name, s, len))
+		return false;
+
+	return !name[len] || (name[len] == '@' && !memchr(s, '@', len));
+}
+
+static int fdt_batch_subnode_offset_namelen(struct fdt_batch *b, int parent,
+					    const char *name, int len)
+{
+	int ret, i;
+
+	ret = fdt_batch_check_node(b, parent);
+	if (ret)
+		return ret;
+
+	/* New subnodes come first in the tree, newest first */
+	for (i = b->num_nodes - 1; i >= 0; i--) {
+		if (b->nodes[i].parent == parent &&
+		    fdt_batch_name_eq(b->nodes[i].name, name, len))
+			return FDT_BATCH_NEW_NODE + i;
+	}
+	if (fdt_batch_is_new(parent))
+		return -FDT_ERR_NOTFOUND;
+	if (fdt_batch_index_tree(b))
+		return fdt_batch_find_child(b, parent, name, len);
+
+	return fdt_subnode_offset_namelen(b->fdt, parent, name, len);
+}
+
+int fdt_batch_subnode_offset(struct fdt_batch *b, int parent,
+			     const char *name)
+{
+	return fdt_batch_subnode_offset_namelen(b, parent, name, strlen(name));
+}
+
+int fdt_batch_path_offset(struct fdt_batch *b, const char *path)
+{
+	const char *end = path + strlen(path);
+	const char *p = path;
+	int offset = 0;
+
+	/* An alias is looked up as it will be after the commit */
+	if (*path != '/') {
+		const char *q = strchr(path, '/');
+		char alias[FDT_BATCH_MAX_ALIAS];
+		int aliases, len;
+
+		if (!q)
+			q = end;
+		if (q - path >= FDT_BATCH_MAX_ALIAS)
+			return -FDT_ERR_BADPATH;
+		memcpy(alias, path, q - path);
+		alias[q - path] = '\0';
+		aliases = fdt_batch_path_offset(b, "/aliases");
+		if (aliases < 0)
+			return -FDT_ERR_BADPATH;
+		p = fdt_batch_getprop(b, aliases, alias, &len);
+		if (!p || !memchr(p, '\0', len))
+			return -FDT_ERR_BADPATH;
+		offset = fdt_batch_path_offset(b, p);
+		p = q;
+	}
+
+	while (p < end) {
+		const char *q;
+
+		while (*p == '/') {
+			p++;
+			if (p == end)
+				return offset;
+		}
+		q = strchr(p, '/');
+		if (!q)
+			q = end;
+
+		offset = fdt_batch_subnode_offset_namelen(b, offset, p, q - p);
+		if (offset < 0)
+			return offset;
+
+		p = q;
+	}
+
+	return offset;
+}
+
+int fdt_batch_get_path(struct fdt_batch *b, int node, char *buf, int buflen)
+{
+	const struct fdt_batch_node *n;
+	int ret, len, namelen;
+
+	ret = fdt_batch_check_node(b, node);
+	if (ret)
+		return ret;
+	if (!fdt_batch_is_new(node)) {
+		if (fdt_batch_index_tree(b))
+			return fdt_batch_tree_path(b, node, buf, buflen);
+		return fdt_get_path(b->fdt, node, buf, buflen);
+	}
+
+	n = &b->nodes[node - FDT_BATCH_NEW_NODE];
+	ret = fdt_batch_get_path(b, n->parent, buf, buflen);
+	if (ret)
+		return ret;
+	len = strlen(buf);
+	if (len == 1)
+		len = 0;
+	namelen = strlen(n->name);
+	if (len + 1 + namelen + 1 > buflen)
+		return -FDT_ERR_NOSPACE;
+	buf[len] = '/';
+	memcpy(buf + len + 1, n->name, namelen + 1);
+
+	return 0;
+}
+
+u32 fdt_batch_get_phandle(struct fdt_batch *b, int node)
+{
+	const fdt32_t *php;
+	int len;
+
+	php = fdt_batch_getprop(b, node, "phandle", &len);
+	if (!php || len != sizeof(*php)) {
+		php = fdt_batch_getprop(b, node, "linux,phandle", &len);
+		if (!php || len != sizeof(*php))
+			return 0;
+	}
+
+	return fdt32_to_cpu(*php);
+}
+
+int fdt_batch_add_subnode(struct fdt_batch *b, int parent, const char *name)
+{
+	struct fdt_batch_node *node;
+	int ret;
+
+	ret = fdt_batch_subnode_offset(b, parent, name);
+	if (ret >= 0)
+		return -FDT_ERR_EXISTS;
+	if (ret != -FDT_ERR_NOTFOUND)
+		return ret;
+
+	ret = fdt_batch_grow((void **)&b->nodes, b->num_nodes, &b->max_nodes,
+			     sizeof(*b->nodes));
+	if (ret)
+		return ret;
+	node = &b->nodes[b->num_nodes];
+	node->name = strdup(name);
+	if (!node->name)
+		return -FDT_ERR_NOSPACE;
+	node->parent = parent;
+	node->seq = ++b->seq;
+
+	return FDT_BATCH_NEW_NODE + b->num_nodes++;
+}
+
+int fdt_batch_find_or_add_subnode(struct fdt_batch *b, int parent,
+				  const char *name)
+{
+	int offset;
+
+	offset = fdt_batch_subnode_offset(b, parent, name);
+	if (offset == -FDT_ERR_NOTFOUND)
+		offset = fdt_batch_add_subnode(b, parent, name);
+
+	return offset;
+}
+
+const void *fdt_batch_getprop(struct fdt_batch *b, int node, const char *name,
+			      int *lenp)
+{
+	struct fdt_batch_prop *p;
+	int ret;
+
+	ret = fdt_batch_check_node(b, node);
+	if (ret)
+		goto err;
+	p = fdt_batch_find_prop(b, node, name);
+	if (p) {
+		if (p->state == FDT_BATCH_DEL) {
+			ret = -FDT_ERR_NOTFOUND;
+			goto err;
+		}
+		if (lenp)
+			*lenp = p->len;
+		return p->val;
+	}
+	if (!fdt_batch_is_new(node))
+		return fdt_getprop(b->fdt, node, name, lenp);
+	ret = -FDT_ERR_NOTFOUND;
+err:
+	if (lenp)
+		*lenp = ret;
+
+	return NULL;
+}
+
+int fdt_batch_setprop(struct fdt_batch *b, int node, const char *name,
+		      const void *val, int len)
+{
+	struct fdt_batch_prop *p;
+	int offset = -1, nameoff = -1;
+	bool add;
+	void *copy;
+	int ret;
+
+	ret = fdt_batch_check_node(b, node);
+	if (ret)
+		return ret;
+
+	/* Keep a non-NULL value even if empty, for fdt_batch_getprop() */
+	copy = malloc(len ? len : 1);
+	if (!copy)
+		return -FDT_ERR_NOSPACE;
+	memcpy(copy, val, len);
+
+	p = fdt_batch_find_prop(b, node, name);
+	if (!p)
+		offset = fdt_batch_orig_prop(b, node, name, &nameoff);
+	/* A property which does not exist is added at the start of its node */
+	add = p ? p->state == FDT_BATCH_DEL : offset < 0;
+	if (add) {
+		nameoff = fdt_batch_add_string(b, name);
+		if (nameoff < 0) {
+			free(copy);
+			return nameoff;
+		}
+	}
+
+	if (!p) {
+		ret = fdt_batch_grow((void **)&b->props, b->num_props,
+				     &b->max_props, sizeof(*b->props));
+		if (ret) {
+			free(copy);
+			return ret;
+		}
+		p = &b->props[b->num_props++];
+		memset(p, '\0', sizeof(*p));
+		p->node = node;
+		p->offset = offset;
+		p->nameoff = nameoff;
+		p->state = FDT_BATCH_SET;
+	}
+	if (add) {
+		p->state = FDT_BATCH_NEW;
+		p->nameoff = nameoff;
+		p->seq = ++b->seq;
+	}
+	free(p->val);
+	p->val = copy;
+	p->len = len;
+
+	return 0;
+}
+
+int fdt_batch_appendprop(struct fdt_batch *b, int node, const char *name,
+			 const void *val, int len)
+{
+	const void *old;
+	int old_len, ret;
+	char *buf;
+
+	old = fdt_batch_getprop(b, node, name, &old_len);
+	if (!old) {
+		if (old_len != -FDT_ERR_NOTFOUND)
+			return old_len;
+		old_len = 0;
+	}
+
+	buf = malloc(old_len + len);
+	if (!buf)
+		return -FDT_ERR_NOSPACE;
+	if (old)
+		memcpy(buf, old, old_len);
+	memcpy(buf + old_len, val, len);
+	ret = fdt_batch_setprop(b, node, name, buf, old_len + len);
+	free(buf);
+
+	return ret;
+}
+
+int fdt_batch_delprop(struct fdt_batch *b, int node, const char *name)
+{
+	struct fdt_batch_prop *p;
+	int offset, nameoff;
+	int ret;
+
+	ret = fdt_batch_check_node(b, node);
+	if (ret)
+		return ret;
+
+	p = fdt_batch_find_prop(b, node, name);
+	if (!p) {
+		offset = fdt_batch_orig_prop(b, node, name, &nameoff);
+		if (offset < 0)
+			return -FDT_ERR_NOTFOUND;
+		ret = fdt_batch_grow((void **)&b->props, b->num_props,
+				     &b->max_props, sizeof(*b->props));
+		if (ret)
+			return ret;
+		p = &b->props[b->num_props++];
+		memset(p, '\0', sizeof(*p));
+		p->node = node;
+		p->offset = offset;
+		p->nameoff = nameoff;
+	} else if (p->state == FDT_BATCH_DEL) {
+		return -FDT_ERR_NOTFOUND;
+	}
+	free(p->val);
+	p->val = NULL;
+	p->len = 0;
+	p->state = FDT_BATCH_DEL;
+
+	return 0;
+}
+
+int fdt_batch_get_mem_rsv(struct fdt_batch *b, int n, u64 *address,
+			  u64 *size)
+{
+	if (n < 0 || n >= b->num_rsv)
+		return -FDT_ERR_NOTFOUND;
+	*address = fdt64_to_cpu(b->rsv[n].address);
+	*size = fdt64_to_cpu(b->rsv[n].size);
+
+	return 0;
+}
+
+int fdt_batch_add_mem_rsv(struct fdt_batch *b, u64 address, u64 size)
+{
+	int ret;
+
+	ret = fdt_batch_grow((void **)&b->rsv, b->num_rsv, &b->max_rsv,
+			     sizeof(*b->rsv));
+	if (ret)
+		return ret;
+	b->rsv[b->num_rsv].address = cpu_to_fdt64(address);
+	b->rsv[b->num_rsv].size = cpu_to_fdt64(size);
+	b->num_rsv++;
+
+	return 0;
+}
+
+int fdt_batch_del_mem_rsv(struct fdt_batch *b, int n)
+{
+	if (n < 0 || n >= b->num_rsv)
+		return -FDT_ERR_NOTFOUND;
+	memmove(&b->rsv[n], &b->rsv[n + 1],
+		(b->num_rsv - n - 1) * sizeof(*b->rsv));
+	b->num_rsv--;
+
+	return 0;
+}
+
+/* Sort properties by node, with new ones newest first */
+static int fdt_batch_cmp_prop(const void *v1, const void *v2)
+{
+	const struct fdt_batch_prop *p1 = v1, *p2 = v2;
+
+	if (p1->node != p2->node)
+		return p1->node < p2->node ? -1 : 1;
+
+	return p2->seq < p1->seq ? -1 : p2->seq > p1->seq;
+}
+
+/* Sort new nodes by parent, newest first */
+static int fdt_batch_cmp_node(const void *v1, const void *v2)
+{
+	const struct fdt_batch_node *n1 = *(struct fdt_batch_node **)v1;
+	const struct fdt_batch_node *n2 = *(struct fdt_batch_node **)v2;
+
+	if (n1->parent != n2->parent)
+		return n1->parent < n2->parent ? -1 : 1;
+
+	return n2->seq < n1->seq ? -1 : n2->seq > n1->seq;
+}
+
+/* Find the first property of a node, in the sorted list */
+static int fdt_batch_first_prop(struct fdt_batch *b, int node)
+{
+	int lo = 0, hi = b->num_props;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (b->props[mid].node < node)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Find the first new subnode of a node, in the sorted list */
+static int fdt_batch_first_node(struct fdt_batch_out *o, int parent)
+{
+	int lo = 0, hi = o->b->num_nodes;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (o->nodes[mid]->parent < parent)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int fdt_batch_put(struct fdt_batch_out *o, const void *data, int len)
+{
+	if (len > o->max - o->len)
+		return -FDT_ERR_NOSPACE;
+	memcpy(o->buf + o->len, data, len);
+	o->len += len;
+
+	return 0;
+}
+
+/* Write a value and zero the padding after it */
+static int fdt_batch_put_padded(struct fdt_batch_out *o, const void *data,
+				int len)
+{
+	int pad = FDT_TAGALIGN(len) - len;
+	int ret;
+
+	ret = fdt_batch_put(o, data, len);
+	if (ret)
+		return ret;
+	if (pad > o->max - o->len)
+		return -FDT_ERR_NOSPACE;
+	memset(o->buf + o->len, '\0', pad);
+	o->len += pad;
+
+	return 0;
+}
+
+static int fdt_batch_put_tag(struct fdt_batch_out *o, u32 tag)
+{
+	fdt32_t val = cpu_to_fdt32(tag);
+
+	return fdt_batch_put(o, &val, sizeof(val));
+}
+
+/* Copy the original structure block up to @offset */
+static int fdt_batch_copy(struct fdt_batch_out *o, int offset)
+{
+	int ret;
+
+	ret = fdt_batch_put(o, o->src + o->copied, offset - o->copied);
+	if (ret)
+		return ret;
+	o->copied = offset;
+
+	return 0;
+}
+
+static int fdt_batch_put_prop(struct fdt_batch_out *o,
+			      const struct fdt_batch_prop *p)
+{
+	struct fdt_property prop;
+	int ret;
+
+	prop.tag = cpu_to_fdt32(FDT_PROP);
+	prop.len = cpu_to_fdt32(p->len);
+	prop.nameoff = cpu_to_fdt32(p->nameoff);
+	ret = fdt_batch_put(o, &prop, sizeof(prop));
+	if (ret)
+		return ret;
+
+	return fdt_batch_put_padded(o, p->val, p->len);
+}
+
+/* Write the properties added to a node, which go before existing ones */
+static int fdt_batch_put_new_props(struct fdt_batch_out *o, int node)
+{
+	struct fdt_batch *b = o->b;
+	int i, ret;
+
+	for (i = fdt_batch_first_prop(b, node);
+	     i < b->num_props && b->props[i].node == node; i++) {
+		if (b->props[i].state != FDT_BATCH_NEW)
+			continue;
+		ret = fdt_batch_put_prop(o, &b->props[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Write the subnodes added to a node, with everything in them */
+static int fdt_batch_put_new_nodes(struct fdt_batch_out *o, int parent)
+{
+	struct fdt_batch_node *node;
+	int i, handle, ret;
+
+	for (i = fdt_batch_first_node(o, parent);
+	     i < o->b->num_nodes && o->nodes[i]->parent == parent; i++) {
+		node = o->nodes[i];
+		handle = FDT_BATCH_NEW_NODE + (node - o->b->nodes);
+		ret = fdt_batch_put_tag(o, FDT_BEGIN_NODE);
+		if (!ret)
+			ret = fdt_batch_put_padded(o, node->name,
+						   strlen(node->name) + 1);
+		if (!ret)
+			ret = fdt_batch_put_new_props(o, handle);
+		if (!ret)
+			ret = fdt_batch_put_new_nodes(o, handle);
+		if (!ret)
+			ret = fdt_batch_put_tag(o, FDT_END_NODE);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Find the edit to an original property, if any */
+static struct fdt_batch_prop *fdt_batch_edit(struct fdt_batch *b, int node,
+					     int offset)
+{
+	int i;
+
+	for (i = fdt_batch_first_prop(b, node);
+	     i < b->num_props && b->props[i].node == node; i++) {
+		if (b->props[i].offset == offset)
+			return &b->props[i];
+	}
+
+	return NULL;
+}
+
+/* Copy the structure block, making the edits along the way */
+static int fdt_batch_put_struct(struct fdt_batch_out *o)
+{
+	int stack[FDT_BATCH_MAX_DEPTH];
+	bool children_done[FDT_BATCH_MAX_DEPTH];
+	struct fdt_batch *b = o->b;
+	struct fdt_batch_prop *p;
+	int offset = 0, next, depth = -1;
+	u32 tag;
+	int ret;
+
+	do {
+		tag = fdt_next_tag(b->fdt, offset, &next);
+		if (next < 0)
+			return next;
+		ret = 0;
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			/* New subnodes of the parent go before this one */
+			if (depth >= 0 && !children_done[depth]) {
+				children_done[depth] = true;
+				ret = fdt_batch_copy(o, offset);
+				if (ret)
+					return ret;
+				ret = fdt_batch_put_new_nodes(o, stack[depth]);
+				if (ret)
+					return ret;
+			}
+			if (++depth >= FDT_BATCH_MAX_DEPTH)
+				return -FDT_ERR_BADSTRUCTURE;
+			stack[depth] = offset;
+			children_done[depth] = false;
+			ret = fdt_batch_copy(o, next);
+			if (!ret)
+				ret = fdt_batch_put_new_props(o, offset);
+			break;
+		case FDT_PROP:
+			if (depth < 0)
+				return -FDT_ERR_BADSTRUCTURE;
+			p = fdt_batch_edit(b, stack[depth], offset);
+			if (!p)
+				break;
+			ret = fdt_batch_copy(o, offset);
+			if (!ret && p->state == FDT_BATCH_SET)
+				ret = fdt_batch_put_prop(o, p);
+			o->copied = next;
+			break;
+		case FDT_END_NODE:
+			if (depth < 0)
+				return -FDT_ERR_BADSTRUCTURE;
+			if (!children_done[depth]) {
+				ret = fdt_batch_copy(o, offset);
+				if (ret)
+					return ret;
+				ret = fdt_batch_put_new_nodes(o, stack[depth]);
+			}
+			depth--;
+			break;
+		}
+		if (ret)
+			return ret;
+		offset = next;
+	} while (tag != FDT_END);
+
+	return fdt_batch_copy(o, offset);
+}
+
+static int fdt_batch_write(struct fdt_batch *b, void *buf, int bufsize)
+{
+	const void *fdt = b->fdt;
+	int rsv_off = fdt_off_mem_rsvmap(fdt);
+	int rsv_size = (b->num_rsv + 1) * sizeof(struct fdt_reserve_entry);
+	int orig_strings = fdt_size_dt_strings(fdt);
+	int strings_size = orig_strings + b->strings_len;
+	int struct_off = rsv_off + rsv_size;
+	struct fdt_batch_node **nodes = NULL;
+	struct fdt_batch_out o;
+	char *strings;
+	int ret, i;
+
+	/* Keep any gap after the header, as fdt_create() leaves */
+	if (rsv_off < sizeof(struct fdt_header) || rsv_off % 8 ||
+	    rsv_off > fdt_off_dt_struct(fdt)) {
+		rsv_off = FDT_ALIGN(sizeof(struct fdt_header), 8);
+		struct_off = rsv_off + rsv_size;
+	}
+	if (struct_off + strings_size > bufsize)
+		return -FDT_ERR_NOSPACE;
+
+	if (b->num_nodes) {
+		nodes = malloc(b->num_nodes * sizeof(*nodes));
+		if (!nodes)
+			return -FDT_ERR_NOSPACE;
+		for (i = 0; i < b->num_nodes; i++)
+			nodes[i] = &b->nodes[i];
+		qsort(nodes, b->num_nodes, sizeof(*nodes), fdt_batch_cmp_node);
+	}
+	if (b->num_props)
+		qsort(b->props, b->num_props, sizeof(*b->props),
+		      fdt_batch_cmp_prop);
+
+	o.b = b;
+	o.src = (char *)fdt + fdt_off_dt_struct(fdt);
+	o.copied = 0;
+	o.buf = buf + struct_off;
+	o.len = 0;
+	o.max = bufsize - struct_off - strings_size;
+	o.nodes = nodes;
+	ret = fdt_batch_put_struct(&o);
+	free(nodes);
+	if (ret)
+		return ret;
+
+	strings = buf + struct_off + o.len;
+	memcpy(strings, (char *)fdt + fdt_off_dt_strings(fdt), orig_strings);
+	if (b->strings_len)
+		memcpy(strings + orig_strings, b->strings, b->strings_len);
+
+	if (b->num_rsv)
+		memcpy(buf + rsv_off, b->rsv, b->num_rsv * sizeof(*b->rsv));
+	memset(buf + rsv_off + b->num_rsv * sizeof(*b->rsv), '\0',
+	       sizeof(struct fdt_reserve_entry));
+
+	memcpy(buf, fdt, rsv_off);
+	fdt_set_magic(buf, FDT_MAGIC);
+	if (fdt_version(fdt) >= 17) {
+		fdt_set_version(buf, fdt_version(fdt));
+		fdt_set_last_comp_version(buf, fdt_last_comp_version(fdt));
+	} else {
+		fdt_set_version(buf, 17);
+		fdt_set_last_comp_version(buf, 16);
+	}
+	fdt_set_boot_cpuid_phys(buf, fdt_boot_cpuid_phys(fdt));
+	fdt_set_totalsize(buf, bufsize);
+	fdt_set_off_mem_rsvmap(buf, rsv_off);
+	fdt_set_off_dt_struct(buf, struct_off);
+	fdt_set_size_dt_struct(buf, o.len);
+	fdt_set_off_dt_strings(buf, struct_off + o.len);
+	fdt_set_size_dt_strings(buf, strings_size);
+
+	return 0;
+}
+
+int fdt_batch_commit(struct fdt_batch *b, void *buf, int bufsize)
+{
+	void *tmp;
+	int ret;
+
+	if (buf && buf != b->fdt)
+		return fdt_batch_write(b, buf, bufsize);
+
+	if (!buf)
+		bufsize = fdt_totalsize(b->fdt);
+	tmp = malloc(bufsize);
+	if (!tmp)
+		return -FDT_ERR_NOSPACE;
+	ret = fdt_batch_write(b, tmp, bufsize);
+	if (!ret) {
+		memcpy(b->fdt, tmp,
+		       fdt_off_dt_strings(tmp) + fdt_size_dt_strings(tmp));
+		if (CONFIG_IS_ENABLED(OF_LIBFDT_CACHE))
+			fdt_cache_invalidate();
+	}
+	free(tmp);
+
+	return ret;
+}
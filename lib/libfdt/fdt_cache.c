@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Lookup cache for the control FDT
+ *
+ * Without a live tree every phandle dereference is a linear scan of the
+ * whole blob, and every path or alias lookup walks the tree from the root.
+ * For the control FDT (gd->fdt_blob) this keeps an index of phandles, built
+ * in a single pass, and the results of recent path lookups.
+ *
+ * Cached offsets are dropped whenever fdt_rw.c changes the layout of the
+ * tree, and are checked before use, so a stale entry can only cost a scan.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <sort.h>
+#include <asm/global_data.h>
+#include <linux/libfdt.h>
+#include "libfdt_internal.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of entries in the path cache, a power of two */
+#define FDT_CACHE_PATHS		64
+
+struct fdt_cache_phandle {
+	u32 phandle;
+	int offset;
+};
+
+struct fdt_cache_path {
+	char *path;		/* Path or alias looked up, not nul-terminated */
+	int len;		/* Length of path */
+	int offset;		/* Node offset, or -FDT_ERR_NOTFOUND */
+};
+
+static struct {
+	const void *fdt;		/* Tree being cached, NULL if none */
+	u32 off_dt_struct;		/* Layout of the tree when cached */
+	u32 size_dt_struct;
+	struct fdt_cache_phandle *phandles;	/* Sorted by phandle */
+	int num_phandles;		/* -1 if not indexed yet */
+	struct fdt_cache_path paths[FDT_CACHE_PATHS];
+} fdt_cache;
+
+/*
+ * Before relocation the cache is not used, and on ARM its BSS may overlap
+ * .rel.dyn, so it must not even be read.
+ */
+static bool fdt_cache_usable(void)
+{
+	return gd->flags & GD_FLG_FULL_MALLOC_INIT;
+}
+
+void fdt_cache_invalidate(void)
+{
+	int i;
+
+	if (!fdt_cache_usable())
+		return;
+	free(fdt_cache.phandles);
+	for (i = 0; i < FDT_CACHE_PATHS; i++)
+		free(fdt_cache.paths[i].path);
+	memset(&fdt_cache, '\0', sizeof(fdt_cache));
+}
+
+void *fdt_cache_memmove(void *dest, const void *src, size_t count)
+{
+	if (!fdt_cache_usable() || !fdt_cache.fdt)
+		return memmove(dest, src, count);
+
+	if ((char *)dest >= (char *)fdt_cache.fdt &&
+	    (char *)dest < (char *)fdt_cache.fdt +
+			   fdt_totalsize(fdt_cache.fdt))
+		fdt_cache_invalidate();
+
+	return memmove(dest, src, count);
+}
+
+/**
+ * fdt_cache_check() - Check whether the cache can be used for a tree
+ *
+ * Only the control FDT is cached, and only once there is a full malloc()
+ * heap. The cache is reset if the tree was replaced since it was filled.
+ *
+ * @fdt:	Tree being looked up
+ * @return true if the cache holds entries for @fdt
+ */
+static bool fdt_cache_check(const void *fdt)
+{
+	if (fdt != gd->fdt_blob || !fdt_cache_usable())
+		return false;
+
+	if (fdt_cache.fdt != fdt ||
+	    fdt_cache.off_dt_struct != fdt_off_dt_struct(fdt) ||
+	    fdt_cache.size_dt_struct != fdt_size_dt_struct(fdt)) {
+		fdt_cache_invalidate();
+		fdt_cache.fdt = fdt;
+		fdt_cache.off_dt_struct = fdt_off_dt_struct(fdt);
+		fdt_cache.size_dt_struct = fdt_size_dt_struct(fdt);
+		fdt_cache.num_phandles = -1;
+	}
+
+	return true;
+}
+
+static int fdt_cache_cmp_phandle(const void *v1, const void *v2)
+{
+	const struct fdt_cache_phandle *p1 = v1, *p2 = v2;
+
+	return p1->phandle < p2->phandle ? -1 : p1->phandle > p2->phandle;
+}
+
+static void fdt_cache_index_phandles(const void *fdt)
+{
+	struct fdt_cache_phandle *phandles = NULL, *tmp;
+	int offset, count = 0, size = 0;
+	u32 phandle;
+
+	for (offset = fdt_next_node(fdt, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(fdt, offset, NULL)) {
+		phandle = fdt_get_phandle(fdt, offset);
+		if (!phandle)
+			continue;
+		if (count == size) {
+			size = size ? size * 2 : 64;
+			tmp = realloc(phandles, size * sizeof(*phandles));
+			if (!tmp) {
+				free(phandles);
+				phandles = NULL;
+				count = 0;
+				break;
+			}
+			phandles = tmp;
+		}
+		phandles[count].phandle = phandle;
+		phandles[count].offset = offset;
+		count++;
+	}
+	qsort(phandles, count, sizeof(*phandles), fdt_cache_cmp_phandle);
+
+	fdt_cache.phandles = phandles;
+	fdt_cache.num_phandles = count;
+}
+
+int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
+{
+	int lo = 0, hi;
+
+	if (!phandle || phandle == ~0U || !fdt_cache_check(fdt))
+		return fdt_node_offset_by_phandle_scan(fdt, phandle);
+
+	if (fdt_cache.num_phandles < 0)
+		fdt_cache_index_phandles(fdt);
+
+	hi = fdt_cache.num_phandles;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		const struct fdt_cache_phandle *entry = &fdt_cache.phandles[mid];
+
+		if (entry->phandle == phandle) {
+			/* The tree may have been changed in place */
+			if (fdt_get_phandle(fdt, entry->offset) == phandle)
+				return entry->offset;
+			fdt_cache_invalidate();
+			break;
+		}
+		if (entry->phandle < phandle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return fdt_node_offset_by_phandle_scan(fdt, phandle);
+}
+
+static uint fdt_cache_hash(const char *path, int len)
+{
+	uint hash = 2166136261U;
+	int i;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++) {
+		hash ^= (uchar)path[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+int fdt_path_offset_namelen(const void *fdt, const char *path, int namelen)
+{
+	struct fdt_cache_path *entry;
+	int offset;
+
+	if (!fdt_cache_check(fdt))
+		return fdt_path_offset_namelen_scan(fdt, path, namelen);
+
+	entry = &fdt_cache.paths[fdt_cache_hash(path, namelen) &
+				 (FDT_CACHE_PATHS - 1)];
+	if (entry->path && entry->len == namelen &&
+	    !memcmp(entry->path, path, namelen) &&
+	    (entry->offset < 0 ||
+	     fdt_check_node_offset_(fdt, entry->offset) >= 0))
+		return entry->offset;
+
+	offset = fdt_path_offset_namelen_scan(fdt, path, namelen);
+	if (offset >= 0 || offset == -FDT_ERR_NOTFOUND) {
+		free(entry->path);
+		entry->path = malloc(namelen);
+		if (entry->path) {
+			memcpy(entry->path, path, namelen);
+			entry->len = namelen;
+			entry->offset = offset;
+		}
+	}
+
+	return offset;
+}
+
+int fdt_path_offset(const void *fdt, const char *path)
+{
+	return fdt_path_offset_namelen(fdt, path, strlen(path));
+}
+
+const char *fdt_get_alias_namelen(const void *fdt, const char *name,
+				  int namelen)
+{
+	int aliasoffset;
+
+	aliasoffset = fdt_path_offset(fdt, "/aliases");
+	if (aliasoffset < 0)
+		return NULL;
+
+	return fdt_getprop_namelen(fdt, aliasoffset, name, namelen, NULL);
+}
+
+const char *fdt_get_alias(const void *fdt, const char *name)
+{
+	return fdt_get_alias_namelen(fdt, name, strlen(name));
+}
@@ -1,2 +1,18 @@
 #include <linux/libfdt_env.h>
 #include "../../scripts/dtc/libfdt/fdt_overlay.c"
+
+/* The steps of fdt_overlay_apply() which fdt_overlay_batch.c shares */
+uint32_t fdt_overlay_target_phandle_(const void *fdto, int fragment)
+{
+	return overlay_get_target_phandle(fdto, fragment);
+}
+
+int fdt_overlay_adjust_local_phandles_(void *fdto, uint32_t delta)
+{
+	return overlay_adjust_local_phandles(fdto, delta);
+}
+
+int fdt_overlay_update_local_references_(void *fdto, uint32_t delta)
+{
+	return overlay_update_local_references(fdto, delta);
+}
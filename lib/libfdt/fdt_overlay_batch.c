@@ -0,0 +1,702 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Applying overlays in a batch
+ *
+ * fdt_overlay_apply() looks up each fixup and fragment target by walking the
+ * base tree, and every property it merges moves the rest of the blob. Here
+ * the phandles and symbols of the base are indexed once and the merge is
+ * recorded in a struct fdt_batch, so any number of overlays cost a single
+ * write of the result. Changes to the overlay itself (phandle adjustment
+ * and fixups) are made in place, as fdt_overlay_apply() does.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <fdt_batch.h>
+#include <malloc.h>
+#include <sort.h>
+#include <time.h>
+#include "libfdt_internal.h"
+
+struct fdt_overlay_phandle {
+	u32 phandle;
+	int node;		/* Node handle in the batch */
+};
+
+struct fdt_overlay_symbol {
+	const char *name;
+	const char *path;
+	char *buf;		/* Holds name and path if allocated, else NULL */
+};
+
+static int overlay_batch_cmp_phandle(const void *v1, const void *v2)
+{
+	const struct fdt_overlay_phandle *p1 = v1, *p2 = v2;
+
+	if (p1->phandle != p2->phandle)
+		return p1->phandle < p2->phandle ? -1 : 1;
+
+	return p1->node - p2->node;
+}
+
+static int overlay_batch_cmp_symbol(const void *v1, const void *v2)
+{
+	const struct fdt_overlay_symbol *s1 = v1, *s2 = v2;
+
+	return strcmp(s1->name, s2->name);
+}
+
+/* Find the first phandle entry which is not before (@phandle, @node) */
+static int overlay_batch_phandle_pos(struct fdt_overlay_batch *ob,
+				     u32 phandle, int node)
+{
+	struct fdt_overlay_phandle key = { phandle, node };
+	int lo = 0, hi = ob->num_phandles;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (overlay_batch_cmp_phandle(&ob->phandles[mid], &key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Look up a phandle, giving the first node in the tree if it is repeated */
+static int overlay_batch_node_by_phandle(struct fdt_overlay_batch *ob,
+					 u32 phandle)
+{
+	int i;
+
+	i = overlay_batch_phandle_pos(ob, phandle, -1);
+	if (i < ob->num_phandles && ob->phandles[i].phandle == phandle)
+		return ob->phandles[i].node;
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+static int overlay_batch_set_phandle(struct fdt_overlay_batch *ob, int node,
+				     u32 old, u32 new)
+{
+	int i, ret;
+
+	if (old) {
+		i = overlay_batch_phandle_pos(ob, old, node);
+		if (i < ob->num_phandles && ob->phandles[i].node == node) {
+			ob->num_phandles--;
+			memmove(&ob->phandles[i], &ob->phandles[i + 1],
+				(ob->num_phandles - i) * sizeof(*ob->phandles));
+		}
+	}
+	if (!new)
+		return 0;
+
+	ret = fdt_batch_grow((void **)&ob->phandles, ob->num_phandles,
+			     &ob->max_phandles, sizeof(*ob->phandles));
+	if (ret)
+		return ret;
+	i = overlay_batch_phandle_pos(ob, new, node);
+	memmove(&ob->phandles[i + 1], &ob->phandles[i],
+		(ob->num_phandles - i) * sizeof(*ob->phandles));
+	ob->phandles[i].phandle = new;
+	ob->phandles[i].node = node;
+	ob->num_phandles++;
+
+	return 0;
+}
+
+/* Find the first symbol whose name is not before @name */
+static int overlay_batch_symbol_pos(struct fdt_overlay_batch *ob,
+				    const char *name)
+{
+	int lo = 0, hi = ob->num_symbols;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (strcmp(ob->symbols[mid].name, name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int overlay_batch_set_symbol(struct fdt_overlay_batch *ob,
+				    const char *name, const char *path,
+				    int len)
+{
+	struct fdt_overlay_symbol *sym;
+	int namelen = strlen(name);
+	char *buf;
+	int i, ret;
+
+	buf = malloc(namelen + 1 + len + 1);
+	if (!buf)
+		return -FDT_ERR_NOSPACE;
+	memcpy(buf, name, namelen + 1);
+	memcpy(buf + namelen + 1, path, len);
+	buf[namelen + 1 + len] = '\0';
+
+	i = overlay_batch_symbol_pos(ob, name);
+	if (i == ob->num_symbols || strcmp(ob->symbols[i].name, name)) {
+		ret = fdt_batch_grow((void **)&ob->symbols, ob->num_symbols,
+				     &ob->max_symbols, sizeof(*ob->symbols));
+		if (ret) {
+			free(buf);
+			return ret;
+		}
+		memmove(&ob->symbols[i + 1], &ob->symbols[i],
+			(ob->num_symbols - i) * sizeof(*ob->symbols));
+		ob->symbols[i].buf = NULL;
+		ob->num_symbols++;
+	}
+	sym = &ob->symbols[i];
+	free(sym->buf);
+	sym->buf = buf;
+	sym->name = buf;
+	sym->path = buf + namelen + 1;
+
+	return 0;
+}
+
+/* Set a property, keeping the phandle and symbol indexes up to date */
+static int overlay_batch_setprop(struct fdt_overlay_batch *ob, int node,
+				 const char *name, const void *val, int len)
+{
+	bool is_phandle;
+	u32 old = 0, new;
+	int ret;
+
+	is_phandle = !strcmp(name, "phandle") ||
+		     !strcmp(name, "linux,phandle");
+	if (is_phandle)
+		old = fdt_batch_get_phandle(&ob->b, node);
+
+	ret = fdt_batch_setprop(&ob->b, node, name, val, len);
+	if (ret)
+		return ret;
+
+	if (is_phandle) {
+		new = fdt_batch_get_phandle(&ob->b, node);
+		if (new != old) {
+			ret = overlay_batch_set_phandle(ob, node, old, new);
+			if (ret)
+				return ret;
+		}
+	}
+	if (node == ob->symbols_node)
+		return overlay_batch_set_symbol(ob, name, val, len);
+
+	return 0;
+}
+
+static int overlay_batch_index(struct fdt_overlay_batch *ob)
+{
+	const void *fdt = ob->b.fdt;
+	struct fdt_overlay_symbol *sym;
+	struct fdt_overlay_phandle *ph;
+	int node, prop, len, ret;
+	const char *path;
+	u32 phandle;
+
+	for (node = fdt_next_node(fdt, -1, NULL); node >= 0;
+	     node = fdt_next_node(fdt, node, NULL)) {
+		phandle = fdt_get_phandle(fdt, node);
+		if (!phandle)
+			continue;
+		ret = fdt_batch_grow((void **)&ob->phandles, ob->num_phandles,
+				     &ob->max_phandles, sizeof(*ob->phandles));
+		if (ret)
+			return ret;
+		ph = &ob->phandles[ob->num_phandles++];
+		ph->phandle = phandle;
+		ph->node = node;
+	}
+	if (node != -FDT_ERR_NOTFOUND)
+		return node;
+	if (ob->num_phandles)
+		qsort(ob->phandles, ob->num_phandles, sizeof(*ob->phandles),
+		      overlay_batch_cmp_phandle);
+
+	ob->symbols_node = fdt_subnode_offset(fdt, 0, "__symbols__");
+	if (ob->symbols_node < 0)
+		return 0;
+
+	/* Values in the base tree stay put until the commit */
+	fdt_for_each_property_offset(prop, fdt, ob->symbols_node) {
+		ret = fdt_batch_grow((void **)&ob->symbols, ob->num_symbols,
+				     &ob->max_symbols, sizeof(*ob->symbols));
+		if (ret)
+			return ret;
+		sym = &ob->symbols[ob->num_symbols];
+		path = fdt_getprop_by_offset(fdt, prop, &sym->name, &len);
+		if (!path || !memchr(path, '\0', len))
+			continue;
+		sym->path = path;
+		sym->buf = NULL;
+		ob->num_symbols++;
+	}
+	if (ob->num_symbols)
+		qsort(ob->symbols, ob->num_symbols, sizeof(*ob->symbols),
+		      overlay_batch_cmp_symbol);
+
+	return 0;
+}
+
+int fdt_overlay_batch_init(struct fdt_overlay_batch *ob, void *fdt)
+{
+	int ret;
+
+	memset(ob, '\0', sizeof(*ob));
+	ob->symbols_node = -FDT_ERR_NOTFOUND;
+	ret = fdt_batch_init(&ob->b, fdt);
+	if (ret)
+		return ret;
+
+	return overlay_batch_index(ob);
+}
+
+void fdt_overlay_batch_uninit(struct fdt_overlay_batch *ob)
+{
+	int i;
+
+	for (i = 0; i < ob->num_symbols; i++)
+		free(ob->symbols[i].buf);
+	free(ob->symbols);
+	free(ob->phandles);
+	free(ob->path);
+	fdt_batch_uninit(&ob->b);
+	memset(ob, '\0', sizeof(*ob));
+}
+
+/* Make sure the path buffer holds at least @size bytes */
+static int overlay_batch_path_reserve(struct fdt_overlay_batch *ob, int size)
+{
+	char *tmp;
+	int max;
+
+	if (size <= ob->path_max)
+		return 0;
+	for (max = ob->path_max ? ob->path_max : 256; max < size; max *= 2)
+		;
+	tmp = realloc(ob->path, max);
+	if (!tmp)
+		return -FDT_ERR_NOSPACE;
+	ob->path = tmp;
+	ob->path_max = max;
+
+	return 0;
+}
+
+/* As overlay_get_target(), using the batch */
+static int overlay_batch_get_target(struct fdt_overlay_batch *ob,
+				    const void *fdto, int fragment,
+				    const char **pathp)
+{
+	const char *path = NULL;
+	int path_len = 0, ret;
+	u32 phandle;
+
+	phandle = fdt_overlay_target_phandle_(fdto, fragment);
+	if (phandle == (u32)-1)
+		return -FDT_ERR_BADPHANDLE;
+
+	if (!phandle) {
+		path = fdt_getprop(fdto, fragment, "target-path", &path_len);
+		if (path)
+			ret = fdt_batch_path_offset(&ob->b, path);
+		else
+			ret = path_len;
+	} else {
+		ret = overlay_batch_node_by_phandle(ob, phandle);
+	}
+
+	if (ret < 0 && path_len == -FDT_ERR_NOTFOUND)
+		ret = -FDT_ERR_BADOVERLAY;
+	if (ret < 0)
+		return ret;
+
+	if (pathp)
+		*pathp = path;
+
+	return ret;
+}
+
+/* Get the base phandle for a label in __fixups__ */
+static int overlay_batch_resolve(struct fdt_overlay_batch *ob,
+				 const char *label, u32 *phandlep)
+{
+	const char *path = NULL;
+	int i, node;
+
+	if (ob->symbols_node < 0)
+		return ob->symbols_node;
+
+	i = overlay_batch_symbol_pos(ob, label);
+	if (i < ob->num_symbols && !strcmp(ob->symbols[i].name, label))
+		path = ob->symbols[i].path;
+	if (!path)
+		return -FDT_ERR_NOTFOUND;
+
+	node = fdt_batch_path_offset(&ob->b, path);
+	if (node < 0)
+		return node;
+	*phandlep = fdt_batch_get_phandle(&ob->b, node);
+	if (!*phandlep)
+		return -FDT_ERR_NOTFOUND;
+
+	return 0;
+}
+
+/*
+ * As overlay_fixup_phandle(), but the label is resolved once for all the
+ * places it is used, and runs of fixups in the same node only look the
+ * node up once
+ */
+static int overlay_batch_fixup_phandle(struct fdt_overlay_batch *ob,
+				       void *fdto, int property)
+{
+	const char *value, *label;
+	const char *last_path = NULL;
+	int last_len = 0, fixup_off = 0;
+	u32 phandle = 0;
+	int len, ret;
+
+	value = fdt_getprop_by_offset(fdto, property, &label, &len);
+	if (!value) {
+		if (len == -FDT_ERR_NOTFOUND)
+			return -FDT_ERR_INTERNAL;
+
+		return len;
+	}
+
+	do {
+		const char *path, *name, *fixup_end;
+		const char *fixup_str = value;
+		u32 path_len, name_len;
+		u32 fixup_len;
+		char *sep, *endptr;
+		fdt32_t phandle_prop;
+		int poffset;
+
+		fixup_end = memchr(value, '\0', len);
+		if (!fixup_end)
+			return -FDT_ERR_BADOVERLAY;
+		fixup_len = fixup_end - fixup_str;
+
+		len -= fixup_len + 1;
+		value += fixup_len + 1;
+
+		path = fixup_str;
+		sep = memchr(fixup_str, ':', fixup_len);
+		if (!sep || *sep != ':')
+			return -FDT_ERR_BADOVERLAY;
+
+		path_len = sep - path;
+		if (path_len == (fixup_len - 1))
+			return -FDT_ERR_BADOVERLAY;
+
+		fixup_len -= path_len + 1;
+		name = sep + 1;
+		sep = memchr(name, ':', fixup_len);
+		if (!sep || *sep != ':')
+			return -FDT_ERR_BADOVERLAY;
+
+		name_len = sep - name;
+		if (!name_len)
+			return -FDT_ERR_BADOVERLAY;
+
+		poffset = strtoul(sep + 1, &endptr, 10);
+		if (*endptr != '\0' || endptr <= sep + 1)
+			return -FDT_ERR_BADOVERLAY;
+
+		if (!phandle) {
+			ret = overlay_batch_resolve(ob, label, &phandle);
+			if (ret)
+				return ret;
+		}
+
+		if (!last_path || last_len != path_len ||
+		    memcmp(last_path, path, path_len)) {
+			fixup_off = fdt_path_offset_namelen(fdto, path,
+							    path_len);
+			if (fixup_off == -FDT_ERR_NOTFOUND)
+				return -FDT_ERR_BADOVERLAY;
+			if (fixup_off < 0)
+				return fixup_off;
+			last_path = path;
+			last_len = path_len;
+		}
+
+		phandle_prop = cpu_to_fdt32(phandle);
+		ret = fdt_setprop_inplace_namelen_partial(fdto, fixup_off,
+							  name, name_len,
+							  poffset,
+							  &phandle_prop,
+							  sizeof(phandle_prop));
+		if (ret)
+			return ret;
+	} while (len > 0);
+
+	return 0;
+}
+
+static int overlay_batch_fixup_phandles(struct fdt_overlay_batch *ob,
+					void *fdto)
+{
+	int fixups_off, property, ret;
+
+	fixups_off = fdt_path_offset(fdto, "/__fixups__");
+	if (fixups_off == -FDT_ERR_NOTFOUND)
+		return 0;
+	if (fixups_off < 0)
+		return fixups_off;
+
+	if (ob->symbols_node < 0 && ob->symbols_node != -FDT_ERR_NOTFOUND)
+		return ob->symbols_node;
+
+	fdt_for_each_property_offset(property, fdto, fixups_off) {
+		ret = overlay_batch_fixup_phandle(ob, fdto, property);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* As overlay_apply_node(), using the batch */
+static int overlay_batch_apply_node(struct fdt_overlay_batch *ob, int target,
+				    void *fdto, int node)
+{
+	int property, subnode, ret;
+
+	fdt_for_each_property_offset(property, fdto, node) {
+		const char *name;
+		const void *prop;
+		int prop_len;
+
+		prop = fdt_getprop_by_offset(fdto, property, &name, &prop_len);
+		if (prop_len == -FDT_ERR_NOTFOUND)
+			return -FDT_ERR_INTERNAL;
+		if (prop_len < 0)
+			return prop_len;
+
+		ret = overlay_batch_setprop(ob, target, name, prop, prop_len);
+		if (ret)
+			return ret;
+	}
+
+	fdt_for_each_subnode(subnode, fdto, node) {
+		const char *name = fdt_get_name(fdto, subnode, NULL);
+		int nnode;
+
+		nnode = fdt_batch_add_subnode(&ob->b, target, name);
+		if (nnode == -FDT_ERR_EXISTS) {
+			nnode = fdt_batch_subnode_offset(&ob->b, target, name);
+			if (nnode == -FDT_ERR_NOTFOUND)
+				return -FDT_ERR_INTERNAL;
+		}
+		if (nnode < 0)
+			return nnode;
+
+		/* A new /__symbols__ is indexed from here on */
+		if (!target && ob->symbols_node == -FDT_ERR_NOTFOUND &&
+		    !strcmp(name, "__symbols__"))
+			ob->symbols_node = nnode;
+
+		ret = overlay_batch_apply_node(ob, nnode, fdto, subnode);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int overlay_batch_merge(struct fdt_overlay_batch *ob, void *fdto)
+{
+	int fragment, overlay, target, ret;
+
+	fdt_for_each_subnode(fragment, fdto, 0) {
+		overlay = fdt_subnode_offset(fdto, fragment, "__overlay__");
+		if (overlay == -FDT_ERR_NOTFOUND)
+			continue;
+		if (overlay < 0)
+			return overlay;
+
+		target = overlay_batch_get_target(ob, fdto, fragment, NULL);
+		if (target < 0)
+			return target;
+
+		ret = overlay_batch_apply_node(ob, target, fdto, overlay);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* As overlay_symbol_update(), using the batch */
+static int overlay_batch_symbol_update(struct fdt_overlay_batch *ob,
+				       void *fdto)
+{
+	int ov_sym, prop, path_len, fragment, target;
+	int len, frag_name_len, ret, rel_path_len;
+	const char *s, *e;
+	const char *path;
+	const char *name;
+	const char *frag_name;
+	const char *rel_path;
+	const char *target_path;
+
+	ov_sym = fdt_subnode_offset(fdto, 0, "__symbols__");
+	if (ov_sym < 0)
+		return 0;
+
+	if (ob->symbols_node == -FDT_ERR_NOTFOUND)
+		ob->symbols_node = fdt_batch_add_subnode(&ob->b, 0,
+							 "__symbols__");
+	if (ob->symbols_node < 0)
+		return ob->symbols_node;
+
+	fdt_for_each_property_offset(prop, fdto, ov_sym) {
+		path = fdt_getprop_by_offset(fdto, prop, &name, &path_len);
+		if (!path)
+			return path_len;
+
+		if (path_len < 1 ||
+		    memchr(path, '\0', path_len) != &path[path_len - 1])
+			return -FDT_ERR_BADVALUE;
+		e = path + path_len;
+
+		if (*path != '/')
+			return -FDT_ERR_BADVALUE;
+
+		/* Symbols outside a fragment do not end up in the tree */
+		s = strchr(path + 1, '/');
+		if (!s)
+			continue;
+
+		frag_name = path + 1;
+		frag_name_len = s - path - 1;
+
+		len = sizeof("/__overlay__/") - 1;
+		if (e - s > len && !memcmp(s, "/__overlay__/", len)) {
+			rel_path = s + len;
+			rel_path_len = e - rel_path;
+		} else if (e - s == len && !memcmp(s, "/__overlay__", len - 1)) {
+			rel_path = "";
+			rel_path_len = 1;
+		} else {
+			continue;
+		}
+
+		ret = fdt_subnode_offset_namelen(fdto, 0, frag_name,
+						 frag_name_len);
+		if (ret < 0)
+			return -FDT_ERR_BADOVERLAY;
+		fragment = ret;
+
+		ret = fdt_subnode_offset(fdto, fragment, "__overlay__");
+		if (ret < 0)
+			return -FDT_ERR_BADOVERLAY;
+
+		ret = overlay_batch_get_target(ob, fdto, fragment,
+					       &target_path);
+		if (ret < 0)
+			return ret;
+		target = ret;
+
+		if (target_path) {
+			len = strlen(target_path);
+			ret = overlay_batch_path_reserve(ob, len + 1);
+			if (ret)
+				return ret;
+			memcpy(ob->path, target_path, len + 1);
+		} else {
+			ret = overlay_batch_path_reserve(ob, 1);
+			while (!ret) {
+				ret = fdt_batch_get_path(&ob->b, target,
+							 ob->path,
+							 ob->path_max);
+				if (ret != -FDT_ERR_NOSPACE)
+					break;
+				ret = overlay_batch_path_reserve(ob,
+								 ob->path_max *
+								 2);
+			}
+			if (ret)
+				return ret;
+			len = strlen(ob->path);
+		}
+
+		/* The root is "/" on its own, anything else needs a '/' */
+		if (len <= 1)
+			len = 0;
+		ret = overlay_batch_path_reserve(ob, len + 1 + rel_path_len);
+		if (ret)
+			return ret;
+		ob->path[len] = '/';
+		memcpy(ob->path + len + 1, rel_path, rel_path_len);
+
+		ret = overlay_batch_setprop(ob, ob->symbols_node, name,
+					    ob->path, len + 1 + rel_path_len);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+int fdt_overlay_batch_apply(struct fdt_overlay_batch *ob, void *fdto)
+{
+	u32 delta;
+	int ret;
+
+	FDT_RO_PROBE(fdto);
+
+	/* The highest phandle in use is the last in the index */
+	delta = ob->num_phandles ?
+		ob->phandles[ob->num_phandles - 1].phandle : 0;
+
+	ret = fdt_overlay_adjust_local_phandles_(fdto, delta);
+	if (!ret)
+		ret = fdt_overlay_update_local_references_(fdto, delta);
+	if (!ret)
+		ret = overlay_batch_fixup_phandles(ob, fdto);
+	if (!ret)
+		ret = overlay_batch_merge(ob, fdto);
+	if (!ret)
+		ret = overlay_batch_symbol_update(ob, fdto);
+
+	/* The overlay has been changed in place, erase its magic */
+	fdt_set_magic(fdto, ~0);
+
+	return ret;
+}
+
+int fdt_overlay_apply_list(void *fdt, int bufsize, void *const fdtos[],
+			   int count, ulong *times_us)
+{
+	struct fdt_overlay_batch ob;
+	ulong start;
+	int i, ret;
+
+	ret = fdt_overlay_batch_init(&ob, fdt);
+	for (i = 0; !ret && i < count; i++) {
+		start = timer_get_us();
+		ret = fdt_overlay_batch_apply(&ob, fdtos[i]);
+		if (times_us)
+			times_us[i] = timer_get_us() - start;
+	}
+	if (!ret)
+		ret = fdt_overlay_batch_commit(&ob, fdt, bufsize);
+	fdt_overlay_batch_uninit(&ob);
+
+	return ret;
+}
@@ -1,2 +1,15 @@
 #include <linux/libfdt_env.h>
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_CACHE)
+/*
+ * Build the lookups under other names: fdt_cache.c provides versions which
+ * look in the cache first and fall back to these
+ */
+#define fdt_node_offset_by_phandle	fdt_node_offset_by_phandle_scan
+#define fdt_path_offset_namelen		fdt_path_offset_namelen_scan
+#define fdt_path_offset			fdt_path_offset_scan
+#define fdt_get_alias_namelen		fdt_get_alias_namelen_scan
+#define fdt_get_alias			fdt_get_alias_scan
+#endif
+
 #include "../../scripts/dtc/libfdt/fdt_ro.c"
@@ -1,2 +1,13 @@
 #include <linux/libfdt_env.h>
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_CACHE)
+/*
+ * Whatever fdt_rw.c does to the layout of a tree, it moves the data with
+ * memmove(), so that is where lookups cached for the tree are dropped
+ */
+void *fdt_cache_memmove(void *dest, const void *src, size_t count);
+
+#define memmove(dest, src, count)	fdt_cache_memmove(dest, src, count)
+#endif
+
 #include "../../scripts/dtc/libfdt/fdt_rw.c"
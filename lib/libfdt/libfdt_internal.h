@@ -1 +1,11 @@
 #include "../../scripts/dtc/libfdt/libfdt_internal.h"
+
+/* Lookups without the cache, see fdt_cache.c */
+int fdt_node_offset_by_phandle_scan(const void *fdt, uint32_t phandle);
+int fdt_path_offset_namelen_scan(const void *fdt, const char *path,
+				 int namelen);
+
+/* Steps of fdt_overlay_apply(), see fdt_overlay_batch.c */
+uint32_t fdt_overlay_target_phandle_(const void *fdto, int fragment);
+int fdt_overlay_adjust_local_phandles_(void *fdto, uint32_t delta);
+int fdt_overlay_update_local_references_(void *fdto, uint32_t delta);
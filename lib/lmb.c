@@ -56,53 +56,86 @@ static long lmb_addrs_overlap(phys_addr_t base1, phys_size_t size1,
 	return ((base1 <= base2_end) && (base2 <= base1_end));
 }
 
-static long lmb_addrs_adjacent(phys_addr_t base1, phys_size_t size1,
-			       phys_addr_t base2, phys_size_t size2)
+/* Last address in a region, which avoids overflow at the top of memory */
+static phys_addr_t lmb_region_end(const struct lmb_property *prop)
 {
-	if (base2 == base1 + size1)
-		return 1;
-	else if (base1 == base2 + size2)
-		return -1;
-
-	return 0;
+	return prop->base + prop->size - 1;
 }
 
-static long lmb_regions_adjacent(struct lmb_region *rgn, unsigned long r1,
-				 unsigned long r2)
+/*
+ * Find the first region which ends at or after @addr, or return rgn->cnt if
+ * there is none. Since regions are sorted and do not overlap, this is the
+ * only region which can contain @addr.
+ */
+static unsigned long lmb_search(struct lmb_region *rgn, phys_addr_t addr)
 {
-	phys_addr_t base1 = rgn->region[r1].base;
-	phys_size_t size1 = rgn->region[r1].size;
-	phys_addr_t base2 = rgn->region[r2].base;
-	phys_size_t size2 = rgn->region[r2].size;
+	unsigned long lo = 0, hi = rgn->cnt, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (lmb_region_end(&rgn->region[mid]) < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-	return lmb_addrs_adjacent(base1, size1, base2, size2);
+	return lo;
 }
 
 static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
 {
-	unsigned long i;
+	memmove(&rgn->region[r], &rgn->region[r + 1],
+		(rgn->cnt - r - 1) * sizeof(*rgn->region));
+	rgn->cnt--;
+}
+
+/* Insert a region at position @r, moving the list to the heap if needed */
+static long lmb_insert_region(struct lmb_region *rgn, unsigned long r,
+			      phys_addr_t base, phys_size_t size)
+{
+	struct lmb_property *region;
 
-	for (i = r; i < rgn->cnt - 1; i++) {
-		rgn->region[i].base = rgn->region[i + 1].base;
-		rgn->region[i].size = rgn->region[i + 1].size;
+	if (rgn->cnt == rgn->max) {
+		region = malloc(rgn->max * 2 * sizeof(*region));
+		if (!region)
+			return -1;
+		memcpy(region, rgn->region, rgn->cnt * sizeof(*region));
+		if (rgn->region != rgn->initial)
+			free(rgn->region);
+		rgn->region = region;
+		rgn->max *= 2;
 	}
-	rgn->cnt--;
+
+	memmove(&rgn->region[r + 1], &rgn->region[r],
+		(rgn->cnt - r) * sizeof(*rgn->region));
+	rgn->region[r].base = base;
+	rgn->region[r].size = size;
+	rgn->cnt++;
+
+	return 0;
 }
 
-/* Assumption: base addr of region 1 < base addr of region 2 */
-static void lmb_coalesce_regions(struct lmb_region *rgn, unsigned long r1,
-				 unsigned long r2)
+static void lmb_region_init(struct lmb_region *rgn)
 {
-	rgn->region[r1].size += rgn->region[r2].size;
-	lmb_remove_region(rgn, r2);
+	rgn->cnt = 0;
+	rgn->size = 0;
+	rgn->max = MAX_LMB_REGIONS;
+	rgn->region = rgn->initial;
 }
 
 void lmb_init(struct lmb *lmb)
 {
-	lmb->memory.cnt = 0;
-	lmb->memory.size = 0;
-	lmb->reserved.cnt = 0;
-	lmb->reserved.size = 0;
+	lmb_region_init(&lmb->memory);
+	lmb_region_init(&lmb->reserved);
+}
+
+void lmb_uninit(struct lmb *lmb)
+{
+	if (lmb->memory.region != lmb->memory.initial)
+		free(lmb->memory.region);
+	if (lmb->reserved.region != lmb->reserved.initial)
+		free(lmb->reserved.region);
+	lmb_init(lmb);
 }
 
 static void lmb_reserve_common(struct lmb *lmb, void *fdt_blob)
@@ -143,71 +176,40 @@ void lmb_init_and_reserve_range(struct lmb *lmb, phys_addr_t base,
 /* This routine called with relocation disabled. */
 static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t size)
 {
-	unsigned long coalesced = 0;
-	long adjacent, i;
-
-	if (rgn->cnt == 0) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		rgn->cnt = 1;
-		return 0;
-	}
+	struct lmb_property *prev, *next;
+	unsigned long i;
 
-	/* First try and coalesce this LMB with another. */
-	for (i = 0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
+	/* Regions before @i end before @base, so only @next can overlap */
+	i = lmb_search(rgn, base);
+	prev = i ? &rgn->region[i - 1] : NULL;
+	next = i < rgn->cnt ? &rgn->region[i] : NULL;
 
-		if ((rgnbase == base) && (rgnsize == size))
+	if (next && lmb_addrs_overlap(base, size, next->base, next->size)) {
+		if (next->base == base && next->size == size)
 			/* Already have this region, so we're done */
 			return 0;
-
-		adjacent = lmb_addrs_adjacent(base, size, rgnbase, rgnsize);
-		if (adjacent > 0) {
-			rgn->region[i].base -= size;
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (adjacent < 0) {
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (lmb_addrs_overlap(base, size, rgnbase, rgnsize)) {
-			/* regions overlap */
-			return -1;
-		}
-	}
-
-	if ((i < rgn->cnt - 1) && lmb_regions_adjacent(rgn, i, i + 1)) {
-		lmb_coalesce_regions(rgn, i, i + 1);
-		coalesced++;
-	}
-
-	if (coalesced)
-		return coalesced;
-	if (rgn->cnt >= MAX_LMB_REGIONS)
+		/* regions overlap */
 		return -1;
+	}
 
-	/* Couldn't coalesce the LMB, so add it to the sorted table. */
-	for (i = rgn->cnt-1; i >= 0; i--) {
-		if (base < rgn->region[i].base) {
-			rgn->region[i + 1].base = rgn->region[i].base;
-			rgn->region[i + 1].size = rgn->region[i].size;
-		} else {
-			rgn->region[i + 1].base = base;
-			rgn->region[i + 1].size = size;
-			break;
+	/* First try and coalesce this LMB with its neighbours */
+	if (prev && prev->base + prev->size == base) {
+		prev->size += size;
+		if (next && base + size == next->base) {
+			prev->size += next->size;
+			lmb_remove_region(rgn, i);
+			return 2;
 		}
+		return 1;
 	}
-
-	if (base < rgn->region[0].base) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
+	if (next && base + size == next->base) {
+		next->base = base;
+		next->size += size;
+		return 1;
 	}
 
-	rgn->cnt++;
-
-	return 0;
+	/* Couldn't coalesce the LMB, so add it to the sorted table. */
+	return lmb_insert_region(rgn, i, base, size);
 }
 
 /* This routine may be called with relocation disabled. */
@@ -223,21 +225,17 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	struct lmb_region *rgn = &(lmb->reserved);
 	phys_addr_t rgnbegin, rgnend;
 	phys_addr_t end = base + size - 1;
-	int i;
-
-	rgnbegin = rgnend = 0; /* supress gcc warnings */
+	unsigned long i;
 
 	/* Find the region where (base, size) belongs to */
-	for (i = 0; i < rgn->cnt; i++) {
-		rgnbegin = rgn->region[i].base;
-		rgnend = rgnbegin + rgn->region[i].size - 1;
-
-		if ((rgnbegin <= base) && (end <= rgnend))
-			break;
-	}
+	i = lmb_search(rgn, base);
+	if (i == rgn->cnt)
+		return -1;
+	rgnbegin = rgn->region[i].base;
+	rgnend = lmb_region_end(&rgn->region[i]);
 
 	/* Didn't find the region */
-	if (i == rgn->cnt)
+	if (rgnbegin > base || end > rgnend)
 		return -1;
 
 	/* Check to see if we are removing entire region */
@@ -264,7 +262,7 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	 * beginging of the hole and add the region after hole.
 	 */
 	rgn->region[i].size = base - rgn->region[i].base;
-	return lmb_add_region(rgn, end + 1, rgnend - end);
+	return lmb_insert_region(rgn, i + 1, end + 1, rgnend - end);
 }
 
 long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
@@ -277,16 +275,14 @@ long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 static long lmb_overlaps_region(struct lmb_region *rgn, phys_addr_t base,
 				phys_size_t size)
 {
-	unsigned long i;
+	unsigned long i = lmb_search(rgn, base);
 
-	for (i = 0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		if (lmb_addrs_overlap(base, size, rgnbase, rgnsize))
-			break;
-	}
+	if (i < rgn->cnt &&
+	    lmb_addrs_overlap(base, size, rgn->region[i].base,
+			      rgn->region[i].size))
+		return i;
 
-	return (i < rgn->cnt) ? i : -1;
+	return -1;
 }
 
 phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
@@ -382,22 +378,20 @@ phys_addr_t lmb_alloc_addr(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 /* Return number of bytes from a given address that are free */
 phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
+	unsigned long i;
 	long rgn;
 
 	/* check if the requested address is in the memory regions */
 	rgn = lmb_overlaps_region(&lmb->memory, addr, 1);
 	if (rgn >= 0) {
-		for (i = 0; i < lmb->reserved.cnt; i++) {
+		i = lmb_search(&lmb->reserved, addr);
+		if (i < lmb->reserved.cnt) {
 			if (addr < lmb->reserved.region[i].base) {
 				/* first reserved range > requested address */
 				return lmb->reserved.region[i].base - addr;
 			}
-			if (lmb->reserved.region[i].base +
-			    lmb->reserved.region[i].size > addr) {
-				/* requested addr is in this reserved range */
-				return 0;
-			}
+			/* requested addr is in this reserved range */
+			return 0;
 		}
 		/* if we come here: no reserved ranges above requested addr */
 		return lmb->memory.region[lmb->memory.cnt - 1].base +
@@ -408,15 +402,9 @@ phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr)
 
 int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
+	unsigned long i = lmb_search(&lmb->reserved, addr);
 
-	for (i = 0; i < lmb->reserved.cnt; i++) {
-		phys_addr_t upper = lmb->reserved.region[i].base +
-			lmb->reserved.region[i].size - 1;
-		if ((addr >= lmb->reserved.region[i].base) && (addr <= upper))
-			return 1;
-	}
-	return 0;
+	return i < lmb->reserved.cnt && lmb->reserved.region[i].base <= addr;
 }
 
 __weak void board_lmb_reserve(struct lmb *lmb)
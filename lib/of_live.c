@@ -315,12 +315,135 @@ static int unflatten_device_tree(const void *blob,
 	return 0;
 }
 
+/* Convert a name / value offset from a live tree image into a pointer */
+static void *of_live_image_ptr(const void *fdt_blob, const char *strings,
+			       u32 size_strings, fdt32_t loc)
+{
+	u32 off = fdt32_to_cpu(loc);
+
+	if (off == OF_LIVE_IMAGE_NONE)
+		return NULL;
+	if (off & OF_LIVE_IMAGE_LOCAL) {
+		off &= ~OF_LIVE_IMAGE_LOCAL;
+		return off < size_strings ? (void *)strings + off : NULL;
+	}
+
+	return off < fdt_totalsize(fdt_blob) ? (void *)fdt_blob + off : NULL;
+}
+
+/* Convert a node index from a live tree image into a pointer */
+static struct device_node *of_live_image_node(struct device_node *nodes,
+					      u32 num_nodes, fdt32_t idx,
+					      bool *badp)
+{
+	u32 i = fdt32_to_cpu(idx);
+
+	if (i == OF_LIVE_IMAGE_NONE)
+		return NULL;
+	if (i >= num_nodes) {
+		*badp = true;
+		return NULL;
+	}
+
+	return &nodes[i];
+}
+
+int of_live_map(const void *fdt_blob, const void *image,
+		struct device_node **rootp)
+{
+	const struct of_live_image_header *hdr = image;
+	const struct of_live_image_node *in;
+	const struct of_live_image_prop *ip;
+	struct device_node *nodes, *np;
+	struct property *props, *pp;
+	u32 num_nodes, num_props, size_strings, i, j, first, count;
+	const char *strings;
+	bool bad = false;
+
+	num_nodes = fdt32_to_cpu(hdr->num_nodes);
+	num_props = fdt32_to_cpu(hdr->num_props);
+	size_strings = fdt32_to_cpu(hdr->size_strings);
+	/* The tables follow each other, in this order */
+	if (!num_nodes ||
+	    fdt32_to_cpu(hdr->off_nodes) + num_nodes * sizeof(*in) >
+	    fdt32_to_cpu(hdr->off_props) ||
+	    fdt32_to_cpu(hdr->off_props) + num_props * sizeof(*ip) >
+	    fdt32_to_cpu(hdr->off_strings) ||
+	    fdt32_to_cpu(hdr->off_strings) + size_strings >
+	    fdt32_to_cpu(hdr->totalsize))
+		return -EINVAL;
+	in = image + fdt32_to_cpu(hdr->off_nodes);
+	ip = image + fdt32_to_cpu(hdr->off_props);
+	strings = image + fdt32_to_cpu(hdr->off_strings);
+
+	nodes = malloc(num_nodes * sizeof(*nodes) + num_props * sizeof(*props));
+	if (!nodes)
+		return -ENOMEM;
+	props = (struct property *)(nodes + num_nodes);
+
+	for (i = 0, np = nodes; i < num_nodes; i++, in++, np++) {
+		np->full_name = of_live_image_ptr(fdt_blob, strings,
+						  size_strings, in->full_name);
+		np->name = of_live_image_ptr(fdt_blob, strings, size_strings,
+					     in->name);
+		np->type = of_live_image_ptr(fdt_blob, strings, size_strings,
+					     in->type);
+		if (!np->type)
+			np->type = "<NULL>";
+		np->phandle = fdt32_to_cpu(in->phandle);
+		np->parent = of_live_image_node(nodes, num_nodes, in->parent,
+						&bad);
+		np->child = of_live_image_node(nodes, num_nodes, in->child,
+					       &bad);
+		np->sibling = of_live_image_node(nodes, num_nodes, in->sibling,
+						 &bad);
+		if (!np->full_name || !np->name)
+			bad = true;
+
+		first = fdt32_to_cpu(in->props);
+		count = fdt32_to_cpu(in->num_props);
+		if (first > num_props || count > num_props - first)
+			bad = true;
+		if (bad)
+			break;
+		np->properties = count ? &props[first] : NULL;
+		for (j = 0, pp = &props[first]; j < count; j++, pp++) {
+			const struct of_live_image_prop *src = &ip[first + j];
+
+			pp->name = of_live_image_ptr(fdt_blob, strings,
+						     size_strings, src->name);
+			pp->length = fdt32_to_cpu(src->length);
+			pp->value = of_live_image_ptr(fdt_blob, strings,
+						      size_strings, src->value);
+			pp->next = j + 1 < count ? pp + 1 : NULL;
+			if (!pp->name || !pp->value)
+				bad = true;
+		}
+	}
+	if (bad) {
+		debug("Invalid live tree image at node %u\n", i);
+		free(nodes);
+		return -EINVAL;
+	}
+	*rootp = nodes;
+
+	return 0;
+}
+
 int of_live_build(const void *fdt_blob, struct device_node **rootp)
 {
+	const void *image = NULL;
 	int ret;
 
 	debug("%s: start\n", __func__);
-	ret = unflatten_device_tree(fdt_blob, rootp);
+	if (IS_ENABLED(CONFIG_OF_LIVE_IMAGE) && fdt_blob)
+		image = of_live_image_find(fdt_blob);
+	ret = image ? of_live_map(fdt_blob, image, rootp) : -ENOENT;
+	if (ret) {
+		if (image)
+			debug("Ignoring live tree image: err=%d\n", ret);
+		ret = unflatten_device_tree(fdt_blob, rootp);
+	}
 	if (ret) {
 		debug("Failed to create live tree: err=%d\n", ret);
 		return ret;
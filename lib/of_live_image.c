@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Pre-unflattened live tree images
+ *
+ * These record what unflatten_device_tree() in lib/of_live.c would build for
+ * a flat tree, so that of_live_map() can set up the live tree at boot
+ * without walking the flat tree twice.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#ifndef USE_HOSTCC
+#include <common.h>
+#include <linux/libfdt.h>
+#else
+#include "fdt_host.h"
+#include "imagetool.h"
+#endif
+#include <of_live.h>
+
+#define FDT_MAX_DEPTH	32
+
+/* Offset of the "name" string, which starts the image string table */
+#define OF_LIVE_IMAGE_NAME	OF_LIVE_IMAGE_LOCAL
+
+/**
+ * of_live_image_walk() - work through the nodes of a flat tree
+ *
+ * This works like unflatten_dt_node(): first with @hdr set to NULL, to count
+ * the nodes, properties and string bytes needed, then again to fill in the
+ * image tables, which the caller has set up in @hdr.
+ *
+ * @fdt: Flat tree to walk
+ * @hdr: Image to fill in, or NULL to just count
+ * @num_nodesp: Returns number of nodes
+ * @num_propsp: Returns number of properties
+ * @size_stringsp: Returns number of bytes of strings
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+static int of_live_image_walk(const void *fdt, struct of_live_image_header *hdr,
+			      uint *num_nodesp, uint *num_propsp,
+			      uint *size_stringsp)
+{
+	struct of_live_image_node *nodes = NULL;
+	struct of_live_image_prop *props = NULL;
+	char *strings = NULL;
+	uint parent[FDT_MAX_DEPTH], plen[FDT_MAX_DEPTH], last[FDT_MAX_DEPTH];
+	uint num_nodes = 0, num_props = 0, size_strings;
+	int node, depth = 0;
+
+	if (hdr) {
+		nodes = (void *)hdr + fdt32_to_cpu(hdr->off_nodes);
+		props = (void *)hdr + fdt32_to_cpu(hdr->off_props);
+		strings = (void *)hdr + fdt32_to_cpu(hdr->off_strings);
+		memcpy(strings, "name", 5);
+	}
+	size_strings = 5;
+
+	for (node = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(fdt, node, &depth)) {
+		struct of_live_image_node *np = NULL;
+		uint name = OF_LIVE_IMAGE_NONE, type = OF_LIVE_IMAGE_NONE;
+		uint phandle = 0, first = num_props, flen, idx = num_nodes++;
+		const char *pathp, *at;
+		int prop, len;
+
+		if (depth >= FDT_MAX_DEPTH)
+			return -FDT_ERR_BADSTRUCTURE;
+		pathp = fdt_get_name(fdt, node, &len);
+		if (!pathp)
+			return len;
+
+		/* The full name is built as in unflatten_dt_node() */
+		if (!depth)
+			flen = 1;
+		else
+			flen = (depth > 1 ? plen[depth - 1] : 0) + 1 + len;
+		if (hdr) {
+			char *fn = strings + size_strings;
+
+			np = &nodes[idx];
+			np->full_name = cpu_to_fdt32(OF_LIVE_IMAGE_LOCAL |
+						     size_strings);
+			np->child = cpu_to_fdt32(OF_LIVE_IMAGE_NONE);
+			np->sibling = cpu_to_fdt32(OF_LIVE_IMAGE_NONE);
+			if (depth > 1) {
+				struct of_live_image_node *dad;
+				uint pfn;
+
+				dad = &nodes[parent[depth - 1]];
+				pfn = fdt32_to_cpu(dad->full_name);
+				pfn &= ~OF_LIVE_IMAGE_LOCAL;
+				memcpy(fn, strings + pfn, plen[depth - 1]);
+				fn += plen[depth - 1];
+			}
+			*fn++ = '/';
+			memcpy(fn, pathp, depth ? len + 1 : 1);
+
+			if (depth) {
+				uint prev = last[depth - 1];
+
+				np->parent = cpu_to_fdt32(parent[depth - 1]);
+				if (prev == OF_LIVE_IMAGE_NONE)
+					nodes[parent[depth - 1]].child =
+						cpu_to_fdt32(idx);
+				else
+					nodes[prev].sibling = cpu_to_fdt32(idx);
+			} else {
+				np->parent = cpu_to_fdt32(OF_LIVE_IMAGE_NONE);
+			}
+		}
+		size_strings += flen + 1;
+		if (depth)
+			last[depth - 1] = idx;
+		parent[depth] = idx;
+		plen[depth] = flen;
+		last[depth] = OF_LIVE_IMAGE_NONE;
+
+		fdt_for_each_property_offset(prop, fdt, node) {
+			const char *pname;
+			const void *val;
+			uint voff;
+			int sz;
+
+			val = fdt_getprop_by_offset(fdt, prop, &pname, &sz);
+			if (!val || !pname)
+				return -FDT_ERR_INTERNAL;
+			voff = (const char *)val - (const char *)fdt;
+			if (!strcmp(pname, "name") &&
+			    name == OF_LIVE_IMAGE_NONE)
+				name = voff;
+			else if (!strcmp(pname, "device_type") &&
+				 type == OF_LIVE_IMAGE_NONE)
+				type = voff;
+			/* The same phandle rules as unflatten_dt_node() */
+			if (sz >= 4 &&
+			    ((!phandle && (!strcmp(pname, "phandle") ||
+					   !strcmp(pname, "linux,phandle"))) ||
+			     !strcmp(pname, "ibm,phandle")))
+				phandle = fdt32_to_cpu(*(const fdt32_t *)val);
+			if (hdr) {
+				struct of_live_image_prop *pp;
+
+				pp = &props[num_props];
+				pp->name = cpu_to_fdt32(pname -
+							(const char *)fdt);
+				pp->length = cpu_to_fdt32(sz);
+				pp->value = cpu_to_fdt32(voff);
+			}
+			num_props++;
+		}
+		if (prop != -FDT_ERR_NOTFOUND)
+			return prop;
+
+		/* Add a "name" property from the unit name if there is none */
+		if (name == OF_LIVE_IMAGE_NONE) {
+			at = depth ? strrchr(pathp, '@') : NULL;
+			len = depth ? (at ? at - pathp : len) : 0;
+			name = OF_LIVE_IMAGE_LOCAL | size_strings;
+			if (hdr) {
+				struct of_live_image_prop *pp;
+
+				pp = &props[num_props];
+				memcpy(strings + size_strings, pathp, len);
+				strings[size_strings + len] = '\0';
+				pp->name = cpu_to_fdt32(OF_LIVE_IMAGE_NAME);
+				pp->length = cpu_to_fdt32(len + 1);
+				pp->value = cpu_to_fdt32(name);
+			}
+			size_strings += len + 1;
+			num_props++;
+		}
+
+		if (hdr) {
+			np->name = cpu_to_fdt32(name);
+			np->type = cpu_to_fdt32(type);
+			np->phandle = cpu_to_fdt32(phandle);
+			np->props = cpu_to_fdt32(first);
+			np->num_props = cpu_to_fdt32(num_props - first);
+		}
+	}
+	if (node < 0 && node != -FDT_ERR_NOTFOUND)
+		return node;
+
+	*num_nodesp = num_nodes;
+	*num_propsp = num_props;
+	*size_stringsp = size_strings;
+
+	return 0;
+}
+
+int of_live_image_create(const void *fdt, void *buf, int size)
+{
+	struct of_live_image_header *hdr = buf;
+	struct of_live_image_node *nodes;
+	struct of_live_image_prop *props;
+	uint num_nodes, num_props, size_strings, off_props, off_strings;
+	uint totalsize;
+	int ret;
+
+	ret = fdt_check_header(fdt);
+	if (ret)
+		return ret;
+	/* Older trees have full paths as node names */
+	if (fdt_version(fdt) < 0x10)
+		return -FDT_ERR_BADVERSION;
+	/* Offsets into the tree must not collide with OF_LIVE_IMAGE_LOCAL */
+	if (fdt_totalsize(fdt) >= OF_LIVE_IMAGE_LOCAL)
+		return -FDT_ERR_TRUNCATED;
+
+	ret = of_live_image_walk(fdt, NULL, &num_nodes, &num_props,
+				 &size_strings);
+	if (ret)
+		return ret;
+	off_props = sizeof(*hdr) + num_nodes * sizeof(*nodes);
+	off_strings = off_props + num_props * sizeof(*props);
+	totalsize = ALIGN(off_strings + size_strings, 4);
+	if (!buf)
+		return totalsize;
+	if (totalsize > size)
+		return -FDT_ERR_NOSPACE;
+
+	memset(buf, '\0', totalsize);
+	hdr->magic = cpu_to_fdt32(OF_LIVE_IMAGE_MAGIC);
+	hdr->version = cpu_to_fdt32(OF_LIVE_IMAGE_VERSION);
+	hdr->totalsize = cpu_to_fdt32(totalsize);
+	hdr->fdt_size = cpu_to_fdt32(fdt_totalsize(fdt));
+	hdr->fdt_size_struct = cpu_to_fdt32(fdt_size_dt_struct(fdt));
+	hdr->fdt_size_strings = cpu_to_fdt32(fdt_size_dt_strings(fdt));
+	hdr->num_nodes = cpu_to_fdt32(num_nodes);
+	hdr->num_props = cpu_to_fdt32(num_props);
+	hdr->off_nodes = cpu_to_fdt32(sizeof(*hdr));
+	hdr->off_props = cpu_to_fdt32(off_props);
+	hdr->off_strings = cpu_to_fdt32(off_strings);
+	hdr->size_strings = cpu_to_fdt32(size_strings);
+
+	ret = of_live_image_walk(fdt, hdr, &num_nodes, &num_props,
+				 &size_strings);
+	if (ret)
+		return ret;
+
+	return totalsize;
+}
+
+const void *of_live_image_find(const void *fdt)
+{
+	const struct of_live_image_header *hdr;
+
+	hdr = fdt + ALIGN(fdt_totalsize(fdt), OF_LIVE_IMAGE_ALIGN);
+	if (fdt32_to_cpu(hdr->magic) != OF_LIVE_IMAGE_MAGIC ||
+	    fdt32_to_cpu(hdr->version) != OF_LIVE_IMAGE_VERSION)
+		return NULL;
+
+	/* Make sure that the image was created from this tree */
+	if (fdt32_to_cpu(hdr->fdt_size) != fdt_totalsize(fdt) ||
+	    fdt32_to_cpu(hdr->fdt_size_struct) != fdt_size_dt_struct(fdt) ||
+	    fdt32_to_cpu(hdr->fdt_size_strings) != fdt_size_dt_strings(fdt))
+		return NULL;
+
+	return hdr;
+}
+
+int of_live_image_size(const void *fdt)
+{
+	const struct of_live_image_header *hdr = of_live_image_find(fdt);
+
+	if (!hdr)
+		return 0;
+
+	return (const void *)hdr - fdt - fdt_totalsize(fdt) +
+		fdt32_to_cpu(hdr->totalsize);
+}
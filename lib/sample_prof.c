@@ -0,0 +1,361 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sampling profiler driven by the ARM generic timer
+ *
+ * Unlike function tracing (lib/trace.c) this needs no special build: a
+ * periodic virtual-timer interrupt records the interrupted PC, and
+ * optionally the link register and the frame-pointer chain, into a ring
+ * buffer. At the default rate of 1kHz the handler costs well under 1% of
+ * the CPU time.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#define pr_fmt(fmt) "sprof: " fmt
+
+#include <common.h>
+#include <interrupts.h>
+#include <kallsyms.h>
+#include <log.h>
+#include <malloc.h>
+#include <sample_prof.h>
+#include <sort.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <asm/ptrace.h>
+#include <asm/sections.h>
+#include <linux/errno.h>
+#include <linux/sizes.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Frame records further than this from the interrupted one are bogus */
+#define SPROF_MAX_STACK		SZ_64K
+
+struct sprof_state {
+	struct trace_sample *buf;	/* Ring buffer of samples */
+	ulong size;			/* Number of entries in buf */
+	ulong head;			/* Next entry to write */
+	ulong count;			/* Samples taken since the last reset */
+	ulong outside;			/* Samples with PC outside U-Boot text */
+	ulong period;			/* Timer period in ticks */
+	uint hz;
+	uint flags;			/* enum sample_prof_flags */
+	u64 start_ticks;		/* Time sampling was last started */
+	u64 run_ticks;			/* Sampling time before start_ticks */
+	u64 handler_ticks;		/* Time spent in the timer handler */
+	bool running;
+	bool irq_requested;
+};
+
+/* A histogram entry, used by sample_prof_print_hist() */
+struct sprof_bucket {
+	ulong addr;		/* Symbol address, or PC if no symbol */
+	const char *name;	/* Symbol name, NULL if unknown */
+	uint count;
+};
+
+static struct sprof_state sprof;
+
+static void sprof_timer_arm(ulong ticks)
+{
+	asm volatile("msr cntv_tval_el0, %0" : : "r" (ticks));
+	asm volatile("msr cntv_ctl_el0, %0" : : "r" (1UL));
+}
+
+static void sprof_timer_disarm(void)
+{
+	asm volatile("msr cntv_ctl_el0, %0" : : "r" (0UL));
+}
+
+static ulong sprof_text_base(void)
+{
+	if (gd->flags & GD_FLG_RELOC)
+		return gd->relocaddr;
+
+	return CONFIG_SYS_TEXT_BASE;
+}
+
+/**
+ * sprof_walk_frames() - Record return addresses from the frame-pointer chain
+ *
+ * Frame records must lie above our own stack frame and each one must be
+ * above the previous one, so a corrupt chain cannot send us off into the
+ * weeds.
+ *
+ * @fp:		Frame pointer (x29) of the interrupted code
+ * @base:	Start of U-Boot text
+ * @s:		Sample to update
+ */
+static void sprof_walk_frames(ulong fp, ulong base, struct trace_sample *s)
+{
+	ulong lo = (ulong)&fp;
+	ulong hi = fp + SPROF_MAX_STACK;
+	int i;
+
+	if ((gd->flags & GD_FLG_RELOC) && gd->start_addr_sp > lo &&
+	    gd->start_addr_sp < hi)
+		hi = gd->start_addr_sp;
+
+	for (i = 0; i < TRACE_SAMPLE_DEPTH; i++) {
+		ulong *frame = (ulong *)fp;
+
+		if (fp <= lo || fp + 2 * sizeof(ulong) > hi ||
+		    (fp & (sizeof(ulong) - 1)))
+			break;
+		s->caller[i] = frame[1] - base;
+		lo = fp;
+		fp = frame[0];
+	}
+}
+
+static void sprof_timer_handler(void *arg)
+{
+	struct pt_regs *regs = get_irq_regs();
+	ulong text_size = __image_copy_end - __image_copy_start;
+	struct trace_sample *s;
+	u64 start = get_ticks();
+	ulong base;
+
+	sprof_timer_arm(sprof.period);
+	if (!regs)
+		return;
+
+	base = sprof_text_base();
+	s = &sprof.buf[sprof.head];
+	memset(s, '\0', sizeof(*s));
+	s->pc = regs->elr - base;
+	if (regs->elr - base >= text_size)
+		sprof.outside++;
+	if (sprof.flags & SAMPLE_PROF_LR)
+		s->lr = regs->regs[30] - base;
+	if (sprof.flags & SAMPLE_PROF_FP)
+		sprof_walk_frames(regs->regs[29], base, s);
+
+	if (++sprof.head == sprof.size)
+		sprof.head = 0;
+	sprof.count++;
+	sprof.handler_ticks += get_ticks() - start;
+}
+
+int sample_prof_start(uint hz, uint flags)
+{
+	int ret;
+
+	if (!hz)
+		hz = CONFIG_SAMPLE_PROF_HZ;
+	if (hz > get_tbclk())
+		return -EINVAL;
+
+	if (!sprof.buf) {
+		sprof.buf = calloc(CONFIG_SAMPLE_PROF_BUF_ENTRIES,
+				   sizeof(*sprof.buf));
+		if (!sprof.buf)
+			return -ENOMEM;
+		sprof.size = CONFIG_SAMPLE_PROF_BUF_ENTRIES;
+	}
+
+	if (!sprof.irq_requested) {
+		ret = request_irq(CONFIG_SAMPLE_PROF_IRQ, sprof_timer_handler,
+				  NULL, IRQ_TYPE_LEVEL_HIGH);
+		if (ret)
+			return log_msg_ret("irq", ret);
+		sprof.irq_requested = true;
+	}
+
+	sprof.hz = hz;
+	sprof.flags = flags;
+	sprof.period = get_tbclk() / hz;
+	if (!sprof.running) {
+		sprof.start_ticks = get_ticks();
+		sprof.running = true;
+	}
+	sprof_timer_arm(sprof.period);
+	enable_irq(CONFIG_SAMPLE_PROF_IRQ);
+	log_debug("sampling at %u Hz, period %lu ticks\n", hz, sprof.period);
+
+	return 0;
+}
+
+void sample_prof_stop(void)
+{
+	if (!sprof.running)
+		return;
+
+	disable_irq(CONFIG_SAMPLE_PROF_IRQ);
+	sprof_timer_disarm();
+	sprof.run_ticks += get_ticks() - sprof.start_ticks;
+	sprof.running = false;
+}
+
+void sample_prof_reset(void)
+{
+	sample_prof_stop();
+	if (sprof.irq_requested)
+		free_irq(CONFIG_SAMPLE_PROF_IRQ);
+	free(sprof.buf);
+	memset(&sprof, '\0', sizeof(sprof));
+}
+
+/* Stop the timer interrupt while the buffer is being read */
+static bool sprof_pause(void)
+{
+	if (sprof.running)
+		disable_irq(CONFIG_SAMPLE_PROF_IRQ);
+
+	return sprof.running;
+}
+
+static void sprof_resume(bool was_running)
+{
+	if (was_running)
+		enable_irq(CONFIG_SAMPLE_PROF_IRQ);
+}
+
+static ulong sprof_kept(void)
+{
+	return min(sprof.count, sprof.size);
+}
+
+void sample_prof_print_stats(void)
+{
+	u64 elapsed = sprof.run_ticks;
+	u64 permyriad = 0;
+
+	if (sprof.running)
+		elapsed += get_ticks() - sprof.start_ticks;
+	if (elapsed)
+		permyriad = sprof.handler_ticks * 10000 / elapsed;
+
+	printf("Sampling %s at %u Hz%s%s\n",
+	       sprof.running ? "running" : "stopped", sprof.hz,
+	       sprof.flags & SAMPLE_PROF_LR ? ", lr" : "",
+	       sprof.flags & SAMPLE_PROF_FP ? ", callchain" : "");
+	printf("%15lu samples taken\n", sprof.count);
+	printf("%15lu samples in buffer (size %lu)\n", sprof_kept(),
+	       sprof.size);
+	printf("%15lu samples outside U-Boot text\n", sprof.outside);
+	printf("%15lu ms sampled\n", (ulong)(elapsed * 1000 / get_tbclk()));
+	printf("%12lu.%02lu%% time in sample handler\n",
+	       (ulong)(permyriad / 100), (ulong)(permyriad % 100));
+}
+
+static const char *sprof_symbol(ulong addr, ulong *base)
+{
+	const char *name = NULL;
+
+	if (IS_ENABLED(CONFIG_KALLSYMS))
+		name = symbol_lookup(addr, base);
+	if (!name)
+		*base = addr;
+
+	return name;
+}
+
+static int sprof_cmp_pc(const void *v1, const void *v2)
+{
+	u32 pc1 = *(const u32 *)v1, pc2 = *(const u32 *)v2;
+
+	return pc1 < pc2 ? -1 : pc1 > pc2;
+}
+
+static int sprof_cmp_count(const void *v1, const void *v2)
+{
+	const struct sprof_bucket *b1 = v1, *b2 = v2;
+
+	return b2->count < b1->count ? -1 : b2->count > b1->count;
+}
+
+int sample_prof_print_hist(uint max_lines)
+{
+	struct sprof_bucket *bucket;
+	ulong i, n, nbuckets;
+	u32 *pcs;
+	bool was_running;
+
+	n = sprof_kept();
+	if (!n) {
+		printf("No samples\n");
+		return 0;
+	}
+
+	pcs = malloc(n * sizeof(*pcs));
+	bucket = malloc(n * sizeof(*bucket));
+	if (!pcs || !bucket) {
+		free(pcs);
+		free(bucket);
+		return -ENOMEM;
+	}
+
+	was_running = sprof_pause();
+	for (i = 0; i < n; i++)
+		pcs[i] = sprof.buf[i].pc;
+	sprof_resume(was_running);
+
+	/*
+	 * With the PCs sorted, all samples in a function are adjacent, so we
+	 * only need one symbol lookup for each distinct PC
+	 */
+	qsort(pcs, n, sizeof(*pcs), sprof_cmp_pc);
+	for (i = nbuckets = 0; i < n; i++) {
+		const char *name;
+		ulong addr;
+
+		if (i && pcs[i] == pcs[i - 1]) {
+			bucket[nbuckets - 1].count++;
+			continue;
+		}
+		name = sprof_symbol(CONFIG_SYS_TEXT_BASE + pcs[i], &addr);
+		if (nbuckets && bucket[nbuckets - 1].addr == addr) {
+			bucket[nbuckets - 1].count++;
+			continue;
+		}
+		bucket[nbuckets].addr = addr;
+		bucket[nbuckets].name = name;
+		bucket[nbuckets].count = 1;
+		nbuckets++;
+	}
+	qsort(bucket, nbuckets, sizeof(*bucket), sprof_cmp_count);
+
+	if (!max_lines || max_lines > nbuckets)
+		max_lines = nbuckets;
+	printf("%8s %7s  %-16s %s\n", "Samples", "%", "Address", "Symbol");
+	for (i = 0; i < max_lines; i++) {
+		ulong permyriad = (ulong)bucket[i].count * 10000 / n;
+
+		printf("%8u %4lu.%02lu  %016lx %s\n", bucket[i].count,
+		       permyriad / 100, permyriad % 100, bucket[i].addr,
+		       bucket[i].name ? bucket[i].name : "?");
+	}
+	if (max_lines < nbuckets)
+		printf("(%lu more)\n", nbuckets - max_lines);
+	free(bucket);
+	free(pcs);
+
+	return 0;
+}
+
+int sample_prof_list(void *buff, size_t buff_size, size_t *needed)
+{
+	struct trace_output_hdr *output_hdr = buff;
+	struct trace_sample *out;
+	ulong i, n, first;
+	bool was_running;
+
+	n = sprof_kept();
+	*needed = sizeof(*output_hdr) + n * sizeof(*out);
+	if (buff_size < *needed)
+		return -ENOSPC;
+
+	was_running = sprof_pause();
+	first = sprof.count > sprof.size ? sprof.head : 0;
+	out = (struct trace_sample *)(output_hdr + 1);
+	for (i = 0; i < n; i++)
+		out[i] = sprof.buf[(first + i) % sprof.size];
+	sprof_resume(was_running);
+
+	output_hdr->type = TRACE_CHUNK_SAMPLES;
+	output_hdr->rec_count = n;
+
+	return 0;
+}
@@ -26,8 +26,16 @@
  * NFSv2 is still used by default. But if server does not support NFSv2, then
  * NFSv3 is used, if available on NFS server. */
 
+/* NOTE 5: The file is read with several READ requests in flight, each reply
+ * being found by its XID in a table of the requests sent and copied from the
+ * packet to its offset in the load buffer.  With NFSv3, the size of the
+ * requests is the one preferred by the server, as told by FSINFO, when the
+ * replies can be reassembled.
+ */
+
 #include <common.h>
 #include <command.h>
+#include <env.h>
 #include <flash.h>
 #include <image.h>
 #include <log.h>
@@ -37,6 +45,8 @@
 #include "nfs.h"
 #include "bootp.h"
 #include <time.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
 #define NFS_RETRY_COUNT 30
@@ -49,12 +59,32 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* Size of the RPC and NFS headers of a READ reply, before the data */
+#define NFS_READ_HDR_SIZE	((6 + NFS_MAX_ATTRS) * sizeof(uint32_t))
+/* Bytes read per "loading" hash */
+#define NFS_HASH_BYTES		((NFS_READ_SIZE / 2) * 10)
+
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/* A READ request in flight */
+struct nfs_read_req {
+	unsigned long id;	/* XID of the request, 0 if the entry is free */
+	u32 offset;
+	u32 len;
+	ulong sent;		/* get_timer() when last sent */
+};
+
+static struct nfs_read_req nfs_reads[NFS_READ_WINDOW_MAX];
+static int nfs_read_window;	/* entries of nfs_reads[] used */
+static u32 nfs_read_size;	/* bytes asked for by each READ */
+static u32 nfs_read_next;	/* offset of the next READ to send */
+static u32 nfs_read_end;	/* size of the file, once nfs_read_eof */
+static bool nfs_read_eof;
+static ulong nfs_read_bytes;
+static ulong nfs_hashes;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -73,6 +103,7 @@ static int nfs_state;
 #define STATE_LOOKUP_REQ		5
 #define STATE_READ_REQ			6
 #define STATE_READLINK_REQ		7
+#define STATE_FSINFO_REQ		8
 
 static char *nfs_filename;
 static char *nfs_path;
@@ -175,15 +206,14 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static void rpc_send(unsigned long id, int rpc_prog, int rpc_proc,
+		     u32 *data, int datalen)
 {
 	struct rpc_t rpc_pkt;
-	unsigned long id;
 	uint32_t *p;
 	int pktlen;
 	int sport;
 
-	id = ++rpc_id;
 	rpc_pkt.u.call.id = htonl(id);
 	rpc_pkt.u.call.type = htonl(MSG_CALL);
 	rpc_pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
@@ -222,6 +252,12 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 			    nfs_our_port, pktlen);
 }
 
+/* Send an RPC call with a new XID */
+static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+{
+	rpc_send(++rpc_id, rpc_prog, rpc_proc, data, datalen);
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
@@ -358,10 +394,29 @@ static void nfs_lookup_req(char *fname)
 	}
 }
 
+/* NFS3_FSINFO - Get the read sizes supported by the server */
+static void nfs_fsinfo_req(void)
+{
+	u32 data[1024];
+	u32 *p;
+	int len;
+
+	p = rpc_add_credentials(data);
+
+	/* Any file handle of the file system will do */
+	*p++ = htonl(filefh3_length);
+	memcpy(p, filefh, filefh3_length);
+	p += (filefh3_length / 4);
+
+	len = p - data;
+
+	rpc_req(PROG_NFS, NFS3PROC_FSINFO, data, len);
+}
+
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static void nfs_read_req(struct nfs_read_req *req)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -373,22 +428,79 @@ static void nfs_read_req(int offset, int readlen)
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		memcpy(p, filefh, NFS_FHSIZE);
 		p += (NFS_FHSIZE / 4);
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(req->offset);
+		*p++ = htonl(req->len);
 		*p++ = 0;
 	} else { /* NFSV3_FLAG */
 		*p++ = htonl(filefh3_length);
 		memcpy(p, filefh, filefh3_length);
 		p += (filefh3_length / 4);
 		*p++ = htonl(0); /* offset is 64-bit long, so fill with 0 */
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(req->offset);
+		*p++ = htonl(req->len);
 		*p++ = 0;
 	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	/* A request sent again keeps its XID, so that either reply will do */
+	req->sent = get_timer(0);
+	rpc_send(req->id, PROG_NFS, NFS_READ, data, len);
+}
+
+/* Send the READ requests timed out, or all those in flight if @all, then
+ * new ones until the window is full or the end of the file is reached.
+ */
+static void nfs_read_send(bool all)
+{
+	struct nfs_read_req *req;
+
+	for (req = nfs_reads; req < nfs_reads + nfs_read_window; req++) {
+		if (req->id && (all || get_timer(req->sent) > nfs_timeout))
+			nfs_read_req(req);
+	}
+
+	for (req = nfs_reads; req < nfs_reads + nfs_read_window; req++) {
+		if (req->id)
+			continue;
+		if (nfs_read_eof && nfs_read_next >= nfs_read_end)
+			break;
+		req->id = ++rpc_id;
+		req->offset = nfs_read_next;
+		req->len = nfs_read_size;
+		nfs_read_next += nfs_read_size;
+		nfs_read_req(req);
+	}
+}
+
+/* Largest READ whose reply can be received */
+static u32 nfs_read_size_max(void)
+{
+	u32 size = NFS_READ_SIZE;
+
+#ifdef CONFIG_IP_DEFRAG
+	size = max_t(u32, size,
+		     rounddown_pow_of_two(CONFIG_NET_MAXDEFRAG -
+					  IP_UDP_HDR_SIZE -
+					  NFS_READ_HDR_SIZE));
+#endif
+	if (supported_nfs_versions & NFSV2_FLAG)
+		size = min_t(u32, size, NFS2_MAXDATA);
+
+	return size;
+}
+
+/* Start reading the file, from its beginning */
+static void nfs_read_start(void)
+{
+	memset(nfs_reads, 0, sizeof(nfs_reads));
+	nfs_read_next = 0;
+	nfs_read_end = 0;
+	nfs_read_eof = false;
+	nfs_read_bytes = 0;
+	nfs_hashes = 0;
+	nfs_state = STATE_READ_REQ;
+	nfs_read_send(false);
 }
 
 /**************************************************************************
@@ -421,11 +533,14 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_send(true);
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
 		break;
+	case STATE_FSINFO_REQ:
+		nfs_fsinfo_req();
+		break;
 	}
 }
 
@@ -664,21 +779,83 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+static int nfs_fsinfo_reply(uchar *pkt, unsigned int len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
-	uchar *data_ptr;
+	int nfsv3_data_offset;
+	u32 rtmax, rtpref;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	memcpy(&rpc_pkt.u.data[0], pkt, len);
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
 	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
 		return -NFS_RPC_DROP;
 
+	if (rpc_pkt.u.reply.rstatus  ||
+	    rpc_pkt.u.reply.verifier ||
+	    rpc_pkt.u.reply.astatus  ||
+	    rpc_pkt.u.reply.data[0])
+		return -1;
+
+	nfsv3_data_offset = nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
+	if ((uchar *)&rpc_pkt.u.reply.data[3 + nfsv3_data_offset] -
+	    (uchar *)&rpc_pkt > len)
+		return -1;
+
+	rtmax = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+	rtpref = ntohl(rpc_pkt.u.reply.data[2 + nfsv3_data_offset]);
+	debug("FSINFO rtmax %u rtpref %u\n", rtmax, rtpref);
+	if (rtpref && rtpref < nfs_read_size)
+		nfs_read_size = rtpref;
+	if (rtmax && rtmax < nfs_read_size)
+		nfs_read_size = rtmax;
+	nfs_read_size = rounddown_pow_of_two(nfs_read_size);
+
+	return 0;
+}
+
+static struct nfs_read_req *nfs_find_read(unsigned long id)
+{
+	struct nfs_read_req *req;
+
+	for (req = nfs_reads; req < nfs_reads + nfs_read_window; req++) {
+		if (id && req->id == id)
+			return req;
+	}
+
+	return NULL;
+}
+
+static void nfs_show_progress(void)
+{
+	while (nfs_hashes < nfs_read_bytes / NFS_HASH_BYTES) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
+}
+
+static int nfs_read_reply(uchar *pkt, unsigned int len)
+{
+	struct rpc_t rpc_pkt;
+	struct nfs_read_req *req, *r;
+	int rlen;
+	int data_offset;
+	bool eof = false;
+
+	debug("%s\n", __func__);
+
+	/* The data is copied from the packet, only the headers go here */
+	memcpy(&rpc_pkt.u.data[0], pkt, min_t(unsigned int, len, NFS_READ_HDR_SIZE));
+
+	req = nfs_find_read(ntohl(rpc_pkt.u.reply.id));
+	if (!req)
+		return -NFS_RPC_DROP;
+
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
 	    rpc_pkt.u.reply.astatus  ||
@@ -690,38 +867,72 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		data_offset = 19;
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset];
 		/* Skip unused values :
-			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		data_offset = 4 + nfsv3_data_offset;
+	}
+	data_offset = (uchar *)&rpc_pkt.u.reply.data[data_offset] -
+		      (uchar *)&rpc_pkt;
+
+	if (rlen < 0 || rlen > req->len || data_offset + rlen > len)
+		return -9999;
+
+	if (store_block(pkt + data_offset, req->offset, rlen))
+		return -9999;
+
+	nfs_read_bytes += rlen;
+	nfs_show_progress();
+
+	/* Nothing is asked for after the end of the file */
+	if (!rlen || eof) {
+		if (!nfs_read_eof || req->offset + rlen < nfs_read_end)
+			nfs_read_end = req->offset + rlen;
+		nfs_read_eof = true;
+		for (r = nfs_reads; r < nfs_reads + nfs_read_window; r++) {
+			if (r->offset >= nfs_read_end)
+				r->id = 0;
+		}
 	}
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
-
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	/* A short read is not the end of the file: ask for the rest */
+	if (rlen && rlen < req->len && !eof) {
+		req->id = ++rpc_id;
+		req->offset += rlen;
+		req->len -= rlen;
+		nfs_read_req(req);
+	} else {
+		req->id = 0;
+	}
 
 	return rlen;
 }
 
+/* Whether all the file was read */
+static bool nfs_read_done(void)
+{
+	struct nfs_read_req *req;
+
+	if (!nfs_read_eof)
+		return false;
+	for (req = nfs_reads; req < nfs_reads + nfs_read_window; req++) {
+		if (req->id)
+			return false;
+	}
+
+	return true;
+}
+
 /**************************************************************************
 Interfaces of U-BOOT
 **************************************************************************/
@@ -747,7 +958,8 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	/* READ replies may be larger, their data is not copied */
+	if (len > sizeof(struct rpc_t) && nfs_state != STATE_READ_REQ)
 		return;
 
 	if (dest != nfs_our_port)
@@ -813,13 +1025,24 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
 			nfs_send();
 		} else {
-			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			nfs_send();
+			nfs_read_size = nfs_read_size_max();
+			if (supported_nfs_versions & NFSV2_FLAG) {
+				nfs_read_start();
+			} else { /* NFSV3_FLAG */
+				nfs_state = STATE_FSINFO_REQ;
+				nfs_send();
+			}
 		}
 		break;
 
+	case STATE_FSINFO_REQ:
+		reply = nfs_fsinfo_reply(pkt, len);
+		if (reply == -NFS_RPC_DROP)
+			break;
+		/* If FSINFO failed, the READs are as large as we can receive */
+		nfs_read_start();
+		break;
+
 	case STATE_READLINK_REQ:
 		reply = nfs_readlink_reply(pkt, len);
 		if (reply == -NFS_RPC_DROP) {
@@ -843,15 +1066,14 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0 && !nfs_read_done()) {
+			nfs_read_send(false);
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
 			if (rlen < 0)
 				debug("NFS READ error (%d)\n", rlen);
@@ -922,6 +1144,9 @@ void nfs_start(void)
 
 	nfs_timeout_count = 0;
 	nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+	nfs_read_window = clamp_t(int, env_get_ulong("nfswindowsize", 10,
+						     CONFIG_NFS_READ_WINDOW),
+				  1, NFS_READ_WINDOW_MAX);
 
 	/*nfs_our_port = 4096 + (get_ticks() % 3072);*/
 	/*FIX ME !!!*/
@@ -25,6 +25,7 @@
 #define NFS_READ        6
 
 #define NFS3PROC_LOOKUP 3
+#define NFS3PROC_FSINFO 19
 
 #define NFS_FHSIZE      32
 #define NFS3_FHSIZE     64
@@ -38,10 +39,14 @@
 /*
  * Block size used for NFS read accesses.  A RPC reply packet (including  all
  * headers) must fit within a single Ethernet frame to avoid fragmentation.
- * However, if CONFIG_IP_DEFRAG is set, a bigger value could be used.  In any
- * case, most NFS servers are optimized for a power of 2.
+ * However, if CONFIG_IP_DEFRAG is set, a bigger value is used, up to what the
+ * server prefers.  In any case, most NFS servers are optimized for a power
+ * of 2.
  */
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
+#define NFS2_MAXDATA	8192	/* largest NFSv2 read */
+/* Most NFS READ requests in flight, whatever CONFIG_NFS_READ_WINDOW says */
+#define NFS_READ_WINDOW_MAX	16
 #define NFS_MAX_ATTRS	26
 
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
@@ -0,0 +1,592 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* Minimal TCP client
+ *
+ * There is one connection at a time, which we open. What we send is small (a
+ * request) and goes one segment at a time. What we receive can be large: once
+ * its user gives a buffer, each segment is copied from the packet straight to
+ * its place there, so segments received out of order are kept without any
+ * reassembly queue and the window can be as large as the buffer.
+ *
+ * Window scaling (RFC 7323) is supported. SACK is not: segments received out
+ * of order are acknowledged at once with duplicate ACKs, which makes the peer
+ * retransmit the missing one (RFC 5681 fast retransmit), and the ACK jumps
+ * over everything kept once the hole is filled.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <linux/kernel.h>
+#include "net_rand.h"
+
+/* Milliseconds before retransmitting, doubled on each retry */
+#define TCP_RTO_MS		500
+#define TCP_RTO_MAX_MS		8000
+/* Retransmissions, or probes of an idle connection, before giving up */
+#define TCP_RETRIES		10
+/* Milliseconds an acknowledgment may be delayed */
+#define TCP_DELACK_MS		10
+/* Segments received before they are acknowledged */
+#define TCP_DELACK_SEGS		2
+/* Duplicate acknowledgments after which we retransmit at once */
+#define TCP_DUPACK_THRESH	3
+/* Ranges of data received out of order that are remembered */
+#define TCP_OOO_RANGES		8
+/* Largest window scale allowed by RFC 7323 */
+#define TCP_WSCALE_MAX		14
+/* MSS assumed when the peer does not give one */
+#define TCP_DEFAULT_MSS		536
+/* First port of the dynamic range, used for our end */
+#define TCP_PORT_DYNAMIC	49152
+
+/* Option kinds */
+#define TCP_OPT_EOL		0
+#define TCP_OPT_NOP		1
+#define TCP_OPT_MSS		2
+#define TCP_OPT_WSCALE		3
+
+/* Length of the options of our SYN: MSS, NOP and window scale */
+#define TCP_SYN_OPTS_LEN	8
+
+enum tcp_state {
+	TCP_STATE_CLOSED,
+	TCP_STATE_SYN_SENT,
+	TCP_STATE_ESTABLISHED,
+	TCP_STATE_CLOSE_WAIT,
+};
+
+/* Data received out of order, from @start up to @end */
+struct tcp_range {
+	u32 start;
+	u32 end;
+};
+
+struct tcp_conn {
+	enum tcp_state state;
+	struct in_addr remote_ip;
+	uchar remote_ethaddr[ARP_HLEN];
+	u16 remote_port;
+	u16 our_port;
+	tcp_rx_f *rx;
+	tcp_event_f *event;
+
+	u32 snd_una;		/* oldest sequence number not acknowledged */
+	u32 snd_nxt;		/* next sequence number to send */
+	u16 snd_mss;		/* largest segment the peer accepts */
+	u8 tx_flags;		/* flags of the segment in flight */
+	unsigned int tx_len;	/* length of the segment in flight */
+	uchar tx_data[TCP_MSS];	/* data of the segment in flight */
+	int dupacks;		/* duplicate ACKs of the segment in flight */
+
+	u32 rcv_nxt;		/* next sequence number expected */
+	u8 rcv_wscale;		/* shift of the windows we advertise */
+	int unacked;		/* segments received and not acknowledged */
+	bool fin;		/* a FIN was received at fin_seq */
+	u32 fin_seq;
+
+	uchar *buf;		/* where received data goes, if anywhere */
+	ulong buf_size;
+	u32 buf_seq;		/* sequence number of buf[0] */
+	struct tcp_range ooo[TCP_OOO_RANGES];
+	int ooo_count;
+
+	int retries;		/* timeouts since the peer was last heard */
+	ulong rto;		/* current retransmission timeout */
+};
+
+static struct tcp_conn tcp;
+
+static inline bool seq_lt(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static inline bool seq_le(u32 a, u32 b)
+{
+	return (s32)(a - b) <= 0;
+}
+
+/* Computes the checksum of a segment, which is 0 for a correct one */
+static u16 tcp_checksum(struct ip_tcp_hdr *ip, unsigned int tcp_len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} pseudo;
+	unsigned int sum;
+
+	net_copy_ip(&pseudo.src, &ip->ip_src);
+	net_copy_ip(&pseudo.dst, &ip->ip_dst);
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(tcp_len);
+	sum = compute_ip_checksum(&pseudo, sizeof(pseudo));
+
+	return add_ip_checksums(sizeof(pseudo), sum,
+				compute_ip_checksum(&ip->tcp_src, tcp_len));
+}
+
+/* Returns how many more bytes we can receive */
+static u32 tcp_rcv_space(void)
+{
+	u32 space = CONFIG_NET_TCP_WINDOW;
+
+	if (tcp.buf)
+		space = min_t(ulong, space,
+			      tcp.buf_size - (tcp.rcv_nxt - tcp.buf_seq));
+
+	return space;
+}
+
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 seq, u32 ack)
+{
+	struct ip_tcp_hdr *ip = (struct ip_tcp_hdr *)pkt;
+	int hdr_len = TCP_HDR_SIZE;
+	u32 win = tcp_rcv_space();
+
+	/* The payload of our SYN is its options, and its window not scaled */
+	if (action & TCP_SYN)
+		hdr_len += payload_len;
+	else
+		win >>= tcp.rcv_wscale;
+
+	net_set_ip_header(pkt, dest, net_ip, IP_TCP_HDR_SIZE + payload_len,
+			  IPPROTO_TCP);
+
+	ip->tcp_src = htons(sport);
+	ip->tcp_dst = htons(dport);
+	ip->tcp_seq = htonl(seq);
+	ip->tcp_ack = htonl(ack);
+	ip->tcp_hlen = (hdr_len / 4) << 4;
+	ip->tcp_flags = action;
+	ip->tcp_win = htons(min_t(u32, win, 0xffff));
+	ip->tcp_xsum = 0;
+	ip->tcp_urg = 0;
+	ip->tcp_xsum = tcp_checksum(ip, TCP_HDR_SIZE + payload_len);
+
+	return IP_TCP_HDR_SIZE;
+}
+
+static void tcp_send_segment(u8 flags, u32 seq, const void *data,
+			     unsigned int len)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_TCP_HDR_SIZE;
+
+	if (len)
+		memcpy(pkt, data, len);
+	if (flags & TCP_ACK)
+		tcp.unacked = 0;
+
+	net_send_ip_packet(tcp.remote_ethaddr, tcp.remote_ip, tcp.remote_port,
+			   tcp.our_port, len, IPPROTO_TCP, flags, seq,
+			   flags & TCP_ACK ? tcp.rcv_nxt : 0);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp.snd_nxt, NULL, 0);
+}
+
+/* Sends the segment in flight again */
+static void tcp_transmit(void)
+{
+	tcp_send_segment(tcp.tx_flags, tcp.snd_una, tcp.tx_data, tcp.tx_len);
+}
+
+static void tcp_timeout_handler(void);
+
+static void tcp_arm_timer(void)
+{
+	if (tcp.unacked)
+		net_set_timeout_handler(TCP_DELACK_MS, tcp_timeout_handler);
+	else
+		net_set_timeout_handler(tcp.rto, tcp_timeout_handler);
+}
+
+static void tcp_fail(enum tcp_event event)
+{
+	tcp_reset();
+	tcp.event(event);
+}
+
+static void tcp_timeout_handler(void)
+{
+	if (tcp.state == TCP_STATE_CLOSED)
+		return;
+
+	if (tcp.unacked) {
+		tcp_send_ack();
+		tcp_arm_timer();
+		return;
+	}
+
+	if (++tcp.retries > TCP_RETRIES) {
+		tcp_fail(TCP_TIMEOUT);
+		return;
+	}
+	tcp.rto = min_t(ulong, tcp.rto * 2, TCP_RTO_MAX_MS);
+
+	/* When waiting for data, our last ACK may be what was lost */
+	if (tcp.snd_una != tcp.snd_nxt)
+		tcp_transmit();
+	else
+		tcp_send_ack();
+	tcp_arm_timer();
+}
+
+int tcp_connect(struct in_addr dest, u16 dport, tcp_rx_f *rx,
+		tcp_event_f *event)
+{
+	static bool seeded;
+	uchar *opt = tcp.tx_data;
+
+	tcp_reset();
+	memset(&tcp, '\0', sizeof(tcp));
+
+	if (!seeded) {
+		srand_mac();
+		seeded = true;
+	}
+
+	tcp.remote_ip = dest;
+	tcp.remote_port = dport;
+	tcp.our_port = TCP_PORT_DYNAMIC + rand() % (65536 - TCP_PORT_DYNAMIC);
+	tcp.rx = rx;
+	tcp.event = event;
+	tcp.snd_una = rand();
+	tcp.snd_nxt = tcp.snd_una + 1;
+	tcp.snd_mss = TCP_DEFAULT_MSS;
+	tcp.rto = TCP_RTO_MS;
+
+	while ((CONFIG_NET_TCP_WINDOW >> tcp.rcv_wscale) > 0xffff &&
+	       tcp.rcv_wscale < TCP_WSCALE_MAX)
+		tcp.rcv_wscale++;
+
+	opt[0] = TCP_OPT_MSS;
+	opt[1] = 4;
+	opt[2] = TCP_MSS >> 8;
+	opt[3] = TCP_MSS & 0xff;
+	opt[4] = TCP_OPT_NOP;
+	opt[5] = TCP_OPT_WSCALE;
+	opt[6] = 3;
+	opt[7] = tcp.rcv_wscale;
+	tcp.tx_flags = TCP_SYN;
+	tcp.tx_len = TCP_SYN_OPTS_LEN;
+
+	tcp.state = TCP_STATE_SYN_SENT;
+	tcp_transmit();
+	tcp_arm_timer();
+
+	return 0;
+}
+
+int tcp_send(const void *data, unsigned int len)
+{
+	if (tcp.state != TCP_STATE_ESTABLISHED &&
+	    tcp.state != TCP_STATE_CLOSE_WAIT)
+		return -ENOTCONN;
+	if (tcp.snd_una != tcp.snd_nxt)
+		return -EBUSY;
+	if (len > min_t(unsigned int, TCP_MSS, tcp.snd_mss))
+		return -E2BIG;
+
+	memcpy(tcp.tx_data, data, len);
+	tcp.tx_flags = TCP_ACK | TCP_PUSH;
+	tcp.tx_len = len;
+	tcp.snd_nxt += len;
+	tcp.dupacks = 0;
+	tcp_transmit();
+	tcp_arm_timer();
+
+	return 0;
+}
+
+void tcp_set_rx_buffer(void *buf, ulong size)
+{
+	tcp.buf = buf;
+	tcp.buf_size = size;
+	tcp.buf_seq = tcp.rcv_nxt;
+	tcp.ooo_count = 0;
+}
+
+void tcp_close(void)
+{
+	if (tcp.state == TCP_STATE_ESTABLISHED ||
+	    tcp.state == TCP_STATE_CLOSE_WAIT)
+		tcp_send_segment(TCP_FIN | TCP_ACK, tcp.snd_nxt, NULL, 0);
+	tcp_reset();
+}
+
+void tcp_abort(void)
+{
+	if (tcp.state == TCP_STATE_ESTABLISHED ||
+	    tcp.state == TCP_STATE_CLOSE_WAIT)
+		tcp_send_segment(TCP_RST | TCP_ACK, tcp.snd_nxt, NULL, 0);
+	tcp_reset();
+}
+
+void tcp_reset(void)
+{
+	if (tcp.state != TCP_STATE_CLOSED)
+		net_set_timeout_handler(0, NULL);
+	tcp.state = TCP_STATE_CLOSED;
+	tcp.buf = NULL;
+}
+
+/* Takes the MSS of the peer and whether it scales windows from its SYN */
+static void tcp_parse_syn_options(const uchar *opt, unsigned int len)
+{
+	bool wscale = false;
+
+	while (len && opt[0] != TCP_OPT_EOL) {
+		if (opt[0] == TCP_OPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+		if (opt[0] == TCP_OPT_MSS && opt[1] == 4)
+			tcp.snd_mss = opt[2] << 8 | opt[3];
+		else if (opt[0] == TCP_OPT_WSCALE && opt[1] == 3)
+			wscale = true;
+		len -= opt[1];
+		opt += opt[1];
+	}
+
+	/* Window scaling is only used if both ends ask for it */
+	if (!wscale)
+		tcp.rcv_wscale = 0;
+}
+
+static void tcp_rcv_syn_sent(struct ip_tcp_hdr *ip, unsigned int hlen)
+{
+	u8 flags = ip->tcp_flags;
+
+	if (!(flags & TCP_ACK) || ntohl(ip->tcp_ack) != tcp.snd_nxt)
+		return;
+	if (flags & TCP_RST) {
+		tcp_fail(TCP_RESET);
+		return;
+	}
+	if (!(flags & TCP_SYN))
+		return;
+
+	tcp_parse_syn_options((uchar *)ip + IP_TCP_HDR_SIZE,
+			      hlen - TCP_HDR_SIZE);
+	tcp.rcv_nxt = ntohl(ip->tcp_seq) + 1;
+	tcp.snd_una = tcp.snd_nxt;
+	tcp.tx_len = 0;
+	tcp.retries = 0;
+	tcp.state = TCP_STATE_ESTABLISHED;
+
+	tcp.event(TCP_CONNECTED);
+	/* Acknowledge the SYN unless the callback sent data doing so */
+	if (tcp.state == TCP_STATE_ESTABLISHED && tcp.snd_una == tcp.snd_nxt)
+		tcp_send_ack();
+}
+
+static void tcp_rcv_ack(u32 ack, bool has_data)
+{
+	u32 n;
+
+	if (seq_lt(tcp.snd_una, ack) && seq_le(ack, tcp.snd_nxt)) {
+		/* Keep what is not acknowledged yet for retransmission */
+		n = ack - tcp.snd_una;
+		tcp.tx_len -= n;
+		memmove(tcp.tx_data, tcp.tx_data + n, tcp.tx_len);
+		tcp.snd_una = ack;
+		tcp.dupacks = 0;
+	} else if (ack == tcp.snd_una && tcp.snd_una != tcp.snd_nxt &&
+		   !has_data) {
+		if (++tcp.dupacks == TCP_DUPACK_THRESH)
+			tcp_transmit();
+	}
+}
+
+/* Keeps a segment received out of order in its place in the buffer. It is
+ * dropped, to be sent again, when there is no buffer yet or no room to
+ * remember it.
+ */
+static void tcp_rcv_out_of_order(u32 seq, const uchar *data,
+				 unsigned int len)
+{
+	struct tcp_range *r = tcp.ooo;
+	u32 end = seq + len;
+	int i, j;
+
+	if (!tcp.buf)
+		return;
+
+	/* Ranges are sorted, and neither overlap nor touch each other */
+	for (i = 0; i < tcp.ooo_count && seq_lt(r[i].end, seq); i++)
+		;
+	if (i == tcp.ooo_count || seq_lt(end, r[i].start)) {
+		if (tcp.ooo_count == TCP_OOO_RANGES)
+			return;
+		memmove(&r[i + 1], &r[i], (tcp.ooo_count - i) * sizeof(*r));
+		r[i].start = seq;
+		r[i].end = end;
+		tcp.ooo_count++;
+	} else {
+		if (seq_lt(seq, r[i].start))
+			r[i].start = seq;
+		if (seq_lt(r[i].end, end))
+			r[i].end = end;
+		for (j = i + 1; j < tcp.ooo_count &&
+		     seq_le(r[j].start, r[i].end); j++) {
+			if (seq_lt(r[i].end, r[j].end))
+				r[i].end = r[j].end;
+		}
+		memmove(&r[i + 1], &r[j], (tcp.ooo_count - j) * sizeof(*r));
+		tcp.ooo_count -= j - i - 1;
+	}
+	memcpy(tcp.buf + (seq - tcp.buf_seq), data, len);
+}
+
+/* Takes data received in order, and any received earlier which now follows
+ * on. Returns true if that filled a hole.
+ */
+static bool tcp_rcv_in_order(const uchar *data, unsigned int len)
+{
+	u32 start = tcp.rcv_nxt;
+	bool filled = false;
+
+	tcp.rcv_nxt += len;
+	if (!tcp.buf) {
+		tcp.rx(data, len);
+		return false;
+	}
+
+	memcpy(tcp.buf + (start - tcp.buf_seq), data, len);
+	while (tcp.ooo_count && seq_le(tcp.ooo[0].start, tcp.rcv_nxt)) {
+		if (seq_lt(tcp.rcv_nxt, tcp.ooo[0].end))
+			tcp.rcv_nxt = tcp.ooo[0].end;
+		tcp.ooo_count--;
+		memmove(&tcp.ooo[0], &tcp.ooo[1],
+			tcp.ooo_count * sizeof(*tcp.ooo));
+		filled = true;
+	}
+	tcp.rx(tcp.buf + (start - tcp.buf_seq), tcp.rcv_nxt - start);
+
+	return filled;
+}
+
+static void tcp_rcv_data(struct ip_tcp_hdr *ip, const uchar *data,
+			 unsigned int len)
+{
+	u32 seq = ntohl(ip->tcp_seq);
+	bool ack_now = false;
+	u32 space, off;
+
+	if (ip->tcp_flags & TCP_FIN) {
+		tcp.fin = true;
+		tcp.fin_seq = seq + len;
+	}
+
+	/* Drop what was received already, and what does not fit */
+	if (seq_lt(seq, tcp.rcv_nxt)) {
+		off = tcp.rcv_nxt - seq;
+		if (off >= len) {
+			/* A retransmission or a probe: our ACK may be lost */
+			ack_now = true;
+			len = 0;
+		} else {
+			data += off;
+			len -= off;
+			seq = tcp.rcv_nxt;
+		}
+	}
+	space = tcp_rcv_space();
+	off = seq - tcp.rcv_nxt;
+	if (len && off + len > space) {
+		len = off < space ? space - off : 0;
+		ack_now = true;
+	}
+
+	if (len && seq == tcp.rcv_nxt) {
+		if (tcp_rcv_in_order(data, len))
+			ack_now = true;
+		/* The callback may have closed the connection */
+		if (tcp.state == TCP_STATE_CLOSED)
+			return;
+		if (++tcp.unacked >= TCP_DELACK_SEGS ||
+		    ip->tcp_flags & TCP_PUSH)
+			ack_now = true;
+	} else if (len) {
+		/* A duplicate ACK tells the peer where the hole is */
+		tcp_rcv_out_of_order(seq, data, len);
+		ack_now = true;
+	}
+
+	if (tcp.fin && tcp.rcv_nxt == tcp.fin_seq &&
+	    tcp.state == TCP_STATE_ESTABLISHED) {
+		tcp.rcv_nxt++;
+		tcp.state = TCP_STATE_CLOSE_WAIT;
+		tcp_send_ack();
+		tcp.event(TCP_CLOSED);
+		return;
+	}
+
+	if (ack_now)
+		tcp_send_ack();
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, int len, struct in_addr src)
+{
+	unsigned int hlen;
+	u32 seq;
+
+	if (tcp.state == TCP_STATE_CLOSED || len < IP_TCP_HDR_SIZE)
+		return;
+	hlen = (ip->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || IP_HDR_SIZE + hlen > len)
+		return;
+	if (src.s_addr != tcp.remote_ip.s_addr ||
+	    ntohs(ip->tcp_src) != tcp.remote_port ||
+	    ntohs(ip->tcp_dst) != tcp.our_port)
+		return;
+	if (tcp_checksum(ip, len - IP_HDR_SIZE)) {
+		debug("TCP checksum bad\n");
+		return;
+	}
+
+	if (tcp.state == TCP_STATE_SYN_SENT) {
+		tcp_rcv_syn_sent(ip, hlen);
+		goto out;
+	}
+
+	seq = ntohl(ip->tcp_seq);
+	if (ip->tcp_flags & TCP_RST) {
+		/* Only believe a reset which is inside the window */
+		if (seq_le(tcp.rcv_nxt, seq) &&
+		    seq_le(seq, tcp.rcv_nxt + tcp_rcv_space()))
+			tcp_fail(TCP_RESET);
+		return;
+	}
+	if (ip->tcp_flags & TCP_SYN) {
+		/* The SYN-ACK again, so our ACK of it was lost */
+		tcp_send_ack();
+		return;
+	}
+	if (!(ip->tcp_flags & TCP_ACK))
+		return;
+
+	tcp.retries = 0;
+	tcp.rto = TCP_RTO_MS;
+	tcp_rcv_ack(ntohl(ip->tcp_ack),
+		    len > IP_HDR_SIZE + hlen || ip->tcp_flags & TCP_FIN);
+	tcp_rcv_data(ip, (uchar *)ip + IP_HDR_SIZE + hlen,
+		     len - IP_HDR_SIZE - hlen);
+
+out:
+	if (tcp.state != TCP_STATE_CLOSED)
+		tcp_arm_timer();
+}
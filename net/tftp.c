@@ -15,6 +15,7 @@
 #include <mapmem.h>
 #include <net.h>
 #include <asm/global_data.h>
+#include <linux/bitops.h>
 #include <net/tftp.h>
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
@@ -35,6 +36,10 @@ DECLARE_GLOBAL_DATA_PTR;
 #endif
 /* Number of "loading" hashes per line (for checking the image size) */
 #define HASHES_PER_LINE	65
+/* Millisecs to wait for a block missing from a window before asking again */
+#define REORDER_TIMEOUT	20UL
+/* Blocks ahead of the next expected one that can be kept (divides 65536) */
+#define TFTP_OOO_BLOCKS	512
 
 /*
  *	TFTP operations.
@@ -104,6 +109,16 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* The window size we ask for, adapted to the losses seen */
+static ushort	tftp_window_size_req;
+/* Blocks received ahead of tftp_cur_block, indexed by block % TFTP_OOO_BLOCKS */
+static unsigned long tftp_ooo_map[BITS_TO_LONGS(TFTP_OOO_BLOCKS)];
+static int	tftp_ooo_count;
+/* Last block of the file, once received, counting wraps; 0 if not yet */
+static ulong	tftp_final_block;
+/* A block is missing and the reorder timer is running */
+static bool	tftp_hole_pending;
+struct tftp_stats tftp_stats;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -157,6 +172,7 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
+static unsigned short tftp_window_size_prev_option;
 
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
@@ -212,6 +228,15 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	return 0;
 }
 
+/* Forget the blocks received early, before a new transfer */
+static void clear_early_blocks(void)
+{
+	memset(tftp_ooo_map, '\0', sizeof(tftp_ooo_map));
+	tftp_ooo_count = 0;
+	tftp_final_block = 0;
+	tftp_hole_pending = false;
+}
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
@@ -311,6 +336,50 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/* Absolute number of the current block, counting wraps */
+static ulong tftp_abs_block(void)
+{
+	return tftp_block_wrap * TFTP_SEQUENCE_SIZE + tftp_cur_block;
+}
+
+/* Acknowledge the current block again, asking for the blocks following it */
+static void tftp_send_nack(void)
+{
+	tftp_send();
+	tftp_last_nack = tftp_cur_block;
+	tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+	tftp_stats.nacks++;
+}
+
+/* Keep a block received ahead of the next one expected where it belongs, and
+ * give the missing ones a little time to arrive before asking for them again.
+ */
+static void store_early_block(ushort block, ushort ahead, uchar *src,
+			      unsigned int len)
+{
+	int bit = block % TFTP_OOO_BLOCKS;
+
+	if (test_bit(bit, tftp_ooo_map)) {
+		tftp_stats.dups++;
+		return;
+	}
+	if (store_block(tftp_cur_block + ahead, src, len)) {
+		eth_halt();
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	__set_bit(bit, tftp_ooo_map);
+	tftp_ooo_count++;
+	tftp_stats.ooo++;
+	if (len < tftp_block_size)
+		tftp_final_block = tftp_abs_block() + ahead;
+
+	if (!tftp_hole_pending) {
+		tftp_hole_pending = true;
+		net_set_timeout_handler(REORDER_TIMEOUT, tftp_timeout_handler);
+	}
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -329,6 +398,16 @@ static void tftp_complete(void)
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
 	}
+	if (!tftp_put_active) {
+		if (tftp_stats.ooo || tftp_stats.dups || tftp_stats.timeouts)
+			printf("\n\t %lu out of order, %lu received again, %lu timeouts",
+			       tftp_stats.ooo, tftp_stats.dups,
+			       tftp_stats.timeouts);
+		/* Additive increase of the window after a transfer without loss */
+		if (!tftp_stats.timeouts &&
+		    tftp_window_size_req < tftp_window_size_option)
+			tftp_window_size_req++;
+	}
 	puts("\ndone\n");
 	if (IS_ENABLED(CONFIG_CMD_BOOTEFI)) {
 		if (!tftp_put_active)
@@ -386,9 +465,9 @@ static void tftp_send(void)
 		 * Implemented only for tftp get.
 		 * Don't bother sending if it's 1
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_req > 1)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_window_size_req, 0);
 		len = pkt - xp;
 		break;
 
@@ -479,6 +558,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	__be16 *s;
 	int i;
 	u16 timeout_val_rcvd;
+	ushort block, ahead;
+	bool skipped;
 
 	if (dest != tftp_our_port) {
 			return;
@@ -609,22 +690,26 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			return;
 		len -= 2;
 
-		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
+		block = ntohs(*(__be16 *)pkt);
+		ahead = block - (ushort)tftp_cur_block;
+		if (ahead > 1 && ahead < TFTP_OOO_BLOCKS && !tftp_put_active &&
+		    (tftp_state == STATE_DATA || tftp_state == STATE_OACK)) {
+			store_early_block(block, ahead, pkt + 2, len);
+			break;
+		}
+		if (ahead != 1) {
 			debug("Received unexpected block: %d, expected: %d\n",
-			      ntohs(*(__be16 *)pkt),
-			      (ushort)(tftp_cur_block + 1));
+			      block, (ushort)(tftp_cur_block + 1));
+			if (tftp_state == STATE_DATA)
+				tftp_stats.dups++;
 			/*
 			 * If one packet is dropped most likely
 			 * all other buffers in the window
 			 * that will arrive will cause a sending NACK.
 			 * This just overwellms the server, let's just send one.
 			 */
-			if (tftp_last_nack != tftp_cur_block) {
-				tftp_send();
-				tftp_last_nack = tftp_cur_block;
-				tftp_next_ack = (ushort)(tftp_cur_block +
-							 tftp_windowsize);
-			}
+			if (tftp_last_nack != tftp_cur_block)
+				tftp_send_nack();
 			break;
 		}
 
@@ -661,6 +746,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		update_block_number();
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
+		tftp_hole_pending = false;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
 		if (store_block(tftp_cur_block, pkt + 2, len)) {
@@ -675,6 +761,38 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			break;
 		}
 
+		/* Move on over the blocks received early which follow */
+		skipped = false;
+		while (test_bit((tftp_cur_block + 1) % TFTP_OOO_BLOCKS,
+				tftp_ooo_map)) {
+			__clear_bit((tftp_cur_block + 1) % TFTP_OOO_BLOCKS,
+				    tftp_ooo_map);
+			tftp_ooo_count--;
+			tftp_cur_block = (tftp_cur_block + 1) % TFTP_SEQUENCE_SIZE;
+			update_block_number();
+			tftp_prev_block = tftp_cur_block;
+			skipped = true;
+		}
+		if (tftp_final_block && tftp_abs_block() == tftp_final_block) {
+			tftp_send();
+			tftp_complete();
+			break;
+		}
+
+		/* After a hole was filled, acknowledge the last block we have
+		 * at once, so that the remote skips what it would resend.
+		 */
+		if (skipped) {
+			tftp_send_nack();
+			break;
+		}
+		/* Another block is missing before some received early */
+		if (tftp_ooo_count) {
+			tftp_hole_pending = true;
+			net_set_timeout_handler(REORDER_TIMEOUT,
+						tftp_timeout_handler);
+		}
+
 		/*
 		 *	Acknowledge the block just received, which will prompt
 		 *	the remote for the next one.
@@ -713,6 +831,19 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 static void tftp_timeout_handler(void)
 {
+	if (tftp_hole_pending) {
+		/* The missing block was lost rather than reordered */
+		tftp_hole_pending = false;
+		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		tftp_send_nack();
+		return;
+	}
+
+	if (tftp_state == STATE_DATA && !tftp_put_active) {
+		tftp_stats.timeouts++;
+		/* Multiplicative decrease of the window asked for next time */
+		tftp_window_size_req = max(tftp_window_size_req / 2, 1);
+	}
 	if (++timeout_count > timeout_count_max) {
 		restart("Retry count exceeded");
 	} else {
@@ -733,6 +864,7 @@ static int tftp_init_load_addr(void)
 	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
 
 	max_size = lmb_get_free_size(&lmb, image_load_addr);
+	lmb_uninit(&lmb);
 	if (!max_size)
 		return -1;
 
@@ -781,8 +913,16 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
+	/* Start again from the window size configured when it changes */
+	if (tftp_window_size_option != tftp_window_size_prev_option ||
+	    tftp_window_size_req > tftp_window_size_option ||
+	    !tftp_window_size_req) {
+		tftp_window_size_prev_option = tftp_window_size_option;
+		tftp_window_size_req = tftp_window_size_option;
+	}
+
 	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
-	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
+	      tftp_block_size_option, tftp_window_size_req, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -877,6 +1017,10 @@ void tftp_start(enum proto_t protocol)
 	tftp_cur_block = 0;
 	tftp_windowsize = 1;
 	tftp_last_nack = 0;
+	memset(&tftp_stats, '\0', sizeof(tftp_stats));
+	/* Blocks may be stored ahead of the first one */
+	new_transfer();
+	clear_early_blocks();
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
@@ -915,6 +1059,7 @@ void tftp_start_server(void)
 	tftp_block_size = TFTP_BLOCK_SIZE;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
+	clear_early_blocks();
 
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
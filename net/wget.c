@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* HTTP/1.1 client, loading a file or part of it into memory
+ *
+ * The response header is gathered from what TCP receives in order. Once it
+ * has been parsed, the body goes from the packets straight to the load
+ * address, TCP placing segments received out of order there as well.
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <efi_loader.h>
+#include <env.h>
+#include <image.h>
+#include <lmb.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/global_data.h>
+#include <net/tcp.h>
+#include <net/wget.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Well known HTTP port # */
+#define HTTP_PORT		80
+/* Longest response header accepted */
+#define WGET_HDR_SIZE		2048
+/* Hashes for a file of known size, and bytes per hash otherwise */
+#define WGET_HASHES		50
+#define WGET_HASH_BYTES		SZ_64K
+/* Number of "loading" hashes per line */
+#define HASHES_PER_LINE		65
+
+ulong wget_range_offset;
+ulong wget_range_size;
+
+static struct in_addr wget_server_ip;
+static int wget_server_port;
+static char wget_path[sizeof(net_boot_file_name) + 1];
+static ulong time_start;
+
+static char wget_hdr[WGET_HDR_SIZE + 1];
+static unsigned int wget_hdr_len;
+static bool wget_hdr_done;
+
+static uchar *wget_load;	/* where the body goes */
+static ulong wget_load_size;	/* room there */
+static ulong wget_limit;	/* bytes of the body to load */
+static bool wget_known_size;	/* wget_limit is the whole body */
+static ulong wget_body_len;	/* bytes of the body loaded */
+static ulong wget_hashes;
+
+static void wget_fail(const char *msg)
+{
+	printf("\nwget: %s\n", msg);
+	tcp_abort();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_done(void)
+{
+	while (wget_known_size && wget_hashes < WGET_HASHES) {
+		putc('#');
+		wget_hashes++;
+	}
+	net_boot_file_size = wget_body_len;
+	time_start = get_timer(time_start);
+	if (time_start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(net_boot_file_size / time_start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	if (IS_ENABLED(CONFIG_CMD_BOOTEFI))
+		efi_set_bootdev("Net", "", wget_path, wget_load,
+				net_boot_file_size);
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+static void wget_show_progress(void)
+{
+	if (wget_known_size) {
+		ulong step = wget_limit / WGET_HASHES + 1;
+
+		while (wget_hashes < wget_body_len / step) {
+			putc('#');
+			wget_hashes++;
+		}
+		return;
+	}
+
+	while (wget_hashes < wget_body_len / WGET_HASH_BYTES) {
+		putc('#');
+		if (++wget_hashes % HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+}
+
+/* Accounts for @len more bytes of the body, already at their place */
+static void wget_body(ulong len)
+{
+	wget_body_len += len;
+	wget_show_progress();
+	if (wget_body_len < wget_limit)
+		return;
+
+	if (!wget_known_size && !wget_range_size) {
+		wget_fail("file too large for the free memory at the load address");
+		return;
+	}
+	/* Stop the server sending what was not asked for */
+	if (wget_known_size)
+		tcp_close();
+	else
+		tcp_abort();
+	wget_done();
+}
+
+/* Returns the value of header @name, or NULL */
+static const char *wget_find_header(const char *name)
+{
+	const char *p = wget_hdr;
+	int len = strlen(name);
+
+	while ((p = strstr(p, "\r\n")) && strncmp(p, "\r\n\r\n", 4)) {
+		p += 2;
+		if (!strncasecmp(p, name, len) && p[len] == ':') {
+			for (p += len + 1; *p == ' ' || *p == '\t'; p++)
+				;
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+static int wget_parse_header(void)
+{
+	const char *val;
+	ulong status;
+
+	if (strncmp(wget_hdr, "HTTP/1.", 7) || wget_hdr[8] != ' ') {
+		wget_fail("not an HTTP/1.x response");
+		return -1;
+	}
+	status = simple_strtoul(wget_hdr + 9, NULL, 10);
+	if (status != 200 && status != 206) {
+		printf("\nwget: %.*s", (int)(strstr(wget_hdr, "\r\n") - wget_hdr),
+		       wget_hdr);
+		wget_fail("request failed");
+		return -1;
+	}
+	if (status == 200 && wget_range_offset) {
+		wget_fail("the server does not support range requests");
+		return -1;
+	}
+
+	val = wget_find_header("Transfer-Encoding");
+	if (val && strncasecmp(val, "identity", 8)) {
+		wget_fail("transfer encodings are not supported");
+		return -1;
+	}
+
+	/* A whole file may be larger than the part asked for */
+	val = wget_find_header("Content-Length");
+	wget_known_size = val;
+	if (val)
+		wget_limit = simple_strtoul(val, NULL, 10);
+	if (wget_range_size && (!val || wget_limit > wget_range_size)) {
+		wget_limit = wget_range_size;
+		wget_known_size = false;
+	}
+	if (!wget_known_size && !wget_range_size)
+		wget_limit = wget_load_size;
+	if (wget_limit > wget_load_size) {
+		wget_fail("file too large for the free memory at the load address");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void wget_rx(const uchar *data, unsigned int len)
+{
+	unsigned int old = wget_hdr_len;
+	unsigned int body_len;
+	char *end;
+
+	if (wget_hdr_done) {
+		wget_body(len);
+		return;
+	}
+
+	wget_hdr_len += min(len, WGET_HDR_SIZE - old);
+	memcpy(wget_hdr + old, data, wget_hdr_len - old);
+	wget_hdr[wget_hdr_len] = '\0';
+	end = strstr(wget_hdr, "\r\n\r\n");
+	if (!end) {
+		if (wget_hdr_len == WGET_HDR_SIZE)
+			wget_fail("response header too long");
+		return;
+	}
+	if (wget_parse_header())
+		return;
+	wget_hdr_done = true;
+
+	/* What follows the header is the start of the body */
+	data += end + 4 - wget_hdr - old;
+	len -= end + 4 - wget_hdr - old;
+	body_len = min_t(ulong, len, wget_limit);
+	memcpy(wget_load, data, body_len);
+	tcp_set_rx_buffer(wget_load + body_len, wget_limit - body_len);
+	wget_body(body_len);
+}
+
+static void wget_send_request(void)
+{
+	char req[TCP_MSS];
+	int len;
+
+	len = snprintf(req, sizeof(req),
+		       "GET %s HTTP/1.1\r\nHost: %pI4", wget_path,
+		       &wget_server_ip);
+	if (wget_server_port != HTTP_PORT)
+		len += snprintf(req + len, sizeof(req) - len, ":%d",
+				wget_server_port);
+	len += snprintf(req + len, sizeof(req) - len,
+			"\r\nUser-Agent: U-Boot\r\nConnection: close\r\n");
+	if (wget_range_offset || wget_range_size)
+		len += snprintf(req + len, sizeof(req) - len,
+				"Range: bytes=%lu-", wget_range_offset);
+	if (wget_range_size)
+		len += snprintf(req + len, sizeof(req) - len, "%lu",
+				wget_range_offset + wget_range_size - 1);
+	if (wget_range_offset || wget_range_size)
+		len += snprintf(req + len, sizeof(req) - len, "\r\n");
+	len += snprintf(req + len, sizeof(req) - len, "\r\n");
+
+	if (len >= sizeof(req) || tcp_send(req, len))
+		wget_fail("request too long");
+}
+
+static void wget_event(enum tcp_event event)
+{
+	switch (event) {
+	case TCP_CONNECTED:
+		wget_send_request();
+		break;
+	case TCP_CLOSED:
+		if (!wget_hdr_done) {
+			wget_fail("connection closed before the response");
+		} else if (wget_known_size && wget_body_len < wget_limit) {
+			printf("\nwget: got %lu of %lu bytes", wget_body_len,
+			       wget_limit);
+			wget_fail("connection closed");
+		} else {
+			tcp_close();
+			wget_done();
+		}
+		break;
+	case TCP_RESET:
+		wget_fail(wget_hdr_len ? "connection reset" :
+			  "connection refused");
+		break;
+	case TCP_TIMEOUT:
+		wget_fail("timed out");
+		break;
+	}
+}
+
+/* Initialize wget_load and wget_load_size from image_load_addr and lmb */
+static int wget_init_load_addr(void)
+{
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+	phys_size_t max_size;
+
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+
+	max_size = lmb_get_free_size(&lmb, image_load_addr);
+	lmb_uninit(&lmb);
+	if (!max_size)
+		return -1;
+
+	wget_load_size = max_size;
+#else
+	wget_load_size = ULONG_MAX - image_load_addr;
+#endif
+	wget_load = map_sysmem(image_load_addr, wget_load_size);
+	return 0;
+}
+
+void wget_start(void)
+{
+	char *ep;
+
+	wget_server_ip = net_server_ip;
+	wget_path[0] = '/';
+	if (!net_parse_bootfile(&wget_server_ip, wget_path + 1,
+				sizeof(wget_path) - 1)) {
+		puts("*** ERROR: no file name\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	/* The path may be given with or without its leading '/' */
+	if (wget_path[1] == '/')
+		memmove(wget_path, wget_path + 1, strlen(wget_path));
+
+	wget_server_port = HTTP_PORT;
+	ep = env_get("httpdstp");
+	if (ep)
+		wget_server_port = simple_strtol(ep, NULL, 10);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4:%d; our IP address is %pI4\n",
+	       &wget_server_ip, wget_server_port, &net_ip);
+	printf("Path '%s'", wget_path);
+	if (wget_range_offset || wget_range_size)
+		printf(", bytes 0x%lx+0x%lx", wget_range_offset,
+		       wget_range_size);
+	putc('\n');
+
+	if (wget_init_load_addr()) {
+		eth_halt();
+		net_set_state(NETLOOP_FAIL);
+		puts("\nwget error: trying to overwrite reserved memory...\n");
+		return;
+	}
+	printf("Load address: 0x%lx\n", image_load_addr);
+	puts("Loading: *\b");
+
+	wget_hdr_len = 0;
+	wget_hdr_done = false;
+	wget_body_len = 0;
+	wget_hashes = 0;
+	time_start = get_timer(0);
+
+	tcp_connect(wget_server_ip, wget_server_port, wget_rx, wget_event);
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for arena allocation of devices
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <dm/arena.h>
+#include <dm/device-internal.h>
+#include <dm/test.h>
+#include <dm/uclass-internal.h>
+#include <test/ut.h>
+
+static const struct dm_test_pdata arena_pdata = {
+	.ping_add		= 3,
+};
+
+static const struct driver_info arena_info = {
+	.name = "test_drv",
+	.plat = &arena_pdata,
+};
+
+/* Check that @ptr lies after the struct udevice, within its bundle */
+static bool in_bundle(struct udevice *dev, void *ptr)
+{
+	return ptr > (void *)dev && ptr < (void *)dev + dm_arena_dev_size(dev);
+}
+
+/* Test that a device and its data areas are allocated as one bundle */
+static int dm_test_arena(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *dev, *dev2;
+	struct uclass *uc;
+	uint size, count;
+
+	ut_assertok(uclass_get(UCLASS_TEST, &uc));
+	count = uc->arena.count;
+
+	ut_assertok(device_bind_by_name(dms->root, false, &arena_info, &dev));
+	ut_assert(dev_get_flags(dev) & DM_FLAG_ARENA);
+	ut_asserteq(count + 1, uc->arena.count);
+	size = dm_arena_dev_size(dev);
+	ut_assert(size > sizeof(*dev));
+	ut_assert(in_bundle(dev, dev_get_uclass_plat(dev)));
+	ut_assertnull(dev_get_priv(dev));
+
+	ut_assertok(device_probe(dev));
+	ut_assert(in_bundle(dev, dev_get_priv(dev)));
+	ut_assert(in_bundle(dev, dev_get_uclass_priv(dev)));
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertnull(dev_get_priv(dev));
+	ut_assertnull(dev_get_uclass_priv(dev));
+
+	/* The bundle of an unbound device is used again by the next one */
+	ut_assertok(device_unbind(dev));
+	ut_asserteq(count, uc->arena.count);
+	ut_assertok(device_bind_by_name(dms->root, false, &arena_info, &dev2));
+	ut_asserteq_ptr(dev, dev2);
+	ut_asserteq(size, dm_arena_dev_size(dev2));
+	ut_assertok(device_probe(dev2));
+	ut_asserteq(DM_TEST_START_TOTAL,
+		    ((struct dm_test_priv *)dev_get_priv(dev2))->ping_total);
+	ut_assertok(device_remove(dev2, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev2));
+
+	return 0;
+}
+
+DM_TEST(dm_test_arena, 0);
@@ -10,13 +10,16 @@
 #include <dm.h>
 #include <env.h>
 #include <fdtdec.h>
+#include <image.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <asm/eth.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
+#include <net/tftp.h>
 #include <test/test.h>
 #include <test/ut.h>
 
@@ -431,3 +434,443 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, UT_TESTF_SCAN_FDT);
+
+/* A file served by a fake TFTP server, and how it is sent */
+#define TFTP_TEST_BLKSIZE	512
+#define TFTP_TEST_BLOCKS	24
+#define TFTP_TEST_SIZE		((TFTP_TEST_BLOCKS - 1) * TFTP_TEST_BLKSIZE + 100)
+#define TFTP_TEST_PORT		1069
+#define TFTP_TEST_ADDR		0x1000000
+
+struct sb_tftp_server {
+	u8 file[TFTP_TEST_SIZE];
+	int requested;		/* window size asked for by the client */
+	int window;		/* window size used */
+	bool reverse;		/* send each window in reverse order */
+	u64 drop;		/* blocks lost the first time they are sent */
+	int client_port;
+};
+
+/*
+ * Queue a UDP datagram for the client to receive, after those already queued
+ * or, if @early, right after the first one, which the client may be
+ * processing.
+ */
+static void sb_udp_queue(struct udevice *dev, int sport, int dport,
+			 const void *data, int len, bool early)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+	int i, at = priv->recv_packets;
+
+	/* Lost when the buffers are full, as it would be on the wire */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	if (early && at > 1) {
+		for (i = priv->recv_packets; i > 1; i--) {
+			memcpy(priv->recv_packet_buffer[i],
+			       priv->recv_packet_buffer[i - 1],
+			       priv->recv_packet_length[i - 1]);
+			priv->recv_packet_length[i] =
+				priv->recv_packet_length[i - 1];
+		}
+		at = 1;
+	}
+
+	eth_recv = (void *)priv->recv_packet_buffer[at];
+	memcpy(eth_recv->et_dest, net_ethaddr, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	memset(ipr, '\0', IP_UDP_HDR_SIZE);
+	ipr->ip_hl_v = 0x45;
+	ipr->ip_len = htons(IP_UDP_HDR_SIZE + len);
+	ipr->ip_off = htons(IP_FLAGS_DFRAG);
+	ipr->ip_ttl = 255;
+	ipr->ip_p = IPPROTO_UDP;
+	net_write_ip(&ipr->ip_src, priv->fake_host_ipaddr);
+	net_write_ip(&ipr->ip_dst, net_ip);
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+	ipr->udp_src = htons(sport);
+	ipr->udp_dst = htons(dport);
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	memcpy((void *)ipr + IP_UDP_HDR_SIZE, data, len);
+
+	priv->recv_packet_length[at] = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+}
+
+static void sb_tftp_queue(struct udevice *dev, struct sb_tftp_server *srv,
+			  const void *data, int len)
+{
+	sb_udp_queue(dev, TFTP_TEST_PORT, srv->client_port, data, len, false);
+}
+
+/* Answer a read request with an OACK, and each ACK with a window of blocks */
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u8 *req = packet + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	int req_len = len - ETHER_HDR_SIZE - IP_UDP_HDR_SIZE;
+	u8 pkt[4 + TFTP_TEST_BLKSIZE];
+	int i, n, block, first, queued = 0;
+	char *opt;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+	srv->client_port = ntohs(ip->udp_src);
+
+	switch (req[1]) {
+	case 1:		/* RRQ */
+		srv->requested = 1;
+		for (i = 2; i < req_len; i += strlen(opt) + 1) {
+			opt = (char *)req + i;
+			if (!strcmp(opt, "windowsize"))
+				srv->requested = simple_strtoul(opt + 11, NULL,
+								10);
+		}
+		/* One receive buffer is in use when the client answers */
+		srv->window = min(srv->requested, PKTBUFSRX - 1);
+		pkt[0] = 0;
+		pkt[1] = 6;	/* OACK */
+		n = 2;
+		n += sprintf((char *)pkt + n, "blksize") + 1;
+		n += sprintf((char *)pkt + n, "%d", TFTP_TEST_BLKSIZE) + 1;
+		n += sprintf((char *)pkt + n, "windowsize") + 1;
+		n += sprintf((char *)pkt + n, "%d", srv->window) + 1;
+		sb_tftp_queue(dev, srv, pkt, n);
+		break;
+	case 4:		/* ACK */
+		/*
+		 * The server starts again after the block acknowledged, and
+		 * the blocks queued but not yet received are lost in flight.
+		 */
+		if (priv->recv_packets > 1)
+			priv->recv_packets = 1;
+		first = (req[2] << 8 | req[3]) + 1;
+		for (i = 0; i < srv->window; i++) {
+			block = srv->reverse ? first + srv->window - 1 - i :
+				first + i;
+			if (block > TFTP_TEST_BLOCKS)
+				continue;
+			if (srv->drop & BIT_ULL(block)) {
+				srv->drop &= ~BIT_ULL(block);
+				continue;
+			}
+			n = min(TFTP_TEST_BLKSIZE,
+				TFTP_TEST_SIZE - (block - 1) * TFTP_TEST_BLKSIZE);
+			pkt[0] = 0;
+			pkt[1] = 3;	/* DATA */
+			pkt[2] = block >> 8;
+			pkt[3] = block;
+			memcpy(pkt + 4,
+			       srv->file + (block - 1) * TFTP_TEST_BLKSIZE, n);
+			sb_tftp_queue(dev, srv, pkt, 4 + n);
+			queued++;
+		}
+		/* Only a timeout makes the client ask again */
+		if (!queued)
+			sandbox_eth_skip_timeout();
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_tftp_get(struct unit_test_state *uts, struct sb_tftp_server *srv)
+{
+	u8 *buf = map_sysmem(TFTP_TEST_ADDR, TFTP_TEST_SIZE);
+
+	memset(buf, '\0', TFTP_TEST_SIZE);
+	image_load_addr = TFTP_TEST_ADDR;
+	ut_asserteq(TFTP_TEST_SIZE, net_loop(TFTPGET));
+	ut_asserteq_mem(srv->file, buf, TFTP_TEST_SIZE);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+static int _dm_test_eth_tftp_window(struct unit_test_state *uts,
+				    struct sb_tftp_server *srv)
+{
+	/* In order, without loss */
+	env_set("tftpwindowsize", "4");
+	ut_assertok(sb_tftp_get(uts, srv));
+	ut_asserteq(PKTBUFSRX - 1, srv->window);
+	ut_asserteq(0, tftp_stats.ooo);
+	ut_asserteq(0, tftp_stats.timeouts);
+
+	/* Blocks received early are kept and not asked for again */
+	srv->reverse = true;
+	ut_assertok(sb_tftp_get(uts, srv));
+	ut_assert(tftp_stats.ooo > 0);
+	ut_asserteq(0, tftp_stats.dups);
+	ut_asserteq(0, tftp_stats.timeouts);
+
+	/*
+	 * A block lost inside a window is asked for again without waiting
+	 * for a timeout, and a whole window lost halves the window asked for
+	 * next time.
+	 */
+	srv->reverse = false;
+	srv->drop = BIT_ULL(5) | BIT_ULL(10) | BIT_ULL(11) | BIT_ULL(12);
+	env_set("tftpwindowsize", "3");
+	ut_assertok(sb_tftp_get(uts, srv));
+	ut_asserteq(3, srv->requested);
+	ut_assert(tftp_stats.nacks > 0);
+	ut_asserteq(1, tftp_stats.timeouts);
+
+	/* The window then grows back, one block per transfer without loss */
+	ut_assertok(sb_tftp_get(uts, srv));
+	ut_asserteq(1, srv->requested);
+	ut_assertok(sb_tftp_get(uts, srv));
+	ut_asserteq(2, srv->requested);
+
+	/* Reordering and losses together */
+	srv->reverse = true;
+	srv->drop = BIT_ULL(7) | BIT_ULL(20) | BIT_ULL(23);
+	ut_assertok(sb_tftp_get(uts, srv));
+	ut_asserteq(3, srv->requested);
+	ut_asserteq(0, tftp_stats.timeouts);
+
+	return 0;
+}
+
+static int dm_test_eth_tftp_window(struct unit_test_state *uts)
+{
+	struct sb_tftp_server *srv;
+	int i, retval;
+
+	srv = calloc(1, sizeof(*srv));
+	ut_assertnonnull(srv);
+	for (i = 0; i < TFTP_TEST_SIZE; i++)
+		srv->file[i] = i * 7 + i / TFTP_TEST_BLKSIZE;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	env_set("serverip", "1.1.2.2");
+	env_set("tftpblocksize", "512");
+	copy_filename(net_boot_file_name, "test.bin",
+		      sizeof(net_boot_file_name));
+
+	retval = _dm_test_eth_tftp_window(uts, srv);
+
+	/* Restore the env */
+	env_set("serverip", NULL);
+	env_set("tftpblocksize", NULL);
+	env_set("tftpwindowsize", NULL);
+	net_boot_file_name[0] = '\0';
+	sandbox_eth_set_tx_handler(0, NULL);
+	free(srv);
+
+	return retval;
+}
+
+DM_TEST(dm_test_eth_tftp_window, UT_TESTF_SCAN_FDT);
+
+/* A file served by a fake NFSv3 server */
+#define NFS_TEST_BLKSIZE	1024	/* READ size preferred by the server */
+#define NFS_TEST_BLOCKS		21
+#define NFS_TEST_SIZE		((NFS_TEST_BLOCKS - 1) * NFS_TEST_BLKSIZE + 300)
+#define NFS_TEST_PORT		2049
+#define NFS_TEST_ADDR		0x1000000
+
+struct sb_nfs_server {
+	u8 file[NFS_TEST_SIZE];
+	bool reverse;		/* queue each READ reply ahead of the others */
+	u32 drop;		/* blocks lost the first time they are read */
+	u32 read_size;		/* largest READ asked for */
+	int queued;		/* most packets queued after a READ reply */
+};
+
+/* Answer the portmap, MOUNT and NFS calls, accepting NFSv3 only */
+static int sb_nfs_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_nfs_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u32 call[128], reply[16 + NFS_TEST_BLKSIZE / 4];
+	u32 *args, *p = reply;
+	u32 offset, count;
+	bool early = false;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+	memcpy(call, (void *)ip + IP_UDP_HDR_SIZE,
+	       min_t(int, len - ETHER_HDR_SIZE - IP_UDP_HDR_SIZE,
+		     sizeof(call)));
+
+	/* Skip the credential and the verifier */
+	args = call + 8 + ntohl(call[7]) / 4;
+	args += 2 + ntohl(args[1]) / 4;
+
+	*p++ = call[0];		/* XID */
+	*p++ = htonl(1);	/* REPLY */
+	*p++ = 0;		/* accepted */
+	*p++ = 0;		/* AUTH_NONE verifier */
+	*p++ = 0;
+	*p++ = 0;		/* success */
+
+	switch (ntohl(call[3])) {
+	case 100000:		/* portmap: MOUNT and NFS use the same port */
+		*p++ = htonl(NFS_TEST_PORT);
+		break;
+	case 100005:		/* MOUNT */
+		if (ntohl(call[5]) == 1) {
+			*p++ = 0;
+			memset(p, '\0', 32);	/* root file handle */
+			p += 8;
+		}
+		break;
+	case 100003:		/* NFS */
+		if (ntohl(call[4]) != 3) {
+			p[-1] = htonl(2);	/* program mismatch */
+			*p++ = htonl(3);
+			*p++ = htonl(3);
+			break;
+		}
+		switch (ntohl(call[5])) {
+		case 3:		/* LOOKUP */
+			*p++ = 0;
+			*p++ = htonl(32);
+			memset(p, 0xff, 32);	/* file handle */
+			p += 8;
+			*p++ = 0;	/* no attributes */
+			*p++ = 0;
+			break;
+		case 19:	/* FSINFO */
+			*p++ = 0;
+			*p++ = 0;	/* no attributes */
+			*p++ = htonl(32768);		/* rtmax */
+			*p++ = htonl(NFS_TEST_BLKSIZE);	/* rtpref */
+			*p++ = htonl(512);		/* rtmult */
+			break;
+		case 6:		/* READ: file handle, 64-bit offset, count */
+			args += 1 + ntohl(args[0]) / 4;
+			offset = min_t(u32, ntohl(args[1]), NFS_TEST_SIZE);
+			count = ntohl(args[2]);
+			srv->read_size = max(srv->read_size, count);
+			if (srv->drop & BIT(offset / NFS_TEST_BLKSIZE)) {
+				srv->drop &= ~BIT(offset / NFS_TEST_BLKSIZE);
+				/* Only a timeout makes the client ask again */
+				sandbox_eth_skip_timeout();
+				return 0;
+			}
+			count = min_t(u32, count, NFS_TEST_BLKSIZE);
+			count = min_t(u32, count, NFS_TEST_SIZE - offset);
+			*p++ = 0;
+			*p++ = 0;	/* no attributes */
+			*p++ = htonl(count);
+			*p++ = htonl(offset + count == NFS_TEST_SIZE);
+			*p++ = htonl(count);
+			memcpy(p, srv->file + offset, count);
+			p += DIV_ROUND_UP(count, 4);
+			early = srv->reverse;
+			break;
+		}
+		break;
+	}
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		sandbox_eth_skip_timeout();
+	sb_udp_queue(dev, ntohs(ip->udp_dst), ntohs(ip->udp_src), reply,
+		     (void *)p - (void *)reply, early);
+	if (ntohl(call[3]) == 100003 && ntohl(call[5]) == 6)
+		srv->queued = max(srv->queued, priv->recv_packets);
+
+	return 0;
+}
+
+static int sb_nfs_get(struct unit_test_state *uts, struct sb_nfs_server *srv)
+{
+	u8 *buf = map_sysmem(NFS_TEST_ADDR, NFS_TEST_SIZE);
+
+	memset(buf, '\0', NFS_TEST_SIZE);
+	image_load_addr = NFS_TEST_ADDR;
+	ut_asserteq(NFS_TEST_SIZE, net_loop(NFS));
+	ut_asserteq_mem(srv->file, buf, NFS_TEST_SIZE);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+static int _dm_test_eth_nfs_read(struct unit_test_state *uts,
+				 struct sb_nfs_server *srv)
+{
+	/*
+	 * One READ at a time, of the size preferred by the server: the
+	 * reply being processed and the next one are queued.
+	 */
+	env_set("nfswindowsize", "1");
+	ut_assertok(sb_nfs_get(uts, srv));
+	ut_asserteq(NFS_TEST_BLKSIZE, srv->read_size);
+	ut_asserteq(2, srv->queued);
+
+	/* As many READs in flight as the receive buffers can hold */
+	env_set_ulong("nfswindowsize", PKTBUFSRX - 1);
+	srv->queued = 0;
+	ut_assertok(sb_nfs_get(uts, srv));
+	ut_asserteq(PKTBUFSRX, srv->queued);
+
+	/* Replies received out of order go to their offset */
+	srv->reverse = true;
+	ut_assertok(sb_nfs_get(uts, srv));
+
+	/* Lost replies are asked for again, in order or not */
+	srv->reverse = false;
+	srv->drop = BIT(3) | BIT(NFS_TEST_BLOCKS - 1);
+	ut_assertok(sb_nfs_get(uts, srv));
+	ut_asserteq(0, srv->drop);
+
+	srv->reverse = true;
+	srv->drop = BIT(0) | BIT(11);
+	ut_assertok(sb_nfs_get(uts, srv));
+	ut_asserteq(0, srv->drop);
+
+	return 0;
+}
+
+static int dm_test_eth_nfs_read(struct unit_test_state *uts)
+{
+	struct sb_nfs_server *srv;
+	int i, retval;
+
+	srv = calloc(1, sizeof(*srv));
+	ut_assertnonnull(srv);
+	for (i = 0; i < NFS_TEST_SIZE; i++)
+		srv->file[i] = i * 5 + i / NFS_TEST_BLKSIZE;
+
+	sandbox_eth_set_tx_handler(0, sb_nfs_handler);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	env_set("serverip", "1.1.2.2");
+	copy_filename(net_boot_file_name, "/export/test.bin",
+		      sizeof(net_boot_file_name));
+
+	retval = _dm_test_eth_nfs_read(uts, srv);
+
+	/* Restore the env */
+	env_set("serverip", NULL);
+	env_set("nfswindowsize", NULL);
+	net_boot_file_name[0] = '\0';
+	sandbox_eth_set_tx_handler(0, NULL);
+	free(srv);
+
+	return retval;
+}
+
+DM_TEST(dm_test_eth_nfs_read, UT_TESTF_SCAN_FDT);
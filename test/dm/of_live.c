@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for pre-unflattened live tree images
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <of_live.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <dm/of.h>
+#include <dm/test.h>
+#include <linux/libfdt.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Check that two live trees have the same nodes and properties */
+static int check_same_tree(struct unit_test_state *uts,
+			   const struct device_node *expect,
+			   const struct device_node *np)
+{
+	const struct property *epp, *pp;
+
+	for (; expect; expect = expect->sibling, np = np->sibling) {
+		ut_assertnonnull(np);
+		ut_asserteq_str(expect->full_name, np->full_name);
+		ut_asserteq_str(expect->name, np->name);
+		ut_asserteq_str(expect->type, np->type);
+		ut_asserteq(expect->phandle, np->phandle);
+		if (expect->parent) {
+			ut_assertnonnull(np->parent);
+			ut_asserteq_str(expect->parent->full_name,
+					np->parent->full_name);
+		} else {
+			ut_assertnull(np->parent);
+		}
+
+		for (epp = expect->properties, pp = np->properties; epp;
+		     epp = epp->next, pp = pp->next) {
+			ut_assertnonnull(pp);
+			ut_asserteq_str(epp->name, pp->name);
+			ut_asserteq(epp->length, pp->length);
+			ut_asserteq_mem(epp->value, pp->value, epp->length);
+		}
+		ut_assertnull(pp);
+
+		ut_assertok(check_same_tree(uts, expect->child, np->child));
+	}
+	ut_assertnull(np);
+
+	return 0;
+}
+
+static int dm_test_of_live_image(struct unit_test_state *uts)
+{
+	const void *fdt = gd->fdt_blob;
+	struct of_live_image_header *hdr;
+	struct device_node *expect, *root;
+	ulong start, build_us, map_us;
+	void *image;
+	int size;
+
+	size = of_live_image_create(fdt, NULL, 0);
+	ut_assert(size > 0);
+	image = malloc(size);
+	ut_assertnonnull(image);
+	ut_asserteq(-FDT_ERR_NOSPACE, of_live_image_create(fdt, image, 16));
+	ut_asserteq(size, of_live_image_create(fdt, image, size));
+
+	/* This also scans the aliases again, which does no harm */
+	start = timer_get_us();
+	ut_assertok(of_live_build(fdt, &expect));
+	build_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	ut_assertok(of_live_map(fdt, image, &root));
+	map_us = timer_get_us() - start;
+	printf("live tree: unflatten %lu us, map image %lu us (%d bytes)\n",
+	       build_us, map_us, size);
+
+	ut_assertok(check_same_tree(uts, expect, root));
+	free(root);
+	free(expect);
+
+	/* The tree that the image came from must not have changed */
+	hdr = image;
+	hdr->num_nodes = cpu_to_fdt32(fdt32_to_cpu(hdr->num_nodes) + 1);
+	ut_asserteq(-EINVAL, of_live_map(fdt, image, &root));
+	free(image);
+
+	return 0;
+}
+
+DM_TEST(dm_test_of_live_image, 0);
@@ -6,7 +6,9 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <memalign.h>
 #include <part.h>
+#include <scsi.h>
 #include <usb.h>
 #include <asm/io.h>
 #include <asm/state.h>
@@ -63,6 +65,70 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/* test that bulk transfers can be queued, then waited for or cancelled */
+static int dm_test_usb_bulk_queue(struct unit_test_state *uts)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_cbw, cbw, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct umass_bbb_csw, csw, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(char, data, 512);
+	struct usb_bulk_xfer xfer[3] = {};
+	struct usb_device *udev;
+	struct udevice *dev;
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
+	udev = dev_get_parent_priv(dev);
+
+	/* Read the first block, with the CBW, data and CSW queued at once */
+	memset(cbw, '\0', sizeof(*cbw));
+	cbw->dCBWSignature = CBWSIGNATURE;
+	cbw->dCBWTag = 0x1234;
+	cbw->dCBWDataTransferLength = 512;
+	cbw->bCBWFlags = CBWFLAGS_IN;
+	cbw->bCDBLength = 10;
+	cbw->CBWCDB[0] = SCSI_READ10;
+	cbw->CBWCDB[8] = 1;
+	memset(data, '\0', 512);
+
+	xfer[0].pipe = usb_sndbulkpipe(udev, 1);
+	xfer[0].buffer = cbw;
+	xfer[0].length = UMASS_BBB_CBW_SIZE;
+	xfer[1].pipe = usb_rcvbulkpipe(udev, 2);
+	xfer[1].buffer = data;
+	xfer[1].length = 512;
+	xfer[2].pipe = usb_rcvbulkpipe(udev, 2);
+	xfer[2].buffer = csw;
+	xfer[2].length = UMASS_BBB_CSW_SIZE;
+	ut_assertok(usb_bulk_submit(udev, &xfer[0]));
+	ut_assertok(usb_bulk_submit(udev, &xfer[1]));
+	ut_assertok(usb_bulk_submit(udev, &xfer[2]));
+	ut_asserteq(-EINPROGRESS, xfer[2].status);
+
+	/* Waiting for the CBW leaves the transfers after it queued */
+	ut_assertok(usb_bulk_wait(udev, &xfer[0], 1000));
+	ut_asserteq(-EINPROGRESS, xfer[1].status);
+	ut_assertok(usb_bulk_wait(udev, &xfer[2], 1000));
+	ut_assertok(xfer[1].status);
+	ut_asserteq(512, xfer[1].actual_length);
+	ut_assertok(strcmp(data, "this is a test"));
+	ut_asserteq(UMASS_BBB_CSW_SIZE, xfer[2].actual_length);
+	ut_asserteq(CSWSIGNATURE, csw->dCSWSignature);
+	ut_asserteq(0x1234, csw->dCSWTag);
+	ut_asserteq(CSWSTATUS_GOOD, csw->bCSWStatus);
+
+	/* A cancelled transfer is never done */
+	ut_assertok(usb_bulk_submit(udev, &xfer[1]));
+	ut_assertok(usb_bulk_cancel(udev, &xfer[1]));
+	ut_asserteq(-ECONNRESET, usb_bulk_wait(udev, &xfer[1], 1000));
+
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+
+DM_TEST(dm_test_usb_bulk_queue, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
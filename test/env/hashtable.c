@@ -124,3 +124,48 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 }
 
 ENV_TEST(env_test_htab_deletes, 0);
+
+/* Import an environment in place and check that exports stay sorted */
+static int env_test_htab_inplace(struct unit_test_state *uts)
+{
+	static const char env[] = "b=2\0a=1\0d=4\0c=3\0";
+	struct hsearch_data htab;
+	struct env_entry item;
+	struct env_entry *ritem;
+	char *res = NULL;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, himport_r(&htab, env, sizeof(env), '\0', 0, 0, 0,
+				 NULL));
+	ut_asserteq(4, htab.filled);
+
+	item.callback = NULL;
+	item.flags = 0;
+	item.key = "c";
+	item.data = NULL;
+	ut_assert(hsearch_r(item, ENV_FIND, &ritem, &htab, 0));
+	ut_asserteq_str("3", ritem->data);
+	if (CONFIG_IS_ENABLED(ENV_INPLACE)) {
+		ut_assert(ritem->data >= htab.blob &&
+			  ritem->data < htab.blob + htab.blob_size);
+	}
+
+	/* Overwrite one variable, add another and delete a third */
+	item.key = "a";
+	item.data = "one";
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	item.key = "bb";
+	item.data = "22";
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_assertok(hdelete_r("d", &htab, 0));
+	ut_asserteq(4, htab.filled);
+
+	ut_asserteq(21, hexport_r(&htab, '\n', 0, &res, 0, 0, NULL));
+	ut_asserteq_str("a=one\nb=2\nbb=22\nc=3\n", res);
+	free(res);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+
+ENV_TEST(env_test_htab_inplace, 0);
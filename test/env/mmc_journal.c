@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the environment journal on the MMC
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <env.h>
+#include <env_internal.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <test/env.h>
+#include <test/ut.h>
+
+/* Check whether the environment stored at @offset holds "@var\0" */
+static bool env_test_mmc_stored(struct blk_desc *desc, u32 offset,
+				const char *var)
+{
+	bool found = false;
+	char *data, *p;
+	env_t *env;
+
+	env = malloc(ALIGN(CONFIG_ENV_SIZE, desc->blksz));
+	if (!env)
+		return false;
+	if (blk_dread(desc, offset / desc->blksz,
+		      DIV_ROUND_UP(CONFIG_ENV_SIZE, desc->blksz), env) !=
+	    DIV_ROUND_UP(CONFIG_ENV_SIZE, desc->blksz))
+		goto out;
+
+	data = (char *)env->data;
+	for (p = data; p < data + ENV_SIZE && *p; p += strlen(p) + 1)
+		if (!strcmp(p, var)) {
+			found = true;
+			break;
+		}
+out:
+	free(env);
+
+	return found;
+}
+
+/*
+ * Save until the journal has wrapped twice: a full rewrite of the environment
+ * must come after exactly as many records as fit before the end of the area
+ * holding it, and nothing past that end may be written.
+ */
+static int env_test_mmc_journal_wrap(struct unit_test_state *uts)
+{
+	struct env_driver *drv = ll_entry_get(struct env_driver, mmc,
+					      env_driver);
+	struct mmc *mmc = find_mmc_device(mmc_get_env_dev());
+	char canary[512], block[512], var[32];
+	u32 offset, journal, size;
+	int full = -1, records;
+	struct blk_desc *desc;
+	bool check_canary;
+	u64 end;
+	int i;
+
+	ut_assertnonnull(drv->save);
+	ut_assertnonnull(mmc);
+	ut_assertok(mmc_init(mmc));
+	desc = mmc_get_blk_desc(mmc);
+	ut_asserteq(sizeof(block), desc->blksz);
+
+	ut_assertok(mmc_get_env_addr(mmc, 0, &offset));
+	ut_assertok(mmc_get_env_end(mmc, 0, &end));
+	journal = offset + CONFIG_ENV_SIZE;
+	size = end > journal ? min_t(u64, end - journal,
+				     CONFIG_ENV_MMC_JOURNAL_SIZE) : 0;
+	size = rounddown(size, desc->blksz);
+	records = size / desc->blksz;
+
+	/* The block following the journal, if it is on the device */
+	check_canary = (u64)journal + size + desc->blksz <= mmc->capacity;
+	if (check_canary) {
+		memset(canary, 0xa5, sizeof(canary));
+		ut_asserteq(1, blk_dwrite(desc, (journal + size) / desc->blksz,
+					  1, canary));
+	}
+
+	for (i = 0; i < 2 * (records + 1) + 1; i++) {
+		snprintf(var, sizeof(var), "jtest=%d", i);
+		ut_assertok(env_set("jtest", var + strlen("jtest=")));
+		ut_assertok(drv->save());
+		if (!env_test_mmc_stored(desc, offset, var))
+			continue;
+		/* The first full rewrite may come early, from an unknown state */
+		if (full >= 0)
+			ut_asserteq(full + records + 1, i);
+		full = i;
+	}
+	ut_assert(full >= records + 1);
+
+	if (check_canary) {
+		ut_asserteq(1, blk_dread(desc, (journal + size) / desc->blksz,
+					 1, block));
+		ut_asserteq_mem(canary, block, sizeof(block));
+	}
+
+	/* The records written since the last full rewrite are applied */
+	ut_assertok(drv->load());
+	ut_asserteq_str(var + strlen("jtest="), env_get("jtest"));
+
+	return 0;
+}
+
+ENV_TEST(env_test_mmc_journal_wrap, 0);
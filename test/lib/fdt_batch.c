@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests and benchmark for batched FDT edits
+ *
+ * To measure a particular tree, e.g. a D9 one, start sandbox with it:
+ *
+ *	./u-boot -d arch/arm/dts/<board>.dtb -c "ut lib lib_test_fdt_batch"
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <fdt_batch.h>
+#include <malloc.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <linux/libfdt.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Extra space for the edits */
+#define FDT_BATCH_EXTRA		0x10000
+
+/* Edits made to node number @i, one at a time, like a board fixup */
+static int edit_node(void *fdt, int node, int i)
+{
+	int ret;
+
+	ret = fdt_setprop_string(fdt, node, "status", i % 3 ? "okay" :
+				 "disabled");
+	if (!ret)
+		ret = fdt_setprop_u32(fdt, node, "u-boot,fixup", i);
+	if (!ret && i % 4 == 1) {
+		ret = fdt_delprop(fdt, node, "compatible");
+		if (ret == -FDT_ERR_NOTFOUND)
+			ret = 0;
+	}
+	if (!ret && i % 8 == 2) {
+		int sub;
+
+		sub = fdt_add_subnode(fdt, node, "fixup@0");
+		if (sub < 0)
+			return sub;
+		ret = fdt_setprop_u64(fdt, sub, "reg", 0x1000ULL * i);
+		if (!ret)
+			ret = fdt_appendprop_string(fdt, node, "u-boot,fixup",
+						    "x");
+	}
+
+	return ret;
+}
+
+/* The same edits, recorded in a batch */
+static int edit_node_batch(struct fdt_batch *b, int node, int i)
+{
+	int ret;
+
+	ret = fdt_batch_setprop_string(b, node, "status", i % 3 ? "okay" :
+				       "disabled");
+	if (!ret)
+		ret = fdt_batch_setprop_u32(b, node, "u-boot,fixup", i);
+	if (!ret && i % 4 == 1) {
+		ret = fdt_batch_delprop(b, node, "compatible");
+		if (ret == -FDT_ERR_NOTFOUND)
+			ret = 0;
+	}
+	if (!ret && i % 8 == 2) {
+		int sub;
+
+		sub = fdt_batch_add_subnode(b, node, "fixup@0");
+		if (sub < 0)
+			return sub;
+		ret = fdt_batch_setprop_u64(b, sub, "reg", 0x1000ULL * i);
+		if (!ret)
+			ret = fdt_batch_appendprop(b, node, "u-boot,fixup",
+						   "x", 2);
+	}
+
+	return ret;
+}
+
+/* fdt_rw.c leaves the padding after property values as it finds it */
+static void zero_padding(void *fdt)
+{
+	const struct fdt_property *prop;
+	int offset = 0, next, len;
+	u32 tag;
+
+	do {
+		tag = fdt_next_tag(fdt, offset, &next);
+		if (tag == FDT_PROP) {
+			prop = fdt_offset_ptr(fdt, offset, sizeof(*prop));
+			len = fdt32_to_cpu(prop->len);
+			memset((char *)prop->data + len, '\0',
+			       ALIGN(len, FDT_TAGSIZE) - len);
+		}
+		offset = next;
+	} while (tag != FDT_END);
+}
+
+static int lib_test_fdt_batch(struct unit_test_state *uts)
+{
+	const void *fdt = gd->fdt_blob;
+	int size = fdt_totalsize(fdt) + FDT_BATCH_EXTRA;
+	ulong start, seq_us, batch_us;
+	void *seq, *out;
+	struct fdt_batch b;
+	int node, count, i;
+	char path[256];
+
+	seq = malloc(size);
+	ut_assertnonnull(seq);
+	out = malloc(size);
+	ut_assertnonnull(out);
+
+	/* Each edit moves the rest of the tree; offsets must be looked up */
+	ut_assertok(fdt_open_into(fdt, seq, size));
+	start = timer_get_us();
+	count = 0;
+	for (node = fdt_next_node(fdt, -1, NULL); node >= 0;
+	     node = fdt_next_node(fdt, node, NULL), count++) {
+		ut_assertok(fdt_get_path(fdt, node, path, sizeof(path)));
+		ut_assertok(edit_node(seq, fdt_path_offset(seq, path), count));
+	}
+	ut_assertok(fdt_add_mem_rsv(seq, 0x1000, 0x100));
+	seq_us = timer_get_us() - start;
+
+	/* A batch uses the original offsets throughout */
+	start = timer_get_us();
+	ut_assertok(fdt_batch_init(&b, (void *)fdt));
+	for (node = fdt_next_node(fdt, -1, NULL), i = 0; node >= 0;
+	     node = fdt_next_node(fdt, node, NULL), i++)
+		ut_assertok(edit_node_batch(&b, node, i));
+	ut_assertok(fdt_batch_add_mem_rsv(&b, 0x1000, 0x100));
+	ut_assertok(fdt_batch_commit(&b, out, size));
+	batch_us = timer_get_us() - start;
+	fdt_batch_uninit(&b);
+
+	printf("%d nodes: one at a time %lu us, batched %lu us\n", count,
+	       seq_us, batch_us);
+
+	zero_padding(seq);
+	ut_asserteq(fdt_totalsize(seq), fdt_totalsize(out));
+	ut_asserteq(fdt_off_dt_strings(seq), fdt_off_dt_strings(out));
+	ut_asserteq_mem(seq, out,
+			fdt_off_dt_strings(seq) + fdt_size_dt_strings(seq));
+	ut_assertok(fdt_check_full(out, size));
+
+	/* Edits within a batch are visible to later lookups */
+	ut_assertok(fdt_batch_init(&b, out));
+	node = fdt_batch_add_subnode(&b, 0, "test@10");
+	ut_assert(node >= FDT_BATCH_NEW_NODE);
+	ut_asserteq(node, fdt_batch_subnode_offset(&b, 0, "test"));
+	ut_asserteq(node, fdt_batch_path_offset(&b, "/test@10"));
+	ut_assertok(fdt_batch_get_path(&b, node, path, sizeof(path)));
+	ut_asserteq_str("/test@10", path);
+	ut_asserteq(-FDT_ERR_NOSPACE, fdt_batch_get_path(&b, node, path, 8));
+	ut_asserteq(-FDT_ERR_EXISTS, fdt_batch_add_subnode(&b, 0, "test@10"));
+	ut_assertok(fdt_batch_setprop_u32(&b, node, "val", 1));
+	ut_assertok(fdt_batch_appendprop(&b, node, "val", "a", 2));
+	ut_assertnonnull(fdt_batch_getprop(&b, node, "val", &i));
+	ut_asserteq(6, i);
+	ut_assertok(fdt_batch_delprop(&b, node, "val"));
+	ut_assertnull(fdt_batch_getprop(&b, node, "val", &i));
+	ut_asserteq(-FDT_ERR_NOTFOUND, i);
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_batch_delprop(&b, node, "val"));
+
+	/* Nothing changes until the commit, which can be done in place */
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(out, "/test@10"));
+	ut_assertok(fdt_batch_commit(&b, NULL, 0));
+	fdt_batch_uninit(&b);
+	ut_assert(fdt_path_offset(out, "/test@10") >= 0);
+	ut_asserteq(size, fdt_totalsize(out));
+
+	free(out);
+	free(seq);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_fdt_batch, 0);
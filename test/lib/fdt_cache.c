@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests and benchmark for the control FDT lookup cache
+ *
+ * To measure a particular tree, e.g. a D9 one, start sandbox with it:
+ *
+ *	./u-boot -d arch/arm/dts/<board>.dtb -c "ut lib lib_test_fdt_cache"
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <linux/libfdt.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of times each lookup is repeated for timing */
+#define FDT_CACHE_ROUNDS	10
+
+/* The lookup as done without the cache, for comparison */
+static int scan_phandle(const void *fdt, uint32_t phandle)
+{
+	int offset;
+
+	for (offset = fdt_next_node(fdt, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(fdt, offset, NULL)) {
+		if (fdt_get_phandle(fdt, offset) == phandle)
+			return offset;
+	}
+
+	return offset;
+}
+
+/* Check each phandle and path lookup in @fdt and time the phandle ones */
+static int check_lookups(struct unit_test_state *uts, const void *fdt,
+			 bool show)
+{
+	ulong start, scan_us, cache_us;
+	int offset, count, i;
+	u32 phandle;
+	char path[256];
+
+	count = 0;
+	for (offset = fdt_next_node(fdt, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(fdt, offset, NULL)) {
+		ut_assertok(fdt_get_path(fdt, offset, path, sizeof(path)));
+		ut_asserteq(offset, fdt_path_offset(fdt, path));
+		phandle = fdt_get_phandle(fdt, offset);
+		if (phandle) {
+			ut_asserteq(offset, fdt_node_offset_by_phandle(fdt,
+								       phandle));
+			count++;
+		}
+	}
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(fdt, "/no-such-node"));
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(fdt, "/no-such-node"));
+	if (!show)
+		return 0;
+
+	start = timer_get_us();
+	for (i = 0; i < FDT_CACHE_ROUNDS; i++) {
+		for (offset = fdt_next_node(fdt, -1, NULL); offset >= 0;
+		     offset = fdt_next_node(fdt, offset, NULL)) {
+			phandle = fdt_get_phandle(fdt, offset);
+			if (phandle)
+				scan_phandle(fdt, phandle);
+		}
+	}
+	scan_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < FDT_CACHE_ROUNDS; i++) {
+		for (offset = fdt_next_node(fdt, -1, NULL); offset >= 0;
+		     offset = fdt_next_node(fdt, offset, NULL)) {
+			phandle = fdt_get_phandle(fdt, offset);
+			if (phandle)
+				fdt_node_offset_by_phandle(fdt, phandle);
+		}
+	}
+	cache_us = timer_get_us() - start;
+
+	printf("%d phandles x %d: scan %lu us, cached %lu us\n", count,
+	       FDT_CACHE_ROUNDS, scan_us, cache_us);
+
+	return 0;
+}
+
+static int lib_test_fdt_cache(struct unit_test_state *uts)
+{
+	const void *fdt = gd->fdt_blob;
+	int size = fdt_totalsize(fdt) + 0x1000;
+	int node, parent;
+	void *copy;
+
+	ut_assertok(check_lookups(uts, fdt, true));
+
+	/* Changing the layout of the tree must not leave stale entries */
+	copy = malloc(size);
+	ut_assertnonnull(copy);
+	ut_assertok(fdt_open_into(fdt, copy, size));
+	gd->fdt_blob = copy;
+	ut_assertok(check_lookups(uts, copy, false));
+
+	parent = fdt_path_offset(copy, "/");
+	ut_assert(parent >= 0);
+	node = fdt_add_subnode(copy, parent, "aaa-first");
+	ut_assert(node >= 0);
+	ut_asserteq(node, fdt_path_offset(copy, "/aaa-first"));
+	ut_assertok(check_lookups(uts, copy, false));
+
+	ut_assertok(fdt_del_node(copy, node));
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(copy, "/aaa-first"));
+	ut_assertok(check_lookups(uts, copy, false));
+
+	gd->fdt_blob = fdt;
+	free(copy);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_fdt_cache, 0);
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the I/O buffer pool
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <iobuf.h>
+#include <malloc.h>
+#include <rand.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of the region used for each test pool */
+#define POOL_SIZE	SZ_1M
+
+/* Number of buffers and operations used by the random test */
+#define RAND_BUFS	32
+#define RAND_ROUNDS	2000
+
+#define PAGE		IOBUF_PAGE_SIZE
+
+static int lib_test_iobuf(struct unit_test_state *uts)
+{
+	struct iobuf_stats stats;
+	struct iobuf_pool pool;
+	void *region, *a, *b, *c, *d;
+	ulong size;
+
+	region = malloc(POOL_SIZE);
+	ut_assertnonnull(region);
+	ut_asserteq(-ENOSPC, iobuf_pool_init(&pool, region, PAGE));
+	/* An unaligned region is trimmed to whole pages */
+	ut_assertok(iobuf_pool_init(&pool, region + 1, POOL_SIZE - 1));
+	iobuf_pool_get_stats(&pool, &stats);
+	size = stats.size;
+	ut_assert(size > POOL_SIZE - 4 * PAGE);
+	ut_asserteq(size, stats.largest_free);
+	ut_asserteq(0, stats.used);
+
+	a = iobuf_pool_alloc(&pool, 1);
+	b = iobuf_pool_alloc(&pool, 3 * PAGE);
+	c = iobuf_pool_alloc(&pool, PAGE + 1);
+	ut_assertnonnull(a);
+	ut_assertnonnull(b);
+	ut_assertnonnull(c);
+	ut_assertok((ulong)a % PAGE);
+	ut_asserteq_ptr(a + PAGE, b);
+	ut_asserteq_ptr(b + 3 * PAGE, c);
+	iobuf_pool_get_stats(&pool, &stats);
+	ut_asserteq(6 * PAGE, stats.used);
+	ut_asserteq(3, stats.count);
+
+	/* Only the start of an allocated buffer can be freed, once */
+	ut_asserteq(-ENOENT, iobuf_pool_free(&pool, region));
+	ut_asserteq(-ENOENT, iobuf_pool_free(&pool, b + 1));
+	ut_asserteq(-ENOENT, iobuf_pool_free(&pool, b + PAGE));
+	ut_asserteq(-ENOENT, iobuf_pool_free(&pool, b + 2 * PAGE));
+	ut_asserteq(-ENOENT, iobuf_pool_free(&pool, c + PAGE));
+	ut_asserteq(-ENOENT, iobuf_pool_free(&pool, c + 2 * PAGE));
+	ut_assertok(iobuf_pool_free(&pool, b));
+	ut_asserteq(-ENOENT, iobuf_pool_free(&pool, b));
+
+	/* The smallest hole which fits is used, not the large one at the end */
+	d = iobuf_pool_alloc(&pool, 2 * PAGE);
+	ut_asserteq_ptr(b, d);
+	ut_assertnull(iobuf_pool_alloc(&pool, size));
+	iobuf_pool_get_stats(&pool, &stats);
+	ut_asserteq(1, stats.fails);
+	ut_asserteq(4, stats.allocs);
+	ut_asserteq(6 * PAGE, stats.peak);
+	ut_asserteq(size - 6 * PAGE, stats.largest_free);
+
+	/* Freed buffers merge with their neighbours on both sides */
+	ut_assertok(iobuf_pool_free(&pool, a));
+	ut_assertok(iobuf_pool_free(&pool, c));
+	ut_assertok(iobuf_pool_free(&pool, d));
+	iobuf_pool_get_stats(&pool, &stats);
+	ut_asserteq(0, stats.used);
+	ut_asserteq(0, stats.count);
+	ut_asserteq(size, stats.largest_free);
+	ut_asserteq_ptr(a, iobuf_pool_alloc(&pool, size));
+	free(region);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_iobuf, 0);
+
+/* Allocate and free buffers at random, checking that they do not overlap */
+static int lib_test_iobuf_random(struct unit_test_state *uts)
+{
+	struct iobuf_stats stats;
+	struct iobuf_pool pool;
+	u8 *bufs[RAND_BUFS];
+	ulong sizes[RAND_BUFS];
+	void *region;
+	ulong used = 0;
+	int i, j, k;
+
+	region = malloc(POOL_SIZE);
+	ut_assertnonnull(region);
+	ut_assertok(iobuf_pool_init(&pool, region, POOL_SIZE));
+	memset(bufs, '\0', sizeof(bufs));
+	srand(1);
+
+	for (i = 0; i < RAND_ROUNDS; i++) {
+		j = rand() % RAND_BUFS;
+		if (bufs[j]) {
+			/* The buffer must still hold what was written to it */
+			for (k = 0; k < sizes[j]; k += PAGE / 4)
+				ut_asserteq(j, bufs[j][k]);
+			ut_assertok(iobuf_pool_free(&pool, bufs[j]));
+			used -= ALIGN(sizes[j], PAGE);
+			bufs[j] = NULL;
+			continue;
+		}
+		sizes[j] = 1 + rand() % (POOL_SIZE / 16);
+		bufs[j] = iobuf_pool_alloc(&pool, sizes[j]);
+		if (!bufs[j])
+			continue;
+		memset(bufs[j], j, sizes[j]);
+		used += ALIGN(sizes[j], PAGE);
+		iobuf_pool_get_stats(&pool, &stats);
+		ut_asserteq(used, stats.used);
+	}
+
+	for (j = 0; j < RAND_BUFS; j++) {
+		if (bufs[j])
+			ut_assertok(iobuf_pool_free(&pool, bufs[j]));
+	}
+	iobuf_pool_get_stats(&pool, &stats);
+	ut_asserteq(0, stats.used);
+	ut_asserteq(stats.size, stats.largest_free);
+	free(region);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_iobuf_random, 0);
@@ -8,6 +8,7 @@
 #include <lmb.h>
 #include <log.h>
 #include <malloc.h>
+#include <rand.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -659,3 +660,132 @@ static int lib_test_lmb_get_free_size(struct unit_test_state *uts)
 
 DM_TEST(lib_test_lmb_get_free_size,
 	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Simulated RAM for the stress test, in units of STRESS_UNIT bytes */
+#define STRESS_UNIT	0x1000
+#define STRESS_UNITS	4096
+#define STRESS_ROUNDS	5000
+
+/* Check that the reserved regions match @map, which has a byte per unit */
+static int check_lmb_map(struct unit_test_state *uts, struct lmb *lmb,
+			 phys_addr_t ram, const u8 *map)
+{
+	unsigned long r = 0;
+	int u, end;
+
+	for (u = 0; u < STRESS_UNITS; u = end) {
+		for (end = u; end < STRESS_UNITS && map[end] == map[u]; end++)
+			;
+		if (!map[u])
+			continue;
+		/* Each run of reserved units must be a single region */
+		ut_assert(r < lmb->reserved.cnt);
+		ut_asserteq(ram + u * STRESS_UNIT, lmb->reserved.region[r].base);
+		ut_asserteq((end - u) * STRESS_UNIT,
+			    lmb->reserved.region[r].size);
+		r++;
+	}
+	ut_asserteq(r, lmb->reserved.cnt);
+
+	return 0;
+}
+
+/* Find where lmb_alloc() should put @len units, or return -1 if nowhere */
+static int find_top_fit(const u8 *map, int len, int align)
+{
+	int u, i;
+
+	for (u = (STRESS_UNITS - len) / align * align; u >= 0; u -= align) {
+		for (i = 0; i < len && !map[u + i]; i++)
+			;
+		if (i == len)
+			return u;
+	}
+
+	return -1;
+}
+
+/*
+ * Reserve, free and allocate at random, with far more regions than fit in
+ * struct lmb_region, checking the result of each call against a simple map
+ */
+static int lib_test_lmb_stress(struct unit_test_state *uts)
+{
+	const phys_addr_t ram = 0x40000000;
+	unsigned long max_cnt = 0;
+	int i, u, len, busy, align, expect;
+	phys_addr_t addr;
+	struct lmb lmb;
+	long ret;
+	u8 *map;
+
+	map = calloc(STRESS_UNITS, 1);
+	ut_assertnonnull(map);
+	lmb_init(&lmb);
+
+	/* Memory banks are sorted however they are added */
+	for (i = 63; i >= 0; i--)
+		ut_asserteq(0, lmb_add(&lmb, ram + i * 2 * STRESS_UNIT,
+				       STRESS_UNIT));
+	ut_asserteq(64, lmb.memory.cnt);
+	for (i = 0; i < 64; i++)
+		ut_asserteq(ram + i * 2 * STRESS_UNIT,
+			    lmb.memory.region[i].base);
+	lmb_uninit(&lmb);
+	ut_asserteq(0, lmb.memory.cnt);
+
+	ut_asserteq(0, lmb_add(&lmb, ram, STRESS_UNITS * STRESS_UNIT));
+	srand(1);
+	for (i = 0; i < STRESS_ROUNDS; i++) {
+		u = rand() % STRESS_UNITS;
+		len = 1 + rand() % min(16, STRESS_UNITS - u);
+		for (busy = 0, expect = u; expect < u + len; expect++)
+			busy += map[expect];
+		addr = ram + u * STRESS_UNIT;
+
+		switch (rand() % 3) {
+		case 0:
+			ret = lmb_reserve(&lmb, addr, len * STRESS_UNIT);
+			if (!busy) {
+				ut_assert(ret >= 0);
+				memset(map + u, 1, len);
+			} else if (busy == len && (!u || !map[u - 1]) &&
+				   (u + len == STRESS_UNITS || !map[u + len])) {
+				/* Reserving an existing region again is OK */
+				ut_asserteq(0, ret);
+			} else {
+				ut_asserteq(-1, ret);
+			}
+			break;
+		case 1:
+			ret = lmb_free(&lmb, addr, len * STRESS_UNIT);
+			ut_asserteq(busy == len ? 0 : -1, ret);
+			if (!ret)
+				memset(map + u, 0, len);
+			break;
+		default:
+			align = 1 << (rand() % 4);
+			expect = find_top_fit(map, len, align);
+			addr = __lmb_alloc_base(&lmb, len * STRESS_UNIT,
+						align * STRESS_UNIT, 0);
+			if (expect < 0) {
+				ut_asserteq(0, addr);
+			} else {
+				ut_asserteq(ram + expect * STRESS_UNIT, addr);
+				memset(map + expect, 1, len);
+			}
+			break;
+		}
+		ut_assertok(check_lmb_map(uts, &lmb, ram, map));
+		ut_asserteq(map[u], lmb_is_reserved(&lmb, ram + u * STRESS_UNIT));
+		max_cnt = max(max_cnt, lmb.reserved.cnt);
+	}
+	ut_assert(max_cnt > MAX_LMB_REGIONS);
+
+	lmb_uninit(&lmb);
+	free(map);
+
+	return 0;
+}
+
+DM_TEST(lib_test_lmb_stress, 0);
@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing sparse and raw images as they are received
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <image-sparse.h>
+#include <rand.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Storage block size, and that of the sparse image, in bytes */
+#define BLKSZ		512
+#define SPARSE_BLKSZ	1024
+
+/* Size of the disk and of the partition on it, in blocks */
+#define DISK_BLKS	64
+#define PART_START	4
+#define PART_BLKS	48
+
+/* Longest piece of the image given to sparse_stream_write() */
+#define MAX_PIECE	700
+
+/* Size of an erase group, in blocks */
+#define ERASE_GRP	4
+
+#define SPARSE_BLKS(n)	((n) * SPARSE_BLKSZ / BLKSZ)
+
+static u8 disk[DISK_BLKS * BLKSZ];
+static u8 expect[DISK_BLKS * BLKSZ];
+static u8 image[PART_BLKS * BLKSZ + 512];
+static u8 image_copy[sizeof(image)];
+
+/* Number of calls to write and blocks erased */
+static int writes;
+static lbaint_t erased;
+
+static lbaint_t test_write(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	memcpy(disk + blk * BLKSZ, buffer, blkcnt * BLKSZ);
+	writes++;
+
+	return blkcnt;
+}
+
+static lbaint_t test_erase(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt)
+{
+	/* Only whole erase groups may be erased */
+	if (blk % ERASE_GRP || blkcnt % ERASE_GRP)
+		return 0;
+	memset(disk + blk * BLKSZ, '\0', blkcnt * BLKSZ);
+	erased += blkcnt;
+
+	return blkcnt;
+}
+
+static lbaint_t test_reserve(struct sparse_storage *info, lbaint_t blk,
+			     lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static void test_storage(struct sparse_storage *info)
+{
+	memset(info, '\0', sizeof(*info));
+	info->blksz = BLKSZ;
+	info->start = PART_START;
+	info->size = PART_BLKS;
+	info->write = test_write;
+	info->reserve = test_reserve;
+	memset(disk, 0xaa, sizeof(disk));
+	memcpy(expect, disk, sizeof(disk));
+	writes = 0;
+	erased = 0;
+}
+
+static u8 *add_chunk(u8 *p, u16 type, u32 blks, u32 data_sz)
+{
+	chunk_header_t *chunk = (chunk_header_t *)p;
+
+	chunk->chunk_type = type;
+	chunk->reserved1 = 0;
+	chunk->chunk_sz = blks;
+	chunk->total_sz = sizeof(*chunk) + data_sz;
+
+	return p + sizeof(*chunk);
+}
+
+/*
+ * Builds a sparse image of each chunk type and fills in what it should write
+ * to the disk. Returns the size of the image.
+ */
+static ulong build_sparse(void)
+{
+	sparse_header_t *header = (sparse_header_t *)image;
+	u8 *out = expect + PART_START * BLKSZ;
+	u8 *p = image + sizeof(*header);
+	u32 fill = 0x12345678;
+	int i;
+
+	header->magic = SPARSE_HEADER_MAGIC;
+	header->major_version = 1;
+	header->minor_version = 0;
+	header->file_hdr_sz = sizeof(*header);
+	header->chunk_hdr_sz = sizeof(chunk_header_t);
+	header->blk_sz = SPARSE_BLKSZ;
+	header->total_blks = 10;
+	header->total_chunks = 5;
+	header->image_checksum = 0;
+
+	p = add_chunk(p, CHUNK_TYPE_RAW, 3, 3 * SPARSE_BLKSZ);
+	for (i = 0; i < 3 * SPARSE_BLKSZ; i++)
+		p[i] = rand();
+	memcpy(out, p, 3 * SPARSE_BLKSZ);
+	p += 3 * SPARSE_BLKSZ;
+	out += 3 * SPARSE_BLKSZ;
+
+	p = add_chunk(p, CHUNK_TYPE_FILL, 2, sizeof(fill));
+	memcpy(p, &fill, sizeof(fill));
+	p += sizeof(fill);
+	for (i = 0; i < 2 * SPARSE_BLKSZ; i += sizeof(fill))
+		memcpy(out + i, &fill, sizeof(fill));
+	out += 2 * SPARSE_BLKSZ;
+
+	/* Left as it was on the disk */
+	p = add_chunk(p, CHUNK_TYPE_DONT_CARE, 4, 0);
+	out += 4 * SPARSE_BLKSZ;
+
+	p = add_chunk(p, CHUNK_TYPE_RAW, 1, SPARSE_BLKSZ);
+	for (i = 0; i < SPARSE_BLKSZ; i++)
+		p[i] = rand();
+	memcpy(out, p, SPARSE_BLKSZ);
+	p += SPARSE_BLKSZ;
+
+	p = add_chunk(p, CHUNK_TYPE_CRC32, 0, sizeof(u32));
+	memset(p, '\0', sizeof(u32));
+	p += sizeof(u32);
+
+	return p - image;
+}
+
+/* Writes @len bytes of the image in pieces of random sizes */
+static int write_pieces(struct sparse_stream *ss, ulong len, char *response)
+{
+	ulong pos, n;
+
+	for (pos = 0; pos < len; pos += n) {
+		n = min_t(ulong, 1 + rand() % MAX_PIECE, len - pos);
+		if (sparse_stream_write(ss, image + pos, n, response))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int lib_test_sparse_stream(struct unit_test_state *uts)
+{
+	char response[65];
+	struct sparse_storage info;
+	struct sparse_stream ss;
+	ulong len;
+	int round;
+
+	srand(1);
+	for (round = 0; round < 20; round++) {
+		test_storage(&info);
+		len = build_sparse();
+		ut_assertok(sparse_stream_init(&ss, &info, "test", response));
+		ut_assertok(write_pieces(&ss, len, response));
+		ut_assertok(sparse_stream_finish(&ss, response));
+		ut_asserteq_mem(expect, disk, sizeof(disk));
+	}
+
+	/* A truncated image is not complete */
+	test_storage(&info);
+	len = build_sparse();
+	ut_assertok(sparse_stream_init(&ss, &info, "test", response));
+	ut_assertok(write_pieces(&ss, len - sizeof(u32), response));
+	ut_asserteq(-1, sparse_stream_finish(&ss, response));
+
+	/* Nor is one which writes past the end of the partition */
+	test_storage(&info);
+	len = build_sparse();
+	info.size = SPARSE_BLKS(4);
+	ut_assertok(sparse_stream_init(&ss, &info, "test", response));
+	ut_asserteq(-1, write_pieces(&ss, len, response));
+	ut_asserteq(-1, sparse_stream_finish(&ss, response));
+
+	return 0;
+}
+
+LIB_TEST(lib_test_sparse_stream, 0);
+
+static int lib_test_sparse_stream_raw(struct unit_test_state *uts)
+{
+	char response[65];
+	struct sparse_storage info;
+	struct sparse_stream ss;
+	ulong len = 5 * BLKSZ + 100;
+	int i;
+
+	/* The partial block at the end is padded with zeroes */
+	test_storage(&info);
+	for (i = 0; i < len; i++)
+		image[i] = rand();
+	memcpy(expect + PART_START * BLKSZ, image, len);
+	memset(expect + PART_START * BLKSZ + len, '\0', BLKSZ - 100);
+	ut_assertok(sparse_stream_init(&ss, &info, "test", response));
+	ut_assertok(write_pieces(&ss, len, response));
+	ut_assertok(sparse_stream_finish(&ss, response));
+	ut_asserteq_mem(expect, disk, sizeof(disk));
+
+	/* An image shorter than a sparse header is raw too */
+	test_storage(&info);
+	memcpy(expect + PART_START * BLKSZ, image, 10);
+	memset(expect + PART_START * BLKSZ + 10, '\0', BLKSZ - 10);
+	ut_assertok(sparse_stream_init(&ss, &info, "test", response));
+	ut_assertok(sparse_stream_write(&ss, image, 10, response));
+	ut_assertok(sparse_stream_finish(&ss, response));
+	ut_asserteq_mem(expect, disk, sizeof(disk));
+
+	/* The image must fit in the partition */
+	test_storage(&info);
+	info.size = 4;
+	ut_assertok(sparse_stream_init(&ss, &info, "test", response));
+	ut_asserteq(-1, write_pieces(&ss, len, response));
+	ut_asserteq(-1, sparse_stream_finish(&ss, response));
+
+	return 0;
+}
+
+LIB_TEST(lib_test_sparse_stream_raw, 0);
+
+/*
+ * Builds a sparse image with two raw chunks and a zero fill chunk, whose whole
+ * erase groups are erased. Returns the size of the image.
+ */
+static ulong build_erase(void)
+{
+	sparse_header_t *header = (sparse_header_t *)image;
+	u8 *out = expect + PART_START * BLKSZ;
+	u8 *p = image + sizeof(*header);
+	u32 fill = 0;
+	int i;
+
+	header->magic = SPARSE_HEADER_MAGIC;
+	header->major_version = 1;
+	header->minor_version = 0;
+	header->file_hdr_sz = sizeof(*header);
+	header->chunk_hdr_sz = sizeof(chunk_header_t);
+	header->blk_sz = SPARSE_BLKSZ;
+	header->total_blks = 9;
+	header->total_chunks = 3;
+	header->image_checksum = 0;
+
+	/* Blocks 4 to 9 */
+	for (i = 0; i < 2; i++) {
+		p = add_chunk(p, CHUNK_TYPE_RAW, i + 1, (i + 1) * SPARSE_BLKSZ);
+		memset(p, i + 1, (i + 1) * SPARSE_BLKSZ);
+		memcpy(out, p, (i + 1) * SPARSE_BLKSZ);
+		p += (i + 1) * SPARSE_BLKSZ;
+		out += (i + 1) * SPARSE_BLKSZ;
+	}
+
+	/* Blocks 10 to 21, of which 12 to 19 are erased */
+	p = add_chunk(p, CHUNK_TYPE_FILL, 6, sizeof(fill));
+	memcpy(p, &fill, sizeof(fill));
+	p += sizeof(fill);
+	memset(out, '\0', 6 * SPARSE_BLKSZ);
+
+	return p - image;
+}
+
+static int lib_test_sparse_erase(struct unit_test_state *uts)
+{
+	char response[65];
+	struct sparse_storage info;
+	struct sparse_stream ss;
+	lbaint_t first;
+	ulong len;
+
+	test_storage(&info);
+	info.erase_grp = ERASE_GRP;
+	info.erase = test_erase;
+	ut_asserteq(8, sparse_erase_span(&info, 10, 12, &first));
+	ut_asserteq(12, first);
+	ut_asserteq(0, sparse_erase_span(&info, 9, 6, &first));
+
+	build_erase();
+	memcpy(image_copy, image, sizeof(image));
+	ut_assertok(write_sparse_image(&info, "test", image, response));
+	ut_asserteq_mem(expect, disk, sizeof(disk));
+	/* One write per raw chunk, one each for the ends of the fill */
+	ut_asserteq(4, writes);
+	ut_asserteq(8, erased);
+
+	/* The image is left as it was, so it can be written again */
+	ut_asserteq_mem(image_copy, image, sizeof(image));
+	memset(disk, 0xaa, sizeof(disk));
+	ut_assertok(write_sparse_image(&info, "test", image, response));
+	ut_asserteq_mem(expect, disk, sizeof(disk));
+
+	/* Streamed images are erased the same way */
+	test_storage(&info);
+	info.erase_grp = ERASE_GRP;
+	info.erase = test_erase;
+	len = build_erase();
+	ut_assertok(sparse_stream_init(&ss, &info, "test", response));
+	ut_assertok(write_pieces(&ss, len, response));
+	ut_assertok(sparse_stream_finish(&ss, response));
+	ut_asserteq_mem(expect, disk, sizeof(disk));
+	ut_asserteq(8, erased);
+
+	/* Zeroes are written when the storage cannot erase */
+	test_storage(&info);
+	build_erase();
+	ut_assertok(write_sparse_image(&info, "test", image, response));
+	ut_asserteq_mem(expect, disk, sizeof(disk));
+	ut_asserteq(0, erased);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_sparse_erase, 0);
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Test of the binary log driver
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <common.h>
+#include <console.h>
+#include <log.h>
+#include <asm/global_data.h>
+#include <test/log.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Check the next record, skipping the timestamp in front of it */
+static int check_rec(struct unit_test_state *uts, const char *expect)
+{
+	const char *msg;
+
+	ut_assert(console_record_readline(uts->actual_str,
+					  sizeof(uts->actual_str)) >= 0);
+	msg = strstr(uts->actual_str, "] ");
+	ut_assertnonnull(msg);
+	ut_asserteq_str(expect, msg + 2);
+
+	return 0;
+}
+
+/* Test that records are formatted from their saved arguments */
+static int log_test_binary(struct unit_test_state *uts)
+{
+	int log_level = gd->default_log_level;
+	int log_fmt = gd->log_fmt;
+	char str[16];
+
+	gd->log_fmt = BIT(LOGF_LEVEL) | BIT(LOGF_MSG);
+	gd->default_log_level = LOGL_ERR;
+	ut_assert(log_binary_dump(true) >= 0);
+
+	strcpy(str, "temporary");
+	log_err("int %d %i %u %x %5d|%-5d|%05d\n", -1, 2, 3, 0xab, 4, 5, 6);
+	log_err("long %ld %lu %lld %llx\n", -7L, 8UL, -9LL, 0x1234567890ULL);
+	log_err("short %hd %hu size %zu %zd\n", (short)-10, (unsigned short)11,
+		(size_t)12, (ssize_t)-13);
+	log_err("str '%s' '%.3s' '%8s' '%-*s' %c%%\n", str, str, "abc", 4,
+		"de", 'f');
+	log_err("%*.*d|%o|%X\n", 6, 4, 42, 8, 0xcd);
+	strcpy(str, "overwritten");
+	/* Below the console level, but still recorded */
+	log_info("info %d\n", 14);
+	gd->default_log_level = log_level;
+
+	console_record_reset_enable();
+	ut_asserteq(6, log_binary_dump(false));
+	ut_assertok(check_rec(uts, "ERR. int -1 2 3 ab     4|5    |00006"));
+	ut_assertok(check_rec(uts, "ERR. long -7 8 -9 1234567890"));
+	ut_assertok(check_rec(uts, "ERR. short -10 11 size 12 -13"));
+	ut_assertok(check_rec(uts,
+			      "ERR. str 'temporary' 'tem' '     abc' 'de  ' f%"));
+	ut_assertok(check_rec(uts, "ERR.   0042|10|CD"));
+	ut_assertok(check_rec(uts, "INFO. info 14"));
+	ut_assert_console_end();
+
+	/* Clearing leaves nothing behind */
+	console_record_reset_enable();
+	ut_assertok(run_command("log dump -c", 0));
+	ut_asserteq(0, log_binary_dump(false));
+	gd->log_fmt = log_fmt;
+
+	return 0;
+}
+LOG_TEST_FLAGS(log_test_binary, UT_TESTF_CONSOLE_REC);
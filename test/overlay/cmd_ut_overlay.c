@@ -7,6 +7,7 @@
 #include <common.h>
 #include <command.h>
 #include <errno.h>
+#include <fdt_batch.h>
 #include <fdt_support.h>
 #include <image.h>
 #include <log.h>
@@ -211,6 +212,86 @@ static int fdt_overlay_stacked(struct unit_test_state *uts)
 }
 OVERLAY_TEST(fdt_overlay_stacked, 0);
 
+/* fdt_rw.c leaves the padding after property values as it finds it */
+static void fdt_zero_padding(void *blob)
+{
+	const struct fdt_property *prop;
+	int offset = 0, next, len;
+	u32 tag;
+
+	do {
+		tag = fdt_next_tag(blob, offset, &next);
+		if (tag == FDT_PROP) {
+			prop = fdt_offset_ptr(blob, offset, sizeof(*prop));
+			len = fdt32_to_cpu(prop->len);
+			memset((char *)prop->data + len, '\0',
+			       ALIGN(len, FDT_TAGSIZE) - len);
+		}
+		offset = next;
+	} while (tag != FDT_END);
+}
+
+/* Applying both overlays in one batch gives the same tree */
+static int fdt_overlay_batch(struct unit_test_state *uts)
+{
+	void *base = &__dtb_test_fdt_base_begin;
+	void *ovs[2] = { &__dtb_test_fdt_overlay_begin,
+			 &__dtb_test_fdt_overlay_stacked_begin };
+	void *seq, *out, *copies[2];
+	ulong times[2] = { ~0UL, ~0UL };
+	int i;
+
+	seq = malloc(FDT_COPY_SIZE);
+	ut_assertnonnull(seq);
+	out = malloc(FDT_COPY_SIZE);
+	ut_assertnonnull(out);
+	for (i = 0; i < 2; i++) {
+		copies[i] = malloc(FDT_COPY_SIZE);
+		ut_assertnonnull(copies[i]);
+	}
+
+	ut_assertok(fdt_open_into(base, seq, FDT_COPY_SIZE));
+	for (i = 0; i < 2; i++) {
+		ut_assertok(fdt_open_into(ovs[i], copies[i], FDT_COPY_SIZE));
+		ut_assertok(fdt_overlay_apply(seq, copies[i]));
+	}
+
+	ut_assertok(fdt_open_into(base, out, FDT_COPY_SIZE));
+	for (i = 0; i < 2; i++)
+		ut_assertok(fdt_open_into(ovs[i], copies[i], FDT_COPY_SIZE));
+	ut_assertok(fdt_overlay_apply_list(out, FDT_COPY_SIZE, copies, 2,
+					   times));
+	for (i = 0; i < 2; i++) {
+		ut_assert(times[i] != ~0UL);
+		ut_asserteq(-FDT_ERR_BADMAGIC, fdt_check_header(copies[i]));
+	}
+
+	fdt_zero_padding(seq);
+	ut_asserteq(FDT_COPY_SIZE, fdt_totalsize(out));
+	ut_asserteq(fdt_off_dt_strings(seq), fdt_off_dt_strings(out));
+	ut_asserteq_mem(seq, out,
+			fdt_off_dt_strings(seq) + fdt_size_dt_strings(seq));
+
+	/* The stacked overlay needs the first; on error the base is kept */
+	ut_assertok(fdt_open_into(base, out, FDT_COPY_SIZE));
+	ut_assertok(fdt_open_into(base, seq, FDT_COPY_SIZE));
+	ut_assertok(fdt_open_into(ovs[1], copies[1], FDT_COPY_SIZE));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_overlay_apply_list(out, FDT_COPY_SIZE, &copies[1], 1,
+					   NULL));
+	ut_asserteq_mem(seq, out,
+			fdt_off_dt_strings(seq) + fdt_size_dt_strings(seq));
+
+	for (i = 0; i < 2; i++)
+		free(copies[i]);
+	free(out);
+	free(seq);
+
+	return CMD_RET_SUCCESS;
+}
+
+OVERLAY_TEST(fdt_overlay_batch, 0);
+
 int do_ut_overlay(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	struct unit_test *tests = ll_entry_start(struct unit_test,
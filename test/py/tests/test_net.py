@@ -55,6 +55,18 @@ env__net_nfs_readable_file = {
     'size': 5058624,
     'crc32': 'c2244b26',
 }
+
+# Details regarding a file that may be read from a HTTP server, on port
+# httpdstp if that is set. This variable may be omitted or set to None if wget
+# testing is not possible or desired. If the server supports range requests,
+# 'range' gives an offset and size to load, and the CRC32 of that part.
+env__net_wget_readable_file = {
+    'fn': 'ubtest-readable.bin',
+    'addr': 0x10000000,
+    'size': 5058624,
+    'crc32': 'c2244b26',
+    'range': (0x100000, 0x10000, '0ffb58d7'),
+}
 """
 
 net_set_up = False
@@ -206,3 +218,52 @@ def test_net_nfs(u_boot_console):
 
     output = u_boot_console.run_command('crc32 %x $filesize' % addr)
     assert expected_crc in output
+
+@pytest.mark.buildconfigspec('cmd_wget')
+def test_net_wget(u_boot_console):
+    """Test the wget command.
+
+    A file is downloaded from the HTTP server, its size and optionally its
+    CRC32 are validated. Optionally, a part of it is downloaded too.
+
+    The details of the file to download are provided by the boardenv_* file;
+    see the comment at the beginning of this file.
+    """
+
+    if not net_set_up:
+        pytest.skip('Network not initialized')
+
+    f = u_boot_console.config.env.get('env__net_wget_readable_file', None)
+    if not f:
+        pytest.skip('No HTTP readable file to read')
+
+    addr = f.get('addr', None)
+    if not addr:
+        addr = u_boot_utils.find_ram_base(u_boot_console)
+
+    fn = f['fn']
+    output = u_boot_console.run_command('wget %x %s' % (addr, fn))
+    expected_text = 'Bytes transferred = '
+    sz = f.get('size', None)
+    if sz:
+        expected_text += '%d' % sz
+    assert expected_text in output
+
+    if u_boot_console.config.buildconfig.get('config_cmd_crc32', 'n') != 'y':
+        return
+
+    expected_crc = f.get('crc32', None)
+    if expected_crc:
+        output = u_boot_console.run_command('crc32 %x $filesize' % addr)
+        assert expected_crc in output
+
+    part = f.get('range', None)
+    if not part:
+        return
+
+    offset, size, expected_crc = part
+    output = u_boot_console.run_command('wget %x %s %x %x' %
+                                        (addr, fn, offset, size))
+    assert 'Bytes transferred = %d' % size in output
+    output = u_boot_console.run_command('crc32 %x %x' % (addr, size))
+    assert expected_crc in output
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Append a pre-unflattened live tree image to a DTB
+ *
+ * The output is the input DTB, padded to OF_LIVE_IMAGE_ALIGN, followed by
+ * the image created by of_live_image_create(). U-Boot uses the image to set
+ * up its live tree without unflattening the DTB (see CONFIG_OF_LIVE_IMAGE).
+ *
+ * (C) Copyright 2021 Semidrive Electronics Co., Ltd.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fdt_host.h"
+#include "imagetool.h"
+#include <of_live.h>
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-v] <input.dtb> <output>\n", prog);
+	fprintf(stderr, "\t-v\tshow the size of the live tree image\n");
+	exit(EXIT_FAILURE);
+}
+
+static void *read_file(const char *fname, long *sizep)
+{
+	FILE *fp;
+	void *buf;
+	long size;
+
+	fp = fopen(fname, "rb");
+	if (!fp) {
+		fprintf(stderr, "Cannot open %s: %s\n", fname, strerror(errno));
+		return NULL;
+	}
+	size = fseek(fp, 0, SEEK_END) ? -1 : ftell(fp);
+	if (size < 0 || fseek(fp, 0, SEEK_SET)) {
+		fprintf(stderr, "Cannot size %s: %s\n", fname, strerror(errno));
+		fclose(fp);
+		return NULL;
+	}
+	buf = malloc(size);
+	if (!buf || fread(buf, 1, size, fp) != size) {
+		fprintf(stderr, "Cannot read %s\n", fname);
+		free(buf);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	*sizep = size;
+
+	return buf;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prog = argv[0];
+	void *fdt, *out;
+	int verbose = 0;
+	int ret, fdt_size, out_size;
+	long size;
+	FILE *fp;
+
+	if (argc > 1 && !strcmp(argv[1], "-v")) {
+		verbose = 1;
+		argc--;
+		argv++;
+	}
+	if (argc != 3)
+		usage(prog);
+
+	fdt = read_file(argv[1], &size);
+	if (!fdt)
+		return EXIT_FAILURE;
+	if (size < sizeof(struct fdt_header) ||
+	    fdt_check_header(fdt) || fdt_totalsize(fdt) > size) {
+		fprintf(stderr, "%s: not a valid DTB\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	ret = of_live_image_create(fdt, NULL, 0);
+	if (ret < 0) {
+		fprintf(stderr, "%s: cannot create live tree image: %s\n",
+			argv[1], fdt_strerror(ret));
+		return EXIT_FAILURE;
+	}
+	fdt_size = ALIGN(fdt_totalsize(fdt), OF_LIVE_IMAGE_ALIGN);
+	out_size = fdt_size + ret;
+	out = calloc(1, out_size);
+	if (!out) {
+		fprintf(stderr, "Out of memory\n");
+		return EXIT_FAILURE;
+	}
+	memcpy(out, fdt, fdt_totalsize(fdt));
+	ret = of_live_image_create(fdt, out + fdt_size, out_size - fdt_size);
+	if (ret < 0) {
+		fprintf(stderr, "%s: cannot create live tree image: %s\n",
+			argv[1], fdt_strerror(ret));
+		return EXIT_FAILURE;
+	}
+	if (verbose) {
+		const struct of_live_image_header *hdr = out + fdt_size;
+
+		printf("%s: %u nodes, %u properties, image %d bytes\n",
+		       argv[2], fdt32_to_cpu(hdr->num_nodes),
+		       fdt32_to_cpu(hdr->num_props), ret);
+	}
+
+	fp = fopen(argv[2], "wb");
+	if (!fp || fwrite(out, 1, out_size, fp) != out_size || fclose(fp)) {
+		fprintf(stderr, "Cannot write %s: %s\n", argv[2],
+			strerror(errno));
+		return EXIT_FAILURE;
+	}
+	free(out);
+	free(fdt);
+
+	return 0;
+}
@@ -31,6 +31,9 @@ struct func_info {
 	const char *name;
 	unsigned long code_size;
 	unsigned long call_count;
+	unsigned long sample_self;	/* Samples with the PC in this function */
+	unsigned long sample_total;	/* Samples with this function on stack */
+	int last_sample;		/* Last sample counted in sample_total */
 	unsigned flags;
 	/* the section this function is in */
 	struct objsection_info *objsection;
@@ -55,6 +58,8 @@ struct func_info *func_list;
 int func_count;
 struct trace_call *call_list;
 int call_count;
+struct trace_sample *sample_list;
+int sample_count;
 int verbose;	/* Verbosity level 0=none, 1=warn, 2=notice, 3=info, 4=debug */
 unsigned long text_offset;		/* text address of first function */
 
@@ -85,6 +90,7 @@ static void usage(void)
 		"\n"
 		"Commands\n"
 		"   dump-ftrace\t\tDump out textual data in ftrace format\n"
+		"   dump-samples\tDump out a histogram of profiler samples\n"
 		"\n"
 		"Options:\n"
 		"   -m <map>\tSpecify Systen.map file\n"
@@ -226,6 +232,19 @@ static int read_calls(FILE *fin, size_t count)
 	return 0;
 }
 
+static int read_samples(FILE *fin, size_t count)
+{
+	notice("sample count: %zu\n", count);
+	sample_list = calloc(count, sizeof(*sample_list));
+	if (!sample_list) {
+		error("Cannot allocate sample_list\n");
+		return -1;
+	}
+	sample_count = count;
+
+	return read_data(fin, sample_list, count * sizeof(*sample_list));
+}
+
 static int read_profile(FILE *fin, int *not_found)
 {
 	struct trace_output_hdr hdr;
@@ -249,6 +268,11 @@ static int read_profile(FILE *fin, int *not_found)
 			if (read_calls(fin, hdr.rec_count))
 				return 1;
 			break;
+
+		case TRACE_CHUNK_SAMPLES:
+			if (read_samples(fin, hdr.rec_count))
+				return 1;
+			break;
 		}
 	}
 	return 0;
@@ -532,6 +556,77 @@ static int make_ftrace(void)
 	return 0;
 }
 
+/* Count a sample against the function containing offset, once per sample */
+static void add_sample(uint32_t offset, int sample, int is_pc)
+{
+	struct func_info *func;
+
+	if (!offset)
+		return;
+	func = find_caller_by_offset(offset);
+	if (!func || offset < func->offset ||
+	    offset >= func->offset + func->code_size)
+		return;
+	if (is_pc)
+		func->sample_self++;
+	if (func->last_sample != sample) {
+		func->sample_total++;
+		func->last_sample = sample;
+	}
+}
+
+static int h_cmp_samples(const void *v1, const void *v2)
+{
+	const struct func_info *f1 = v1, *f2 = v2;
+
+	if (f1->sample_self != f2->sample_self)
+		return f1->sample_self < f2->sample_self ? 1 : -1;
+
+	return f1->sample_total < f2->sample_total ? 1 :
+		f1->sample_total > f2->sample_total ? -1 : 0;
+}
+
+/*
+ * Print a flat profile from the sampling profiler. 'Self' counts the samples
+ * taken inside each function; 'Total' also counts those taken in anything it
+ * called, as far as the recorded link register and call chain go.
+ */
+static int make_sample_hist(void)
+{
+	struct func_info *func, *end;
+	struct trace_sample *sample;
+	int i, j;
+
+	if (!sample_count) {
+		error("No samples in profile data\n");
+		return -1;
+	}
+
+	for (func = func_list, end = func + func_count; func < end; func++)
+		func->last_sample = -1;
+	for (i = 0, sample = sample_list; i < sample_count; i++, sample++) {
+		add_sample(sample->pc, i, 1);
+		add_sample(sample->lr, i, 0);
+		for (j = 0; j < TRACE_SAMPLE_DEPTH; j++)
+			add_sample(sample->caller[j], i, 0);
+	}
+
+	/* This reorders func_list, so it must be the last command */
+	qsort(func_list, func_count, sizeof(*func_list), h_cmp_samples);
+	printf("%8s %7s %8s %7s  %s\n", "Self", "%", "Total", "%",
+	       "Function");
+	for (func = func_list, end = func + func_count; func < end; func++) {
+		if (!func->sample_total)
+			continue;
+		printf("%8lu %6.2f%% %8lu %6.2f%%  %s\n", func->sample_self,
+		       func->sample_self * 100.0 / sample_count,
+		       func->sample_total,
+		       func->sample_total * 100.0 / sample_count, func->name);
+	}
+
+	return 0;
+}
+
 static int prof_tool(int argc, char *const argv[],
 		     const char *prof_fname, const char *map_fname,
 		     const char *trace_config_fname)
@@ -552,6 +647,8 @@ static int prof_tool(int argc, char *const argv[],
 
 		if (0 == strcmp(cmd, "dump-ftrace"))
 			err = make_ftrace();
+		else if (!strcmp(cmd, "dump-samples"))
+			err = make_sample_hist();
 		else
 			warn("Unknown command '%s'\n", cmd);
 	}